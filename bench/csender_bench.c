@@ -0,0 +1,812 @@
+#include "allocation_check.h"
+#include "event.h"
+#include "format.h"
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_MAX_RESULTS 64
+#define BENCH_NAME_LENGTH 64
+
+struct bench_arguments
+{
+  const char* output_filename;
+  const char* filter;
+  long        min_time_ms;
+  int         repetitions;
+};
+
+struct bench_case
+{
+  char                        name[ BENCH_NAME_LENGTH ];
+  void                        ( *function )( const struct bench_case* ap_case,
+                                             long a_iterations );
+  size_t                      event_length;
+  enum csender_clock_source   clock_source;
+  enum csender_timezone       timezone;
+  enum csender_framing        framing;
+  uint64_t                    value;
+};
+
+struct bench_result
+{
+  char   name[ BENCH_NAME_LENGTH ];
+  size_t event_length;
+  long   iterations;
+  double min_ns_per_op;
+  double median_ns_per_op;
+  double mean_ns_per_op;
+};
+
+// Every benchmarked function writes here, so that the compiler cannot drop
+// the calls being measured.
+static char g_sink_buffer[ CSENDER_EVENT_BUFFER_LENGTH ];
+static volatile char g_sink;
+
+
+long long now_ns( )
+{
+  struct timespec time_spec;
+  clock_gettime( CLOCK_MONOTONIC, &time_spec );
+
+  return ( long long ) time_spec.tv_sec * 1000000000LL + time_spec.tv_nsec;
+}
+
+
+void bench_timestamp_rfc3339( const struct bench_case* ap_case,
+                              long a_iterations )
+{
+  struct csender_timestamp_context* p_context =
+      csender_timestamp_context_create( ap_case->clock_source,
+                                        ap_case->timezone );
+  if( p_context == NULL )
+  {
+    return;
+  }
+
+  bool second_changed = false;
+
+  for( long i = 0; i < a_iterations; i++ )
+  {
+    csender_timestamp_rfc3339( p_context, g_sink_buffer, &second_changed );
+  }
+
+  csender_timestamp_context_destroy( p_context );
+  g_sink = g_sink_buffer[ 0 ];
+}
+
+
+// Worst case: a new second on every call, so the cached prefix never helps
+void bench_timestamp_rollover( const struct bench_case* ap_case,
+                               long a_iterations )
+{
+  struct csender_timestamp_context* p_context =
+      csender_timestamp_context_create( CSENDER_CLOCK_REALTIME,
+                                        ap_case->timezone );
+  if( p_context == NULL )
+  {
+    return;
+  }
+
+  struct timespec time;
+  clock_gettime( CLOCK_REALTIME, &time );
+
+  for( long i = 0; i < a_iterations; i++ )
+  {
+    time.tv_sec++;
+    csender_timestamp_rfc3339_at( p_context, &time, g_sink_buffer, NULL );
+  }
+
+  csender_timestamp_context_destroy( p_context );
+  g_sink = g_sink_buffer[ 0 ];
+}
+
+
+void bench_generate_event_body( const struct bench_case* ap_case,
+                                long a_iterations )
+{
+  uint64_t random_state = 1;
+  size_t body_length = ap_case->event_length - ( SYSLOG_HEADER_LENGTH + 1 );
+
+  for( long i = 0; i < a_iterations; i++ )
+  {
+    generate_event_body( body_length, &random_state, g_sink_buffer );
+  }
+
+  g_sink = g_sink_buffer[ 0 ];
+}
+
+
+void bench_generate_event( const struct bench_case* ap_case,
+                           long a_iterations )
+{
+  char timestamp[ DATETIME_LENGTH ];
+  struct timespec now;
+  clock_gettime( CLOCK_REALTIME, &now );
+
+  struct csender_timestamp_context* p_context =
+      csender_timestamp_context_create( CSENDER_CLOCK_REALTIME,
+                                        CSENDER_TIMEZONE_UTC );
+  int timestamp_length = -1;
+  if( p_context != NULL )
+  {
+    timestamp_length =
+        csender_timestamp_rfc3339_at( p_context, &now, timestamp, NULL );
+    csender_timestamp_context_destroy( p_context );
+  }
+
+  if( timestamp_length < 0 )
+  {
+    return;
+  }
+
+  struct csender_generator_options options;
+  memset( &options, 0, sizeof options );
+  options.framing = ap_case->framing;
+  struct event_template template;
+  event_template_init( &template, &options );
+  uint64_t random_state = 1;
+
+  for( long i = 0; i < a_iterations; i++ )
+  {
+    generate_event( g_sink_buffer,
+                    timestamp,
+                    timestamp_length,
+                    i,
+                    ap_case->event_length,
+                    0,
+                    NULL,
+                    &template,
+                    &random_state );
+  }
+
+  g_sink = g_sink_buffer[ 0 ];
+}
+
+
+// The measured loop of the generator cases. Past the first event, which may
+// still set things up, it must not allocate, as builds with
+// CSENDER_ALLOCATION_CHECK make sure.
+void generate_events( struct csender_generator* ap_generator,
+                      long a_iterations )
+{
+  for( long i = 0; i < a_iterations; i++ )
+  {
+    csender_generator_next( ap_generator, g_sink_buffer, NULL, NULL );
+    if( i == 0 )
+    {
+      allocation_check_begin( );
+    }
+  }
+
+  allocation_check_end( );
+}
+
+
+// Cost of a whole event: a fresh timestamp plus the event built on top of it,
+// as done by the send loop.
+void bench_generator_next( const struct bench_case* ap_case,
+                           long a_iterations )
+{
+  struct csender_generator_options options;
+  memset( &options, 0, sizeof options );
+  options.event_length = ap_case->event_length;
+  options.clock_source = ap_case->clock_source;
+  options.framing = ap_case->framing;
+
+  struct csender_generator* p_generator = csender_generator_create( &options );
+  if( p_generator == NULL )
+  {
+    return;
+  }
+
+  generate_events( p_generator, a_iterations );
+
+  csender_generator_destroy( p_generator );
+  g_sink = g_sink_buffer[ 0 ];
+}
+
+
+// Multi-line bodies of the given no. of lines, as stack traces
+void bench_generator_next_multiline( const struct bench_case* ap_case,
+                                     long a_iterations )
+{
+  struct csender_generator_options options;
+  memset( &options, 0, sizeof options );
+  options.event_length = csender_min_event_length( );
+  options.framing = CSENDER_FRAMING_OCTET_COUNTING;
+  options.body_kind = CSENDER_BODY_MULTILINE;
+  options.min_lines = ( unsigned int ) ap_case->value;
+  options.max_lines = ( unsigned int ) ap_case->value;
+  options.min_line_length = 60;
+  options.max_line_length = 100;
+
+  struct csender_generator* p_generator = csender_generator_create( &options );
+  if( p_generator == NULL )
+  {
+    return;
+  }
+
+  generate_events( p_generator, a_iterations );
+
+  csender_generator_destroy( p_generator );
+  g_sink = g_sink_buffer[ 0 ];
+}
+
+
+// UTF-8 bodies of the default mix, in events of the given length
+void bench_generator_next_utf8( const struct bench_case* ap_case,
+                                long a_iterations )
+{
+  struct csender_generator_options options;
+  memset( &options, 0, sizeof options );
+  options.event_length = ( size_t ) ap_case->value;
+  options.body_kind = CSENDER_BODY_UTF8;
+
+  struct csender_generator* p_generator = csender_generator_create( &options );
+  if( p_generator == NULL )
+  {
+    return;
+  }
+
+  generate_events( p_generator, a_iterations );
+
+  csender_generator_destroy( p_generator );
+  g_sink = g_sink_buffer[ 0 ];
+}
+
+
+// Word bodies of the built-in dictionary, in events of the given length
+void bench_generator_next_words( const struct bench_case* ap_case,
+                                 long a_iterations )
+{
+  struct csender_generator_options options;
+  memset( &options, 0, sizeof options );
+  options.event_length = ( size_t ) ap_case->value;
+  options.body_kind = CSENDER_BODY_WORDS;
+
+  struct csender_generator* p_generator = csender_generator_create( &options );
+  if( p_generator == NULL )
+  {
+    return;
+  }
+
+  generate_events( p_generator, a_iterations );
+
+  csender_generator_destroy( p_generator );
+  g_sink = g_sink_buffer[ 0 ];
+}
+
+
+// Key-value or JSON bodies of the given no. of fields
+void bench_generator_next_structured( const struct bench_case* ap_case,
+                                      long a_iterations,
+                                      enum csender_body_kind a_body_kind )
+{
+  struct csender_generator_options options;
+  memset( &options, 0, sizeof options );
+  options.event_length = csender_min_event_length( );
+  options.body_kind = a_body_kind;
+  options.num_fields = ( unsigned int ) ap_case->value;
+
+  struct csender_generator* p_generator = csender_generator_create( &options );
+  if( p_generator == NULL )
+  {
+    return;
+  }
+
+  generate_events( p_generator, a_iterations );
+
+  csender_generator_destroy( p_generator );
+  g_sink = g_sink_buffer[ 0 ];
+}
+
+
+void bench_generator_next_key_value( const struct bench_case* ap_case,
+                                     long a_iterations )
+{
+  bench_generator_next_structured( ap_case,
+                                   a_iterations,
+                                   CSENDER_BODY_KEY_VALUE );
+}
+
+
+void bench_generator_next_json( const struct bench_case* ap_case,
+                                long a_iterations )
+{
+  bench_generator_next_structured( ap_case, a_iterations, CSENDER_BODY_JSON );
+}
+
+
+// Replay of a pack of JSON bodies of the given no. of fields, against
+// generating them
+void bench_generator_next_replay( const struct bench_case* ap_case,
+                                  long a_iterations )
+{
+  char file_name[] = "/tmp/csender_bench_XXXXXX";
+  int fd = mkstemp( file_name );
+  if( fd < 0 )
+  {
+    return;
+  }
+  close( fd );
+
+  struct csender_generator_options options;
+  memset( &options, 0, sizeof options );
+  options.event_length = csender_min_event_length( );
+  options.body_kind = CSENDER_BODY_JSON;
+  options.num_fields = ( unsigned int ) ap_case->value;
+
+  struct csender_pack* p_pack = NULL;
+  if( csender_pack_write( file_name, &options, 4096 ) == 0 )
+  {
+    p_pack = csender_pack_open( file_name );
+  }
+  unlink( file_name );
+  if( p_pack == NULL )
+  {
+    return;
+  }
+
+  memset( &options, 0, sizeof options );
+  options.p_pack = p_pack;
+  struct csender_generator* p_generator = csender_generator_create( &options );
+  if( p_generator != NULL )
+  {
+    generate_events( p_generator, a_iterations );
+  }
+
+  csender_generator_destroy( p_generator );
+  csender_pack_close( p_pack );
+  g_sink = g_sink_buffer[ 0 ];
+}
+
+
+// Integer formatting kernels, against snprintf(). Values advance on every
+// iteration, so that branch prediction cannot learn a single one.
+void bench_format_u64_snprintf( const struct bench_case* ap_case,
+                                long a_iterations )
+{
+  for( long i = 0; i < a_iterations; i++ )
+  {
+    snprintf( g_sink_buffer, 24, "%lu",
+              ( unsigned long ) ( ap_case->value + i ) );
+  }
+
+  g_sink = g_sink_buffer[ 0 ];
+}
+
+
+void bench_format_u64( const struct bench_case* ap_case, long a_iterations )
+{
+  for( long i = 0; i < a_iterations; i++ )
+  {
+    format_u64( g_sink_buffer, ap_case->value + i );
+  }
+
+  g_sink = g_sink_buffer[ 0 ];
+}
+
+
+void bench_format_sequence_snprintf( const struct bench_case* ap_case,
+                                     long a_iterations )
+{
+  for( long i = 0; i < a_iterations; i++ )
+  {
+    snprintf( g_sink_buffer, 24, "%010lu",
+              ( unsigned long ) ( ap_case->value + i ) );
+  }
+
+  g_sink = g_sink_buffer[ 0 ];
+}
+
+
+void bench_format_sequence( const struct bench_case* ap_case,
+                            long a_iterations )
+{
+  for( long i = 0; i < a_iterations; i++ )
+  {
+    format_u64_fixed( g_sink_buffer,
+                      ap_case->value + i,
+                      SEQUENCE_NUMBER_DIGITS );
+  }
+
+  g_sink = g_sink_buffer[ 0 ];
+}
+
+
+void bench_format_microseconds_snprintf( const struct bench_case* ap_case,
+                                         long a_iterations )
+{
+  ( void ) ap_case;
+  for( long i = 0; i < a_iterations; i++ )
+  {
+    snprintf( g_sink_buffer, 24, "%06ld", i % 1000000 );
+  }
+
+  g_sink = g_sink_buffer[ 0 ];
+}
+
+
+void bench_format_microseconds( const struct bench_case* ap_case,
+                                long a_iterations )
+{
+  ( void ) ap_case;
+  for( long i = 0; i < a_iterations; i++ )
+  {
+    format_microseconds( g_sink_buffer, i % 1000000 );
+  }
+
+  g_sink = g_sink_buffer[ 0 ];
+}
+
+
+size_t build_bench_cases( struct bench_case* ap_cases, size_t a_max_cases )
+{
+  static const size_t event_lengths[] = { 64, 128, 300, 512, 1024 };
+  const size_t num_event_lengths = sizeof event_lengths / sizeof event_lengths[ 0 ];
+  size_t num_cases = 0;
+
+  struct
+  {
+    const char*                 name;
+    void                        ( *function )( const struct bench_case*, long );
+    enum csender_clock_source   clock_source;
+    enum csender_timezone       timezone;
+  }
+  timestamps[] =
+  {
+    { "timestamp_rfc3339/realtime/utc", bench_timestamp_rfc3339,
+      CSENDER_CLOCK_REALTIME, CSENDER_TIMEZONE_UTC },
+    { "timestamp_rfc3339/realtime/local", bench_timestamp_rfc3339,
+      CSENDER_CLOCK_REALTIME, CSENDER_TIMEZONE_LOCAL },
+    { "timestamp_rfc3339/coarse/utc", bench_timestamp_rfc3339,
+      CSENDER_CLOCK_REALTIME_COARSE, CSENDER_TIMEZONE_UTC },
+    { "timestamp_rfc3339/tsc/utc", bench_timestamp_rfc3339,
+      CSENDER_CLOCK_TSC, CSENDER_TIMEZONE_UTC },
+    { "timestamp_rfc3339/rollover/utc", bench_timestamp_rollover,
+      CSENDER_CLOCK_REALTIME, CSENDER_TIMEZONE_UTC },
+    { "timestamp_rfc3339/rollover/local", bench_timestamp_rollover,
+      CSENDER_CLOCK_REALTIME, CSENDER_TIMEZONE_LOCAL },
+  };
+
+  for( size_t i = 0;
+       i < sizeof timestamps / sizeof timestamps[ 0 ] &&
+       num_cases < a_max_cases;
+       i++ )
+  {
+    memset( &( ap_cases[ num_cases ] ), 0, sizeof ap_cases[ num_cases ] );
+    snprintf( ap_cases[ num_cases ].name, BENCH_NAME_LENGTH,
+              "%s", timestamps[ i ].name );
+    ap_cases[ num_cases ].function = timestamps[ i ].function;
+    ap_cases[ num_cases ].clock_source = timestamps[ i ].clock_source;
+    ap_cases[ num_cases ].timezone = timestamps[ i ].timezone;
+    num_cases++;
+  }
+
+  struct
+  {
+    const char*   name;
+    void          ( *function )( const struct bench_case*, long );
+    uint64_t      value;
+  }
+  valued_cases[] =
+  {
+    { "format/length_prefix/snprintf", bench_format_u64_snprintf, 64 },
+    { "format/length_prefix/swar", bench_format_u64, 64 },
+    { "format/u64/snprintf", bench_format_u64_snprintf, 1ULL << 40 },
+    { "format/u64/swar", bench_format_u64, 1ULL << 40 },
+    { "format/sequence/snprintf", bench_format_sequence_snprintf, 1000000 },
+    { "format/sequence/swar", bench_format_sequence, 1000000 },
+    { "format/microseconds/snprintf", bench_format_microseconds_snprintf, 0 },
+    { "format/microseconds/swar", bench_format_microseconds, 0 },
+    { "generator_next/multiline/5", bench_generator_next_multiline, 5 },
+    { "generator_next/multiline/50", bench_generator_next_multiline, 50 },
+    { "generator_next/utf8/300", bench_generator_next_utf8, 300 },
+    { "generator_next/utf8/2000", bench_generator_next_utf8, 2000 },
+    { "generator_next/words/300", bench_generator_next_words, 300 },
+    { "generator_next/words/2000", bench_generator_next_words, 2000 },
+    { "generator_next/kv/10", bench_generator_next_key_value, 10 },
+    { "generator_next/kv/50", bench_generator_next_key_value, 50 },
+    { "generator_next/json/10", bench_generator_next_json, 10 },
+    { "generator_next/json/50", bench_generator_next_json, 50 },
+    { "generator_next/replay/json/10", bench_generator_next_replay, 10 },
+    { "generator_next/replay/json/50", bench_generator_next_replay, 50 },
+  };
+
+  for( size_t i = 0;
+       i < sizeof valued_cases / sizeof valued_cases[ 0 ] &&
+       num_cases < a_max_cases;
+       i++ )
+  {
+    memset( &( ap_cases[ num_cases ] ), 0, sizeof ap_cases[ num_cases ] );
+    snprintf( ap_cases[ num_cases ].name, BENCH_NAME_LENGTH,
+              "%s", valued_cases[ i ].name );
+    ap_cases[ num_cases ].function = valued_cases[ i ].function;
+    ap_cases[ num_cases ].value = valued_cases[ i ].value;
+    num_cases++;
+  }
+
+  for( size_t i = 0; i < num_event_lengths; i++ )
+  {
+    struct
+    {
+      const char*            name;
+      void                   ( *function )( const struct bench_case*, long );
+      enum csender_framing   framing;
+    }
+    stages[] =
+    {
+      { "generate_event_body", bench_generate_event_body, CSENDER_FRAMING_LF },
+      { "generate_event/lf", bench_generate_event, CSENDER_FRAMING_LF },
+      { "generate_event/octet", bench_generate_event,
+        CSENDER_FRAMING_OCTET_COUNTING },
+      { "generator_next/lf", bench_generator_next, CSENDER_FRAMING_LF },
+      { "generator_next/octet", bench_generator_next,
+        CSENDER_FRAMING_OCTET_COUNTING },
+    };
+
+    for( size_t j = 0;
+         j < sizeof stages / sizeof stages[ 0 ] && num_cases < a_max_cases;
+         j++ )
+    {
+      memset( &( ap_cases[ num_cases ] ), 0, sizeof ap_cases[ num_cases ] );
+      snprintf( ap_cases[ num_cases ].name, BENCH_NAME_LENGTH,
+                "%s/%zu", stages[ j ].name, event_lengths[ i ] );
+      ap_cases[ num_cases ].function = stages[ j ].function;
+      ap_cases[ num_cases ].event_length = event_lengths[ i ];
+      ap_cases[ num_cases ].framing = stages[ j ].framing;
+      num_cases++;
+    }
+  }
+
+  return num_cases;
+}
+
+
+int compare_doubles( const void* ap_first, const void* ap_second )
+{
+  double first = *( const double* ) ap_first;
+  double second = *( const double* ) ap_second;
+
+  return ( first > second ) - ( first < second );
+}
+
+
+void run_bench_case( const struct bench_case* ap_case,
+                     const struct bench_arguments* ap_arguments,
+                     struct bench_result* ap_output_result )
+{
+  // Find out how many iterations fill the minimum measurement time, doubling
+  // them from a small warm-up run.
+  long iterations = 16;
+  long long min_time_ns = ap_arguments->min_time_ms * 1000000LL;
+  while( 1 )
+  {
+    long long start_ns = now_ns( );
+    ap_case->function( ap_case, iterations );
+    long long elapsed_ns = now_ns( ) - start_ns;
+
+    if( elapsed_ns >= min_time_ns || iterations >= ( 1L << 30 ) )
+    {
+      break;
+    }
+
+    iterations *= 2;
+  }
+
+  // Then measure the given no. of repetitions
+  double ns_per_op[ ap_arguments->repetitions ];
+  double total_ns_per_op = 0;
+  for( int i = 0; i < ap_arguments->repetitions; i++ )
+  {
+    long long start_ns = now_ns( );
+    ap_case->function( ap_case, iterations );
+    long long elapsed_ns = now_ns( ) - start_ns;
+
+    ns_per_op[ i ] = ( double ) elapsed_ns / iterations;
+    total_ns_per_op += ns_per_op[ i ];
+  }
+
+  qsort( ns_per_op, ap_arguments->repetitions, sizeof ns_per_op[ 0 ],
+         compare_doubles );
+
+  memcpy( ap_output_result->name, ap_case->name, BENCH_NAME_LENGTH );
+  ap_output_result->event_length = ap_case->event_length;
+  ap_output_result->iterations = iterations;
+  ap_output_result->min_ns_per_op = ns_per_op[ 0 ];
+  ap_output_result->median_ns_per_op =
+      ns_per_op[ ap_arguments->repetitions / 2 ];
+  ap_output_result->mean_ns_per_op =
+      total_ns_per_op / ap_arguments->repetitions;
+}
+
+
+void write_json_report( FILE* ap_output,
+                        const struct bench_arguments* ap_arguments,
+                        const struct bench_result* ap_results,
+                        size_t a_num_results )
+{
+  char date[ 32 ];
+  time_t now = time( NULL );
+  struct tm now_tm;
+  gmtime_r( &now, &now_tm );
+  strftime( date, sizeof date, "%FT%TZ", &now_tm );
+
+  char host_name[ 256 ] = "";
+  gethostname( host_name, sizeof host_name - 1 );
+
+  fprintf( ap_output, "{\n" );
+  fprintf( ap_output, "  \"context\": {\n" );
+  fprintf( ap_output, "    \"date\": \"%s\",\n", date );
+  fprintf( ap_output, "    \"host_name\": \"%s\",\n", host_name );
+  fprintf( ap_output, "    \"num_cpus\": %ld,\n",
+           sysconf( _SC_NPROCESSORS_ONLN ) );
+  fprintf( ap_output, "    \"min_time_ms\": %ld,\n",
+           ap_arguments->min_time_ms );
+  fprintf( ap_output, "    \"repetitions\": %d\n",
+           ap_arguments->repetitions );
+  fprintf( ap_output, "  },\n" );
+  fprintf( ap_output, "  \"benchmarks\": [\n" );
+
+  for( size_t i = 0; i < a_num_results; i++ )
+  {
+    fprintf( ap_output,
+             "    { \"name\": \"%s\", \"event_length\": %zu, "
+             "\"iterations\": %ld, \"min_ns_per_op\": %.2f, "
+             "\"median_ns_per_op\": %.2f, \"mean_ns_per_op\": %.2f }%s\n",
+             ap_results[ i ].name,
+             ap_results[ i ].event_length,
+             ap_results[ i ].iterations,
+             ap_results[ i ].min_ns_per_op,
+             ap_results[ i ].median_ns_per_op,
+             ap_results[ i ].mean_ns_per_op,
+             ( i + 1 < a_num_results ) ? "," : "" );
+  }
+
+  fprintf( ap_output, "  ]\n" );
+  fprintf( ap_output, "}\n" );
+}
+
+
+void print_usage( )
+{
+  printf( "csender_bench. Measures the cost of each stage of the event "
+          "generation pipeline.\n" );
+  printf( "usage:\n"
+          "    csender_bench [option]...\n"
+          "options:\n"
+          "    -h, --help         Print this help.\n"
+          "    -o, --output       File to write the JSON report to. Default: standard output.\n"
+          "    -f, --filter       Only run the benchmarks whose name contains the given text.\n"
+          "    -t, --min-time     Minimum time (in ms) of each measurement. Default: 100.\n"
+          "    -r, --repetitions  No. of measurements of each benchmark. Default: 5.\n" );
+}
+
+
+bool process_argument_list( int argc,
+                            char* argv[],
+                            struct bench_arguments* ap_arguments )
+{
+  ap_arguments->output_filename = NULL;
+  ap_arguments->filter = NULL;
+  ap_arguments->min_time_ms = 100;
+  ap_arguments->repetitions = 5;
+
+  struct option long_options[] =
+  {
+  { "help", no_argument, 0, 'h' },
+  { "output", required_argument, 0, 'o' },
+  { "filter", required_argument, 0, 'f' },
+  { "min-time", required_argument, 0, 't' },
+  { "repetitions", required_argument, 0, 'r' },
+  { 0, 0, 0, 0 }
+  };
+
+  int index, opt = 0;
+  while( ( opt =
+           getopt_long( argc, argv, "ho:f:t:r:", long_options, &index ) ) != -1 )
+  {
+    switch( opt )
+    {
+      case 'h':
+      {
+        print_usage( );
+        return false;
+      }
+      case 'o':
+      {
+        ap_arguments->output_filename = optarg;
+        break;
+      }
+      case 'f':
+      {
+        ap_arguments->filter = optarg;
+        break;
+      }
+      case 't':
+      {
+        ap_arguments->min_time_ms = atol( optarg );
+        if( ap_arguments->min_time_ms <= 0 )
+        {
+          printf( "Invalid minimum time.\n" );
+          return false;
+        }
+        break;
+      }
+      case 'r':
+      {
+        ap_arguments->repetitions = atoi( optarg );
+        if( ap_arguments->repetitions <= 0 )
+        {
+          printf( "Invalid no. of repetitions.\n" );
+          return false;
+        }
+        break;
+      }
+      default:
+      {
+        printf( "Unknown option, or option without value.\n" );
+        print_usage( );
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+
+int main( int argc, char* argv[] )
+{
+  struct bench_arguments arguments;
+  if( !process_argument_list( argc, argv, &arguments ) )
+  {
+    exit( 1 );
+  }
+
+  struct bench_case cases[ BENCH_MAX_RESULTS ];
+  size_t num_cases = build_bench_cases( cases, BENCH_MAX_RESULTS );
+
+  struct bench_result results[ BENCH_MAX_RESULTS ];
+  size_t num_results = 0;
+  for( size_t i = 0; i < num_cases; i++ )
+  {
+    if( arguments.filter != NULL &&
+        strstr( cases[ i ].name, arguments.filter ) == NULL )
+    {
+      continue;
+    }
+
+    run_bench_case( &( cases[ i ] ), &arguments, &( results[ num_results ] ) );
+    fprintf( stderr, "%-32s %12.2f ns/op\n",
+             results[ num_results ].name,
+             results[ num_results ].median_ns_per_op );
+    num_results++;
+  }
+
+  FILE* output = stdout;
+  if( arguments.output_filename != NULL )
+  {
+    output = fopen( arguments.output_filename, "w" );
+    if( output == NULL )
+    {
+      perror( "It was not possible to open the output file" );
+      exit( 1 );
+    }
+  }
+
+  write_json_report( output, &arguments, results, num_results );
+
+  if( output != stdout )
+  {
+    fclose( output );
+  }
+
+  return 0;
+}
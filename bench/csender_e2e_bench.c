@@ -0,0 +1,768 @@
+#define _GNU_SOURCE                     // recvmmsg()
+
+#include "csender.h"
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define E2E_MAX_VALUES 16
+#define E2E_MAX_RESULTS 256
+#define E2E_MAX_THREADS 64
+#define E2E_RECEIVE_BUFFER_LENGTH ( 1024 * 1024 )
+#define E2E_DATAGRAMS_PER_RECEIVE 64
+#define E2E_UDP_RECEIVE_BUFFER_LENGTH ( 16 * 1024 * 1024 )
+#define E2E_UDP_LINGER_US 200000      // For the last datagrams to arrive
+
+struct e2e_arguments
+{
+  const char*                output_filename;
+  const char*                markdown_filename;
+  bool                       udp;
+  int                        duration_seconds;
+  int                        batch_size;
+  enum csender_send_engine   engines[ CSENDER_NUM_SEND_ENGINES ];
+  int                        num_engines;
+  long                       event_lengths[ E2E_MAX_VALUES ];
+  int                        num_event_lengths;
+  long                       thread_counts[ E2E_MAX_VALUES ];
+  int                        num_thread_counts;
+};
+
+struct e2e_result
+{
+  enum csender_send_engine   engine;
+  size_t                     event_length;
+  int                        num_threads;
+  bool                       available;       // false if the engine is not,
+                                              // or the case could not be run
+  double                     events_per_second;
+  double                     megabytes_per_second;
+  double                     send_calls_per_event;
+  double                     sender_cpu_ns_per_event;
+  double                     sender_cores;
+  double                     receiver_cores;
+  double                     delivery_ratio;  // Bytes received / sent
+};
+
+// One connection of the receiver, drained by its own thread
+struct e2e_drain
+{
+  pthread_t     thread;
+  int           socket_fd;
+  bool          udp;
+  atomic_long   num_bytes;
+};
+
+
+long long now_ns( )
+{
+  struct timespec time_spec;
+  clock_gettime( CLOCK_MONOTONIC, &time_spec );
+
+  return ( long long ) time_spec.tv_sec * 1000000000LL + time_spec.tv_nsec;
+}
+
+
+long long process_cpu_ns( )
+{
+  struct rusage usage;
+  getrusage( RUSAGE_SELF, &usage );
+
+  return ( usage.ru_utime.tv_sec + usage.ru_stime.tv_sec ) * 1000000000LL +
+         ( usage.ru_utime.tv_usec + usage.ru_stime.tv_usec ) * 1000LL;
+}
+
+
+long long thread_cpu_ns( pthread_t a_thread )
+{
+  clockid_t clock_id;
+  struct timespec time_spec;
+  if( pthread_getcpuclockid( a_thread, &clock_id ) != 0 ||
+      clock_gettime( clock_id, &time_spec ) != 0 )
+  {
+    return 0;
+  }
+
+  return ( long long ) time_spec.tv_sec * 1000000000LL + time_spec.tv_nsec;
+}
+
+
+// The built-in receiver: reads and counts, as fast as it can, until the
+// sender closes the connection, or the socket is shut down. Datagrams are
+// taken many at a time.
+void* drain_main( void* ap_drain )
+{
+  struct e2e_drain* p_drain = ap_drain;
+
+  char* p_buffer = malloc( E2E_RECEIVE_BUFFER_LENGTH );
+  if( p_buffer == NULL )
+  {
+    return NULL;
+  }
+
+  size_t datagram_length = E2E_RECEIVE_BUFFER_LENGTH / E2E_DATAGRAMS_PER_RECEIVE;
+  struct iovec buffers[ E2E_DATAGRAMS_PER_RECEIVE ];
+  struct mmsghdr messages[ E2E_DATAGRAMS_PER_RECEIVE ];
+  memset( messages, 0, sizeof messages );
+  for( int i = 0; i < E2E_DATAGRAMS_PER_RECEIVE; i++ )
+  {
+    buffers[ i ].iov_base = p_buffer + i * datagram_length;
+    buffers[ i ].iov_len = datagram_length;
+    messages[ i ].msg_hdr.msg_iov = &( buffers[ i ] );
+    messages[ i ].msg_hdr.msg_iovlen = 1;
+  }
+
+  while( 1 )
+  {
+    long num_bytes = 0;
+    if( p_drain->udp )
+    {
+      int num_datagrams = recvmmsg( p_drain->socket_fd,
+                                    messages,
+                                    E2E_DATAGRAMS_PER_RECEIVE,
+                                    MSG_WAITFORONE,
+                                    NULL );
+      for( int i = 0; i < num_datagrams; i++ )
+      {
+        num_bytes += messages[ i ].msg_len;
+      }
+    }
+    else
+    {
+      num_bytes = recv( p_drain->socket_fd,
+                        p_buffer,
+                        E2E_RECEIVE_BUFFER_LENGTH,
+                        0 );
+    }
+    if( num_bytes <= 0 )
+    {
+      break;
+    }
+
+    atomic_fetch_add_explicit( &( p_drain->num_bytes ),
+                               num_bytes,
+                               memory_order_relaxed );
+  }
+
+  free( p_buffer );
+
+  return NULL;
+}
+
+
+// Listens (or just binds, for UDP) on an ephemeral port of localhost, and
+// tells which one. Returns the socket, or -1 on error.
+int open_receiver( bool a_udp, char* a_output_service_name, size_t a_length )
+{
+  int socket_fd = socket( AF_INET, a_udp ? SOCK_DGRAM : SOCK_STREAM, 0 );
+  if( socket_fd < 0 )
+  {
+    perror( "It was not possible to create the receiver socket" );
+    return -1;
+  }
+
+  // Room for bursts of datagrams, as far as the system allows
+  if( a_udp )
+  {
+    int buffer_length = E2E_UDP_RECEIVE_BUFFER_LENGTH;
+    setsockopt( socket_fd,
+                SOL_SOCKET,
+                SO_RCVBUF,
+                &buffer_length,
+                sizeof buffer_length );
+  }
+
+  struct sockaddr_in address;
+  memset( &address, 0, sizeof address );
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+  socklen_t address_length = sizeof address;
+  if( bind( socket_fd, ( struct sockaddr* ) &address, sizeof address ) != 0 ||
+      ( !a_udp && listen( socket_fd, E2E_MAX_THREADS ) != 0 ) ||
+      getsockname( socket_fd,
+                   ( struct sockaddr* ) &address,
+                   &address_length ) != 0 )
+  {
+    perror( "It was not possible to set up the receiver" );
+    close( socket_fd );
+    return -1;
+  }
+
+  snprintf( a_output_service_name, a_length, "%d", ntohs( address.sin_port ) );
+
+  return socket_fd;
+}
+
+
+// Sends from the given no. of threads to the built-in receiver, for the given
+// time, and measures what gets through, and at what cost
+void run_e2e_case( enum csender_send_engine a_engine,
+                   size_t a_event_length,
+                   int a_num_threads,
+                   const struct e2e_arguments* ap_arguments,
+                   struct e2e_result* ap_output_result )
+{
+  memset( ap_output_result, 0, sizeof *ap_output_result );
+  ap_output_result->engine = a_engine;
+  ap_output_result->event_length = a_event_length;
+  ap_output_result->num_threads = a_num_threads;
+
+  char service_name[ 16 ];
+  bool udp = ap_arguments->udp;
+  int listen_fd = open_receiver( udp, service_name, sizeof service_name );
+  if( listen_fd < 0 )
+  {
+    return;
+  }
+
+  struct csender_runner_options options;
+  memset( &options, 0, sizeof options );
+  options.target_name = "127.0.0.1";
+  options.service_name = service_name;
+  options.generator.event_length = a_event_length;
+  options.generator.seed = 1;
+  options.num_threads = a_num_threads;
+  options.engine = a_engine;
+  options.batch_size = ap_arguments->batch_size;
+  options.udp = udp;
+
+  // The connections wait in the backlog until accepted. Datagrams of every
+  // thread go to the same socket.
+  struct csender_runner* p_runner = csender_runner_create( &options );
+  if( p_runner == NULL )
+  {
+    close( listen_fd );
+    return;
+  }
+
+  struct e2e_drain drains[ E2E_MAX_THREADS ];
+  int num_connections = udp ? 1 : a_num_threads;
+  int num_drains = 0;
+  for( ; num_drains < num_connections; num_drains++ )
+  {
+    struct e2e_drain* p_drain = &( drains[ num_drains ] );
+    atomic_init( &( p_drain->num_bytes ), 0 );
+    p_drain->udp = udp;
+    p_drain->socket_fd = udp ? dup( listen_fd ) : accept( listen_fd, NULL, NULL );
+    if( p_drain->socket_fd < 0 )
+    {
+      break;
+    }
+    if( pthread_create( &( p_drain->thread ),
+                        NULL,
+                        drain_main,
+                        p_drain ) != 0 )
+    {
+      close( p_drain->socket_fd );
+      break;
+    }
+  }
+
+  struct csender_stats_snapshot snapshot;
+  memset( &snapshot, 0, sizeof snapshot );
+
+  ap_output_result->available = ( num_drains == num_connections );
+  if( ap_output_result->available )
+  {
+    long long start_ns = now_ns( );
+    long long start_cpu_ns = process_cpu_ns( );
+    long long start_receiver_cpu_ns = 0;
+    for( int i = 0; i < num_drains; i++ )
+    {
+      start_receiver_cpu_ns += thread_cpu_ns( drains[ i ].thread );
+    }
+
+    if( csender_runner_start( p_runner ) == 0 )
+    {
+      sleep( ap_arguments->duration_seconds );
+    }
+    csender_runner_stop( p_runner );
+
+    long long elapsed_ns = now_ns( ) - start_ns;
+    long long cpu_ns = process_cpu_ns( ) - start_cpu_ns;
+    long long receiver_cpu_ns = -start_receiver_cpu_ns;
+    for( int i = 0; i < num_drains; i++ )
+    {
+      receiver_cpu_ns += thread_cpu_ns( drains[ i ].thread );
+    }
+
+    csender_runner_stats( p_runner, &snapshot );
+
+    double num_events = ( snapshot.num_events_sent > 0 ) ?
+                            ( double ) snapshot.num_events_sent :
+                            1.0;
+    ap_output_result->events_per_second =
+        snapshot.num_events_sent * 1e9 / elapsed_ns;
+    ap_output_result->megabytes_per_second =
+        snapshot.num_bytes_sent * 1e3 / elapsed_ns;
+    ap_output_result->send_calls_per_event =
+        snapshot.num_send_calls / num_events;
+    ap_output_result->sender_cpu_ns_per_event =
+        ( cpu_ns - receiver_cpu_ns ) / num_events;
+    ap_output_result->sender_cores =
+        ( double ) ( cpu_ns - receiver_cpu_ns ) / elapsed_ns;
+    ap_output_result->receiver_cores = ( double ) receiver_cpu_ns / elapsed_ns;
+  }
+
+  // Closing the connections lets the receiver drain the rest. Datagrams have
+  // no end, so their socket is shut down after a while.
+  csender_runner_destroy( p_runner );
+  if( udp && num_drains > 0 )
+  {
+    usleep( E2E_UDP_LINGER_US );
+    shutdown( drains[ 0 ].socket_fd, SHUT_RD );
+  }
+
+  long num_bytes_received = 0;
+  for( int i = 0; i < num_drains; i++ )
+  {
+    pthread_join( drains[ i ].thread, NULL );
+    close( drains[ i ].socket_fd );
+    num_bytes_received += atomic_load( &( drains[ i ].num_bytes ) );
+  }
+  close( listen_fd );
+
+  ap_output_result->delivery_ratio =
+      ( snapshot.num_bytes_sent > 0 ) ?
+          ( double ) num_bytes_received / snapshot.num_bytes_sent :
+          1.0;
+}
+
+
+void write_json_report( FILE* ap_output,
+                        const struct e2e_arguments* ap_arguments,
+                        const struct e2e_result* ap_results,
+                        size_t a_num_results )
+{
+  char date[ 32 ];
+  time_t now = time( NULL );
+  struct tm now_tm;
+  gmtime_r( &now, &now_tm );
+  strftime( date, sizeof date, "%FT%TZ", &now_tm );
+
+  char host_name[ 256 ] = "";
+  gethostname( host_name, sizeof host_name - 1 );
+
+  fprintf( ap_output, "{\n" );
+  fprintf( ap_output, "  \"context\": {\n" );
+  fprintf( ap_output, "    \"date\": \"%s\",\n", date );
+  fprintf( ap_output, "    \"host_name\": \"%s\",\n", host_name );
+  fprintf( ap_output, "    \"num_cpus\": %ld,\n",
+           sysconf( _SC_NPROCESSORS_ONLN ) );
+  fprintf( ap_output, "    \"duration_seconds\": %d,\n",
+           ap_arguments->duration_seconds );
+  fprintf( ap_output, "    \"protocol\": \"%s\",\n",
+           ap_arguments->udp ? "udp" : "tcp" );
+  fprintf( ap_output, "    \"batch_size\": %d\n", ap_arguments->batch_size );
+  fprintf( ap_output, "  },\n" );
+  fprintf( ap_output, "  \"benchmarks\": [\n" );
+
+  for( size_t i = 0; i < a_num_results; i++ )
+  {
+    const struct e2e_result* p_result = &( ap_results[ i ] );
+    fprintf( ap_output,
+             "    { \"engine\": \"%s\", \"event_length\": %zu, "
+             "\"threads\": %d, \"available\": %s",
+             csender_send_engine_name( p_result->engine ),
+             p_result->event_length,
+             p_result->num_threads,
+             p_result->available ? "true" : "false" );
+    if( p_result->available )
+    {
+      fprintf( ap_output,
+               ", \"events_per_second\": %.0f, "
+               "\"megabytes_per_second\": %.2f, "
+               "\"send_calls_per_event\": %.4f, "
+               "\"sender_cpu_ns_per_event\": %.1f, "
+               "\"sender_cores\": %.2f, \"receiver_cores\": %.2f, "
+               "\"delivery_ratio\": %.4f",
+               p_result->events_per_second,
+               p_result->megabytes_per_second,
+               p_result->send_calls_per_event,
+               p_result->sender_cpu_ns_per_event,
+               p_result->sender_cores,
+               p_result->receiver_cores,
+               p_result->delivery_ratio );
+    }
+    fprintf( ap_output, " }%s\n", ( i + 1 < a_num_results ) ? "," : "" );
+  }
+
+  fprintf( ap_output, "  ]\n" );
+  fprintf( ap_output, "}\n" );
+}
+
+
+void write_markdown_report( FILE* ap_output,
+                            const struct e2e_arguments* ap_arguments,
+                            const struct e2e_result* ap_results,
+                            size_t a_num_results )
+{
+  fprintf( ap_output,
+           "| engine | event length | threads | events/sec | MB/sec | "
+           "calls/event | sender ns/event | sender cores | receiver cores | "
+           "delivered |\n"
+           "|---|---:|---:|---:|---:|---:|---:|---:|---:|---:|\n" );
+
+  for( size_t i = 0; i < a_num_results; i++ )
+  {
+    const struct e2e_result* p_result = &( ap_results[ i ] );
+    fprintf( ap_output, "| %s | %zu | %d ",
+             csender_send_engine_name( p_result->engine ),
+             p_result->event_length,
+             p_result->num_threads );
+    if( !p_result->available )
+    {
+      fprintf( ap_output, "| not available | | | | | | |\n" );
+      continue;
+    }
+
+    fprintf( ap_output,
+             "| %.0f | %.1f | %.3f | %.0f | %.2f | %.2f | %.2f%% |\n",
+             p_result->events_per_second,
+             p_result->megabytes_per_second,
+             p_result->send_calls_per_event,
+             p_result->sender_cpu_ns_per_event,
+             p_result->sender_cores,
+             p_result->receiver_cores,
+             100.0 * p_result->delivery_ratio );
+  }
+
+  fprintf( ap_output,
+           "\n%s, %d s per case, batches of up to %d events.\n",
+           ap_arguments->udp ? "UDP (an event per datagram)" : "TCP",
+           ap_arguments->duration_seconds,
+           ap_arguments->batch_size );
+}
+
+
+void print_usage( )
+{
+  printf( "csender_e2e_bench. Sends to a built-in receiver on localhost with "
+          "every engine, event length and no. of threads, and compares them.\n" );
+  printf( "usage:\n"
+          "    csender_e2e_bench [option]...\n"
+          "options:\n"
+          "    -h, --help         Print this help.\n"
+          "    -o, --output       File to write the JSON report to. Default: standard output.\n"
+          "    -m, --markdown     File to write a markdown table of the results to.\n"
+          "    -d, --duration     Seconds of every case. Default: 2.\n"
+          "    -u, --udp          Send every event as a UDP datagram, instead of through TCP connections.\n"
+          "    -e, --engines      Engines to compare, e.g. send,writev. Default: all of those that suit the\n"
+          "                       protocol (TCP: all but udp_gso; UDP: all but writev), but packet_ring.\n"
+          "    -l, --lengths      Event lengths, e.g. 100,300,1200. Default: 100,300,1200.\n"
+          "    -t, --threads      Nos. of sender threads, e.g. 1,2,4. Default: 1,2,4.\n"
+          "    -y, --batch        Most events per batch [1-%d]. Default: 32.\n",
+          CSENDER_MAX_SEND_BATCH );
+}
+
+
+// Parses a list of positive numbers, separated by commas. Returns its length,
+// or -1 if not valid.
+int parse_number_list( const char* a_list, long* ap_output_values )
+{
+  int num_values = 0;
+  const char* p_position = a_list;
+  while( *p_position != '\0' )
+  {
+    char* p_end = NULL;
+    long value = strtol( p_position, &p_end, 10 );
+    if( p_end == p_position || value <= 0 || num_values == E2E_MAX_VALUES ||
+        ( *p_end != ',' && *p_end != '\0' ) )
+    {
+      return -1;
+    }
+
+    ap_output_values[ num_values++ ] = value;
+    p_position = ( *p_end == ',' ) ? p_end + 1 : p_end;
+  }
+
+  return ( num_values > 0 ) ? num_values : -1;
+}
+
+
+bool parse_engine_list( const char* a_list,
+                        struct e2e_arguments* ap_arguments )
+{
+  char list[ 256 ];
+  snprintf( list, sizeof list, "%s", a_list );
+
+  ap_arguments->num_engines = 0;
+  char* p_save = NULL;
+  for( char* p_name = strtok_r( list, ",", &p_save );
+       p_name != NULL;
+       p_name = strtok_r( NULL, ",", &p_save ) )
+  {
+    if( ap_arguments->num_engines == CSENDER_NUM_SEND_ENGINES ||
+        !csender_parse_send_engine(
+            p_name,
+            &( ap_arguments->engines[ ap_arguments->num_engines ] ) ) )
+    {
+      return false;
+    }
+    ap_arguments->num_engines++;
+  }
+
+  return ap_arguments->num_engines > 0;
+}
+
+
+bool process_argument_list( int argc,
+                            char* argv[],
+                            struct e2e_arguments* ap_arguments )
+{
+  ap_arguments->output_filename = NULL;
+  ap_arguments->markdown_filename = NULL;
+  ap_arguments->udp = false;
+  ap_arguments->duration_seconds = 2;
+  ap_arguments->batch_size = 32;
+  ap_arguments->num_engines = 0;
+  ap_arguments->num_event_lengths =
+      parse_number_list( "100,300,1200", ap_arguments->event_lengths );
+  ap_arguments->num_thread_counts =
+      parse_number_list( "1,2,4", ap_arguments->thread_counts );
+
+  struct option long_options[] =
+  {
+  { "help", no_argument, 0, 'h' },
+  { "output", required_argument, 0, 'o' },
+  { "markdown", required_argument, 0, 'm' },
+  { "duration", required_argument, 0, 'd' },
+  { "udp", no_argument, 0, 'u' },
+  { "engines", required_argument, 0, 'e' },
+  { "lengths", required_argument, 0, 'l' },
+  { "threads", required_argument, 0, 't' },
+  { "batch", required_argument, 0, 'y' },
+  { 0, 0, 0, 0 }
+  };
+
+  int index, opt = 0;
+  while( ( opt =
+           getopt_long( argc, argv, "ho:m:d:ue:l:t:y:", long_options,
+                        &index ) ) != -1 )
+  {
+    switch( opt )
+    {
+      case 'h':
+      {
+        print_usage( );
+        return false;
+      }
+      case 'o':
+      {
+        ap_arguments->output_filename = optarg;
+        break;
+      }
+      case 'm':
+      {
+        ap_arguments->markdown_filename = optarg;
+        break;
+      }
+      case 'd':
+      {
+        ap_arguments->duration_seconds = atoi( optarg );
+        if( ap_arguments->duration_seconds <= 0 )
+        {
+          printf( "Invalid duration.\n" );
+          return false;
+        }
+        break;
+      }
+      case 'u':
+      {
+        ap_arguments->udp = true;
+        break;
+      }
+      case 'e':
+      {
+        if( !parse_engine_list( optarg, ap_arguments ) )
+        {
+          printf( "Invalid list of engines.\n" );
+          return false;
+        }
+        break;
+      }
+      case 'l':
+      {
+        ap_arguments->num_event_lengths =
+            parse_number_list( optarg, ap_arguments->event_lengths );
+        if( ap_arguments->num_event_lengths < 0 )
+        {
+          printf( "Invalid list of event lengths.\n" );
+          return false;
+        }
+        for( int i = 0; i < ap_arguments->num_event_lengths; i++ )
+        {
+          if( ( size_t ) ap_arguments->event_lengths[ i ] <
+                  csender_min_event_length( ) ||
+              ( size_t ) ap_arguments->event_lengths[ i ] >
+                  csender_max_event_length( ) )
+          {
+            printf( "Event lengths must be within %zu and %zu.\n",
+                    csender_min_event_length( ),
+                    csender_max_event_length( ) );
+            return false;
+          }
+        }
+        break;
+      }
+      case 't':
+      {
+        ap_arguments->num_thread_counts =
+            parse_number_list( optarg, ap_arguments->thread_counts );
+        if( ap_arguments->num_thread_counts < 0 )
+        {
+          printf( "Invalid list of thread counts.\n" );
+          return false;
+        }
+        for( int i = 0; i < ap_arguments->num_thread_counts; i++ )
+        {
+          if( ap_arguments->thread_counts[ i ] > E2E_MAX_THREADS )
+          {
+            printf( "At most %d threads.\n", E2E_MAX_THREADS );
+            return false;
+          }
+        }
+        break;
+      }
+      case 'y':
+      {
+        ap_arguments->batch_size = atoi( optarg );
+        if( ap_arguments->batch_size < 1 ||
+            ap_arguments->batch_size > CSENDER_MAX_SEND_BATCH )
+        {
+          printf( "Invalid batch size.\n" );
+          return false;
+        }
+        break;
+      }
+      default:
+      {
+        printf( "Unknown option, or option without value.\n" );
+        print_usage( );
+        return false;
+      }
+    }
+  }
+
+  if( ap_arguments->num_engines == 0 )
+  {
+    for( int i = 0; i < CSENDER_NUM_SEND_ENGINES; i++ )
+    {
+      enum csender_send_engine engine = ( enum csender_send_engine ) i;
+      // The packet ring can not reach the receivers here, on the loopback
+      if( engine != ( ap_arguments->udp ? CSENDER_ENGINE_WRITEV :
+                                          CSENDER_ENGINE_UDP_GSO ) &&
+          engine != CSENDER_ENGINE_PACKET_RING )
+      {
+        ap_arguments->engines[ ap_arguments->num_engines++ ] = engine;
+      }
+    }
+  }
+
+  return true;
+}
+
+
+bool write_report( const char* a_filename,
+                   void ( *write_function )( FILE*,
+                                             const struct e2e_arguments*,
+                                             const struct e2e_result*,
+                                             size_t ),
+                   const struct e2e_arguments* ap_arguments,
+                   const struct e2e_result* ap_results,
+                   size_t a_num_results )
+{
+  FILE* output = stdout;
+  if( a_filename != NULL )
+  {
+    output = fopen( a_filename, "w" );
+    if( output == NULL )
+    {
+      perror( "It was not possible to open the output file" );
+      return false;
+    }
+  }
+
+  write_function( output, ap_arguments, ap_results, a_num_results );
+
+  if( output != stdout )
+  {
+    fclose( output );
+  }
+
+  return true;
+}
+
+
+int main( int argc, char* argv[] )
+{
+  struct e2e_arguments arguments;
+  if( !process_argument_list( argc, argv, &arguments ) )
+  {
+    exit( 1 );
+  }
+
+  struct e2e_result results[ E2E_MAX_RESULTS ];
+  size_t num_results = 0;
+  for( int i = 0; i < arguments.num_engines; i++ )
+  {
+    for( int j = 0; j < arguments.num_event_lengths; j++ )
+    {
+      for( int k = 0;
+           k < arguments.num_thread_counts && num_results < E2E_MAX_RESULTS;
+           k++ )
+      {
+        struct e2e_result* p_result = &( results[ num_results++ ] );
+        run_e2e_case( arguments.engines[ i ],
+                      arguments.event_lengths[ j ],
+                      arguments.thread_counts[ k ],
+                      &arguments,
+                      p_result );
+        if( p_result->available )
+        {
+          fprintf( stderr,
+                   "%-9s %5zu bytes %2d threads %12.0f events/sec "
+                   "%8.1f ns/event %7.2f%% delivered\n",
+                   csender_send_engine_name( p_result->engine ),
+                   p_result->event_length,
+                   p_result->num_threads,
+                   p_result->events_per_second,
+                   p_result->sender_cpu_ns_per_event,
+                   100.0 * p_result->delivery_ratio );
+        }
+        else
+        {
+          fprintf( stderr, "%-9s not available\n",
+                   csender_send_engine_name( p_result->engine ) );
+        }
+      }
+    }
+  }
+
+  bool written = write_report( arguments.output_filename,
+                               write_json_report,
+                               &arguments,
+                               results,
+                               num_results );
+  if( arguments.markdown_filename != NULL )
+  {
+    written = write_report( arguments.markdown_filename,
+                            write_markdown_report,
+                            &arguments,
+                            results,
+                            num_results ) && written;
+  }
+
+  return written ? 0 : 1;
+}
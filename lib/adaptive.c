@@ -0,0 +1,144 @@
+#include "csender.h"
+#include "clock.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct csender_adaptive
+{
+  struct csender_adaptive_options   options;
+  struct csender_runner*            p_runner;
+  long                              rate;
+
+  // Measurements at the previous update
+  int64_t                           previous_ns;
+  struct csender_stats_snapshot     previous_stats;
+  struct csender_histogram          previous_send_times;
+};
+
+
+void csender_adaptive_options_init(
+    struct csender_adaptive_options* ap_options )
+{
+  memset( ap_options, 0, sizeof *ap_options );
+  ap_options->initial_rate = 10000;
+  ap_options->min_rate = 100;
+  ap_options->max_rate = 0;
+  ap_options->additive_increase = 1000;
+  ap_options->multiplicative_decrease = 0.7;
+  ap_options->max_p99_send_time_ns = 1000000;
+  ap_options->max_send_queue_bytes = 1024 * 1024;
+  ap_options->min_delivery_ratio = 0.98;
+}
+
+
+struct csender_adaptive* csender_adaptive_create(
+    struct csender_runner* ap_runner,
+    const struct csender_adaptive_options* ap_options )
+{
+  if( ap_options->initial_rate <= 0 || ap_options->min_rate <= 0 ||
+      ap_options->additive_increase <= 0 ||
+      ap_options->multiplicative_decrease <= 0 ||
+      ap_options->multiplicative_decrease >= 1 )
+  {
+    return NULL;
+  }
+
+  struct csender_adaptive* p_adaptive = malloc( sizeof *p_adaptive );
+  if( p_adaptive == NULL )
+  {
+    return NULL;
+  }
+
+  p_adaptive->options = *ap_options;
+  p_adaptive->p_runner = ap_runner;
+  p_adaptive->rate = ap_options->initial_rate;
+  csender_runner_set_rate( ap_runner, p_adaptive->rate );
+
+  p_adaptive->previous_ns = monotonic_ns( );
+  csender_runner_stats( ap_runner, &( p_adaptive->previous_stats ) );
+  csender_runner_send_times( ap_runner, &( p_adaptive->previous_send_times ) );
+
+  return p_adaptive;
+}
+
+
+int csender_adaptive_update( struct csender_adaptive* ap_adaptive,
+                             struct csender_adaptive_step* ap_output_step )
+{
+  const struct csender_adaptive_options* p_options = &( ap_adaptive->options );
+
+  int64_t now_ns = monotonic_ns( );
+  if( now_ns <= ap_adaptive->previous_ns )
+  {
+    return -1;
+  }
+
+  struct csender_stats_snapshot stats;
+  csender_runner_stats( ap_adaptive->p_runner, &stats );
+
+  // Only what was recorded since the previous update
+  struct csender_histogram send_times;
+  csender_runner_send_times( ap_adaptive->p_runner, &send_times );
+  struct csender_histogram interval_send_times = send_times;
+  csender_histogram_subtract( &interval_send_times,
+                              &( ap_adaptive->previous_send_times ) );
+
+  ap_output_step->rate = ap_adaptive->rate;
+  ap_output_step->achieved_rate =
+      ( double ) ( stats.num_events_sent -
+                   ap_adaptive->previous_stats.num_events_sent ) *
+      NS_PER_SECOND / ( now_ns - ap_adaptive->previous_ns );
+  ap_output_step->p99_send_time_ns =
+      csender_histogram_percentile( &interval_send_times, 99 );
+  ap_output_step->send_queue_bytes =
+      csender_runner_send_queue_bytes( ap_adaptive->p_runner );
+
+  // Any sign of the receiver not keeping up counts: a few slow sends are
+  // not enough to lower the p99, but they make the pacer fall behind, and
+  // a filling send queue shows up before the sends start to block at all.
+  ap_output_step->congested =
+      ( ap_output_step->p99_send_time_ns > p_options->max_p99_send_time_ns ) ||
+      ( ap_output_step->send_queue_bytes > p_options->max_send_queue_bytes ) ||
+      ( ap_output_step->achieved_rate <
+        p_options->min_delivery_ratio * ap_adaptive->rate );
+
+  long next_rate;
+  if( ap_output_step->congested )
+  {
+    next_rate = ( long ) ( ap_adaptive->rate *
+                           p_options->multiplicative_decrease );
+  }
+  else
+  {
+    next_rate = ap_adaptive->rate + p_options->additive_increase;
+  }
+
+  if( p_options->max_rate > 0 && next_rate > p_options->max_rate )
+  {
+    next_rate = p_options->max_rate;
+  }
+  if( next_rate < p_options->min_rate )
+  {
+    next_rate = p_options->min_rate;
+  }
+
+  ap_output_step->next_rate = next_rate;
+  if( next_rate != ap_adaptive->rate )
+  {
+    ap_adaptive->rate = next_rate;
+    csender_runner_set_rate( ap_adaptive->p_runner, next_rate );
+  }
+
+  ap_adaptive->previous_ns = now_ns;
+  ap_adaptive->previous_stats = stats;
+  ap_adaptive->previous_send_times = send_times;
+
+  return 0;
+}
+
+
+void csender_adaptive_destroy( struct csender_adaptive* ap_adaptive )
+{
+  free( ap_adaptive );
+}
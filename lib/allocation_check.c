@@ -0,0 +1,100 @@
+#include "allocation_check.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// The allocator of glibc, which the definitions below stand in front of
+extern void* __libc_malloc( size_t a_size );
+extern void* __libc_calloc( size_t a_num_items, size_t a_size );
+extern void* __libc_realloc( void* ap_memory, size_t a_size );
+extern void* __libc_memalign( size_t a_alignment, size_t a_size );
+extern void __libc_free( void* ap_memory );
+
+static __thread bool g_allocations_forbidden = false;
+
+
+void allocation_check_begin( void )
+{
+  g_allocations_forbidden = true;
+}
+
+
+void allocation_check_end( void )
+{
+  g_allocations_forbidden = false;
+}
+
+
+static void check_allocation( const char* a_function_name )
+{
+  if( g_allocations_forbidden )
+  {
+    // Not through stdio, which may allocate itself
+    char message[ 64 ] = "csender: allocation in a send loop: ";
+    strcat( message, a_function_name );
+    strcat( message, "()\n" );
+    if( write( STDERR_FILENO, message, strlen( message ) ) < 0 )
+    {
+      // Nothing else to tell it with
+    }
+
+    abort( );
+  }
+}
+
+
+void* malloc( size_t a_size )
+{
+  check_allocation( "malloc" );
+  return __libc_malloc( a_size );
+}
+
+
+void* calloc( size_t a_num_items, size_t a_size )
+{
+  check_allocation( "calloc" );
+  return __libc_calloc( a_num_items, a_size );
+}
+
+
+void* realloc( void* ap_memory, size_t a_size )
+{
+  check_allocation( "realloc" );
+  return __libc_realloc( ap_memory, a_size );
+}
+
+
+void* aligned_alloc( size_t a_alignment, size_t a_size )
+{
+  check_allocation( "aligned_alloc" );
+  return __libc_memalign( a_alignment, a_size );
+}
+
+
+int posix_memalign( void** ap_output_memory, size_t a_alignment, size_t a_size )
+{
+  check_allocation( "posix_memalign" );
+  if( a_alignment % sizeof( void* ) != 0 ||
+      ( a_alignment & ( a_alignment - 1 ) ) != 0 )
+  {
+    return EINVAL;
+  }
+
+  void* p_memory = __libc_memalign( a_alignment, a_size );
+  if( p_memory == NULL )
+  {
+    return ENOMEM;
+  }
+
+  *ap_output_memory = p_memory;
+  return 0;
+}
+
+
+void free( void* ap_memory )
+{
+  __libc_free( ap_memory );
+}
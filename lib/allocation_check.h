@@ -0,0 +1,31 @@
+#ifndef CSENDER_ALLOCATION_CHECK_H
+#define CSENDER_ALLOCATION_CHECK_H
+
+// Builds with CSENDER_ALLOCATION_CHECK interpose malloc() and the like, and
+// abort, telling which one, if a thread allocates between these two calls.
+// The send loops make them once warmed up, so any allocation that finds its
+// way into them fails the run. Other builds pay nothing.
+
+// Events a send loop sends before its allocations are checked: the first ones
+// may still set up things lazily, as the time zone of local timestamps
+#define ALLOCATION_CHECK_WARM_UP_EVENTS 1000
+
+#ifdef CSENDER_ALLOCATION_CHECK
+
+void allocation_check_begin( void );
+void allocation_check_end( void );
+
+#else
+
+static inline void allocation_check_begin( void )
+{
+}
+
+
+static inline void allocation_check_end( void )
+{
+}
+
+#endif
+
+#endif
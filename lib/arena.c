@@ -0,0 +1,55 @@
+#include "arena.h"
+
+#include <stdint.h>
+#include <sys/mman.h>
+
+bool arena_init( struct arena* ap_arena, size_t a_capacity )
+{
+  ap_arena->used = 0;
+  ap_arena->capacity = a_capacity;
+  ap_arena->p_base = mmap( NULL,
+                           a_capacity,
+                           PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE,
+                           -1,
+                           0 );
+  if( ap_arena->p_base == MAP_FAILED )
+  {
+    ap_arena->p_base = NULL;
+    return false;
+  }
+
+  return true;
+}
+
+
+void* arena_alloc( struct arena* ap_arena, size_t a_size, size_t a_alignment )
+{
+  uintptr_t base = ( uintptr_t ) ap_arena->p_base;
+  size_t offset = ( ( base + ap_arena->used + a_alignment - 1 ) &
+                    ~( uintptr_t ) ( a_alignment - 1 ) ) - base;
+  if( offset > ap_arena->capacity || a_size > ap_arena->capacity - offset )
+  {
+    return NULL;
+  }
+
+  ap_arena->used = offset + a_size;
+
+  return ap_arena->p_base + offset;
+}
+
+
+void arena_reset( struct arena* ap_arena )
+{
+  ap_arena->used = 0;
+}
+
+
+void arena_destroy( struct arena* ap_arena )
+{
+  if( ap_arena->p_base != NULL )
+  {
+    munmap( ap_arena->p_base, ap_arena->capacity );
+    ap_arena->p_base = NULL;
+  }
+}
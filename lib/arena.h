@@ -0,0 +1,29 @@
+#ifndef CSENDER_ARENA_H
+#define CSENDER_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// A bump allocator over a block mapped, and touched, up front by the thread
+// that uses it. Send loops take all of their buffers from one before they
+// start, so that sending never allocates, nor faults pages in.
+struct arena
+{
+  char*    p_base;
+  size_t   capacity;
+  size_t   used;
+};
+
+// Returns false if the block could not be mapped
+bool arena_init( struct arena* ap_arena, size_t a_capacity );
+
+// Returns NULL if there is not enough room left. The alignment must be a power
+// of 2.
+void* arena_alloc( struct arena* ap_arena, size_t a_size, size_t a_alignment );
+
+// Makes all of the room available again
+void arena_reset( struct arena* ap_arena );
+
+void arena_destroy( struct arena* ap_arena );
+
+#endif
@@ -0,0 +1,1302 @@
+#include "csender.h"
+#include "clock.h"
+#include "format.h"
+#include "pack.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Formats of the captures
+#define PCAP_MAGIC_US 0xA1B2C3D4
+#define PCAP_MAGIC_NS 0xA1B23C4D
+#define PCAP_HEADER_LENGTH 24
+#define PCAP_RECORD_HEADER_LENGTH 16
+#define PCAPNG_SECTION_HEADER 0x0A0D0D0A
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1A2B3C4D
+#define PCAPNG_INTERFACE_DESCRIPTION 1
+#define PCAPNG_SIMPLE_PACKET 3
+#define PCAPNG_ENHANCED_PACKET 6
+#define PCAPNG_OPTION_END 0
+#define PCAPNG_OPTION_TIMESTAMP_RESOLUTION 9
+#define PCAPNG_MAX_INTERFACES 256
+#define PCAPNG_DEFAULT_TICKS_PER_SECOND 1000000
+
+// Link types, as numbered by pcap
+#define LINKTYPE_NULL 0
+#define LINKTYPE_ETHERNET 1
+#define LINKTYPE_RAW 101
+#define LINKTYPE_LINUX_SLL 113
+#define LINKTYPE_IPV4 228
+#define LINKTYPE_IPV6 229
+#define LINKTYPE_LINUX_SLL2 276
+
+#define ETHERTYPE_IPV4 0x0800
+#define ETHERTYPE_IPV6 0x86DD
+#define ETHERTYPE_VLAN 0x8100
+#define ETHERTYPE_QINQ 0x88A8
+
+#define IP_PROTOCOL_TCP 6
+#define IP_PROTOCOL_UDP 17
+#define IPV6_HOP_BY_HOP_OPTIONS 0
+#define IPV6_ROUTING 43
+#define IPV6_FRAGMENT 44
+#define IPV6_DESTINATION_OPTIONS 60
+
+#define TCP_FLAG_FIN 0x01
+#define TCP_FLAG_SYN 0x02
+#define TCP_FLAG_RST 0x04
+
+// Segments past a hole in a stream, kept while it may still be filled by a
+// retransmission
+#define MAX_PENDING_SEGMENTS 64
+
+// Bytes of a stream without the end of a message in sight, past which it is
+// given up until the start of the next one
+#define MAX_STREAM_BUFFER_LENGTH ( 16 * CSENDER_EVENT_MAXLENGTH )
+
+// Longest octet count taken as such, rather than as the start of a message
+#define MAX_OCTET_COUNT_DIGITS 9
+
+// Messages without PRI, as RFC 3164 has it
+#define DEFAULT_SEVERITY 5
+
+// A packet of a capture
+struct capture_packet
+{
+  int64_t          time_ns;
+  int              link_type;
+  const uint8_t*   p_data;
+  size_t           length;
+};
+
+// Reads the packets of a pcap or pcapng capture, in turn
+struct capture_reader
+{
+  const uint8_t*   p_data;
+  size_t           length;
+  size_t           position;
+  bool             pcapng;
+  bool             big_endian;
+  int64_t          last_time_ns;
+
+  // pcap
+  int64_t          ns_per_tick;
+  int              link_type;
+
+  // pcapng: interfaces of the current section
+  int              link_types[ PCAPNG_MAX_INTERFACES ];
+  uint64_t         ticks_per_second[ PCAPNG_MAX_INTERFACES ];
+  int              num_interfaces;
+};
+
+// One direction of a connection. Zeroed before being filled in, so that it
+// can be compared and hashed whole.
+struct flow_key
+{
+  uint8_t    source_address[ 16 ];
+  uint8_t    destination_address[ 16 ];
+  uint16_t   source_port;
+  uint16_t   destination_port;
+  uint8_t    ip_version;
+  uint8_t    reserved[ 3 ];
+};
+
+// The TCP or UDP payload of a packet
+struct capture_segment
+{
+  struct flow_key   key;
+  uint8_t           protocol;
+  uint8_t           tcp_flags;
+  uint32_t          tcp_sequence_number;
+  const uint8_t*    p_payload;
+  size_t            payload_length;
+};
+
+struct pending_segment
+{
+  uint32_t   sequence_number;
+  uint8_t*   p_data;
+  size_t     length;
+};
+
+enum stream_framing
+{
+  STREAM_FRAMING_UNKNOWN,
+  STREAM_FRAMING_LF,
+  STREAM_FRAMING_OCTET_COUNTING
+};
+
+// A TCP stream, reassembled and split into messages as it goes
+struct tcp_flow
+{
+  struct flow_key          key;
+  bool                     used;
+  bool                     synchronized;    // next_sequence_number is known
+  bool                     lost;            // Past a hole: looking for the
+                                            // start of a message
+  uint32_t                 next_sequence_number;
+  enum stream_framing      framing;
+  uint8_t*                 p_buffer;        // Not split into messages yet
+  size_t                   buffer_length;
+  size_t                   buffer_capacity;
+  struct pending_segment   pending[ MAX_PENDING_SEGMENTS ];
+  int                      num_pending;
+};
+
+struct capture_import
+{
+  struct pack_writer      writer;
+  enum csender_framing    framing;
+  int                     port;
+  struct tcp_flow*        p_flows;          // Open addressing, by key
+  size_t                  flows_capacity;
+  size_t                  num_flows;
+  bool                    failed;
+  bool                    truncated;        // Malformed past some packets
+  bool                    first_event;
+  int64_t                 first_time_ns;
+  uint64_t                last_time_ns;
+  long                    num_events;
+  long                    num_too_long;
+};
+
+
+static uint16_t read_u16( const uint8_t* ap_bytes, bool a_big_endian )
+{
+  return a_big_endian ?
+             ( uint16_t ) ( ap_bytes[ 0 ] << 8 | ap_bytes[ 1 ] ) :
+             ( uint16_t ) ( ap_bytes[ 1 ] << 8 | ap_bytes[ 0 ] );
+}
+
+
+static uint32_t read_u32( const uint8_t* ap_bytes, bool a_big_endian )
+{
+  uint32_t high = read_u16( ap_bytes + ( a_big_endian ? 0 : 2 ), a_big_endian );
+  uint32_t low = read_u16( ap_bytes + ( a_big_endian ? 2 : 0 ), a_big_endian );
+
+  return high << 16 | low;
+}
+
+
+// --- Captures ----------------------------------------------------------------
+
+static bool capture_reader_init( struct capture_reader* ap_reader,
+                                 const uint8_t* a_data,
+                                 size_t a_length )
+{
+  memset( ap_reader, 0, sizeof *ap_reader );
+  ap_reader->p_data = a_data;
+  ap_reader->length = a_length;
+  if( a_length < 4 )
+  {
+    return false;
+  }
+
+  // The section header block tells the byte order of pcapng ones
+  if( read_u32( a_data, false ) == PCAPNG_SECTION_HEADER )
+  {
+    ap_reader->pcapng = true;
+    return true;
+  }
+
+  for( int big_endian = 0; big_endian <= 1; big_endian++ )
+  {
+    uint32_t magic = read_u32( a_data, big_endian );
+    if( ( magic == PCAP_MAGIC_US || magic == PCAP_MAGIC_NS ) &&
+        a_length >= PCAP_HEADER_LENGTH )
+    {
+      ap_reader->big_endian = big_endian;
+      ap_reader->ns_per_tick = ( magic == PCAP_MAGIC_US ) ? 1000 : 1;
+      ap_reader->link_type = read_u32( a_data + 20, big_endian ) & 0xFFFF;
+      ap_reader->position = PCAP_HEADER_LENGTH;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+static int64_t ticks_to_ns( uint64_t a_ticks, uint64_t a_ticks_per_second )
+{
+  return ( int64_t ) ( a_ticks / a_ticks_per_second ) * NS_PER_SECOND +
+         ( int64_t ) ( ( double ) ( a_ticks % a_ticks_per_second ) *
+                       NS_PER_SECOND / a_ticks_per_second );
+}
+
+
+// Ticks per second of the timestamps of an interface, from the options of its
+// description
+static uint64_t interface_ticks_per_second( const uint8_t* a_options,
+                                            size_t a_length,
+                                            bool a_big_endian )
+{
+  size_t position = 0;
+  while( position + 4 <= a_length )
+  {
+    uint16_t code = read_u16( a_options + position, a_big_endian );
+    uint16_t length = read_u16( a_options + position + 2, a_big_endian );
+    if( code == PCAPNG_OPTION_END || length > a_length - position - 4 )
+    {
+      break;
+    }
+
+    if( code == PCAPNG_OPTION_TIMESTAMP_RESOLUTION && length >= 1 )
+    {
+      // Negative power of 2 if the upper bit is set, of 10 otherwise
+      uint8_t resolution = a_options[ position + 4 ];
+      if( resolution & 0x80 )
+      {
+        return 1ULL << ( ( resolution & 0x7F ) < 63 ? resolution & 0x7F : 63 );
+      }
+      return g_powers_of_10[ ( resolution < 19 ) ? resolution : 19 ];
+    }
+
+    position += 4 + ( ( length + 3u ) & ~3u );
+  }
+
+  return PCAPNG_DEFAULT_TICKS_PER_SECOND;
+}
+
+
+// Returns 1 if there was another packet, 0 at the end of the capture, or -1
+// if it is malformed
+static int pcapng_next( struct capture_reader* ap_reader,
+                        struct capture_packet* ap_output_packet )
+{
+  while( ap_reader->position < ap_reader->length )
+  {
+    const uint8_t* p_block = ap_reader->p_data + ap_reader->position;
+    size_t remaining = ap_reader->length - ap_reader->position;
+    if( remaining < 12 )
+    {
+      return -1;
+    }
+
+    // Every section may have its own byte order, and interfaces
+    if( read_u32( p_block, false ) == PCAPNG_SECTION_HEADER )
+    {
+      if( remaining < 28 )
+      {
+        return -1;
+      }
+
+      if( read_u32( p_block + 8, false ) == PCAPNG_BYTE_ORDER_MAGIC )
+      {
+        ap_reader->big_endian = false;
+      }
+      else if( read_u32( p_block + 8, true ) == PCAPNG_BYTE_ORDER_MAGIC )
+      {
+        ap_reader->big_endian = true;
+      }
+      else
+      {
+        return -1;
+      }
+
+      ap_reader->num_interfaces = 0;
+    }
+
+    bool big_endian = ap_reader->big_endian;
+    uint32_t type = read_u32( p_block, big_endian );
+    uint32_t total_length = read_u32( p_block + 4, big_endian );
+    if( total_length < 12 || total_length % 4 != 0 ||
+        total_length > remaining )
+    {
+      return -1;
+    }
+
+    const uint8_t* p_body = p_block + 8;
+    size_t body_length = total_length - 12;
+    ap_reader->position += total_length;
+
+    switch( type )
+    {
+      case PCAPNG_INTERFACE_DESCRIPTION:
+      {
+        if( body_length < 8 )
+        {
+          return -1;
+        }
+
+        int i = ap_reader->num_interfaces;
+        if( i < PCAPNG_MAX_INTERFACES )
+        {
+          ap_reader->link_types[ i ] = read_u16( p_body, big_endian );
+          ap_reader->ticks_per_second[ i ] =
+              interface_ticks_per_second( p_body + 8,
+                                          body_length - 8,
+                                          big_endian );
+          ap_reader->num_interfaces++;
+        }
+
+        break;
+      }
+      case PCAPNG_ENHANCED_PACKET:
+      {
+        if( body_length < 20 )
+        {
+          return -1;
+        }
+
+        uint32_t interface = read_u32( p_body, big_endian );
+        uint64_t ticks = ( uint64_t ) read_u32( p_body + 4, big_endian ) << 32 |
+                         read_u32( p_body + 8, big_endian );
+        uint32_t captured_length = read_u32( p_body + 12, big_endian );
+        if( interface >= ( uint32_t ) ap_reader->num_interfaces ||
+            captured_length > body_length - 20 )
+        {
+          return -1;
+        }
+
+        ap_reader->last_time_ns =
+            ticks_to_ns( ticks, ap_reader->ticks_per_second[ interface ] );
+        ap_output_packet->time_ns = ap_reader->last_time_ns;
+        ap_output_packet->link_type = ap_reader->link_types[ interface ];
+        ap_output_packet->p_data = p_body + 20;
+        ap_output_packet->length = captured_length;
+        return 1;
+      }
+      case PCAPNG_SIMPLE_PACKET:
+      {
+        if( body_length < 4 || ap_reader->num_interfaces == 0 )
+        {
+          return -1;
+        }
+
+        // Of the first interface, and with no time of its own
+        uint32_t original_length = read_u32( p_body, big_endian );
+        ap_output_packet->time_ns = ap_reader->last_time_ns;
+        ap_output_packet->link_type = ap_reader->link_types[ 0 ];
+        ap_output_packet->p_data = p_body + 4;
+        ap_output_packet->length = ( original_length < body_length - 4 ) ?
+                                       original_length :
+                                       body_length - 4;
+        return 1;
+      }
+      default:
+      {
+        break;
+      }
+    }
+  }
+
+  return 0;
+}
+
+
+// Returns 1 if there was another packet, 0 at the end of the capture, or -1
+// if it is malformed
+static int capture_next( struct capture_reader* ap_reader,
+                         struct capture_packet* ap_output_packet )
+{
+  if( ap_reader->pcapng )
+  {
+    return pcapng_next( ap_reader, ap_output_packet );
+  }
+
+  size_t remaining = ap_reader->length - ap_reader->position;
+  if( remaining == 0 )
+  {
+    return 0;
+  }
+
+  const uint8_t* p_record = ap_reader->p_data + ap_reader->position;
+  bool big_endian = ap_reader->big_endian;
+  if( remaining < PCAP_RECORD_HEADER_LENGTH ||
+      read_u32( p_record + 8, big_endian ) >
+          remaining - PCAP_RECORD_HEADER_LENGTH )
+  {
+    return -1;
+  }
+
+  ap_output_packet->time_ns =
+      ( int64_t ) read_u32( p_record, big_endian ) * NS_PER_SECOND +
+      read_u32( p_record + 4, big_endian ) * ap_reader->ns_per_tick;
+  ap_output_packet->link_type = ap_reader->link_type;
+  ap_output_packet->p_data = p_record + PCAP_RECORD_HEADER_LENGTH;
+  ap_output_packet->length = read_u32( p_record + 8, big_endian );
+  ap_reader->position += PCAP_RECORD_HEADER_LENGTH + ap_output_packet->length;
+
+  return 1;
+}
+
+
+// --- Packets -----------------------------------------------------------------
+
+// Finds the TCP or UDP payload of an IP packet. Fragments are left out, as
+// syslog messages fit in a datagram, or are split by TCP.
+static bool decode_ip( const uint8_t* a_data,
+                       size_t a_length,
+                       struct capture_segment* ap_output_segment )
+{
+  struct flow_key* p_key = &( ap_output_segment->key );
+  memset( p_key, 0, sizeof *p_key );
+
+  uint8_t protocol;
+  if( a_length >= 20 && ( a_data[ 0 ] >> 4 ) == 4 )
+  {
+    size_t header_length = ( a_data[ 0 ] & 0x0F ) * 4;
+    size_t total_length = read_u16( a_data + 2, true );
+    uint16_t fragment = read_u16( a_data + 6, true );
+    if( header_length < 20 || total_length < header_length ||
+        total_length > a_length || ( fragment & 0x3FFF ) != 0 )
+    {
+      return false;
+    }
+
+    p_key->ip_version = 4;
+    memcpy( p_key->source_address, a_data + 12, 4 );
+    memcpy( p_key->destination_address, a_data + 16, 4 );
+    protocol = a_data[ 9 ];
+    a_data += header_length;
+    a_length = total_length - header_length;
+  }
+  else if( a_length >= 40 && ( a_data[ 0 ] >> 4 ) == 6 )
+  {
+    size_t payload_length = read_u16( a_data + 4, true );
+    if( payload_length > a_length - 40 )
+    {
+      return false;
+    }
+
+    p_key->ip_version = 6;
+    memcpy( p_key->source_address, a_data + 8, 16 );
+    memcpy( p_key->destination_address, a_data + 24, 16 );
+    protocol = a_data[ 6 ];
+    a_data += 40;
+    a_length = payload_length;
+
+    while( protocol == IPV6_HOP_BY_HOP_OPTIONS ||
+           protocol == IPV6_ROUTING ||
+           protocol == IPV6_DESTINATION_OPTIONS )
+    {
+      if( a_length < 8 || ( size_t ) ( a_data[ 1 ] + 1 ) * 8 > a_length )
+      {
+        return false;
+      }
+
+      size_t extension_length = ( size_t ) ( a_data[ 1 ] + 1 ) * 8;
+      protocol = a_data[ 0 ];
+      a_data += extension_length;
+      a_length -= extension_length;
+    }
+  }
+  else
+  {
+    return false;
+  }
+
+  ap_output_segment->protocol = protocol;
+  if( protocol == IP_PROTOCOL_TCP )
+  {
+    size_t header_length = ( a_length >= 20 ) ? ( a_data[ 12 ] >> 4 ) * 4 : 0;
+    if( header_length < 20 || header_length > a_length )
+    {
+      return false;
+    }
+
+    ap_output_segment->tcp_sequence_number = read_u32( a_data + 4, true );
+    ap_output_segment->tcp_flags = a_data[ 13 ];
+    ap_output_segment->p_payload = a_data + header_length;
+    ap_output_segment->payload_length = a_length - header_length;
+  }
+  else if( protocol == IP_PROTOCOL_UDP )
+  {
+    size_t datagram_length = ( a_length >= 8 ) ? read_u16( a_data + 4, true ) : 0;
+    if( datagram_length < 8 || datagram_length > a_length )
+    {
+      return false;
+    }
+
+    ap_output_segment->tcp_flags = 0;
+    ap_output_segment->p_payload = a_data + 8;
+    ap_output_segment->payload_length = datagram_length - 8;
+  }
+  else
+  {
+    return false;
+  }
+
+  p_key->source_port = read_u16( a_data, true );
+  p_key->destination_port = read_u16( a_data + 2, true );
+
+  return true;
+}
+
+
+// Skips the link layer header of a packet, and decodes what follows
+static bool decode_packet( const struct capture_packet* ap_packet,
+                           struct capture_segment* ap_output_segment )
+{
+  const uint8_t* p_data = ap_packet->p_data;
+  size_t length = ap_packet->length;
+  size_t header_length = 0;
+  uint16_t ethertype = 0;             // 0: told by the IP version
+
+  switch( ap_packet->link_type )
+  {
+    case LINKTYPE_NULL:
+    {
+      header_length = 4;
+      break;
+    }
+    case LINKTYPE_ETHERNET:
+    {
+      header_length = 14;
+      if( length < header_length )
+      {
+        return false;
+      }
+
+      ethertype = read_u16( p_data + 12, true );
+      while( ( ethertype == ETHERTYPE_VLAN || ethertype == ETHERTYPE_QINQ ) &&
+             length >= header_length + 4 )
+      {
+        ethertype = read_u16( p_data + header_length + 2, true );
+        header_length += 4;
+      }
+
+      break;
+    }
+    case LINKTYPE_RAW:
+    case LINKTYPE_IPV4:
+    case LINKTYPE_IPV6:
+    {
+      break;
+    }
+    case LINKTYPE_LINUX_SLL:
+    {
+      header_length = 16;
+      if( length >= header_length )
+      {
+        ethertype = read_u16( p_data + 14, true );
+      }
+
+      break;
+    }
+    case LINKTYPE_LINUX_SLL2:
+    {
+      header_length = 20;
+      if( length >= header_length )
+      {
+        ethertype = read_u16( p_data, true );
+      }
+
+      break;
+    }
+    default:
+    {
+      return false;
+    }
+  }
+
+  if( length < header_length ||
+      ( ethertype != 0 && ethertype != ETHERTYPE_IPV4 &&
+        ethertype != ETHERTYPE_IPV6 ) )
+  {
+    return false;
+  }
+
+  return decode_ip( p_data + header_length,
+                    length - header_length,
+                    ap_output_segment );
+}
+
+
+// --- Messages ----------------------------------------------------------------
+
+// Severity of the PRI a message starts with
+static int message_severity( const uint8_t* a_message, size_t a_length )
+{
+  unsigned int priority = 0;
+  size_t i = 1;
+  while( i < a_length && i <= 3 && a_message[ i ] >= '0' &&
+         a_message[ i ] <= '9' )
+  {
+    priority = priority * 10 + ( a_message[ i ] - '0' );
+    i++;
+  }
+
+  if( a_length == 0 || a_message[ 0 ] != '<' || i == 1 || i == a_length ||
+      a_message[ i ] != '>' ||
+      priority >= CSENDER_NUM_FACILITIES * CSENDER_NUM_SEVERITIES )
+  {
+    return DEFAULT_SEVERITY;
+  }
+
+  return priority % CSENDER_NUM_SEVERITIES;
+}
+
+
+// Adds a message, framed as asked, to the pack
+static void add_message( struct capture_import* ap_import,
+                         const uint8_t* a_message,
+                         size_t a_length,
+                         int64_t a_time_ns )
+{
+  if( a_length == 0 )
+  {
+    return;
+  }
+
+  char event[ CSENDER_EVENT_BUFFER_LENGTH ];
+  size_t prefix_length = 0;
+  size_t suffix_length = 0;
+  if( ap_import->framing == CSENDER_FRAMING_OCTET_COUNTING )
+  {
+    prefix_length = format_u64( event, a_length ) + 1;
+  }
+  else
+  {
+    suffix_length = 1;
+  }
+
+  if( a_length > CSENDER_EVENT_MAXLENGTH - prefix_length - suffix_length )
+  {
+    ap_import->num_too_long++;
+    return;
+  }
+
+  if( prefix_length > 0 )
+  {
+    event[ prefix_length - 1 ] = ' ';
+  }
+  memcpy( event + prefix_length, a_message, a_length );
+  if( suffix_length > 0 )
+  {
+    event[ prefix_length + a_length ] = '\n';
+  }
+
+  // Times start at the first event, and never go back, though the packets of
+  // different interfaces may
+  if( !ap_import->first_event )
+  {
+    ap_import->first_event = true;
+    ap_import->first_time_ns = a_time_ns;
+  }
+  int64_t time_ns = a_time_ns - ap_import->first_time_ns;
+  if( time_ns > ( int64_t ) ap_import->last_time_ns )
+  {
+    ap_import->last_time_ns = ( uint64_t ) time_ns;
+  }
+
+  struct pack_index_entry entry;
+  memset( &entry, 0, sizeof entry );
+  entry.timestamp_offset = PACK_NO_TIMESTAMP;
+  entry.sequence_number_offset = PACK_NO_SEQUENCE_NUMBER;
+  entry.severity = ( uint8_t ) message_severity( a_message, a_length );
+  pack_writer_add( &( ap_import->writer ),
+                   event,
+                   prefix_length + a_length + suffix_length,
+                   &entry,
+                   ap_import->last_time_ns );
+  ap_import->num_events++;
+}
+
+
+// Length of the octet count (and its space) a message starts at, or 0 if
+// there is none. *ap_output_complete tells whether the bytes are enough to
+// tell.
+static size_t octet_count_length( const uint8_t* a_data,
+                                  size_t a_length,
+                                  size_t* ap_output_count,
+                                  bool* ap_output_complete )
+{
+  size_t count = 0;
+  size_t i = 0;
+  while( i < a_length && i < MAX_OCTET_COUNT_DIGITS && a_data[ i ] >= '0' &&
+         a_data[ i ] <= '9' )
+  {
+    count = count * 10 + ( a_data[ i ] - '0' );
+    i++;
+  }
+
+  *ap_output_complete = ( i < a_length );
+  if( i == 0 || i == MAX_OCTET_COUNT_DIGITS || !*ap_output_complete ||
+      a_data[ i ] != ' ' || count == 0 || a_data[ 0 ] == '0' )
+  {
+    return 0;
+  }
+
+  *ap_output_count = count;
+  return i + 1;
+}
+
+
+// Where the first message of a stream, or the first one past a hole, starts:
+// a PRI at the start of the data or of a line, or an octet count before one.
+// Tells the framing the stream seems to use. Returns the length of the data
+// if there is none in sight.
+static size_t find_message_start( const uint8_t* a_data,
+                                  size_t a_length,
+                                  enum stream_framing* ap_framing )
+{
+  for( size_t i = 0; i < a_length; i++ )
+  {
+    bool line_start = ( i == 0 || a_data[ i - 1 ] == '\n' );
+    if( *ap_framing != STREAM_FRAMING_OCTET_COUNTING && line_start &&
+        a_data[ i ] == '<' )
+    {
+      *ap_framing = STREAM_FRAMING_LF;
+      return i;
+    }
+
+    bool digit_start = ( i == 0 || a_data[ i - 1 ] < '0' || a_data[ i - 1 ] > '9' );
+    size_t count = 0;
+    bool complete = false;
+    size_t prefix_length = 0;
+    if( *ap_framing != STREAM_FRAMING_LF && digit_start )
+    {
+      prefix_length = octet_count_length( a_data + i,
+                                          a_length - i,
+                                          &count,
+                                          &complete );
+    }
+
+    if( prefix_length > 0 && i + prefix_length < a_length &&
+        a_data[ i + prefix_length ] == '<' )
+    {
+      *ap_framing = STREAM_FRAMING_OCTET_COUNTING;
+      return i;
+    }
+  }
+
+  return a_length;
+}
+
+
+// Splits the complete messages off the buffer of a stream. At the end of it,
+// what is left is a message too, if it is not cut short.
+static void split_messages( struct capture_import* ap_import,
+                            struct tcp_flow* ap_flow,
+                            int64_t a_time_ns,
+                            bool a_end_of_stream )
+{
+  uint8_t* p_data = ap_flow->p_buffer;
+  size_t length = ap_flow->buffer_length;
+  size_t position = 0;
+
+  while( position < length )
+  {
+    if( ap_flow->lost || ap_flow->framing == STREAM_FRAMING_UNKNOWN )
+    {
+      size_t start = find_message_start( p_data + position,
+                                         length - position,
+                                         &( ap_flow->framing ) );
+      if( start == length - position )
+      {
+        // The tail that could start a message is kept, for the next segment
+        size_t kept = 0;
+        while( !a_end_of_stream && kept < length - position &&
+               kept < MAX_OCTET_COUNT_DIGITS + 1 &&
+               p_data[ length - kept - 1 ] != '\n' )
+        {
+          kept++;
+        }
+        position = length - kept;
+
+        break;
+      }
+
+      position += start;
+      ap_flow->lost = false;
+    }
+
+    if( ap_flow->framing == STREAM_FRAMING_OCTET_COUNTING )
+    {
+      size_t count = 0;
+      bool complete = false;
+      size_t prefix_length = octet_count_length( p_data + position,
+                                                 length - position,
+                                                 &count,
+                                                 &complete );
+      if( prefix_length == 0 )
+      {
+        if( complete )
+        {
+          ap_flow->lost = true;
+          continue;
+        }
+        break;
+      }
+
+      if( length - position - prefix_length < count )
+      {
+        break;
+      }
+
+      add_message( ap_import, p_data + position + prefix_length, count,
+                   a_time_ns );
+      position += prefix_length + count;
+    }
+    else
+    {
+      const uint8_t* p_line_end = memchr( p_data + position,
+                                          '\n',
+                                          length - position );
+      if( p_line_end == NULL && !a_end_of_stream )
+      {
+        break;
+      }
+
+      size_t line_end = ( p_line_end != NULL ) ?
+                            ( size_t ) ( p_line_end - p_data ) :
+                            length;
+      size_t message_end = line_end;
+      if( message_end > position && p_data[ message_end - 1 ] == '\r' )
+      {
+        message_end--;
+      }
+
+      add_message( ap_import, p_data + position, message_end - position,
+                   a_time_ns );
+      position = ( p_line_end != NULL ) ? line_end + 1 : length;
+    }
+  }
+
+  // A message that never ends is given up
+  if( length - position > MAX_STREAM_BUFFER_LENGTH )
+  {
+    position = length;
+    ap_flow->lost = true;
+  }
+
+  memmove( p_data, p_data + position, length - position );
+  ap_flow->buffer_length = length - position;
+}
+
+
+// --- TCP streams -------------------------------------------------------------
+
+static size_t hash_flow_key( const struct flow_key* ap_key )
+{
+  const uint8_t* p_bytes = ( const uint8_t* ) ap_key;
+  uint64_t hash = 0xCBF29CE484222325ULL;
+  for( size_t i = 0; i < sizeof *ap_key; i++ )
+  {
+    hash = ( hash ^ p_bytes[ i ] ) * 0x100000001B3ULL;
+  }
+
+  return ( size_t ) hash;
+}
+
+
+// Slot of the flow of the key, or of the empty one it would take
+static struct tcp_flow* flow_slot( struct tcp_flow* ap_flows,
+                                   size_t a_capacity,
+                                   const struct flow_key* ap_key )
+{
+  size_t i = hash_flow_key( ap_key ) & ( a_capacity - 1 );
+  while( ap_flows[ i ].used &&
+         memcmp( &( ap_flows[ i ].key ), ap_key, sizeof *ap_key ) != 0 )
+  {
+    i = ( i + 1 ) & ( a_capacity - 1 );
+  }
+
+  return &( ap_flows[ i ] );
+}
+
+
+// Returns NULL on lack of memory
+static struct tcp_flow* find_flow( struct capture_import* ap_import,
+                                   const struct flow_key* ap_key )
+{
+  // Kept at most half full
+  if( 2 * ( ap_import->num_flows + 1 ) > ap_import->flows_capacity )
+  {
+    size_t capacity = ( ap_import->flows_capacity > 0 ) ?
+                          2 * ap_import->flows_capacity :
+                          64;
+    struct tcp_flow* p_flows = calloc( capacity, sizeof *p_flows );
+    if( p_flows == NULL )
+    {
+      return NULL;
+    }
+
+    for( size_t i = 0; i < ap_import->flows_capacity; i++ )
+    {
+      if( ap_import->p_flows[ i ].used )
+      {
+        *flow_slot( p_flows, capacity, &( ap_import->p_flows[ i ].key ) ) =
+            ap_import->p_flows[ i ];
+      }
+    }
+
+    free( ap_import->p_flows );
+    ap_import->p_flows = p_flows;
+    ap_import->flows_capacity = capacity;
+  }
+
+  struct tcp_flow* p_flow = flow_slot( ap_import->p_flows,
+                                       ap_import->flows_capacity,
+                                       ap_key );
+  if( !p_flow->used )
+  {
+    p_flow->used = true;
+    p_flow->key = *ap_key;
+    ap_import->num_flows++;
+  }
+
+  return p_flow;
+}
+
+
+// Appends in-order bytes to the stream, and splits off its messages
+static void append_to_flow( struct capture_import* ap_import,
+                            struct tcp_flow* ap_flow,
+                            const uint8_t* a_data,
+                            size_t a_length,
+                            int64_t a_time_ns )
+{
+  if( ap_flow->buffer_length + a_length > ap_flow->buffer_capacity )
+  {
+    size_t capacity = ( ap_flow->buffer_capacity > 0 ) ?
+                          ap_flow->buffer_capacity :
+                          CSENDER_EVENT_MAXLENGTH;
+    while( capacity < ap_flow->buffer_length + a_length )
+    {
+      capacity *= 2;
+    }
+
+    uint8_t* p_buffer = realloc( ap_flow->p_buffer, capacity );
+    if( p_buffer == NULL )
+    {
+      ap_import->failed = true;
+      return;
+    }
+
+    ap_flow->p_buffer = p_buffer;
+    ap_flow->buffer_capacity = capacity;
+  }
+
+  memcpy( ap_flow->p_buffer + ap_flow->buffer_length, a_data, a_length );
+  ap_flow->buffer_length += a_length;
+  ap_flow->next_sequence_number += ( uint32_t ) a_length;
+  split_messages( ap_import, ap_flow, a_time_ns, false );
+}
+
+
+// Appends the part of a segment not seen yet, if it follows the stream
+static bool apply_segment( struct capture_import* ap_import,
+                           struct tcp_flow* ap_flow,
+                           uint32_t a_sequence_number,
+                           const uint8_t* a_data,
+                           size_t a_length,
+                           int64_t a_time_ns )
+{
+  int32_t ahead = ( int32_t ) ( a_sequence_number -
+                                ap_flow->next_sequence_number );
+  if( ahead > 0 )
+  {
+    return false;
+  }
+
+  // Retransmissions may overlap what is already there
+  size_t seen = ( size_t ) -( int64_t ) ahead;
+  if( seen < a_length )
+  {
+    append_to_flow( ap_import, ap_flow, a_data + seen, a_length - seen,
+                    a_time_ns );
+  }
+
+  return true;
+}
+
+
+// Applies the pending segments that follow the stream. If asked to, skips the
+// holes before them, and goes on from the first message start past each one.
+static void apply_pending_segments( struct capture_import* ap_import,
+                                    struct tcp_flow* ap_flow,
+                                    int64_t a_time_ns,
+                                    bool a_skip_holes )
+{
+  while( ap_flow->num_pending > 0 )
+  {
+    int earliest = 0;
+    for( int i = 1; i < ap_flow->num_pending; i++ )
+    {
+      if( ( int32_t ) ( ap_flow->pending[ i ].sequence_number -
+                        ap_flow->pending[ earliest ].sequence_number ) < 0 )
+      {
+        earliest = i;
+      }
+    }
+
+    struct pending_segment segment = ap_flow->pending[ earliest ];
+    if( ( int32_t ) ( segment.sequence_number -
+                      ap_flow->next_sequence_number ) > 0 )
+    {
+      if( !a_skip_holes )
+      {
+        break;
+      }
+
+      ap_flow->next_sequence_number = segment.sequence_number;
+      ap_flow->buffer_length = 0;
+      ap_flow->lost = true;
+    }
+
+    ap_flow->pending[ earliest ] =
+        ap_flow->pending[ --( ap_flow->num_pending ) ];
+    apply_segment( ap_import, ap_flow, segment.sequence_number,
+                   segment.p_data, segment.length, a_time_ns );
+    free( segment.p_data );
+  }
+}
+
+
+// Ends the stream: whatever is pending goes, holes and all, and so does what
+// is left of the last message, if the sender closed the connection after it
+static void close_flow( struct capture_import* ap_import,
+                        struct tcp_flow* ap_flow,
+                        int64_t a_time_ns,
+                        bool a_closed_by_sender )
+{
+  apply_pending_segments( ap_import, ap_flow, a_time_ns, true );
+  split_messages( ap_import, ap_flow, a_time_ns, a_closed_by_sender );
+  ap_flow->buffer_length = 0;
+  ap_flow->synchronized = false;
+  ap_flow->lost = false;
+  ap_flow->framing = STREAM_FRAMING_UNKNOWN;
+}
+
+
+static void add_tcp_segment( struct capture_import* ap_import,
+                             const struct capture_segment* ap_segment,
+                             int64_t a_time_ns )
+{
+  struct tcp_flow* p_flow = find_flow( ap_import, &( ap_segment->key ) );
+  if( p_flow == NULL )
+  {
+    ap_import->failed = true;
+    return;
+  }
+
+  uint32_t sequence_number = ap_segment->tcp_sequence_number;
+  if( ap_segment->tcp_flags & TCP_FLAG_SYN )
+  {
+    if( p_flow->synchronized )
+    {
+      close_flow( ap_import, p_flow, a_time_ns, true );
+    }
+
+    p_flow->synchronized = true;
+    p_flow->next_sequence_number = ++sequence_number;
+  }
+
+  if( ap_segment->payload_length > 0 )
+  {
+    // Captures started in the middle of a connection
+    if( !p_flow->synchronized )
+    {
+      p_flow->synchronized = true;
+      p_flow->lost = true;
+      p_flow->next_sequence_number = sequence_number;
+    }
+
+    if( apply_segment( ap_import, p_flow, sequence_number,
+                       ap_segment->p_payload, ap_segment->payload_length,
+                       a_time_ns ) )
+    {
+      apply_pending_segments( ap_import, p_flow, a_time_ns, false );
+    }
+    else
+    {
+      uint8_t* p_data = malloc( ap_segment->payload_length );
+      if( p_data == NULL )
+      {
+        ap_import->failed = true;
+        return;
+      }
+
+      memcpy( p_data, ap_segment->p_payload, ap_segment->payload_length );
+      struct pending_segment* p_pending =
+          &( p_flow->pending[ p_flow->num_pending++ ] );
+      p_pending->sequence_number = sequence_number;
+      p_pending->p_data = p_data;
+      p_pending->length = ap_segment->payload_length;
+
+      // Too long a wait: what is missing was not captured
+      if( p_flow->num_pending == MAX_PENDING_SEGMENTS )
+      {
+        apply_pending_segments( ap_import, p_flow, a_time_ns, true );
+      }
+    }
+  }
+
+  if( p_flow->synchronized &&
+      ( ap_segment->tcp_flags & ( TCP_FLAG_FIN | TCP_FLAG_RST ) ) )
+  {
+    close_flow( ap_import, p_flow, a_time_ns, true );
+  }
+}
+
+
+// Syslog over UDP: a message per datagram, perhaps with trailing '\n's or
+// nulls
+static void add_udp_datagram( struct capture_import* ap_import,
+                              const struct capture_segment* ap_segment,
+                              int64_t a_time_ns )
+{
+  size_t length = ap_segment->payload_length;
+  while( length > 0 && ( ap_segment->p_payload[ length - 1 ] == '\n' ||
+                         ap_segment->p_payload[ length - 1 ] == '\0' ) )
+  {
+    length--;
+  }
+
+  add_message( ap_import, ap_segment->p_payload, length, a_time_ns );
+}
+
+
+// Reads every packet of the capture into the pack. Returns false if the
+// capture is not valid. Captures cut short keep the packets before the cut.
+static bool import_packets( struct capture_import* ap_import,
+                            const uint8_t* a_data,
+                            size_t a_length )
+{
+  struct capture_reader reader;
+  if( !capture_reader_init( &reader, a_data, a_length ) )
+  {
+    return false;
+  }
+
+  struct capture_packet packet;
+  int64_t time_ns = 0;
+  long num_packets = 0;
+  int result = 0;
+  while( !ap_import->failed &&
+         ( result = capture_next( &reader, &packet ) ) > 0 )
+  {
+    time_ns = packet.time_ns;
+    num_packets++;
+
+    struct capture_segment segment;
+    if( !decode_packet( &packet, &segment ) ||
+        ( ap_import->port != 0 &&
+          segment.key.destination_port != ap_import->port ) )
+    {
+      continue;
+    }
+
+    if( segment.protocol == IP_PROTOCOL_TCP )
+    {
+      add_tcp_segment( ap_import, &segment, time_ns );
+    }
+    else
+    {
+      add_udp_datagram( ap_import, &segment, time_ns );
+    }
+  }
+
+  // Streams still open when the capture stopped, perhaps in the middle of a
+  // message
+  for( size_t i = 0; i < ap_import->flows_capacity; i++ )
+  {
+    struct tcp_flow* p_flow = &( ap_import->p_flows[ i ] );
+    if( p_flow->used && p_flow->synchronized && !ap_import->failed )
+    {
+      close_flow( ap_import, p_flow, time_ns, false );
+    }
+  }
+
+  ap_import->truncated = ( result < 0 && num_packets > 0 );
+
+  return result >= 0 || num_packets > 0;
+}
+
+
+long csender_pack_import( const char* a_file_name,
+                          const char* a_capture_file_name,
+                          int a_port,
+                          enum csender_framing a_framing )
+{
+  int fd = open( a_capture_file_name, O_RDONLY );
+  if( fd < 0 )
+  {
+    fprintf( stderr, "%s: %s\n", a_capture_file_name, strerror( errno ) );
+    return -1;
+  }
+
+  struct stat file_status;
+  void* p_map = MAP_FAILED;
+  if( fstat( fd, &file_status ) == 0 && file_status.st_size > 0 )
+  {
+    p_map = mmap( NULL, file_status.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+  }
+  close( fd );
+  if( p_map == MAP_FAILED )
+  {
+    fprintf( stderr, "%s: not a capture\n", a_capture_file_name );
+    return -1;
+  }
+  madvise( p_map, file_status.st_size, MADV_SEQUENTIAL );
+
+  struct capture_import import;
+  memset( &import, 0, sizeof import );
+  import.framing = a_framing;
+  import.port = a_port;
+  if( !pack_writer_open( &( import.writer ),
+                         a_file_name,
+                         a_framing,
+                         CSENDER_TIMEZONE_UTC,
+                         true ) )
+  {
+    munmap( p_map, file_status.st_size );
+    return -1;
+  }
+
+  bool valid = import_packets( &import, p_map, file_status.st_size );
+  if( !valid )
+  {
+    fprintf( stderr, "%s: not a valid pcap or pcapng capture\n",
+             a_capture_file_name );
+  }
+  else if( import.num_events == 0 && !import.failed )
+  {
+    fprintf( stderr, "%s: no syslog events found\n", a_capture_file_name );
+  }
+  if( import.truncated )
+  {
+    fprintf( stderr, "%s: cut short, or malformed, past some packets\n",
+             a_capture_file_name );
+  }
+  if( import.num_too_long > 0 )
+  {
+    fprintf( stderr, "%s: %ld events longer than %d chars left out\n",
+             a_capture_file_name, import.num_too_long,
+             CSENDER_EVENT_MAXLENGTH );
+  }
+
+  int result = -1;
+  if( valid && import.num_events > 0 )
+  {
+    import.writer.failed |= import.failed;
+    result = pack_writer_close( &( import.writer ) );
+  }
+  else
+  {
+    pack_writer_abort( &( import.writer ) );
+  }
+
+  for( size_t i = 0; i < import.flows_capacity; i++ )
+  {
+    struct tcp_flow* p_flow = &( import.p_flows[ i ] );
+    for( int j = 0; j < p_flow->num_pending; j++ )
+    {
+      free( p_flow->pending[ j ].p_data );
+    }
+    free( p_flow->p_buffer );
+  }
+  free( import.p_flows );
+  munmap( p_map, file_status.st_size );
+
+  return ( result == 0 ) ? import.num_events : -1;
+}
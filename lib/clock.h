@@ -0,0 +1,27 @@
+#ifndef CSENDER_CLOCK_H
+#define CSENDER_CLOCK_H
+
+#include <stdint.h>
+#include <time.h>
+
+#define NS_PER_SECOND 1000000000LL
+
+static inline int64_t monotonic_ns( )
+{
+  struct timespec time_spec;
+  clock_gettime( CLOCK_MONOTONIC, &time_spec );
+
+  return ( int64_t ) time_spec.tv_sec * NS_PER_SECOND + time_spec.tv_nsec;
+}
+
+
+static inline void sleep_until_ns( int64_t a_monotonic_ns )
+{
+  struct timespec wake_up_time;
+  wake_up_time.tv_sec = a_monotonic_ns / NS_PER_SECOND;
+  wake_up_time.tv_nsec = a_monotonic_ns % NS_PER_SECOND;
+
+  clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &wake_up_time, NULL );
+}
+
+#endif
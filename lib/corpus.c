@@ -0,0 +1,106 @@
+#include "corpus.h"
+#include "file.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct csender_corpus* csender_corpus_load( const char* a_file_name )
+{
+  size_t length = 0;
+  char* p_text = read_file( a_file_name, &length );
+  if( p_text == NULL )
+  {
+    fprintf( stderr, "%s: %s\n", a_file_name, strerror( errno ) );
+    return NULL;
+  }
+
+  struct csender_corpus* p_corpus = calloc( 1, sizeof *p_corpus );
+  if( p_corpus == NULL )
+  {
+    free( p_text );
+    return NULL;
+  }
+  p_corpus->p_text = p_text;
+
+  // Entries are runs of non-blank lines
+  int capacity = 0;
+  const char* p_entry_start = NULL;
+  const char* p_entry_end = NULL;
+  const char* p_line = p_text;
+  while( p_line < p_text + length || p_entry_start != NULL )
+  {
+    const char* p_line_end = memchr( p_line, '\n', p_text + length - p_line );
+    if( p_line_end == NULL )
+    {
+      p_line_end = p_text + length;
+    }
+
+    const char* p_content_end = p_line_end;
+    if( p_content_end > p_line && p_content_end[ -1 ] == '\r' )
+    {
+      p_content_end--;
+    }
+
+    bool blank = ( p_content_end == p_line );
+    if( !blank )
+    {
+      if( p_entry_start == NULL )
+      {
+        p_entry_start = p_line;
+      }
+      p_entry_end = p_content_end;
+    }
+
+    if( ( blank || p_line_end == p_text + length ) && p_entry_start != NULL )
+    {
+      if( p_corpus->num_entries == capacity )
+      {
+        capacity = ( capacity > 0 ) ? capacity * 2 : 64;
+        struct corpus_entry* p_entries =
+            realloc( p_corpus->p_entries, capacity * sizeof *p_entries );
+        if( p_entries == NULL )
+        {
+          csender_corpus_destroy( p_corpus );
+          return NULL;
+        }
+        p_corpus->p_entries = p_entries;
+      }
+
+      struct corpus_entry* p_entry =
+          &( p_corpus->p_entries[ p_corpus->num_entries++ ] );
+      p_entry->p_text = p_entry_start;
+      p_entry->length = p_entry_end - p_entry_start;
+      p_entry_start = NULL;
+    }
+
+    p_line = p_line_end + 1;
+  }
+
+  if( p_corpus->num_entries == 0 )
+  {
+    fprintf( stderr, "%s: no entries\n", a_file_name );
+    csender_corpus_destroy( p_corpus );
+    return NULL;
+  }
+
+  return p_corpus;
+}
+
+
+int csender_corpus_num_entries( const struct csender_corpus* ap_corpus )
+{
+  return ap_corpus->num_entries;
+}
+
+
+void csender_corpus_destroy( struct csender_corpus* ap_corpus )
+{
+  if( ap_corpus != NULL )
+  {
+    free( ap_corpus->p_entries );
+    free( ap_corpus->p_text );
+    free( ap_corpus );
+  }
+}
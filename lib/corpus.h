@@ -0,0 +1,21 @@
+#ifndef CSENDER_CORPUS_H
+#define CSENDER_CORPUS_H
+
+#include "csender.h"
+
+#include <stddef.h>
+
+struct corpus_entry
+{
+  const char*   p_text;             // Within the text of the corpus
+  size_t        length;
+};
+
+struct csender_corpus
+{
+  char*                  p_text;    // The whole file
+  struct corpus_entry*   p_entries;
+  int                    num_entries;
+};
+
+#endif
@@ -0,0 +1,997 @@
+#ifndef CSENDER_H
+#define CSENDER_H
+
+// libcsender: generation of syslog events, and sending of them to a receiver.
+//
+// Every handle type is independent of the others, and carries all of its own
+// state, so different threads may use different handles concurrently. A
+// single handle must not be used by more than one thread at a time, except
+// where stated otherwise.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Longest timestamp ("YYYY-MM-DDTHH:MM:SS.ffffff+hh:mm"), null terminator
+// included
+#define CSENDER_DATETIME_LENGTH 33
+// Longest event: what RFC 5425 receivers should take, room enough for most
+// stack traces
+#define CSENDER_EVENT_MAXLENGTH 8192
+// Length of the header with a UTC timestamp, and the default host and app
+#define CSENDER_HEADER_LENGTH 62
+
+// Longest host and app names of the header (RFC 5424)
+#define CSENDER_HOSTNAME_MAXLENGTH 255
+#define CSENDER_APP_NAME_MAXLENGTH 48
+
+// Room for an event plus its framing, and the null terminator
+#define CSENDER_EVENT_BUFFER_LENGTH ( CSENDER_EVENT_MAXLENGTH + 32 )
+
+
+// --- Timestamps --------------------------------------------------------------
+
+enum csender_clock_source
+{
+  CSENDER_CLOCK_REALTIME,           // clock_gettime( CLOCK_REALTIME )
+  CSENDER_CLOCK_REALTIME_COARSE,    // Cheaper, but only ticks every few ms
+  CSENDER_CLOCK_TSC,                // Calibrated TSC, if invariant on this CPU
+  CSENDER_CLOCK_SYNTHETIC           // Starts at CSENDER_SYNTHETIC_CLOCK_START,
+                                    // and advances 1 us per timestamp
+};
+
+// 2000-01-01T00:00:00Z
+#define CSENDER_SYNTHETIC_CLOCK_START 946684800
+
+enum csender_timezone
+{
+  CSENDER_TIMEZONE_UTC,             // "...T10:00:00.000000Z"
+  CSENDER_TIMEZONE_LOCAL            // "...T12:00:00.000000+02:00"
+};
+
+// Per-thread timestamp state: the formatted current second, and its offset
+// from UTC, are cached, so that only the sub-second digits are formatted for
+// most events.
+struct csender_timestamp_context;
+
+struct csender_timestamp_context* csender_timestamp_context_create(
+    enum csender_clock_source a_clock_source,
+    enum csender_timezone a_timezone );
+
+void csender_timestamp_context_destroy(
+    struct csender_timestamp_context* ap_context );
+
+// Source actually in use, as the TSC falls back to CSENDER_CLOCK_REALTIME on
+// CPUs without an invariant one.
+enum csender_clock_source csender_timestamp_context_clock_source(
+    const struct csender_timestamp_context* ap_context );
+
+// Writes the current time, in RFC 3339 format and null-terminated, into the
+// given buffer (at least CSENDER_DATETIME_LENGTH chars long). Tells whether
+// the second has changed since the previous call. Returns the length of the
+// timestamp, or -1 on error.
+int csender_timestamp_rfc3339( struct csender_timestamp_context* ap_context,
+                               char* a_output_buffer,
+                               bool* ap_output_second_changed );
+
+// Same, for the given instant instead of the current one
+int csender_timestamp_rfc3339_at( struct csender_timestamp_context* ap_context,
+                                  const struct timespec* ap_time,
+                                  char* a_output_buffer,
+                                  bool* ap_output_second_changed );
+
+
+// --- Priorities --------------------------------------------------------------
+
+// RFC 5424 codes: PRI = facility * 8 + severity
+#define CSENDER_NUM_FACILITIES 24
+#define CSENDER_NUM_SEVERITIES 8
+
+// Names by code ("user", "local0"...; "err", "info"...). NULL if not valid.
+const char* csender_facility_name( int a_facility );
+const char* csender_severity_name( int a_severity );
+
+// Parses a list of names (or codes) with their relative weights, e.g.
+// "local0:3,auth:1" or "info:90,warning:9,err". A missing weight is 1.
+// Returns false if the list is not valid.
+bool csender_parse_facility_weights( const char* a_specification,
+                                     unsigned int* ap_output_weights );
+bool csender_parse_severity_weights( const char* a_specification,
+                                     unsigned int* ap_output_weights );
+
+
+// --- Event generator ---------------------------------------------------------
+
+// How events are delimited in the stream (RFC 6587)
+enum csender_framing
+{
+  CSENDER_FRAMING_LF,               // Every event ends with '\n'
+  CSENDER_FRAMING_OCTET_COUNTING    // Every event is preceded by "LENGTH "
+};
+
+// What fills the body of the events
+enum csender_body_kind
+{
+  CSENDER_BODY_RANDOM,              // A random letter, repeated
+  CSENDER_BODY_MULTILINE,           // Lines of random letters, all but the
+                                    // first indented with a tab, as frames
+  CSENDER_BODY_CORPUS,              // The entries of a corpus, in turn
+  CSENDER_BODY_UTF8,                // Characters of a mix of scripts, and
+                                    // optionally invalid sequences
+  CSENDER_BODY_WORDS,               // Words of a dictionary, as text
+  CSENDER_BODY_KEY_VALUE,           // key=value pairs, separated by spaces
+  CSENDER_BODY_JSON                 // A JSON object
+};
+
+// Types of the values of key-value and JSON bodies
+enum csender_value_type
+{
+  CSENDER_VALUE_INT,                // 0-999999
+  CSENDER_VALUE_FLOAT,              // 0.000-999.999
+  CSENDER_VALUE_STRING,             // A word, quoted in JSON
+  CSENDER_VALUE_BOOL,
+  CSENDER_NUM_VALUE_TYPES
+};
+
+// Parses a list of type weights, with the names "int", "float", "string" and
+// "bool" (e.g. "int:3,string:1"). A missing weight is 1. Returns false if the
+// list is not valid.
+bool csender_parse_value_types( const char* a_specification,
+                                unsigned int* ap_output_weights );
+
+#define CSENDER_MAX_BODY_FIELDS 256
+#define CSENDER_MAX_BODY_DEPTH 8
+#define CSENDER_MAX_BODY_KEYS 65536
+
+// Classes of characters of UTF-8 bodies
+enum csender_utf8_class
+{
+  CSENDER_UTF8_ASCII,               // Letters, digits and spaces
+  CSENDER_UTF8_CYRILLIC,            // 2 bytes each
+  CSENDER_UTF8_CJK,                 // 3 bytes each
+  CSENDER_UTF8_EMOJI,               // 4 bytes each
+  CSENDER_UTF8_INVALID,             // Stray continuation bytes, overlong or
+                                    // truncated sequences, surrogates...
+  CSENDER_NUM_UTF8_CLASSES
+};
+
+// Parses a list of class weights, with the names above in lowercase (e.g.
+// "ascii:80,cjk:15,invalid:5"). A missing weight is 1. Returns false if the
+// list is not valid.
+bool csender_parse_utf8_weights( const char* a_specification,
+                                 unsigned int* ap_output_weights );
+
+// Texts to replay as event bodies, e.g. stack traces or multi-line JSON.
+// Entries are separated in the file by blank lines. It may be shared by any
+// no. of generators.
+struct csender_corpus;
+
+// Returns NULL, after telling why on stderr, if the file could not be read or
+// has no entries.
+struct csender_corpus* csender_corpus_load( const char* a_file_name );
+
+int csender_corpus_num_entries( const struct csender_corpus* ap_corpus );
+
+void csender_corpus_destroy( struct csender_corpus* ap_corpus );
+
+// Words to build text bodies from, with their frequencies, so that bodies
+// compress as real text does. One word per line, optionally followed by its
+// weight; a missing weight follows Zipf's law, in which the n-th word is
+// picked in proportion to 1/n. Up to 65536 words of up to 64 chars. It may be
+// shared by any no. of generators.
+struct csender_dictionary;
+
+// Returns NULL, after telling why on stderr, if the file could not be read or
+// is not valid.
+struct csender_dictionary* csender_dictionary_load( const char* a_file_name );
+
+int csender_dictionary_num_words(
+    const struct csender_dictionary* ap_dictionary );
+
+void csender_dictionary_destroy( struct csender_dictionary* ap_dictionary );
+
+// Events rendered in advance by csender_pack_write(), and mapped into memory
+// to be replayed. It may be shared by any no. of generators.
+struct csender_pack;
+
+// Returns NULL, after telling why on stderr, if the file could not be mapped
+// or is not valid.
+struct csender_pack* csender_pack_open( const char* a_file_name );
+
+int csender_pack_num_events( const struct csender_pack* ap_pack );
+
+// Whether the pack keeps the time every event was captured at, to be replayed
+// at the same pace
+bool csender_pack_has_times( const struct csender_pack* ap_pack );
+
+// Time zone of the timestamps of the pack, which replays keep
+enum csender_timezone csender_pack_timezone(
+    const struct csender_pack* ap_pack );
+
+void csender_pack_close( struct csender_pack* ap_pack );
+
+#define CSENDER_MAX_BODY_LINES 256
+
+struct csender_generator_options
+{
+  size_t                      event_length;   // Message, and its '\n' if any
+  size_t                      max_event_length; // If longer than event_length,
+                                                // lengths are uniform between
+                                                // both. 0: fixed length
+  const char*                 hostname;       // NULL: "localhost.localdomain"
+  const char*                 app_name;       // NULL: "my.app"
+  enum csender_clock_source   clock_source;
+  enum csender_timezone       timezone;
+  enum csender_framing        framing;
+  bool                        sequence_numbers; // Body starts with "seq=N "
+
+  // Relative weights of every facility, and every severity, which are picked
+  // independently for each event. All 0: user, and notice ("<13>").
+  unsigned int                facility_weights[ CSENDER_NUM_FACILITIES ];
+  unsigned int                severity_weights[ CSENDER_NUM_SEVERITIES ];
+
+  // Multi-line, corpus, key-value and JSON bodies set the length of their
+  // events, within CSENDER_EVENT_MAXLENGTH, so the event lengths above do not
+  // apply. Their '\n's only keep them whole with octet counting framing; LF
+  // framing splits them, as naive receivers would.
+  enum csender_body_kind      body_kind;
+
+  // Multi-line bodies: no. of lines (up to CSENDER_MAX_BODY_LINES), and
+  // length of each one, uniform in these ranges
+  unsigned int                min_lines;
+  unsigned int                max_lines;
+  unsigned int                min_line_length;
+  unsigned int                max_line_length;
+
+  const struct csender_corpus* p_corpus;      // Must outlive the generator
+
+  // UTF-8 bodies: relative weight of every class of characters, and whether
+  // bodies start with a byte order mark, as RFC 5424 asks of UTF-8 messages.
+  // All 0: 70% ASCII, and 10% of each other class but invalid.
+  unsigned int                utf8_weights[ CSENDER_NUM_UTF8_CLASSES ];
+  bool                        utf8_byte_order_mark;
+
+  // Word bodies. NULL: a built-in dictionary of common English words, and
+  // words of logs. Must outlive the generator.
+  const struct csender_dictionary* p_dictionary;
+
+  // Key-value and JSON bodies: fields of every object (up to
+  // CSENDER_MAX_BODY_FIELDS), no. of distinct keys they are named from (at
+  // least as many as the fields; 0: as many), levels of objects nested in the
+  // last field of the one above (up to CSENDER_MAX_BODY_DEPTH), and relative
+  // weight of every type of value. Fields that do not fit in
+  // CSENDER_EVENT_MAXLENGTH are left out. All 0 weights: the same for every
+  // type.
+  unsigned int                num_fields;
+  unsigned int                num_keys;
+  unsigned int                depth;
+  unsigned int                value_type_weights[ CSENDER_NUM_VALUE_TYPES ];
+
+  // If set, its events are replayed instead, in turn from a random one, with
+  // only their timestamps and sequence numbers renewed; the options above but
+  // the clock source, seed and stream index do not apply. Must outlive the
+  // generator.
+  const struct csender_pack*  p_pack;
+
+  // Every random choice of a generator (contents, lengths, hosts...) comes
+  // from a stream derived from these two values, so the same seed and stream
+  // index always yield the same events. Together with the synthetic clock,
+  // that makes the whole byte stream reproducible.
+  uint64_t                    seed;
+  unsigned int                stream_index;
+};
+
+struct csender_generator;
+
+// Returns NULL if the options are not valid, or on lack of memory. The names
+// are copied, so they need not outlive the call.
+struct csender_generator* csender_generator_create(
+    const struct csender_generator_options* ap_options );
+
+void csender_generator_destroy( struct csender_generator* ap_generator );
+
+// Writes a new, null-terminated event into the given buffer, which must be at
+// least CSENDER_EVENT_BUFFER_LENGTH chars long. Optionally tells whether the
+// second of the wall clock has changed since the previous event. Returns 0 on
+// success.
+int csender_generator_next( struct csender_generator* ap_generator,
+                            char* a_output_event,
+                            size_t* ap_output_length,
+                            bool* ap_output_second_changed );
+
+// Severity of the last event generated
+int csender_generator_last_severity(
+    const struct csender_generator* ap_generator );
+
+// When replaying a pack with times: ns since the first event replayed that the
+// next one was captured after. The pack starts again after the mean spacing
+// of its events. -1 for any other generator.
+int64_t csender_generator_next_event_time_ns(
+    const struct csender_generator* ap_generator );
+
+// Renders the given no. of events of the given options into a pack file, to be
+// replayed at the cost of a copy. Returns 0 on success, or -1, after telling
+// why on stderr.
+int csender_pack_write( const char* a_file_name,
+                        const struct csender_generator_options* ap_options,
+                        long a_num_events );
+
+// Packs the syslog events of a pcap or pcapng capture, framed as given: the
+// payloads of UDP datagrams, and the messages of TCP streams, reassembled and
+// split by octet counting or LFs, whichever they use. Just the traffic to the
+// given port, or all of it if 0. Events keep the time they were captured at,
+// and are replayed as they were, timestamps included. Returns the no. of
+// events packed, or -1, after telling why on stderr.
+long csender_pack_import( const char* a_file_name,
+                          const char* a_capture_file_name,
+                          int a_port,
+                          enum csender_framing a_framing );
+
+// Generates the given no. of events, and returns the FNV-1a hash of all of
+// their bytes, which are also counted into ap_output_num_bytes.
+uint64_t csender_generator_checksum( struct csender_generator* ap_generator,
+                                     uint64_t a_num_events,
+                                     uint64_t* ap_output_num_bytes );
+
+// Limits of the event length, for the default options
+size_t csender_min_event_length( );
+size_t csender_max_event_length( );
+
+// Minimum event length for the given options
+size_t csender_min_event_length_for(
+    const struct csender_generator_options* ap_options );
+
+
+// --- Transport ---------------------------------------------------------------
+
+// How batches of events are handed to the kernel
+enum csender_send_engine
+{
+  CSENDER_ENGINE_SEND,              // A send() per event
+  CSENDER_ENGINE_WRITEV,            // A writev() per batch
+  CSENDER_ENGINE_SENDMMSG,          // A sendmmsg() per batch, a message per
+                                    // event
+  CSENDER_ENGINE_IO_URING,          // A chain of linked sends per batch, all
+                                    // submitted with one io_uring_enter()
+  CSENDER_ENGINE_UDP_GSO,           // UDP only: a sendmsg() per run of events
+                                    // of the same length, split into
+                                    // datagrams by the kernel (UDP_SEGMENT)
+  CSENDER_ENGINE_PACKET_RING,       // UDP over IPv4 only: Ethernet frames
+                                    // built in a PACKET_TX_RING, and a send()
+                                    // per batch to transmit them. Needs
+                                    // CAP_NET_RAW, and a target that is not
+                                    // local.
+  CSENDER_NUM_SEND_ENGINES
+};
+
+// Most events per batch
+#define CSENDER_MAX_SEND_BATCH 64
+
+// Names by value ("send", "writev", "sendmmsg", "io_uring", "udp_gso",
+// "packet_ring"). NULL if not valid.
+const char* csender_send_engine_name( enum csender_send_engine a_engine );
+
+// Returns false if the name is not valid
+bool csender_parse_send_engine( const char* a_name,
+                                enum csender_send_engine* ap_output_engine );
+
+struct csender_transport;
+
+// Resolves the given target, and connects a TCP socket to it. Returns NULL if
+// that was not possible.
+struct csender_transport* csender_transport_connect( const char* a_target_name,
+                                                     const char* a_service_name );
+
+// Same, with a UDP socket: every event goes out as a datagram of its own
+struct csender_transport* csender_transport_connect_udp(
+    const char* a_target_name,
+    const char* a_service_name );
+
+// Same as csender_transport_connect(), with Multipath TCP (IPPROTO_MPTCP)
+// where the kernel offers it, or plain TCP otherwise, with a warning. A peer
+// without MPTCP turns it into plain TCP as well.
+struct csender_transport* csender_transport_connect_mptcp(
+    const char* a_target_name,
+    const char* a_service_name );
+
+// Connects to a csender_shm_reader through its Unix socket, and writes events
+// into the shared memory ring it hands over, instead of sending them: there
+// are no system calls, but for waking up a reader that ran out of events, or
+// waiting for one that fell behind. Only the default engine applies. Returns
+// NULL, after telling why on stderr, if that was not possible.
+struct csender_transport* csender_transport_connect_shm(
+    const char* a_socket_path );
+
+// Sends the whole given buffer. Returns the no. of system calls it took (at
+// least 1, but for a shared memory transport), or -1 (with errno set) on
+// error.
+int csender_transport_send( struct csender_transport* ap_transport,
+                            const char* a_data,
+                            size_t a_length );
+
+// Switches the engine of csender_transport_send_batch() (by default,
+// CSENDER_ENGINE_SEND). Returns 0 on success, or -1, after telling why on
+// stderr, if the system does not offer it, or it does not suit the transport
+// (writev, to UDP; UDP GSO and the packet ring, to TCP). UDP GSO falls back to
+// CSENDER_ENGINE_SENDMMSG, with a warning, if the kernel or the device can not
+// take it.
+int csender_transport_set_engine( struct csender_transport* ap_transport,
+                                  enum csender_send_engine a_engine );
+
+// Sends the given events (up to CSENDER_MAX_SEND_BATCH), whole and in order,
+// through the engine of the transport. Returns the no. of system calls it
+// took, or -1 (with errno set) on error.
+int csender_transport_send_batch( struct csender_transport* ap_transport,
+                                  const struct iovec* ap_events,
+                                  int a_num_events );
+
+// What the kernel TX timestamps of a sampled event tell
+struct csender_tx_latency
+{
+  int64_t   qdisc_ns;     // From entering the queueing discipline to being
+                          // handed to the device; -1 if not reported
+  int64_t   ack_ns;       // From the send call to the peer acknowledging it
+};
+
+// Has the kernel timestamp the last event of the batch (or the event) sent
+// after every given no. of events (SO_TIMESTAMPING), through a TCP transport:
+// without any help from the receiver, it tells how long events wait in the
+// queueing discipline, and for the peer to acknowledge them. A sampled batch
+// goes out with one sendmsg(), whatever the engine. Must be called before
+// anything is sent. Returns 0 on success, or -1, after telling why on stderr.
+int csender_transport_enable_tx_timestamps(
+    struct csender_transport* ap_transport,
+    int a_sample_period );
+
+// Takes the latencies of the sampled events the kernel has reported in full
+// so far, up to the given no. of them, without any system call. Returns how
+// many.
+int csender_transport_tx_latencies( struct csender_transport* ap_transport,
+                                    struct csender_tx_latency* ap_output_latencies,
+                                    int a_max_latencies );
+
+// Most subflows of an MPTCP connection reported
+#define CSENDER_MAX_SUBFLOWS 8
+
+// Room for "[address]:port", IPv6 included
+#define CSENDER_ENDPOINT_LENGTH 56
+
+// A subflow of an MPTCP connection, as the kernel tells (MPTCP_TCPINFO and
+// MPTCP_SUBFLOW_ADDRS)
+struct csender_subflow_info
+{
+  char       local_endpoint[ CSENDER_ENDPOINT_LENGTH ];
+  char       remote_endpoint[ CSENDER_ENDPOINT_LENGTH ];
+  uint64_t   num_bytes_acked;     // Since the subflow was established
+  uint32_t   rtt_us;              // Smoothed
+  uint32_t   congestion_window;   // Segments
+  uint32_t   num_retransmits;     // Segments, in all
+};
+
+// Fills in the subflows of an MPTCP transport, up to the given no. of them.
+// Returns how many, or -1 if the connection is not (or no longer) MPTCP.
+int csender_transport_subflows( const struct csender_transport* ap_transport,
+                                struct csender_subflow_info* ap_output_subflows,
+                                int a_max_subflows );
+
+int csender_transport_fd( const struct csender_transport* ap_transport );
+
+// Bytes handed to the kernel but not yet acknowledged by the peer (SIOCOUTQ),
+// or written into a shared memory ring but not yet read, which grow as the
+// receiver falls behind. -1 on error.
+long csender_transport_send_queue_bytes(
+    const struct csender_transport* ap_transport );
+
+// Numeric address of the peer the transport is connected to
+const char* csender_transport_peer_address(
+    const struct csender_transport* ap_transport );
+
+void csender_transport_close( struct csender_transport* ap_transport );
+
+
+// --- Statistics --------------------------------------------------------------
+
+// Log-linear histogram of durations, in ns: exact below 16 ns, and with 16
+// buckets per power of two above (so within 6.25% of the true value), up to
+// about 18 minutes.
+#define CSENDER_HISTOGRAM_NUM_BUCKETS 592
+
+struct csender_histogram
+{
+  uint64_t   counts[ CSENDER_HISTOGRAM_NUM_BUCKETS ];
+};
+
+void csender_histogram_clear( struct csender_histogram* ap_histogram );
+
+void csender_histogram_record( struct csender_histogram* ap_histogram,
+                               uint64_t a_value );
+
+// ap_total += ap_histogram
+void csender_histogram_accumulate( struct csender_histogram* ap_total,
+                                   const struct csender_histogram* ap_histogram );
+
+// ap_histogram -= ap_earlier, where ap_earlier is an earlier copy of the same
+// histogram. Leaves what was recorded in between.
+void csender_histogram_subtract( struct csender_histogram* ap_histogram,
+                                 const struct csender_histogram* ap_earlier );
+
+uint64_t csender_histogram_count( const struct csender_histogram* ap_histogram );
+
+// Value below which the given percentage (0-100) of the recorded values are.
+// 0 if the histogram is empty.
+uint64_t csender_histogram_percentile(
+    const struct csender_histogram* ap_histogram,
+    double a_percentile );
+
+struct csender_stats_snapshot
+{
+  long   num_events_sent;
+  long   num_bytes_sent;
+  long   num_send_errors;
+  long   send_time_ns;      // Total time spent inside the transport's send
+  long   num_send_calls;    // System calls the transport's send made
+  long   num_events_by_severity[ CSENDER_NUM_SEVERITIES ];
+};
+
+// A block of counters. It must be updated by a single thread at a time, but
+// snapshots of it may be taken from any thread, at any moment.
+struct csender_stats;
+
+struct csender_stats* csender_stats_create( );
+
+void csender_stats_destroy( struct csender_stats* ap_stats );
+
+void csender_stats_add( struct csender_stats* ap_stats,
+                        long a_num_events,
+                        long a_num_bytes,
+                        long a_num_errors );
+
+// Counts one event sent of the given severity, on top of csender_stats_add()
+void csender_stats_count_severity( struct csender_stats* ap_stats,
+                                   int a_severity );
+
+// Records how long sending one event took
+void csender_stats_record_send_time( struct csender_stats* ap_stats,
+                                     uint64_t a_send_time_ns );
+
+// Counts the system calls a send took, as csender_transport_send() returns
+void csender_stats_count_send_calls( struct csender_stats* ap_stats,
+                                     long a_num_calls );
+
+// Records the latencies of an event sampled with kernel TX timestamps
+void csender_stats_record_tx_latency( struct csender_stats* ap_stats,
+                                      const struct csender_tx_latency* ap_latency );
+
+void csender_stats_snapshot( const struct csender_stats* ap_stats,
+                             struct csender_stats_snapshot* ap_output_snapshot );
+
+// Adds the histogram of the send times recorded so far to the given one
+void csender_stats_send_times( const struct csender_stats* ap_stats,
+                               struct csender_histogram* ap_io_histogram );
+
+// Adds the histograms of the TX latencies recorded so far to the given ones:
+// times in the queueing discipline, and until acknowledged by the peer
+void csender_stats_tx_latencies( const struct csender_stats* ap_stats,
+                                 struct csender_histogram* ap_io_qdisc_times,
+                                 struct csender_histogram* ap_io_ack_times );
+
+// Adds the counters of a snapshot to the ones of another one
+void csender_stats_snapshot_accumulate(
+    struct csender_stats_snapshot* ap_total,
+    const struct csender_stats_snapshot* ap_snapshot );
+
+
+// --- Performance counters ----------------------------------------------------
+
+// What the kernel (perf_event_open) may count of a thread
+enum csender_perf_counter
+{
+  CSENDER_PERF_TASK_CLOCK,          // ns on a CPU
+  CSENDER_PERF_CONTEXT_SWITCHES,
+  CSENDER_PERF_CYCLES,
+  CSENDER_PERF_USER_CYCLES,         // Those out of the kernel
+  CSENDER_PERF_INSTRUCTIONS,
+  CSENDER_PERF_CACHE_MISSES,
+  CSENDER_PERF_BRANCH_MISSES,
+  CSENDER_NUM_PERF_COUNTERS
+};
+
+// Totals since the counters were opened. Virtual machines often lack the
+// hardware counters, so any of them may not be available.
+struct csender_perf_sample
+{
+  uint64_t   values[ CSENDER_NUM_PERF_COUNTERS ];
+  bool       available[ CSENDER_NUM_PERF_COUNTERS ];
+};
+
+// Counters of a single thread. They may be read from any thread, at any
+// moment, and keep their totals once the thread is gone.
+struct csender_perf;
+
+// Opens every counter the kernel offers for the calling thread. Returns NULL,
+// with errno set, if none could be opened.
+struct csender_perf* csender_perf_open( );
+
+void csender_perf_read( const struct csender_perf* ap_perf,
+                        struct csender_perf_sample* ap_output_sample );
+
+// Adds the counters of a sample to the ones of another one. A counter is
+// available in the total if it is in either.
+void csender_perf_sample_accumulate(
+    struct csender_perf_sample* ap_total,
+    const struct csender_perf_sample* ap_sample );
+
+void csender_perf_close( struct csender_perf* ap_perf );
+
+
+// --- Send loop ---------------------------------------------------------------
+
+// Lets other threads steer a running send loop
+struct csender_send_control
+{
+  volatile bool   stop_requested;
+  volatile long   rate;             // Events/sec. 0: as fast as possible
+  double          replay_speed;     // If > 0, packs with times are sent at
+                                    // this multiple of their original pace
+                                    // instead
+  int             batch_size;       // Most events per batch handed to the
+                                    // transport (up to CSENDER_MAX_SEND_BATCH).
+                                    // A batch is sent early rather than wait
+                                    // for the pace. 0 or 1: one per event.
+};
+
+// Generates events and sends them through the transport, paced at the rate of
+// the control struct, until a stop is requested or an error happens. Send
+// times are recorded per batch. Returns 0 if stopped on request, or -1 on
+// error.
+int csender_send_events( struct csender_generator* ap_generator,
+                         struct csender_transport* ap_transport,
+                         struct csender_stats* ap_stats,
+                         const struct csender_send_control* ap_control );
+
+
+// --- Runner: in-process load generation --------------------------------------
+
+struct csender_runner_options
+{
+  const char*                        target_name;
+  const char*                        service_name;
+  struct csender_generator_options   generator;
+  int                                num_threads;
+  long                               rate;          // Events/sec; 0: no limit
+  double                             replay_speed;  // See csender_send_control
+  bool                               perf_counters; // Count what every sender
+                                                    // thread costs the CPU
+  enum csender_send_engine           engine;
+  int                                batch_size;    // See csender_send_control
+  bool                               udp;           // Datagrams instead of a
+                                                    // TCP connection
+  bool                               mptcp;         // Multipath TCP, where
+                                                    // offered
+  int                                tx_timestamps; // Sample one in every so
+                                                    // many events with kernel
+                                                    // TX timestamps; 0: none
+  const char*                        shm_path;      // Socket of a shared
+                                                    // memory reader to write
+                                                    // to instead of the
+                                                    // target; NULL: none
+};
+
+struct csender_runner;
+
+// Thread i gets a generator with its stream_index increased by i, so that
+// every thread sends a different, but reproducible, stream. Connects one
+// transport per thread to the target. Returns NULL if any of the connections
+// could not be established. The runner handle itself may be used from any
+// thread.
+struct csender_runner* csender_runner_create(
+    const struct csender_runner_options* ap_options );
+
+// Spawns the sender threads. Returns 0 on success.
+int csender_runner_start( struct csender_runner* ap_runner );
+
+// Requests the sender threads to stop, and waits for them.
+void csender_runner_stop( struct csender_runner* ap_runner );
+
+// Tells whether any sender thread is still sending
+bool csender_runner_is_running( const struct csender_runner* ap_runner );
+
+// Changes the total rate of all the sender threads (events/sec; 0: no limit)
+void csender_runner_set_rate( struct csender_runner* ap_runner, long a_rate );
+
+long csender_runner_rate( const struct csender_runner* ap_runner );
+
+// Sum of the statistics of every sender thread
+void csender_runner_stats( const struct csender_runner* ap_runner,
+                           struct csender_stats_snapshot* ap_output_snapshot );
+
+// Histogram of the send times of every sender thread
+void csender_runner_send_times( const struct csender_runner* ap_runner,
+                                struct csender_histogram* ap_output_histogram );
+
+// Histograms of the TX latencies of every sender thread, if sampled: times in
+// the queueing discipline, and until acknowledged by the peer
+void csender_runner_tx_latencies( const struct csender_runner* ap_runner,
+                                  struct csender_histogram* ap_output_qdisc_times,
+                                  struct csender_histogram* ap_output_ack_times );
+
+// Subflows of the connection of the given sender thread, as
+// csender_transport_subflows() tells
+int csender_runner_subflows( const struct csender_runner* ap_runner,
+                             int a_thread_index,
+                             struct csender_subflow_info* ap_output_subflows,
+                             int a_max_subflows );
+
+// Sum of the send queues of the connections of every sender thread
+long csender_runner_send_queue_bytes( const struct csender_runner* ap_runner );
+
+// Sum of the performance counters of every sender thread, if asked for in the
+// options. Returns false if none could be opened (yet).
+bool csender_runner_perf_counters( const struct csender_runner* ap_runner,
+                                   struct csender_perf_sample* ap_output_sample );
+
+void csender_runner_destroy( struct csender_runner* ap_runner );
+
+
+// --- Maximum throughput search -----------------------------------------------
+
+struct csender_find_max_options
+{
+  long     initial_rate;              // Events/sec of the first step
+  long     max_rate;                  // Highest rate to try; 0: no limit
+  uint64_t max_p99_send_time_ns;      // Latency budget
+  double   min_delivery_ratio;        // Of the offered rate, e.g. 0.98
+  int      min_step_seconds;          // Each step is held at least this long,
+  int      max_step_seconds;          // and at most this long, until stable
+  double   precision;                 // Relative width where the search stops
+};
+
+struct csender_find_max_step
+{
+  long       offered_rate;
+  double     achieved_rate;
+  uint64_t   p99_send_time_ns;
+  int        num_seconds;
+  bool       sustained;
+};
+
+struct csender_find_max_result
+{
+  long       max_sustained_rate;      // 0 if not even the lowest one was
+  uint64_t   p99_send_time_ns;        // At that rate
+  int        num_steps;
+};
+
+// Fills in the default search options
+void csender_find_max_options_init( struct csender_find_max_options* ap_options );
+
+// Searches for the highest rate a started runner can sustain: doubling it
+// until a step fails, then bisecting. A step is sustained if the achieved rate
+// keeps up with the offered one, and the p99 of the send times (which grow as
+// the receiver pushes back) stays within budget. The optional callback is
+// told about every step. Returns 0 on success, or -1 if the runner stopped.
+int csender_find_max( struct csender_runner* ap_runner,
+                      const struct csender_find_max_options* ap_options,
+                      void ( *ap_step_callback )(
+                          const struct csender_find_max_step* ap_step,
+                          void* ap_user_data ),
+                      void* ap_user_data,
+                      struct csender_find_max_result* ap_output_result );
+
+
+// --- Adaptive rate -----------------------------------------------------------
+
+// Additive-increase/multiplicative-decrease control of the rate of a runner,
+// driven by how hard the receiver pushes back.
+struct csender_adaptive_options
+{
+  long       initial_rate;            // Events/sec
+  long       min_rate;
+  long       max_rate;                // 0: no limit
+  long       additive_increase;       // Events/sec added after a clean interval
+  double     multiplicative_decrease; // Rate factor after a congested one
+  uint64_t   max_p99_send_time_ns;    // Congestion signals: send() blocking,
+  long       max_send_queue_bytes;    // unacknowledged bytes queued in the
+  double     min_delivery_ratio;      // kernel, or falling behind the rate
+};
+
+// What was observed during an interval, and the decision taken
+struct csender_adaptive_step
+{
+  long       rate;                    // Offered during the interval
+  long       next_rate;
+  double     achieved_rate;
+  uint64_t   p99_send_time_ns;
+  long       send_queue_bytes;        // At the end of the interval
+  bool       congested;
+};
+
+struct csender_adaptive;
+
+// Fills in the default options
+void csender_adaptive_options_init(
+    struct csender_adaptive_options* ap_options );
+
+// Sets the runner to the initial rate, and starts measuring. Returns NULL if
+// the options are not valid, or on lack of memory.
+struct csender_adaptive* csender_adaptive_create(
+    struct csender_runner* ap_runner,
+    const struct csender_adaptive_options* ap_options );
+
+// Measures the interval since the previous update (or the creation), and
+// adjusts the rate of the runner accordingly. Meant to be called at a steady
+// pace, e.g. every second. Returns 0 on success, or -1 if no time has passed.
+int csender_adaptive_update( struct csender_adaptive* ap_adaptive,
+                             struct csender_adaptive_step* ap_output_step );
+
+void csender_adaptive_destroy( struct csender_adaptive* ap_adaptive );
+
+
+// --- Workloads: mixes of streams ---------------------------------------------
+
+// How the rate of a stream evolves, from its start
+enum csender_rate_profile
+{
+  CSENDER_RATE_CONSTANT,            // Always rate
+  CSENDER_RATE_RAMP,                // From rate to peak_rate along the period,
+                                    // then peak_rate
+  CSENDER_RATE_SINE                 // Between rate and peak_rate, and back,
+                                    // every period
+};
+
+#define CSENDER_STREAM_NAME_MAXLENGTH 63
+#define CSENDER_TARGET_NAME_MAXLENGTH 255
+#define CSENDER_SERVICE_NAME_MAXLENGTH 31
+
+// One source of traffic: its own kind of events, sent at its own rate, to its
+// own target
+struct csender_stream_options
+{
+  char                               name[ CSENDER_STREAM_NAME_MAXLENGTH + 1 ];
+  char                               target_name[
+                                         CSENDER_TARGET_NAME_MAXLENGTH + 1 ];
+  char                               service_name[
+                                         CSENDER_SERVICE_NAME_MAXLENGTH + 1 ];
+  char                               hostname[ CSENDER_HOSTNAME_MAXLENGTH + 1 ];
+  char                               app_name[ CSENDER_APP_NAME_MAXLENGTH + 1 ];
+
+  // Its names are taken from the fields above (empty: the defaults), and
+  // its stream index is increased by the no. of the connection within the
+  // whole workload
+  struct csender_generator_options   generator;
+
+  long                               rate;          // Events/sec
+  enum csender_rate_profile          rate_profile;
+  long                               peak_rate;
+  int                                period_seconds;
+  int                                num_connections;
+};
+
+struct csender_workload
+{
+  int                                num_threads;
+  int                                num_streams;
+  struct csender_stream_options*     p_streams;
+  struct csender_corpus**            pp_corpora;    // Loaded for its streams
+  int                                num_corpora;
+  struct csender_dictionary**        pp_dictionaries;
+  int                                num_dictionaries;
+  struct csender_pack**              pp_packs;
+  int                                num_packs;
+};
+
+// Reads a workload file, in INI format:
+//
+//   threads = 4                     # Keys before any section apply to every
+//   port = 514                      # stream, unless a stream overrides them
+//
+//   [web]                           # A stream, with its name
+//   rate = 5000
+//   profile = sine                  # constant, ramp or sine
+//   peak_rate = 20000
+//   period = 60                     # Seconds
+//   length = 200-800                # Fixed, or uniform in a range
+//   hostname = web01.example.com
+//   app = nginx
+//
+// Other keys: host, connections, clock, timezone, framing, sequence, facility,
+// severity, body, lines, line_length, corpus (a file name), utf8, bom,
+// dictionary (a file name), fields, keys, depth, value_types, replay (a pack
+// file) and seed.
+// Comments start with '#' or ';', at the start of a line or after a space, so
+// that values may hold them. Lines are at most 1023 characters long.
+// Values not given in the file are taken from the defaults. Returns NULL,
+// after telling why on stderr, if the file is not valid.
+struct csender_workload* csender_workload_load(
+    const char* a_file_name,
+    const struct csender_stream_options* ap_defaults,
+    int a_default_num_threads );
+
+void csender_workload_destroy( struct csender_workload* ap_workload );
+
+// Rate of a stream after the given time since its start
+long csender_stream_rate_at( const struct csender_stream_options* ap_stream,
+                             int64_t a_elapsed_ns );
+
+// Sends all the streams of a workload. Every stream gets its own connections,
+// which are spread among the sender threads; each thread interleaves the
+// events of its connections, in the order they are due.
+struct csender_workload_runner;
+
+// Connects to the targets. Returns NULL if any of the connections could not be
+// established. The workload must outlive the runner.
+struct csender_workload_runner* csender_workload_runner_create(
+    const struct csender_workload* ap_workload );
+
+// Spawns the sender threads. Returns 0 on success.
+int csender_workload_runner_start( struct csender_workload_runner* ap_runner );
+
+// Requests the sender threads to stop, and waits for them.
+void csender_workload_runner_stop( struct csender_workload_runner* ap_runner );
+
+// Tells whether any connection is still sending
+bool csender_workload_runner_is_running(
+    const struct csender_workload_runner* ap_runner );
+
+// Sum of the statistics of the connections of a stream
+void csender_workload_runner_stream_stats(
+    const struct csender_workload_runner* ap_runner,
+    int a_stream_index,
+    struct csender_stats_snapshot* ap_output_snapshot );
+
+void csender_workload_runner_destroy(
+    struct csender_workload_runner* ap_runner );
+
+
+// --- Shared memory reader ----------------------------------------------------
+
+// The receiving end of csender_transport_connect_shm(), for measuring the
+// handoff of events to a collector on the same host. It listens on a Unix
+// socket, and hands every writer that connects a ring of its own in shared
+// memory (a memfd), drained by a thread of its own.
+struct csender_shm_reader;
+
+// Most writers a reader takes at once. The slot of a writer that went away is
+// taken by the next one.
+#define CSENDER_SHM_MAX_WRITERS 64
+
+// Bytes of the ring of every writer, unless told otherwise
+#define CSENDER_SHM_DEFAULT_RING_LENGTH ( 4 * 1024 * 1024 )
+
+struct csender_shm_reader_stats
+{
+  int        num_writers;           // Connected now
+  uint64_t   num_events_read;       // Since the start, from every writer
+  uint64_t   num_bytes_read;
+};
+
+// Listens on the given socket path, replacing a stale socket there. Events are
+// told apart by the given framing. Returns NULL, after telling why on stderr,
+// if that was not possible.
+struct csender_shm_reader* csender_shm_reader_create(
+    const char* a_socket_path,
+    size_t a_ring_length,
+    enum csender_framing a_framing );
+
+// Spawns the thread that takes writers. Returns 0 on success.
+int csender_shm_reader_start( struct csender_shm_reader* ap_reader );
+
+// Sum of what every writer handed over so far. May be called from any thread.
+void csender_shm_reader_stats(
+    const struct csender_shm_reader* ap_reader,
+    struct csender_shm_reader_stats* ap_output_stats );
+
+// Stops taking and reading events, and removes the socket
+void csender_shm_reader_destroy( struct csender_shm_reader* ap_reader );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
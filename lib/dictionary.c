@@ -0,0 +1,322 @@
+#include "dictionary.h"
+#include "file.h"
+#include "weights.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Most frequent first
+static const char* g_builtin_words[] =
+{
+  "the", "to", "of", "and", "a", "in", "is", "for", "on", "that",
+  "with", "from", "by", "at", "as", "not", "be", "was", "user", "this",
+  "request", "error", "it", "are", "an", "or", "no", "server", "connection",
+  "failed", "session", "id", "new", "all", "has", "service", "status",
+  "will", "time", "file", "data", "client", "started", "process", "after",
+  "message", "can", "one", "received", "have", "up", "out", "if", "ms",
+  "but", "more", "check", "host", "which", "been", "set", "their", "into",
+  "disk", "timeout", "response", "other", "queue", "there", "cache", "read",
+  "were", "write", "when", "key", "default", "than", "network", "some",
+  "retry", "them", "memory", "update", "port", "would", "so", "what",
+  "config", "only", "completed", "its", "also", "first", "value", "about",
+  "open", "closed", "login", "accepted", "denied", "access", "could",
+  "because", "while", "job", "task", "thread", "worker", "over", "then",
+  "path", "node", "two", "may", "any", "like", "system", "should", "how",
+  "total", "state", "ok", "warning", "these", "each", "address", "before",
+  "used", "during", "our", "most", "load", "limit", "rate", "through",
+  "between", "under", "same", "remote", "local", "source", "target", "size",
+  "bytes", "start", "stop", "running", "waiting", "pending", "reset",
+  "refused", "invalid", "missing", "found", "created", "deleted", "updated",
+  "backend", "database", "query", "transaction", "commit", "rollback",
+  "lock", "index", "table", "record", "field", "event", "handler", "module",
+  "version", "build", "deploy", "health", "probe", "metric", "latency",
+  "upstream", "downstream", "proxy", "route", "token", "expired", "secure",
+  "certificate", "handshake", "socket", "buffer", "stream", "packet",
+  "channel", "batch", "schedule", "cron", "backup", "restore", "snapshot",
+  "volume", "mount", "kernel", "daemon", "signal", "exit", "code", "pid",
+  "uid", "group", "policy", "rule", "firewall", "allowed", "blocked",
+  "dropped", "forwarded", "sent", "delivered", "bounced", "mail", "account",
+  "password", "authentication", "authorization", "permission", "resource",
+  "quota", "exceeded", "throttled", "slow", "fast", "high", "low", "normal",
+  "critical", "unavailable", "recovered", "degraded", "initialized",
+  "shutdown", "restart", "reload", "listening", "bound", "interface",
+  "gateway", "dns", "lookup", "resolved", "http", "https", "get", "post",
+  "put", "delete", "header", "body", "payload", "json", "parse", "format"
+};
+
+static struct csender_dictionary* g_p_builtin_dictionary = NULL;
+static pthread_once_t g_builtin_dictionary_once = PTHREAD_ONCE_INIT;
+
+
+// Builds a dictionary of the given words, with the given weights
+static struct csender_dictionary* dictionary_create( const char** a_words,
+                                                     const size_t* a_lengths,
+                                                     const double* a_weights,
+                                                     int a_num_words )
+{
+  struct csender_dictionary* p_dictionary = calloc( 1, sizeof *p_dictionary );
+  if( p_dictionary == NULL )
+  {
+    return NULL;
+  }
+
+  // Block copies of the last word may read past it
+  size_t arena_length = WORD_BLOCK_LENGTH;
+  for( int i = 0; i < a_num_words; i++ )
+  {
+    arena_length += a_lengths[ i ] + 1;
+  }
+
+  p_dictionary->num_words = a_num_words;
+  p_dictionary->p_arena = calloc( arena_length, 1 );
+  p_dictionary->p_offsets = malloc( a_num_words * sizeof( uint32_t ) );
+  p_dictionary->p_lengths = malloc( a_num_words * sizeof( uint8_t ) );
+  p_dictionary->p_thresholds = malloc( a_num_words * sizeof( uint64_t ) );
+  p_dictionary->p_aliases = malloc( a_num_words * sizeof( uint32_t ) );
+  double* p_scratch = malloc( a_num_words * sizeof( double ) );
+  int* p_scratch_indices = malloc( a_num_words * sizeof( int ) );
+  if( p_dictionary->p_arena == NULL || p_dictionary->p_offsets == NULL ||
+      p_dictionary->p_lengths == NULL || p_dictionary->p_thresholds == NULL ||
+      p_dictionary->p_aliases == NULL || p_scratch == NULL ||
+      p_scratch_indices == NULL )
+  {
+    free( p_scratch );
+    free( p_scratch_indices );
+    csender_dictionary_destroy( p_dictionary );
+    return NULL;
+  }
+
+  char* p_output = p_dictionary->p_arena;
+  for( int i = 0; i < a_num_words; i++ )
+  {
+    p_dictionary->p_offsets[ i ] = ( uint32_t ) ( p_output -
+                                                  p_dictionary->p_arena );
+    p_dictionary->p_lengths[ i ] = ( uint8_t ) ( a_lengths[ i ] + 1 );
+    memcpy( p_output, a_words[ i ], a_lengths[ i ] );
+    p_output += a_lengths[ i ];
+    *p_output++ = ' ';
+  }
+
+  alias_table_build( a_weights,
+                     a_num_words,
+                     p_scratch,
+                     p_scratch_indices,
+                     p_dictionary->p_thresholds,
+                     p_dictionary->p_aliases );
+
+  free( p_scratch );
+  free( p_scratch_indices );
+
+  return p_dictionary;
+}
+
+
+static void init_builtin_dictionary( )
+{
+  int num_words = sizeof g_builtin_words / sizeof g_builtin_words[ 0 ];
+  size_t lengths[ sizeof g_builtin_words / sizeof g_builtin_words[ 0 ] ];
+  double weights[ sizeof g_builtin_words / sizeof g_builtin_words[ 0 ] ];
+  for( int i = 0; i < num_words; i++ )
+  {
+    lengths[ i ] = strlen( g_builtin_words[ i ] );
+    weights[ i ] = 1.0 / ( i + 1 );
+  }
+
+  g_p_builtin_dictionary = dictionary_create( g_builtin_words,
+                                              lengths,
+                                              weights,
+                                              num_words );
+}
+
+
+const struct csender_dictionary* dictionary_builtin( )
+{
+  pthread_once( &g_builtin_dictionary_once, init_builtin_dictionary );
+
+  return g_p_builtin_dictionary;
+}
+
+
+// "WORD [WEIGHT]" per line, where a missing weight follows Zipf's law. Blank
+// lines, and lines starting with '#', are skipped. Returns the no. of words,
+// or -1, after telling why on stderr, if the text is not valid.
+static int parse_words( char* a_text,
+                        size_t a_length,
+                        const char* a_file_name,
+                        const char** ap_output_words,
+                        size_t* ap_output_lengths,
+                        double* ap_output_weights )
+{
+  int num_words = 0;
+  int line_number = 0;
+  char* p_line = a_text;
+  while( p_line < a_text + a_length )
+  {
+    line_number++;
+    char* p_line_end = memchr( p_line, '\n', a_text + a_length - p_line );
+    if( p_line_end == NULL )
+    {
+      p_line_end = a_text + a_length;
+    }
+    *p_line_end = '\0';
+
+    char* p_word = p_line + strspn( p_line, " \t\r" );
+    p_line = p_line_end + 1;
+    size_t word_length = strcspn( p_word, " \t\r" );
+    if( word_length == 0 || *p_word == '#' )
+    {
+      continue;
+    }
+
+    double weight = 1.0 / ( num_words + 1 );
+    char* p_rest = p_word + word_length + strspn( p_word + word_length,
+                                                  " \t\r" );
+    if( *p_rest != '\0' )
+    {
+      char* p_end = NULL;
+      weight = strtod( p_rest, &p_end );
+      if( p_end == p_rest || !( weight > 0 ) ||
+          p_end[ strspn( p_end, " \t\r" ) ] != '\0' )
+      {
+        fprintf( stderr, "%s:%d: invalid weight\n", a_file_name, line_number );
+        return -1;
+      }
+    }
+
+    if( word_length > DICTIONARY_WORD_MAXLENGTH )
+    {
+      fprintf( stderr, "%s:%d: word longer than %d chars\n",
+               a_file_name, line_number, DICTIONARY_WORD_MAXLENGTH );
+      return -1;
+    }
+
+    if( num_words == DICTIONARY_MAX_WORDS )
+    {
+      fprintf( stderr, "%s: more than %d words\n",
+               a_file_name, DICTIONARY_MAX_WORDS );
+      return -1;
+    }
+
+    ap_output_words[ num_words ] = p_word;
+    ap_output_lengths[ num_words ] = word_length;
+    ap_output_weights[ num_words ] = weight;
+    num_words++;
+  }
+
+  if( num_words == 0 )
+  {
+    fprintf( stderr, "%s: no words\n", a_file_name );
+    return -1;
+  }
+
+  return num_words;
+}
+
+
+struct csender_dictionary* csender_dictionary_load( const char* a_file_name )
+{
+  size_t length = 0;
+  char* p_text = read_file( a_file_name, &length );
+  if( p_text == NULL )
+  {
+    fprintf( stderr, "%s: %s\n", a_file_name, strerror( errno ) );
+    return NULL;
+  }
+
+  const char** pp_words = malloc( DICTIONARY_MAX_WORDS * sizeof *pp_words );
+  size_t* p_lengths = malloc( DICTIONARY_MAX_WORDS * sizeof *p_lengths );
+  double* p_weights = malloc( DICTIONARY_MAX_WORDS * sizeof *p_weights );
+  struct csender_dictionary* p_dictionary = NULL;
+  if( pp_words != NULL && p_lengths != NULL && p_weights != NULL )
+  {
+    int num_words = parse_words( p_text,
+                                 length,
+                                 a_file_name,
+                                 pp_words,
+                                 p_lengths,
+                                 p_weights );
+    if( num_words > 0 )
+    {
+      p_dictionary = dictionary_create( pp_words,
+                                        p_lengths,
+                                        p_weights,
+                                        num_words );
+    }
+  }
+
+  free( pp_words );
+  free( p_lengths );
+  free( p_weights );
+  free( p_text );
+
+  return p_dictionary;
+}
+
+
+int csender_dictionary_num_words(
+    const struct csender_dictionary* ap_dictionary )
+{
+  return ap_dictionary->num_words;
+}
+
+
+void csender_dictionary_destroy( struct csender_dictionary* ap_dictionary )
+{
+  if( ap_dictionary != NULL )
+  {
+    free( ap_dictionary->p_arena );
+    free( ap_dictionary->p_offsets );
+    free( ap_dictionary->p_lengths );
+    free( ap_dictionary->p_thresholds );
+    free( ap_dictionary->p_aliases );
+    free( ap_dictionary );
+  }
+}
+
+
+void generate_words_body( const struct csender_dictionary* ap_dictionary,
+                          size_t a_body_length,
+                          uint64_t* ap_io_random_state,
+                          char* a_output_body )
+{
+  // Kept in locals: the output is made of chars, which may alias anything, so
+  // the compiler would otherwise reload them after every word
+  const struct csender_dictionary dictionary = *ap_dictionary;
+  uint64_t random_state = *ap_io_random_state;
+  char* p_output = a_output_body;
+  char* p_end = a_output_body + a_body_length;
+
+  // Two words per random no. Most of them are copied as a fixed block, which
+  // is cheaper than a copy of variable length; what goes beyond a word is
+  // overwritten by the next one.
+  while( p_output < p_end )
+  {
+    uint64_t random = random_next( &random_state );
+    for( int i = 0; i < 2 && p_output < p_end; i++, random >>= 32 )
+    {
+      int word = dictionary_pick( &dictionary, ( uint32_t ) random );
+      const char* p_word = dictionary.p_arena + dictionary.p_offsets[ word ];
+      size_t word_length = dictionary.p_lengths[ word ];
+
+      if( word_length <= WORD_BLOCK_LENGTH &&
+          p_end - p_output >= WORD_BLOCK_LENGTH )
+      {
+        memcpy( p_output, p_word, WORD_BLOCK_LENGTH );
+      }
+      else
+      {
+        memcpy( p_output,
+                p_word,
+                ( word_length < ( size_t ) ( p_end - p_output ) ) ?
+                    word_length :
+                    ( size_t ) ( p_end - p_output ) );
+      }
+      p_output += word_length;
+    }
+  }
+
+  *ap_io_random_state = random_state;
+}
@@ -0,0 +1,56 @@
+#ifndef CSENDER_DICTIONARY_H
+#define CSENDER_DICTIONARY_H
+
+#include "csender.h"
+#include "random.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Every pick takes 32 random bits: 16 for the word, and 16 for its alias
+#define DICTIONARY_MAX_WORDS 65536
+#define DICTIONARY_WORD_MAXLENGTH 64
+
+// Words up to this long, with their space, are copied at once
+#define WORD_BLOCK_LENGTH 16
+
+// The words, all together in an arena, each one followed by a space, ready to
+// be picked in constant time as the priorities are (see pri.h).
+struct csender_dictionary
+{
+  char*       p_arena;
+  uint32_t*   p_offsets;                    // Within the arena
+  uint8_t*    p_lengths;                    // Space included
+  uint64_t*   p_thresholds;                 // Out of 2^32
+  uint32_t*   p_aliases;
+  int         num_words;
+};
+
+// Common English words, and words of logs, by frequency
+const struct csender_dictionary* dictionary_builtin( );
+
+// Index of a random word, out of 32 random bits. The choice between a word
+// and its alias is as good as random, so it is made without a branch, which
+// would be mispredicted half of the time.
+static inline int dictionary_pick(
+    const struct csender_dictionary* ap_dictionary,
+    uint32_t a_random )
+{
+  uint32_t index =
+      ( ( a_random >> 16 ) * ( uint32_t ) ap_dictionary->num_words ) >> 16;
+  uint32_t keep_mask =
+      -( uint32_t ) ( ( ( uint64_t ) ( a_random & 0xFFFF ) << 16 ) <
+                      ap_dictionary->p_thresholds[ index ] );
+
+  return ( int ) ( ( index & keep_mask ) |
+                   ( ap_dictionary->p_aliases[ index ] & ~keep_mask ) );
+}
+
+// Fills exactly the given no. of bytes with words of the dictionary, separated
+// by spaces. The last one may be cut short.
+void generate_words_body( const struct csender_dictionary* ap_dictionary,
+                          size_t a_body_length,
+                          uint64_t* ap_io_random_state,
+                          char* a_output_body );
+
+#endif
@@ -0,0 +1,296 @@
+#include "event.h"
+#include "format.h"
+
+#include <string.h>
+
+static const char g_default_hostname[] = "localhost.localdomain";
+static const char g_default_app_name[] = "my.app";
+static const char g_sequence_number_key[] = "seq=";
+
+// Digits of the longest event
+#define OCTET_COUNT_MAXLENGTH 4
+
+
+bool event_template_init( struct event_template* ap_template,
+                          const struct csender_generator_options* ap_options )
+{
+  const char* p_hostname = ( ap_options->hostname != NULL ) ?
+                               ap_options->hostname :
+                               g_default_hostname;
+  const char* p_app_name = ( ap_options->app_name != NULL ) ?
+                               ap_options->app_name :
+                               g_default_app_name;
+
+  size_t hostname_length = strlen( p_hostname );
+  size_t app_name_length = strlen( p_app_name );
+  if( hostname_length == 0 || hostname_length > CSENDER_HOSTNAME_MAXLENGTH ||
+      app_name_length == 0 || app_name_length > CSENDER_APP_NAME_MAXLENGTH )
+  {
+    return false;
+  }
+
+  ap_template->framing = ap_options->framing;
+  ap_template->sequence_numbers = ap_options->sequence_numbers;
+  pri_table_init( &( ap_template->priorities ),
+                  ap_options->facility_weights,
+                  ap_options->severity_weights );
+  ap_template->body_kind = ap_options->body_kind;
+  ap_template->min_lines = ap_options->min_lines;
+  ap_template->max_lines = ap_options->max_lines;
+  ap_template->min_line_length = ap_options->min_line_length;
+  ap_template->max_line_length = ap_options->max_line_length;
+  ap_template->p_corpus = ap_options->p_corpus;
+  if( ap_options->body_kind == CSENDER_BODY_UTF8 )
+  {
+    utf8_mix_init( &( ap_template->utf8 ),
+                   ap_options->utf8_weights,
+                   ap_options->utf8_byte_order_mark );
+  }
+  ap_template->p_dictionary = ( ap_options->p_dictionary != NULL ) ?
+                                  ap_options->p_dictionary :
+                                  dictionary_builtin( );
+  if( ( ap_options->body_kind == CSENDER_BODY_KEY_VALUE ||
+        ap_options->body_kind == CSENDER_BODY_JSON ) &&
+      !structured_schema_init( &( ap_template->structured ), ap_options ) )
+  {
+    return false;
+  }
+
+  char* p_output = ap_template->header_end;
+  *p_output++ = ' ';
+  memcpy( p_output, p_hostname, hostname_length );
+  p_output += hostname_length;
+  *p_output++ = ' ';
+  memcpy( p_output, p_app_name, app_name_length );
+  p_output += app_name_length;
+  *p_output++ = ':';
+  *p_output++ = ' ';
+  *p_output = '\0';
+  ap_template->header_end_length = p_output - ap_template->header_end;
+
+  return true;
+}
+
+
+size_t event_template_header_length( const struct event_template* ap_template )
+{
+  return ap_template->priorities.max_prefix_length +
+         ap_template->header_end_length;
+}
+
+
+void generate_event_body( size_t a_body_length,
+                          uint64_t* ap_io_random_state,
+                          char* a_output_body )
+{
+  // Fill the event body with a random character, between 65 ('A') and 90 ('Z')
+  memset( a_output_body,
+          65 + ( random_next( ap_io_random_state ) % 26 ),
+          a_body_length );
+}
+
+
+// Uniform in [a_min, a_max]
+static unsigned int random_between( uint64_t* ap_io_random_state,
+                                    unsigned int a_min,
+                                    unsigned int a_max )
+{
+  return a_min + ( unsigned int ) ( random_next( ap_io_random_state ) %
+                                    ( a_max - a_min + 1 ) );
+}
+
+
+void plan_multiline_body( const struct event_template* ap_template,
+                          size_t a_max_body_length,
+                          uint64_t* ap_io_random_state,
+                          struct event_body* ap_output_body )
+{
+  unsigned int num_lines = random_between( ap_io_random_state,
+                                           ap_template->min_lines,
+                                           ap_template->max_lines );
+
+  size_t length = 0;
+  int i = 0;
+  for( ; i < ( int ) num_lines; i++ )
+  {
+    // Every line but the first one takes a '\n' before it
+    size_t separator_length = ( i > 0 ) ? 1 : 0;
+    if( length + separator_length >= a_max_body_length )
+    {
+      break;
+    }
+
+    size_t line_length = random_between( ap_io_random_state,
+                                         ap_template->min_line_length,
+                                         ap_template->max_line_length );
+    size_t room = a_max_body_length - length - separator_length;
+    if( line_length > room )
+    {
+      line_length = room;
+    }
+
+    ap_output_body->line_lengths[ i ] = ( uint16_t ) line_length;
+    length += separator_length + line_length;
+  }
+
+  ap_output_body->num_lines = i;
+  ap_output_body->length = length;
+  ap_output_body->p_text = NULL;
+}
+
+
+static void write_multiline_body( const struct event_body* ap_body,
+                                  uint64_t* ap_io_random_state,
+                                  char* a_output_body )
+{
+  char* p_output = a_output_body;
+  for( int i = 0; i < ap_body->num_lines; i++ )
+  {
+    size_t line_length = ap_body->line_lengths[ i ];
+    if( i > 0 )
+    {
+      *p_output++ = '\n';
+      if( line_length > 0 )
+      {
+        *p_output++ = '\t';
+        line_length--;
+      }
+    }
+
+    generate_event_body( line_length, ap_io_random_state, p_output );
+    p_output += line_length;
+  }
+}
+
+
+size_t generate_event( char* a_output_event,
+                       const char* a_timestamp,
+                       size_t a_timestamp_length,
+                       uint64_t a_sequence_number,
+                       size_t a_event_length,
+                       int a_priority_index,
+                       const struct event_body* ap_body,
+                       const struct event_template* ap_template,
+                       uint64_t* ap_io_random_state )
+{
+  char* p_output = a_output_event;
+  bool structured = ( ap_template->body_kind == CSENDER_BODY_KEY_VALUE ||
+                      ap_template->body_kind == CSENDER_BODY_JSON );
+
+  // Octet counting: the length of the message goes first. Structured bodies
+  // only know it once written, so room is left for the longest one.
+  size_t trailer_length = 1;
+  if( ap_template->framing == CSENDER_FRAMING_OCTET_COUNTING )
+  {
+    if( structured )
+    {
+      p_output += OCTET_COUNT_MAXLENGTH + 1;
+    }
+    else
+    {
+      p_output += format_u64( p_output, a_event_length );
+      *p_output++ = ' ';
+    }
+    trailer_length = 0;
+  }
+
+  char* p_message_start = p_output;
+  char* p_message_end = p_output + a_event_length - trailer_length;
+
+  // Then the event header
+  memcpy( p_output,
+          ap_template->priorities.prefixes[ a_priority_index ],
+          PRI_PREFIX_BLOCK_LENGTH );
+  p_output += ap_template->priorities.prefix_lengths[ a_priority_index ];
+  memcpy( p_output, a_timestamp, a_timestamp_length );
+  p_output += a_timestamp_length;
+  // Short ones, as the default, are copied as a fixed block, which is cheaper
+  // than a copy of variable length. What goes beyond is overwritten next, or
+  // falls in the slack of the buffer.
+  if( ap_template->header_end_length <= HEADER_END_BLOCK_LENGTH )
+  {
+    memcpy( p_output, ap_template->header_end, HEADER_END_BLOCK_LENGTH );
+  }
+  else
+  {
+    memcpy( p_output, ap_template->header_end, ap_template->header_end_length );
+  }
+  p_output += ap_template->header_end_length;
+
+  if( ap_template->sequence_numbers )
+  {
+    memcpy( p_output, g_sequence_number_key, sizeof g_sequence_number_key - 1 );
+    p_output += sizeof g_sequence_number_key - 1;
+    format_u64_fixed( p_output, a_sequence_number, SEQUENCE_NUMBER_DIGITS );
+    p_output += SEQUENCE_NUMBER_DIGITS;
+    *p_output++ = ' ';
+  }
+
+  // Then the body, up to the requested length
+  switch( ap_template->body_kind )
+  {
+    case CSENDER_BODY_MULTILINE:
+    {
+      write_multiline_body( ap_body, ap_io_random_state, p_output );
+      break;
+    }
+    case CSENDER_BODY_CORPUS:
+    {
+      memcpy( p_output, ap_body->p_text, p_message_end - p_output );
+      break;
+    }
+    case CSENDER_BODY_UTF8:
+    {
+      generate_utf8_body( &( ap_template->utf8 ),
+                          p_message_end - p_output,
+                          ap_io_random_state,
+                          p_output );
+      break;
+    }
+    case CSENDER_BODY_KEY_VALUE:
+    case CSENDER_BODY_JSON:
+    {
+      p_message_end = generate_structured_body( &( ap_template->structured ),
+                                                p_output,
+                                                p_message_end,
+                                                ap_io_random_state );
+      break;
+    }
+    case CSENDER_BODY_WORDS:
+    {
+      generate_words_body( ap_template->p_dictionary,
+                           p_message_end - p_output,
+                           ap_io_random_state,
+                           p_output );
+      break;
+    }
+    default:
+    {
+      generate_event_body( p_message_end - p_output,
+                           ap_io_random_state,
+                           p_output );
+      break;
+    }
+  }
+  p_output = p_message_end;
+
+  if( trailer_length > 0 )
+  {
+    *p_output++ = '\n';
+  }
+  *p_output = '\0';
+
+  // Now that the length is known, the message is moved right after it
+  if( structured && ap_template->framing == CSENDER_FRAMING_OCTET_COUNTING )
+  {
+    size_t message_length = p_output - p_message_start;
+    size_t prefix_length = format_u64( a_output_event, message_length );
+    a_output_event[ prefix_length++ ] = ' ';
+    memmove( a_output_event + prefix_length,
+             p_message_start,
+             message_length + 1 );
+    return prefix_length + message_length;
+  }
+
+  return p_output - a_output_event;
+}
@@ -0,0 +1,99 @@
+#ifndef CSENDER_EVENT_H
+#define CSENDER_EVENT_H
+
+#include "corpus.h"
+#include "csender.h"
+#include "dictionary.h"
+#include "pri.h"
+#include "random.h"
+#include "structured.h"
+#include "utf8.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define DATETIME_LENGTH CSENDER_DATETIME_LENGTH
+#define SYSLOG_MSG_MAXLENGTH CSENDER_EVENT_MAXLENGTH
+#define SYSLOG_HEADER_LENGTH CSENDER_HEADER_LENGTH
+
+// "seq=" + 10 digits + " "
+#define SEQUENCE_NUMBER_LENGTH 15
+#define SEQUENCE_NUMBER_DIGITS 10
+
+// " HOSTNAME APP-NAME: ", after the timestamp
+#define HEADER_END_MAXLENGTH \
+  ( CSENDER_HOSTNAME_MAXLENGTH + CSENDER_APP_NAME_MAXLENGTH + 4 )
+
+// Header ends up to this long are copied at once
+#define HEADER_END_BLOCK_LENGTH 32
+
+// What every event of a generator has in common, rendered once from its
+// options, so that building an event only copies it.
+struct event_template
+{
+  enum csender_framing   framing;
+  bool                   sequence_numbers;
+  struct pri_table       priorities;
+  enum csender_body_kind body_kind;
+  unsigned int           min_lines;
+  unsigned int           max_lines;
+  unsigned int           min_line_length;
+  unsigned int           max_line_length;
+  const struct csender_corpus* p_corpus;
+  struct utf8_mix        utf8;
+  const struct csender_dictionary* p_dictionary;
+  struct structured_schema structured;
+  char                   header_end[ HEADER_END_MAXLENGTH + 1 ];
+  size_t                 header_end_length;
+};
+
+// Returns false if the names of the options are too long.
+bool event_template_init( struct event_template* ap_template,
+                          const struct csender_generator_options* ap_options );
+
+// Length of the longest header, but for its timestamp
+size_t event_template_header_length( const struct event_template* ap_template );
+
+// The body of one event, other than a random one, laid out before it is
+// written, as the length of the event must be known up front (octet counting
+// writes it first).
+struct event_body
+{
+  size_t        length;
+  const char*   p_text;                                   // Corpus entry
+  int           num_lines;                                // Multi-line
+  uint16_t      line_lengths[ CSENDER_MAX_BODY_LINES ];
+};
+
+// Draws the lines of a multi-line body, dropping (or cutting short) the ones
+// that would not fit in the given length.
+void plan_multiline_body( const struct event_template* ap_template,
+                          size_t a_max_body_length,
+                          uint64_t* ap_io_random_state,
+                          struct event_body* ap_output_body );
+
+// Fills the given no. of chars of an event body. Neither the trailing '\n' nor
+// the null terminator are written.
+void generate_event_body( size_t a_body_length,
+                          uint64_t* ap_io_random_state,
+                          char* a_output_body );
+
+// Writes a whole syslog event (framing, header and body) of the given length,
+// with the given entry of the priorities of the template, and the given body
+// (used by multi-line and corpus ones only), null-terminated, into the given
+// buffer, which must be at least CSENDER_EVENT_BUFFER_LENGTH chars long.
+// Key-value and JSON bodies take the length as the most the event may take,
+// and end where their last field does. Returns the length written, framing
+// included.
+size_t generate_event( char* a_output_event,
+                       const char* a_timestamp,
+                       size_t a_timestamp_length,
+                       uint64_t a_sequence_number,
+                       size_t a_event_length,
+                       int a_priority_index,
+                       const struct event_body* ap_body,
+                       const struct event_template* ap_template,
+                       uint64_t* ap_io_random_state );
+
+#endif
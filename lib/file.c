@@ -0,0 +1,47 @@
+#include "file.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+char* read_file( const char* a_file_name, size_t* ap_output_length )
+{
+  FILE* p_file = fopen( a_file_name, "rb" );
+  if( p_file == NULL )
+  {
+    return NULL;
+  }
+
+  size_t capacity = 65536;
+  size_t length = 0;
+  char* p_text = malloc( capacity );
+  while( p_text != NULL )
+  {
+    length += fread( p_text + length, 1, capacity - length - 1, p_file );
+    if( length < capacity - 1 )
+    {
+      break;
+    }
+
+    capacity *= 2;
+    char* p_grown = realloc( p_text, capacity );
+    if( p_grown == NULL )
+    {
+      free( p_text );
+    }
+    p_text = p_grown;
+  }
+
+  bool failed = ( p_text == NULL ) || ferror( p_file );
+  fclose( p_file );
+  if( failed )
+  {
+    free( p_text );
+    return NULL;
+  }
+
+  p_text[ length ] = '\0';
+  *ap_output_length = length;
+
+  return p_text;
+}
@@ -0,0 +1,10 @@
+#ifndef CSENDER_FILE_H
+#define CSENDER_FILE_H
+
+#include <stddef.h>
+
+// Reads a whole file into a null-terminated buffer, to be freed by the
+// caller. Returns NULL, with errno set, on failure.
+char* read_file( const char* a_file_name, size_t* ap_output_length );
+
+#endif
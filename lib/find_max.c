@@ -0,0 +1,252 @@
+#include "csender.h"
+#include "clock.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Seconds at the start of every step that are not measured, while the
+// receiver adapts to the new rate
+#define WARM_UP_SECONDS 1
+
+// Seconds that must agree for a step to be considered stable
+#define STABLE_WINDOW_SECONDS 3
+
+// Send time p99s closer than this are considered equal, however different
+// they are in relative terms
+#define STABLE_P99_TOLERANCE_NS 10000
+
+struct second_sample
+{
+  struct csender_stats_snapshot   stats;
+  struct csender_histogram        send_times;
+};
+
+
+void csender_find_max_options_init( struct csender_find_max_options* ap_options )
+{
+  memset( ap_options, 0, sizeof *ap_options );
+  ap_options->initial_rate = 10000;
+  ap_options->max_rate = 0;
+  ap_options->max_p99_send_time_ns = 1000000;
+  ap_options->min_delivery_ratio = 0.98;
+  ap_options->min_step_seconds = 3;
+  ap_options->max_step_seconds = 10;
+  ap_options->precision = 0.05;
+}
+
+
+static void take_sample( struct csender_runner* ap_runner,
+                         struct second_sample* ap_output_sample )
+{
+  csender_runner_stats( ap_runner, &( ap_output_sample->stats ) );
+  csender_runner_send_times( ap_runner, &( ap_output_sample->send_times ) );
+}
+
+
+// Events/sec, and send time p99, between two samples
+static void measure_between( const struct second_sample* ap_earlier,
+                             const struct second_sample* ap_later,
+                             int a_num_seconds,
+                             double* ap_output_rate,
+                             uint64_t* ap_output_p99 )
+{
+  *ap_output_rate = ( double ) ( ap_later->stats.num_events_sent -
+                                 ap_earlier->stats.num_events_sent ) /
+                    a_num_seconds;
+
+  struct csender_histogram send_times = ap_later->send_times;
+  csender_histogram_subtract( &send_times, &( ap_earlier->send_times ) );
+  *ap_output_p99 = csender_histogram_percentile( &send_times, 99 );
+}
+
+
+static bool is_stable( const double* a_rates,
+                       const uint64_t* a_p99s,
+                       long a_offered_rate )
+{
+  double min_rate = a_rates[ 0 ], max_rate = a_rates[ 0 ];
+  uint64_t min_p99 = a_p99s[ 0 ], max_p99 = a_p99s[ 0 ];
+  for( int i = 1; i < STABLE_WINDOW_SECONDS; i++ )
+  {
+    min_rate = ( a_rates[ i ] < min_rate ) ? a_rates[ i ] : min_rate;
+    max_rate = ( a_rates[ i ] > max_rate ) ? a_rates[ i ] : max_rate;
+    min_p99 = ( a_p99s[ i ] < min_p99 ) ? a_p99s[ i ] : min_p99;
+    max_p99 = ( a_p99s[ i ] > max_p99 ) ? a_p99s[ i ] : max_p99;
+  }
+
+  bool stable_rate = ( max_rate - min_rate ) <= 0.05 * a_offered_rate;
+  bool stable_p99 = ( max_p99 - min_p99 ) <= STABLE_P99_TOLERANCE_NS ||
+                    ( max_p99 - min_p99 ) <= max_p99 / 4;
+
+  return stable_rate && stable_p99;
+}
+
+
+// Holds the given rate until the measurements settle, and tells whether it was
+// sustained. Returns -1 if the runner stopped.
+static int run_step( struct csender_runner* ap_runner,
+                     const struct csender_find_max_options* ap_options,
+                     long a_rate,
+                     struct csender_find_max_step* ap_output_step )
+{
+  csender_runner_set_rate( ap_runner, a_rate );
+
+  int64_t start_ns = monotonic_ns( );
+  sleep_until_ns( start_ns + WARM_UP_SECONDS * NS_PER_SECOND );
+
+  // A sample at every second boundary; the last few are kept
+  struct second_sample* p_samples =
+      malloc( ( STABLE_WINDOW_SECONDS + 1 ) * sizeof *p_samples );
+  if( p_samples == NULL )
+  {
+    return -1;
+  }
+
+  double rates[ STABLE_WINDOW_SECONDS ];
+  uint64_t p99s[ STABLE_WINDOW_SECONDS ];
+  take_sample( ap_runner, &( p_samples[ 0 ] ) );
+
+  int num_seconds = 0;
+  int to_return = 0;
+  while( num_seconds < ap_options->max_step_seconds )
+  {
+    num_seconds++;
+    sleep_until_ns( start_ns +
+                    ( WARM_UP_SECONDS + num_seconds ) * NS_PER_SECOND );
+
+    if( !csender_runner_is_running( ap_runner ) )
+    {
+      to_return = -1;
+      break;
+    }
+
+    struct second_sample* p_previous =
+        &( p_samples[ ( num_seconds - 1 ) % ( STABLE_WINDOW_SECONDS + 1 ) ] );
+    struct second_sample* p_current =
+        &( p_samples[ num_seconds % ( STABLE_WINDOW_SECONDS + 1 ) ] );
+    take_sample( ap_runner, p_current );
+
+    int window_index = num_seconds % STABLE_WINDOW_SECONDS;
+    measure_between( p_previous, p_current, 1,
+                     &( rates[ window_index ] ), &( p99s[ window_index ] ) );
+
+    if( num_seconds >= ap_options->min_step_seconds &&
+        num_seconds >= STABLE_WINDOW_SECONDS &&
+        is_stable( rates, p99s, a_rate ) )
+    {
+      break;
+    }
+  }
+
+  if( to_return == 0 )
+  {
+    // Judge the step by the last few seconds, as a whole
+    int window_length = ( num_seconds < STABLE_WINDOW_SECONDS ) ?
+                            num_seconds :
+                            STABLE_WINDOW_SECONDS;
+    const struct second_sample* p_first =
+        &( p_samples[ ( num_seconds - window_length ) %
+                      ( STABLE_WINDOW_SECONDS + 1 ) ] );
+    const struct second_sample* p_last =
+        &( p_samples[ num_seconds % ( STABLE_WINDOW_SECONDS + 1 ) ] );
+
+    ap_output_step->offered_rate = a_rate;
+    ap_output_step->num_seconds = WARM_UP_SECONDS + num_seconds;
+    measure_between( p_first, p_last, window_length,
+                     &( ap_output_step->achieved_rate ),
+                     &( ap_output_step->p99_send_time_ns ) );
+    ap_output_step->sustained =
+        ( p_last->stats.num_send_errors == p_first->stats.num_send_errors ) &&
+        ( ap_output_step->achieved_rate >=
+          ap_options->min_delivery_ratio * a_rate ) &&
+        ( ap_output_step->p99_send_time_ns <=
+          ap_options->max_p99_send_time_ns );
+  }
+
+  free( p_samples );
+
+  return to_return;
+}
+
+
+int csender_find_max( struct csender_runner* ap_runner,
+                      const struct csender_find_max_options* ap_options,
+                      void ( *ap_step_callback )(
+                          const struct csender_find_max_step* ap_step,
+                          void* ap_user_data ),
+                      void* ap_user_data,
+                      struct csender_find_max_result* ap_output_result )
+{
+  memset( ap_output_result, 0, sizeof *ap_output_result );
+
+  // Highest rate sustained so far, and lowest one that was not (0: none yet)
+  long lower_rate = 0;
+  long upper_rate = 0;
+  long rate = ( ap_options->initial_rate > 0 ) ? ap_options->initial_rate : 1;
+
+  while( 1 )
+  {
+    struct csender_find_max_step step;
+    if( run_step( ap_runner, ap_options, rate, &step ) != 0 )
+    {
+      return -1;
+    }
+
+    ap_output_result->num_steps++;
+    if( ap_step_callback != NULL )
+    {
+      ap_step_callback( &step, ap_user_data );
+    }
+
+    if( step.sustained )
+    {
+      lower_rate = rate;
+      ap_output_result->max_sustained_rate = rate;
+      ap_output_result->p99_send_time_ns = step.p99_send_time_ns;
+    }
+    else
+    {
+      upper_rate = rate;
+    }
+
+    if( upper_rate == 0 )
+    {
+      // Nothing has failed yet: keep on doubling, up to the limit
+      if( ap_options->max_rate > 0 && rate >= ap_options->max_rate )
+      {
+        break;
+      }
+
+      rate *= 2;
+      if( ap_options->max_rate > 0 && rate > ap_options->max_rate )
+      {
+        rate = ap_options->max_rate;
+      }
+    }
+    else
+    {
+      // Bisect, until the interval is narrow enough
+      if( lower_rate > 0 &&
+          upper_rate - lower_rate <= ap_options->precision * lower_rate )
+      {
+        break;
+      }
+
+      long middle_rate = lower_rate + ( upper_rate - lower_rate ) / 2;
+      if( middle_rate == lower_rate || middle_rate == upper_rate )
+      {
+        break;
+      }
+
+      rate = middle_rate;
+    }
+  }
+
+  // Leave the runner at the rate found, if any
+  if( ap_output_result->max_sustained_rate > 0 )
+  {
+    csender_runner_set_rate( ap_runner, ap_output_result->max_sustained_rate );
+  }
+
+  return 0;
+}
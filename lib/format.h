@@ -0,0 +1,121 @@
+#ifndef CSENDER_FORMAT_H
+#define CSENDER_FORMAT_H
+
+// Branchless integer to decimal formatting. Digits are computed eight at a
+// time inside a 64-bit register (SWAR), instead of one division per digit as
+// snprintf() does.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+static const uint64_t g_powers_of_10[] =
+{
+  1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+  100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL,
+  1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+  1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+  1000000000000000000ULL, 10000000000000000000ULL
+};
+
+
+// The eight ASCII digits of a value below 10^8, most significant one in the
+// lowest byte (so that a little-endian store writes them in order).
+static inline uint64_t encode_8_digits( uint32_t a_value )
+{
+  // Two lanes of 32 bits: the upper and the lower four digits
+  uint64_t merged = ( a_value / 10000 ) |
+                    ( ( uint64_t ) ( a_value % 10000 ) << 32 );
+
+  // Four lanes of 16 bits: pairs of digits. x * 10486 >> 20 == x / 100 for
+  // every x below 10^4.
+  uint64_t hundreds = ( ( merged * 10486 ) >> 20 ) & 0x0000007F0000007FULL;
+  merged = hundreds | ( ( merged - hundreds * 100 ) << 16 );
+
+  // Eight lanes of 8 bits: single digits. x * 103 >> 10 == x / 10 for every
+  // x below 100.
+  uint64_t tens = ( ( merged * 103 ) >> 10 ) & 0x000F000F000F000FULL;
+  merged = tens | ( ( merged - tens * 10 ) << 8 );
+
+  return merged + 0x3030303030303030ULL;
+}
+
+
+static inline void store_8_digits( char* a_output, uint64_t a_digits )
+{
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+  a_digits = __builtin_bswap64( a_digits );
+#endif
+  memcpy( a_output, &a_digits, 8 );
+}
+
+
+static inline int count_digits_u64( uint64_t a_value )
+{
+  // Approximate log10 from log2 (1233 / 4096 ~= log10(2)), then correct it
+  int log2 = 63 - __builtin_clzll( a_value | 1 );
+  int num_digits = ( ( log2 + 1 ) * 1233 ) >> 12;
+
+  return num_digits + ( a_value >= g_powers_of_10[ num_digits ] ) +
+         ( a_value == 0 );
+}
+
+
+// Writes the value with exactly a_width digits (up to 16), zero-padded on the
+// left. Higher digits that do not fit are dropped.
+static inline void format_u64_fixed( char* a_output,
+                                     uint64_t a_value,
+                                     int a_width )
+{
+  char digits[ 16 ];
+
+  // Most values (lengths, microseconds) fit in a single register of digits
+  if( a_width <= 8 )
+  {
+    store_8_digits( digits, encode_8_digits( a_value % 100000000 ) );
+    memcpy( a_output, digits + 8 - a_width, a_width );
+    return;
+  }
+
+  a_value %= g_powers_of_10[ 16 ];
+  store_8_digits( digits, encode_8_digits( a_value / 100000000 ) );
+  store_8_digits( digits + 8, encode_8_digits( a_value % 100000000 ) );
+
+  memcpy( a_output, digits + 16 - a_width, a_width );
+}
+
+
+// Writes the value with no padding, and returns the no. of digits written
+// (up to 20).
+static inline size_t format_u64( char* a_output, uint64_t a_value )
+{
+  int num_digits = count_digits_u64( a_value );
+
+  if( num_digits <= 16 )
+  {
+    format_u64_fixed( a_output, a_value, num_digits );
+  }
+  else
+  {
+    uint64_t upper = a_value / g_powers_of_10[ 16 ];
+    int num_upper_digits = num_digits - 16;
+    format_u64_fixed( a_output, upper, num_upper_digits );
+    format_u64_fixed( a_output + num_upper_digits,
+                      a_value % g_powers_of_10[ 16 ],
+                      16 );
+  }
+
+  return num_digits;
+}
+
+
+// Six digits, as the microseconds of a timestamp
+static inline void format_microseconds( char* a_output, uint32_t a_value )
+{
+  char digits[ 8 ];
+  store_8_digits( digits, encode_8_digits( a_value ) );
+
+  memcpy( a_output, digits + 2, 6 );
+}
+
+#endif
@@ -0,0 +1,393 @@
+#include "csender.h"
+#include "event.h"
+#include "pack.h"
+#include "timestamp.h"
+
+#include <stdlib.h>
+
+struct csender_generator
+{
+  struct csender_generator_options   options;
+  struct event_template              template;
+  struct csender_timestamp_context   timestamp_context;
+  uint64_t                           random_state;
+  uint64_t                           sequence_number;
+  int                                last_severity;
+  int                                corpus_position;
+  int                                pack_position;
+  int64_t                            pack_loop_ns;  // Added to pack times
+};
+
+// Least wait before a pack with times starts again
+#define MIN_PACK_LOOP_GAP_NS 1000000LL
+
+#define FNV_OFFSET_BASIS 0xCBF29CE484222325ULL
+#define FNV_PRIME 0x100000001B3ULL
+
+
+// splitmix64 finalizer: spreads close inputs (as consecutive stream indexes)
+// into unrelated outputs.
+static uint64_t mix_seed( uint64_t a_value )
+{
+  a_value += 0x9E3779B97F4A7C15ULL;
+  a_value = ( a_value ^ ( a_value >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+  a_value = ( a_value ^ ( a_value >> 27 ) ) * 0x94D049BB133111EBULL;
+
+  return a_value ^ ( a_value >> 31 );
+}
+
+
+size_t csender_min_event_length( )
+{
+  // Minimum: The syslog information + trailing \n + 1 character
+  return SYSLOG_HEADER_LENGTH + 1 + 1;
+}
+
+
+size_t csender_max_event_length( )
+{
+  return SYSLOG_MSG_MAXLENGTH;
+}
+
+
+// Whether the options of the kind of body make sense
+static bool is_valid_body( const struct csender_generator_options* ap_options )
+{
+  switch( ap_options->body_kind )
+  {
+    case CSENDER_BODY_RANDOM:
+    case CSENDER_BODY_UTF8:
+    {
+      return true;
+    }
+    case CSENDER_BODY_MULTILINE:
+    {
+      return ap_options->min_lines > 0 &&
+             ap_options->min_lines <= ap_options->max_lines &&
+             ap_options->max_lines <= CSENDER_MAX_BODY_LINES &&
+             ap_options->min_line_length > 0 &&
+             ap_options->min_line_length <= ap_options->max_line_length &&
+             ap_options->max_line_length <= CSENDER_EVENT_MAXLENGTH;
+    }
+    case CSENDER_BODY_CORPUS:
+    {
+      return ap_options->p_corpus != NULL &&
+             ap_options->p_corpus->num_entries > 0;
+    }
+    case CSENDER_BODY_KEY_VALUE:
+    case CSENDER_BODY_JSON:
+    {
+      return ap_options->num_fields > 0 &&
+             ap_options->num_fields <= CSENDER_MAX_BODY_FIELDS &&
+             ( ap_options->num_keys == 0 ||
+               ap_options->num_keys >= ap_options->num_fields ) &&
+             ap_options->num_keys <= CSENDER_MAX_BODY_KEYS &&
+             ap_options->depth <= CSENDER_MAX_BODY_DEPTH &&
+             dictionary_builtin( ) != NULL;
+    }
+    case CSENDER_BODY_WORDS:
+    {
+      return ap_options->p_dictionary != NULL ||
+             dictionary_builtin( ) != NULL;
+    }
+    default:
+    {
+      return false;
+    }
+  }
+}
+
+
+size_t csender_min_event_length_for(
+    const struct csender_generator_options* ap_options )
+{
+  // Names that do not fit leave no valid length at all
+  struct event_template template;
+  if( !event_template_init( &template, ap_options ) )
+  {
+    return csender_max_event_length( ) + 1;
+  }
+
+  // The syslog information + 1 character, and the optional parts
+  size_t min_length = event_template_header_length( &template ) +
+                      timestamp_length( ap_options->timezone ) +
+                      1;
+
+  if( ap_options->framing == CSENDER_FRAMING_LF )
+  {
+    min_length += 1;
+  }
+
+  if( ap_options->sequence_numbers )
+  {
+    min_length += SEQUENCE_NUMBER_LENGTH;
+  }
+
+  return min_length;
+}
+
+
+struct csender_generator* csender_generator_create(
+    const struct csender_generator_options* ap_options )
+{
+  // Replays only take their timestamps from the options
+  if( ap_options->p_pack == NULL &&
+      ( ap_options->event_length <
+            csender_min_event_length_for( ap_options ) ||
+        ap_options->event_length > csender_max_event_length( ) ||
+        ap_options->max_event_length > csender_max_event_length( ) ||
+        !is_valid_body( ap_options ) ) )
+  {
+    return NULL;
+  }
+
+  struct csender_generator* p_generator = malloc( sizeof *p_generator );
+  if( p_generator != NULL )
+  {
+    p_generator->options = *ap_options;
+    p_generator->options.hostname = NULL;
+    p_generator->options.app_name = NULL;
+    if( p_generator->options.max_event_length <
+        p_generator->options.event_length )
+    {
+      p_generator->options.max_event_length =
+          p_generator->options.event_length;
+    }
+
+    event_template_init( &( p_generator->template ), ap_options );
+    p_generator->sequence_number = 0;
+    p_generator->last_severity = 0;
+    p_generator->corpus_position = 0;
+    p_generator->pack_position = 0;
+    p_generator->pack_loop_ns = 0;
+    timestamp_context_init( &( p_generator->timestamp_context ),
+                            ap_options->clock_source,
+                            ( ap_options->p_pack != NULL ) ?
+                                csender_pack_timezone( ap_options->p_pack ) :
+                                ap_options->timezone );
+
+    p_generator->random_state =
+        mix_seed( ap_options->seed ^ mix_seed( ap_options->stream_index ) );
+    if( p_generator->random_state == 0 )
+    {
+      p_generator->random_state = FNV_OFFSET_BASIS;
+    }
+
+    // Every stream replays the corpus, or the pack, from a different entry.
+    // Packs with times play out from the start, as they were captured.
+    if( ap_options->body_kind == CSENDER_BODY_CORPUS )
+    {
+      p_generator->corpus_position =
+          random_next( &( p_generator->random_state ) ) %
+          ap_options->p_corpus->num_entries;
+    }
+    if( ap_options->p_pack != NULL && ap_options->p_pack->p_times == NULL )
+    {
+      p_generator->pack_position =
+          random_next( &( p_generator->random_state ) ) %
+          ap_options->p_pack->num_events;
+    }
+  }
+
+  return p_generator;
+}
+
+
+void csender_generator_destroy( struct csender_generator* ap_generator )
+{
+  free( ap_generator );
+}
+
+
+// A new event of the options of the generator, with the given timestamp
+static size_t generate_next_event( struct csender_generator* ap_generator,
+                                   const char* a_timestamp,
+                                   size_t a_timestamp_length,
+                                   char* a_output_event )
+{
+  // Fixed lengths do not draw from the random stream, so their events stay
+  // the same for a given seed
+  size_t event_length = ap_generator->options.event_length;
+  size_t length_range = ap_generator->options.max_event_length - event_length;
+  if( length_range > 0 )
+  {
+    event_length += random_next( &( ap_generator->random_state ) ) %
+                    ( length_range + 1 );
+  }
+
+  int priority_index = pri_table_pick( &( ap_generator->template.priorities ),
+                                       &( ap_generator->random_state ) );
+  ap_generator->last_severity =
+      ap_generator->template.priorities.severities[ priority_index ];
+
+  // Multi-line and corpus bodies set the length of the event up front, and
+  // key-value and JSON ones as they are written
+  struct event_body body;
+  const struct event_template* p_template = &( ap_generator->template );
+  if( p_template->body_kind == CSENDER_BODY_MULTILINE ||
+      p_template->body_kind == CSENDER_BODY_CORPUS )
+  {
+    size_t header_length =
+        p_template->priorities.prefix_lengths[ priority_index ] +
+        a_timestamp_length + p_template->header_end_length +
+        ( p_template->sequence_numbers ? SEQUENCE_NUMBER_LENGTH : 0 );
+    size_t trailer_length =
+        ( p_template->framing == CSENDER_FRAMING_LF ) ? 1 : 0;
+    size_t max_body_length =
+        SYSLOG_MSG_MAXLENGTH - header_length - trailer_length;
+
+    if( p_template->body_kind == CSENDER_BODY_MULTILINE )
+    {
+      plan_multiline_body( p_template,
+                           max_body_length,
+                           &( ap_generator->random_state ),
+                           &body );
+    }
+    else
+    {
+      const struct corpus_entry* p_entry =
+          &( p_template->p_corpus->p_entries[ ap_generator->corpus_position ] );
+      ap_generator->corpus_position =
+          ( ap_generator->corpus_position + 1 ) %
+          p_template->p_corpus->num_entries;
+
+      body.p_text = p_entry->p_text;
+      body.length = ( p_entry->length < max_body_length ) ? p_entry->length :
+                                                            max_body_length;
+    }
+
+    event_length = header_length + body.length + trailer_length;
+  }
+  else if( p_template->body_kind == CSENDER_BODY_KEY_VALUE ||
+           p_template->body_kind == CSENDER_BODY_JSON )
+  {
+    // Their fields stop where the event would get too long
+    event_length = SYSLOG_MSG_MAXLENGTH;
+  }
+
+  return generate_event( a_output_event,
+                         a_timestamp,
+                         a_timestamp_length,
+                         ap_generator->sequence_number++,
+                         event_length,
+                         priority_index,
+                         &body,
+                         p_template,
+                         &( ap_generator->random_state ) );
+}
+
+
+int csender_generator_next( struct csender_generator* ap_generator,
+                            char* a_output_event,
+                            size_t* ap_output_length,
+                            bool* ap_output_second_changed )
+{
+  char timestamp[ DATETIME_LENGTH ];
+  bool second_changed = false;
+
+  int timestamp_length =
+      csender_timestamp_rfc3339( &( ap_generator->timestamp_context ),
+                                 timestamp,
+                                 &second_changed );
+  if( timestamp_length < 0 )
+  {
+    return -1;
+  }
+
+  size_t length;
+  if( ap_generator->options.p_pack != NULL )
+  {
+    const struct csender_pack* p_pack = ap_generator->options.p_pack;
+    int position = ap_generator->pack_position;
+    ap_generator->pack_position =
+        ( position + 1 < p_pack->num_events ) ? position + 1 : 0;
+    if( ap_generator->pack_position == 0 && p_pack->p_times != NULL )
+    {
+      int64_t duration_ns = ( int64_t ) p_pack->p_times[ position ];
+      int64_t gap_ns = ( position > 0 ) ? duration_ns / position : 0;
+      ap_generator->pack_loop_ns +=
+          duration_ns +
+          ( ( gap_ns > MIN_PACK_LOOP_GAP_NS ) ? gap_ns : MIN_PACK_LOOP_GAP_NS );
+    }
+    ap_generator->last_severity = p_pack->p_index[ position ].severity;
+
+    length = pack_replay_event( p_pack,
+                                position,
+                                timestamp,
+                                ap_generator->sequence_number++,
+                                a_output_event );
+  }
+  else
+  {
+    length = generate_next_event( ap_generator,
+                                  timestamp,
+                                  timestamp_length,
+                                  a_output_event );
+  }
+
+  if( ap_output_length != NULL )
+  {
+    *ap_output_length = length;
+  }
+
+  if( ap_output_second_changed != NULL )
+  {
+    *ap_output_second_changed = second_changed;
+  }
+
+  return 0;
+}
+
+
+int csender_generator_last_severity(
+    const struct csender_generator* ap_generator )
+{
+  return ap_generator->last_severity;
+}
+
+
+int64_t csender_generator_next_event_time_ns(
+    const struct csender_generator* ap_generator )
+{
+  const struct csender_pack* p_pack = ap_generator->options.p_pack;
+  if( p_pack == NULL || p_pack->p_times == NULL )
+  {
+    return -1;
+  }
+
+  return ap_generator->pack_loop_ns +
+         ( int64_t ) p_pack->p_times[ ap_generator->pack_position ];
+}
+
+
+uint64_t csender_generator_checksum( struct csender_generator* ap_generator,
+                                     uint64_t a_num_events,
+                                     uint64_t* ap_output_num_bytes )
+{
+  char event[ CSENDER_EVENT_BUFFER_LENGTH ];
+  uint64_t hash = FNV_OFFSET_BASIS;
+  uint64_t num_bytes = 0;
+
+  for( uint64_t i = 0; i < a_num_events; i++ )
+  {
+    size_t event_length = 0;
+    if( csender_generator_next( ap_generator, event, &event_length, NULL ) != 0 )
+    {
+      break;
+    }
+
+    for( size_t j = 0; j < event_length; j++ )
+    {
+      hash = ( hash ^ ( unsigned char ) event[ j ] ) * FNV_PRIME;
+    }
+
+    num_bytes += event_length;
+  }
+
+  if( ap_output_num_bytes != NULL )
+  {
+    *ap_output_num_bytes = num_bytes;
+  }
+
+  return hash;
+}
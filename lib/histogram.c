@@ -0,0 +1,83 @@
+#include "csender.h"
+#include "histogram.h"
+
+#include <string.h>
+
+void csender_histogram_clear( struct csender_histogram* ap_histogram )
+{
+  memset( ap_histogram, 0, sizeof *ap_histogram );
+}
+
+
+void csender_histogram_record( struct csender_histogram* ap_histogram,
+                               uint64_t a_value )
+{
+  ap_histogram->counts[ histogram_bucket( a_value ) ]++;
+}
+
+
+void csender_histogram_accumulate( struct csender_histogram* ap_total,
+                                   const struct csender_histogram* ap_histogram )
+{
+  for( int i = 0; i < CSENDER_HISTOGRAM_NUM_BUCKETS; i++ )
+  {
+    ap_total->counts[ i ] += ap_histogram->counts[ i ];
+  }
+}
+
+
+void csender_histogram_subtract( struct csender_histogram* ap_histogram,
+                                 const struct csender_histogram* ap_earlier )
+{
+  for( int i = 0; i < CSENDER_HISTOGRAM_NUM_BUCKETS; i++ )
+  {
+    ap_histogram->counts[ i ] -= ap_earlier->counts[ i ];
+  }
+}
+
+
+uint64_t csender_histogram_count( const struct csender_histogram* ap_histogram )
+{
+  uint64_t count = 0;
+  for( int i = 0; i < CSENDER_HISTOGRAM_NUM_BUCKETS; i++ )
+  {
+    count += ap_histogram->counts[ i ];
+  }
+
+  return count;
+}
+
+
+uint64_t csender_histogram_percentile(
+    const struct csender_histogram* ap_histogram,
+    double a_percentile )
+{
+  uint64_t count = csender_histogram_count( ap_histogram );
+  if( count == 0 )
+  {
+    return 0;
+  }
+
+  // Rank of the wanted value, 1-based
+  uint64_t rank = ( uint64_t ) ( a_percentile / 100.0 * count + 0.5 );
+  if( rank < 1 )
+  {
+    rank = 1;
+  }
+  if( rank > count )
+  {
+    rank = count;
+  }
+
+  uint64_t accumulated = 0;
+  for( int i = 0; i < CSENDER_HISTOGRAM_NUM_BUCKETS; i++ )
+  {
+    accumulated += ap_histogram->counts[ i ];
+    if( accumulated >= rank )
+    {
+      return histogram_bucket_upper_bound( i );
+    }
+  }
+
+  return histogram_bucket_upper_bound( CSENDER_HISTOGRAM_NUM_BUCKETS - 1 );
+}
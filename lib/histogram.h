@@ -0,0 +1,49 @@
+#ifndef CSENDER_HISTOGRAM_H
+#define CSENDER_HISTOGRAM_H
+
+#include "csender.h"
+
+#include <stdint.h>
+
+#define HISTOGRAM_SUB_BUCKET_BITS 4
+#define HISTOGRAM_SUB_BUCKETS ( 1 << HISTOGRAM_SUB_BUCKET_BITS )
+
+
+// Values below 16 have a bucket each. Above, the power of two of the value
+// picks a group of 16 buckets, and its next 4 bits the bucket in the group.
+static inline int histogram_bucket( uint64_t a_value )
+{
+  if( a_value < HISTOGRAM_SUB_BUCKETS )
+  {
+    return ( int ) a_value;
+  }
+
+  int log2 = 63 - __builtin_clzll( a_value );
+  int sub_bucket = ( a_value >> ( log2 - HISTOGRAM_SUB_BUCKET_BITS ) ) &
+                   ( HISTOGRAM_SUB_BUCKETS - 1 );
+  int bucket = ( log2 - HISTOGRAM_SUB_BUCKET_BITS + 1 ) * HISTOGRAM_SUB_BUCKETS +
+               sub_bucket;
+
+  return ( bucket < CSENDER_HISTOGRAM_NUM_BUCKETS ) ?
+             bucket :
+             CSENDER_HISTOGRAM_NUM_BUCKETS - 1;
+}
+
+
+// Highest value that falls into the given bucket
+static inline uint64_t histogram_bucket_upper_bound( int a_bucket )
+{
+  if( a_bucket < HISTOGRAM_SUB_BUCKETS )
+  {
+    return a_bucket;
+  }
+
+  int log2 = a_bucket / HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BUCKET_BITS - 1;
+  uint64_t sub_bucket = a_bucket % HISTOGRAM_SUB_BUCKETS;
+  uint64_t lower_bound = ( HISTOGRAM_SUB_BUCKETS + sub_bucket ) <<
+                         ( log2 - HISTOGRAM_SUB_BUCKET_BITS );
+
+  return lower_bound + ( 1ULL << ( log2 - HISTOGRAM_SUB_BUCKET_BITS ) ) - 1;
+}
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef CSENDER_PACING_H
+#define CSENDER_PACING_H
+
+// Lateness beyond this (a stall of the sender, or of the receiver) is not made
+// up for with a burst of events
+#define MAX_PACING_BACKLOG_NS 10000000LL
+
+// Shorter waits are spent spinning, as sleeping would overshoot them
+#define MIN_PACING_SLEEP_NS 50000LL
+
+#endif
@@ -0,0 +1,448 @@
+#include "pack.h"
+#include "event.h"
+#include "format.h"
+#include "timestamp.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Sequence numbers follow the end of the header
+static const char g_sequence_number_marker[] = ": seq=";
+
+
+// Finds the parts of a generated, null-terminated event to patch on replay
+static void index_event( const char* a_event,
+                         size_t a_length,
+                         size_t a_timestamp_length,
+                         bool a_sequence_numbers,
+                         struct pack_index_entry* ap_output_entry )
+{
+  // The timestamp follows "<PRI>", past the octet count, if any
+  const char* p_timestamp = memchr( a_event, '>', a_length ) + 1;
+  ap_output_entry->timestamp_offset = ( uint16_t ) ( p_timestamp - a_event );
+  ap_output_entry->sequence_number_offset = PACK_NO_SEQUENCE_NUMBER;
+
+  if( a_sequence_numbers )
+  {
+    const char* p_header_rest = p_timestamp + a_timestamp_length;
+    const char* p_marker = strstr( p_header_rest, g_sequence_number_marker );
+    if( p_marker != NULL )
+    {
+      ap_output_entry->sequence_number_offset =
+          ( uint16_t ) ( p_marker + sizeof g_sequence_number_marker - 1 -
+                         a_event );
+    }
+  }
+}
+
+
+bool pack_writer_open( struct pack_writer* ap_writer,
+                       const char* a_file_name,
+                       enum csender_framing a_framing,
+                       enum csender_timezone a_timezone,
+                       bool a_timed )
+{
+  memset( ap_writer, 0, sizeof *ap_writer );
+  ap_writer->p_file_name = a_file_name;
+  ap_writer->p_file = fopen( a_file_name, "wb" );
+  if( ap_writer->p_file == NULL )
+  {
+    fprintf( stderr, "%s: %s\n", a_file_name, strerror( errno ) );
+    return false;
+  }
+
+  struct pack_header* p_header = &( ap_writer->header );
+  memcpy( p_header->magic, PACK_MAGIC, sizeof p_header->magic );
+  p_header->version = PACK_VERSION;
+  p_header->framing = ( uint8_t ) a_framing;
+  p_header->timezone = ( uint8_t ) a_timezone;
+  p_header->timestamp_length = ( uint16_t ) timestamp_length( a_timezone );
+  ap_writer->timed = a_timed;
+
+  // The header is written again at the end, once the index is placed
+  ap_writer->failed =
+      ( fwrite( p_header, sizeof *p_header, 1, ap_writer->p_file ) != 1 );
+  ap_writer->offset = sizeof *p_header;
+
+  return true;
+}
+
+
+void pack_writer_add( struct pack_writer* ap_writer,
+                      const char* a_event,
+                      size_t a_length,
+                      const struct pack_index_entry* ap_entry,
+                      uint64_t a_time_ns )
+{
+  uint32_t num_events = ap_writer->header.num_events;
+  if( ap_writer->failed || num_events == INT32_MAX )
+  {
+    ap_writer->failed = true;
+    return;
+  }
+
+  if( num_events == ap_writer->capacity )
+  {
+    uint32_t capacity = ( num_events > 0 ) ? 2 * num_events : 1024;
+    if( capacity > INT32_MAX )
+    {
+      capacity = INT32_MAX;
+    }
+
+    struct pack_index_entry* p_index =
+        realloc( ap_writer->p_index, capacity * sizeof *p_index );
+    if( p_index != NULL )
+    {
+      ap_writer->p_index = p_index;
+    }
+
+    uint64_t* p_times = ap_writer->p_times;
+    if( p_index != NULL && ap_writer->timed )
+    {
+      p_times = realloc( ap_writer->p_times, capacity * sizeof *p_times );
+      if( p_times != NULL )
+      {
+        ap_writer->p_times = p_times;
+      }
+    }
+
+    if( p_index == NULL || ( ap_writer->timed && p_times == NULL ) )
+    {
+      ap_writer->failed = true;
+      return;
+    }
+    ap_writer->capacity = capacity;
+  }
+
+  struct pack_index_entry* p_entry = &( ap_writer->p_index[ num_events ] );
+  *p_entry = *ap_entry;
+  uint32_t record_length = ( uint32_t ) a_length;
+  p_entry->record_offset = ap_writer->offset + sizeof record_length;
+  p_entry->length = record_length;
+  if( ap_writer->timed )
+  {
+    ap_writer->p_times[ num_events ] = a_time_ns;
+  }
+
+  ap_writer->failed =
+      ( fwrite( &record_length, sizeof record_length, 1, ap_writer->p_file ) !=
+            1 ||
+        fwrite( a_event, 1, a_length, ap_writer->p_file ) != a_length );
+  ap_writer->offset += sizeof record_length + a_length;
+  ap_writer->header.num_events++;
+}
+
+
+int pack_writer_close( struct pack_writer* ap_writer )
+{
+  struct pack_header* p_header = &( ap_writer->header );
+  uint32_t num_events = p_header->num_events;
+  bool failed = ap_writer->failed || num_events == 0;
+
+  // The index and times are aligned, to be read in place from the map
+  static const char padding[ 8 ];
+  size_t padding_length = ( 8 - ap_writer->offset % 8 ) % 8;
+  p_header->index_offset = ap_writer->offset + padding_length;
+  if( ap_writer->timed )
+  {
+    p_header->times_offset =
+        p_header->index_offset + num_events * sizeof *( ap_writer->p_index );
+  }
+
+  if( !failed )
+  {
+    FILE* p_file = ap_writer->p_file;
+    failed = ( fwrite( padding, 1, padding_length, p_file ) != padding_length ||
+               fwrite( ap_writer->p_index,
+                       sizeof *( ap_writer->p_index ),
+                       num_events,
+                       p_file ) != num_events ||
+               ( ap_writer->timed &&
+                 fwrite( ap_writer->p_times,
+                         sizeof *( ap_writer->p_times ),
+                         num_events,
+                         p_file ) != num_events ) ||
+               fseek( p_file, 0, SEEK_SET ) != 0 ||
+               fwrite( p_header, sizeof *p_header, 1, p_file ) != 1 );
+  }
+
+  if( fclose( ap_writer->p_file ) != 0 )
+  {
+    failed = true;
+  }
+  if( failed )
+  {
+    fprintf( stderr, "%s: could not be written\n", ap_writer->p_file_name );
+  }
+
+  free( ap_writer->p_index );
+  free( ap_writer->p_times );
+
+  return failed ? -1 : 0;
+}
+
+
+void pack_writer_abort( struct pack_writer* ap_writer )
+{
+  fclose( ap_writer->p_file );
+  remove( ap_writer->p_file_name );
+  free( ap_writer->p_index );
+  free( ap_writer->p_times );
+}
+
+
+int csender_pack_write( const char* a_file_name,
+                        const struct csender_generator_options* ap_options,
+                        long a_num_events )
+{
+  if( a_num_events <= 0 || a_num_events > INT32_MAX ||
+      ap_options->p_pack != NULL )
+  {
+    return -1;
+  }
+
+  struct csender_generator* p_generator = csender_generator_create( ap_options );
+  if( p_generator == NULL )
+  {
+    return -1;
+  }
+
+  struct pack_writer writer;
+  if( !pack_writer_open( &writer,
+                         a_file_name,
+                         ap_options->framing,
+                         ap_options->timezone,
+                         false ) )
+  {
+    csender_generator_destroy( p_generator );
+    return -1;
+  }
+
+  char event[ CSENDER_EVENT_BUFFER_LENGTH ];
+  for( long i = 0; i < a_num_events && !writer.failed; i++ )
+  {
+    size_t length = 0;
+    if( csender_generator_next( p_generator, event, &length, NULL ) != 0 )
+    {
+      writer.failed = true;
+      break;
+    }
+
+    struct pack_index_entry entry;
+    memset( &entry, 0, sizeof entry );
+    entry.severity =
+        ( uint8_t ) csender_generator_last_severity( p_generator );
+    index_event( event,
+                 length,
+                 writer.header.timestamp_length,
+                 ap_options->sequence_numbers,
+                 &entry );
+
+    pack_writer_add( &writer, event, length, &entry, 0 );
+  }
+
+  csender_generator_destroy( p_generator );
+
+  return pack_writer_close( &writer );
+}
+
+
+// Whether the index only points within the records, at parts that fit
+static bool is_valid_pack( const struct csender_pack* ap_pack )
+{
+  const struct pack_header* p_header = ap_pack->p_header;
+  if( memcmp( p_header->magic, PACK_MAGIC, sizeof p_header->magic ) != 0 ||
+      p_header->version != PACK_VERSION ||
+      p_header->num_events == 0 ||
+      p_header->num_events > INT32_MAX ||
+      p_header->timezone > CSENDER_TIMEZONE_LOCAL ||
+      p_header->timestamp_length !=
+          timestamp_length( ( enum csender_timezone ) p_header->timezone ) ||
+      p_header->index_offset < sizeof *p_header ||
+      p_header->index_offset % 8 != 0 ||
+      p_header->index_offset > ap_pack->map_length ||
+      ( ap_pack->map_length - p_header->index_offset ) /
+              sizeof( struct pack_index_entry ) <
+          p_header->num_events )
+  {
+    return false;
+  }
+
+  if( p_header->times_offset != 0 )
+  {
+    uint64_t index_end = p_header->index_offset +
+                         p_header->num_events *
+                             sizeof( struct pack_index_entry );
+    if( p_header->times_offset < index_end ||
+        p_header->times_offset % 8 != 0 ||
+        p_header->times_offset > ap_pack->map_length ||
+        ( ap_pack->map_length - p_header->times_offset ) / sizeof( uint64_t ) <
+            p_header->num_events )
+    {
+      return false;
+    }
+
+    // Replays wait for every event in turn
+    const uint64_t* p_times =
+        ( const uint64_t* ) ( ap_pack->p_map + p_header->times_offset );
+    for( uint32_t i = 1; i < p_header->num_events; i++ )
+    {
+      if( p_times[ i ] < p_times[ i - 1 ] )
+      {
+        return false;
+      }
+    }
+  }
+
+  for( uint32_t i = 0; i < p_header->num_events; i++ )
+  {
+    const struct pack_index_entry* p_entry = &( ap_pack->p_index[ i ] );
+    if( p_entry->length >= CSENDER_EVENT_BUFFER_LENGTH ||
+        p_entry->record_offset > p_header->index_offset ||
+        p_header->index_offset - p_entry->record_offset < p_entry->length ||
+        ( p_entry->timestamp_offset != PACK_NO_TIMESTAMP &&
+          p_entry->timestamp_offset + p_header->timestamp_length >
+              p_entry->length ) ||
+        ( p_entry->sequence_number_offset != PACK_NO_SEQUENCE_NUMBER &&
+          ( size_t ) p_entry->sequence_number_offset +
+                  SEQUENCE_NUMBER_DIGITS >
+              p_entry->length ) ||
+        p_entry->severity >= CSENDER_NUM_SEVERITIES )
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+struct csender_pack* csender_pack_open( const char* a_file_name )
+{
+  int fd = open( a_file_name, O_RDONLY );
+  if( fd < 0 )
+  {
+    fprintf( stderr, "%s: %s\n", a_file_name, strerror( errno ) );
+    return NULL;
+  }
+
+  struct stat file_status;
+  if( fstat( fd, &file_status ) != 0 ||
+      ( size_t ) file_status.st_size < sizeof( struct pack_header ) )
+  {
+    fprintf( stderr, "%s: not a pack file\n", a_file_name );
+    close( fd );
+    return NULL;
+  }
+
+  // Read-only: events are copied out before being patched, so that any no.
+  // of sender threads share the same pages
+  void* p_map = mmap( NULL,
+                      file_status.st_size,
+                      PROT_READ,
+                      MAP_PRIVATE,
+                      fd,
+                      0 );
+  close( fd );
+  if( p_map == MAP_FAILED )
+  {
+    fprintf( stderr, "%s: %s\n", a_file_name, strerror( errno ) );
+    return NULL;
+  }
+  madvise( p_map, file_status.st_size, MADV_WILLNEED );
+
+  struct csender_pack* p_pack = malloc( sizeof *p_pack );
+  if( p_pack == NULL )
+  {
+    munmap( p_map, file_status.st_size );
+    return NULL;
+  }
+
+  p_pack->p_map = p_map;
+  p_pack->map_length = file_status.st_size;
+  p_pack->p_header = p_map;
+  p_pack->p_index = ( const struct pack_index_entry* ) (
+      p_pack->p_map + p_pack->p_header->index_offset );
+  p_pack->p_times = NULL;
+  p_pack->num_events = ( int ) p_pack->p_header->num_events;
+
+  if( !is_valid_pack( p_pack ) )
+  {
+    fprintf( stderr, "%s: not a valid pack file\n", a_file_name );
+    csender_pack_close( p_pack );
+    return NULL;
+  }
+
+  if( p_pack->p_header->times_offset != 0 )
+  {
+    p_pack->p_times = ( const uint64_t* ) (
+        p_pack->p_map + p_pack->p_header->times_offset );
+  }
+
+  return p_pack;
+}
+
+
+int csender_pack_num_events( const struct csender_pack* ap_pack )
+{
+  return ap_pack->num_events;
+}
+
+
+bool csender_pack_has_times( const struct csender_pack* ap_pack )
+{
+  return ap_pack->p_times != NULL;
+}
+
+
+enum csender_timezone csender_pack_timezone(
+    const struct csender_pack* ap_pack )
+{
+  return ( enum csender_timezone ) ap_pack->p_header->timezone;
+}
+
+
+void csender_pack_close( struct csender_pack* ap_pack )
+{
+  if( ap_pack != NULL )
+  {
+    munmap( ( void* ) ap_pack->p_map, ap_pack->map_length );
+    free( ap_pack );
+  }
+}
+
+
+size_t pack_replay_event( const struct csender_pack* ap_pack,
+                          int a_event_index,
+                          const char* a_timestamp,
+                          uint64_t a_sequence_number,
+                          char* a_output_event )
+{
+  const struct pack_index_entry* p_entry = &( ap_pack->p_index[ a_event_index ] );
+
+  memcpy( a_output_event,
+          ap_pack->p_map + p_entry->record_offset,
+          p_entry->length );
+  a_output_event[ p_entry->length ] = '\0';
+
+  if( p_entry->timestamp_offset != PACK_NO_TIMESTAMP )
+  {
+    memcpy( a_output_event + p_entry->timestamp_offset,
+            a_timestamp,
+            ap_pack->p_header->timestamp_length );
+  }
+  if( p_entry->sequence_number_offset != PACK_NO_SEQUENCE_NUMBER )
+  {
+    format_u64_fixed( a_output_event + p_entry->sequence_number_offset,
+                      a_sequence_number,
+                      SEQUENCE_NUMBER_DIGITS );
+  }
+
+  return p_entry->length;
+}
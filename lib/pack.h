@@ -0,0 +1,109 @@
+#ifndef CSENDER_PACK_H
+#define CSENDER_PACK_H
+
+#include "csender.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Pack files: events rendered in advance, to be replayed with no other cost
+// than a copy, and fresh timestamps and sequence numbers written over the old
+// ones. Little-endian, as written by the hosts csender runs on.
+//
+//   header
+//   records: for each event, its length (uint32_t), then the event itself
+//   index: a pack_index_entry per event, 8-byte aligned
+//   times: if the events come from a capture, the ns since the first one
+//          each was captured at (uint64_t), in order
+#define PACK_MAGIC "CSPACK\r\n"
+#define PACK_VERSION 2
+
+// Not valid offsets of a timestamp or a sequence number, which follow the
+// PRI. Events imported from captures are replayed as they were.
+#define PACK_NO_TIMESTAMP 0
+#define PACK_NO_SEQUENCE_NUMBER 0
+
+struct pack_header
+{
+  char       magic[ 8 ];
+  uint32_t   version;
+  uint32_t   num_events;
+  uint8_t    framing;
+  uint8_t    timezone;
+  uint16_t   timestamp_length;
+  uint32_t   reserved;
+  uint64_t   index_offset;
+  uint64_t   times_offset;          // 0: no times
+};
+
+// Where the parts to patch of every event are
+struct pack_index_entry
+{
+  uint64_t   record_offset;         // Of the event, past its length
+  uint32_t   length;
+  uint16_t   timestamp_offset;
+  uint16_t   sequence_number_offset;
+  uint8_t    severity;
+  uint8_t    reserved[ 7 ];
+};
+
+struct csender_pack
+{
+  const uint8_t*                   p_map;
+  size_t                           map_length;
+  const struct pack_header*        p_header;
+  const struct pack_index_entry*   p_index;
+  const uint64_t*                  p_times;       // NULL: no times
+  int                              num_events;
+};
+
+// Writes the events added to it into a pack file
+struct pack_writer
+{
+  const char*                p_file_name;
+  FILE*                      p_file;
+  struct pack_header         header;
+  struct pack_index_entry*   p_index;
+  bool                       timed;
+  uint64_t*                  p_times;
+  uint32_t                   capacity;
+  uint64_t                   offset;
+  bool                       failed;
+};
+
+// Returns false, after telling why on stderr, if the file could not be
+// created. Timed packs take the time of every event.
+bool pack_writer_open( struct pack_writer* ap_writer,
+                       const char* a_file_name,
+                       enum csender_framing a_framing,
+                       enum csender_timezone a_timezone,
+                       bool a_timed );
+
+// Adds an event, which the index entry tells where to patch (its offsets and
+// length are filled in here)
+void pack_writer_add( struct pack_writer* ap_writer,
+                      const char* a_event,
+                      size_t a_length,
+                      const struct pack_index_entry* ap_entry,
+                      uint64_t a_time_ns );
+
+// Completes the file. Returns 0 on success, or -1, after telling why on
+// stderr.
+int pack_writer_close( struct pack_writer* ap_writer );
+
+// Removes the file, with nothing to tell
+void pack_writer_abort( struct pack_writer* ap_writer );
+
+// Writes a copy of the given event of the pack, with the given timestamp
+// (of the length of the pack) and sequence number where it has them,
+// null-terminated, into the given buffer, which must be at least
+// CSENDER_EVENT_BUFFER_LENGTH chars long. Returns its length.
+size_t pack_replay_event( const struct csender_pack* ap_pack,
+                          int a_event_index,
+                          const char* a_timestamp,
+                          uint64_t a_sequence_number,
+                          char* a_output_event );
+
+#endif
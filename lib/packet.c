@@ -0,0 +1,503 @@
+#include "packet.h"
+#include "csender.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <ifaddrs.h>
+#include <linux/if_packet.h>
+#include <net/ethernet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PACKET_RING_NUM_FRAMES 256
+#define PACKET_RING_MIN_BLOCK_LENGTH ( 64 * 1024 )
+
+// Where the frame starts, past the ring's own header
+#define FRAME_DATA_OFFSET TPACKET_ALIGN( sizeof( struct tpacket2_hdr ) )
+
+// Ethernet, IPv4 (without options) and UDP headers
+#define ETHERNET_HEADER_LENGTH 14
+#define IP_HEADER_LENGTH 20
+#define UDP_HEADER_LENGTH 8
+#define FRAME_HEADERS_LENGTH ( ETHERNET_HEADER_LENGTH + IP_HEADER_LENGTH + \
+                               UDP_HEADER_LENGTH )
+
+// How long to wait for the MAC address of the next hop
+#define NEIGHBOUR_WAIT_MS 1000
+#define NEIGHBOUR_POLL_MS 10
+
+struct packet_ring
+{
+  int        socket_fd;
+  char*      p_ring;
+  size_t     ring_length;
+  size_t     frame_length;
+  int        num_frames;
+  int        next_frame;
+  size_t     max_payload_length;
+  uint16_t   ip_id;
+};
+
+
+// One's complement sum of the IPv4 header
+static uint16_t ip_checksum( const uint8_t* a_header )
+{
+  uint32_t sum = 0;
+  for( int i = 0; i < IP_HEADER_LENGTH; i += 2 )
+  {
+    sum += ( uint32_t ) ( a_header[ i ] << 8 | a_header[ i + 1 ] );
+  }
+  while( sum >> 16 )
+  {
+    sum = ( sum & 0xffff ) + ( sum >> 16 );
+  }
+
+  return ( uint16_t ) ~sum;
+}
+
+
+static void put_u16( uint8_t* ap_output, uint16_t a_value )
+{
+  ap_output[ 0 ] = ( uint8_t ) ( a_value >> 8 );
+  ap_output[ 1 ] = ( uint8_t ) a_value;
+}
+
+
+// The interface the given local address belongs to, and whether the peer is
+// local too. Returns false if none.
+static bool find_interface( struct in_addr a_local_address,
+                            struct in_addr a_peer_address,
+                            char* a_output_name,
+                            bool* ap_output_peer_local )
+{
+  struct ifaddrs* p_list = NULL;
+  if( getifaddrs( &p_list ) != 0 )
+  {
+    return false;
+  }
+
+  bool found = false;
+  *ap_output_peer_local = false;
+  for( struct ifaddrs* p_entry = p_list;
+       p_entry != NULL;
+       p_entry = p_entry->ifa_next )
+  {
+    if( p_entry->ifa_addr == NULL || p_entry->ifa_addr->sa_family != AF_INET )
+    {
+      continue;
+    }
+
+    in_addr_t address =
+        ( ( struct sockaddr_in* ) p_entry->ifa_addr )->sin_addr.s_addr;
+    if( address == a_peer_address.s_addr )
+    {
+      *ap_output_peer_local = true;
+    }
+    if( address == a_local_address.s_addr && !found )
+    {
+      snprintf( a_output_name, IFNAMSIZ, "%s", p_entry->ifa_name );
+      found = true;
+    }
+  }
+
+  freeifaddrs( p_list );
+
+  return found;
+}
+
+
+// The gateway to the given address through the interface, from the most
+// specific route of the kernel's table, or the address itself if on-link
+static struct in_addr find_next_hop( const char* a_interface_name,
+                                     struct in_addr a_address )
+{
+  struct in_addr next_hop = a_address;
+
+  FILE* p_file = fopen( "/proc/net/route", "r" );
+  if( p_file == NULL )
+  {
+    return next_hop;
+  }
+
+  char line[ 256 ];
+  int64_t best_mask = -1;
+  while( fgets( line, sizeof line, p_file ) != NULL )
+  {
+    char name[ IFNAMSIZ + 1 ];
+    unsigned int destination, gateway, flags, mask;
+    if( sscanf( line, "%16s %x %x %x %*d %*d %*d %x",
+                name, &destination, &gateway, &flags, &mask ) != 5 ||
+        strcmp( name, a_interface_name ) != 0 ||
+        ( a_address.s_addr & mask ) != destination ||
+        ( int64_t ) ntohl( mask ) <= best_mask )
+    {
+      continue;
+    }
+
+    best_mask = ntohl( mask );
+    next_hop.s_addr = ( gateway != 0 ) ? gateway : a_address.s_addr;
+  }
+
+  fclose( p_file );
+
+  return next_hop;
+}
+
+
+// Looks the address up in the neighbour table. Returns false if not there, or
+// not resolved yet.
+static bool find_neighbour( const char* a_interface_name,
+                            struct in_addr a_address,
+                            uint8_t* ap_output_mac )
+{
+  FILE* p_file = fopen( "/proc/net/arp", "r" );
+  if( p_file == NULL )
+  {
+    return false;
+  }
+
+  char address[ INET_ADDRSTRLEN ];
+  inet_ntop( AF_INET, &a_address, address, sizeof address );
+
+  bool found = false;
+  char line[ 256 ];
+  while( !found && fgets( line, sizeof line, p_file ) != NULL )
+  {
+    char entry_address[ 64 ], name[ IFNAMSIZ + 1 ];
+    unsigned int flags;
+    unsigned int mac[ ETH_ALEN ];
+    if( sscanf( line, "%63s %*x %x %x:%x:%x:%x:%x:%x %*s %16s",
+                entry_address, &flags,
+                &mac[ 0 ], &mac[ 1 ], &mac[ 2 ], &mac[ 3 ], &mac[ 4 ],
+                &mac[ 5 ], name ) == 9 &&
+        ( flags & 0x2 ) != 0 &&                   // ATF_COM: resolved
+        strcmp( entry_address, address ) == 0 &&
+        strcmp( name, a_interface_name ) == 0 )
+    {
+      for( int i = 0; i < ETH_ALEN; i++ )
+      {
+        ap_output_mac[ i ] = ( uint8_t ) mac[ i ];
+      }
+      found = true;
+    }
+  }
+
+  fclose( p_file );
+
+  return found;
+}
+
+
+// Maps a TX ring of frames long enough for the largest datagram the interface
+// takes, or the longest event
+static bool map_ring( struct packet_ring* ap_ring, int a_mtu )
+{
+  size_t max_payload_length = a_mtu - IP_HEADER_LENGTH - UDP_HEADER_LENGTH;
+  if( max_payload_length > CSENDER_EVENT_BUFFER_LENGTH )
+  {
+    max_payload_length = CSENDER_EVENT_BUFFER_LENGTH;
+  }
+  ap_ring->max_payload_length = max_payload_length;
+
+  size_t frame_length = 1024;
+  while( frame_length < FRAME_DATA_OFFSET + FRAME_HEADERS_LENGTH +
+                        max_payload_length )
+  {
+    frame_length *= 2;
+  }
+  size_t block_length = ( frame_length > PACKET_RING_MIN_BLOCK_LENGTH ) ?
+                            frame_length :
+                            PACKET_RING_MIN_BLOCK_LENGTH;
+  size_t frames_per_block = block_length / frame_length;
+
+  struct tpacket_req request;
+  memset( &request, 0, sizeof request );
+  request.tp_block_size = block_length;
+  request.tp_frame_size = frame_length;
+  request.tp_block_nr = ( PACKET_RING_NUM_FRAMES + frames_per_block - 1 ) /
+                        frames_per_block;
+  request.tp_frame_nr = request.tp_block_nr * frames_per_block;
+
+  int version = TPACKET_V2;
+  if( setsockopt( ap_ring->socket_fd, SOL_PACKET, PACKET_VERSION,
+                  &version, sizeof version ) != 0 ||
+      setsockopt( ap_ring->socket_fd, SOL_PACKET, PACKET_TX_RING,
+                  &request, sizeof request ) != 0 )
+  {
+    return false;
+  }
+
+  ap_ring->frame_length = frame_length;
+  ap_ring->num_frames = request.tp_frame_nr;
+  ap_ring->ring_length = ( size_t ) request.tp_block_nr * block_length;
+  ap_ring->p_ring = mmap( NULL,
+                          ap_ring->ring_length,
+                          PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE,
+                          ap_ring->socket_fd,
+                          0 );
+  if( ap_ring->p_ring == MAP_FAILED )
+  {
+    ap_ring->p_ring = NULL;
+    return false;
+  }
+
+  return true;
+}
+
+
+struct packet_ring* packet_ring_create( int a_udp_socket_fd )
+{
+  struct sockaddr_in local_address, peer_address;
+  socklen_t local_length = sizeof local_address;
+  socklen_t peer_length = sizeof peer_address;
+  if( getsockname( a_udp_socket_fd,
+                   ( struct sockaddr* ) &local_address,
+                   &local_length ) != 0 ||
+      getpeername( a_udp_socket_fd,
+                   ( struct sockaddr* ) &peer_address,
+                   &peer_length ) != 0 ||
+      local_address.sin_family != AF_INET )
+  {
+    fprintf( stderr, "The packet ring just sends to IPv4 targets.\n" );
+    return NULL;
+  }
+
+  // The interface of the socket, and its addresses
+  char interface_name[ IFNAMSIZ ];
+  bool peer_local = false;
+  struct ifreq request;
+  memset( &request, 0, sizeof request );
+  if( !find_interface( local_address.sin_addr,
+                       peer_address.sin_addr,
+                       interface_name,
+                       &peer_local ) )
+  {
+    fprintf( stderr, "The interface to the target could not be found.\n" );
+    return NULL;
+  }
+
+  // Frames the loopback takes back in carry none of the routes the kernel
+  // gives its own, and are dropped as martians
+  if( peer_local ||
+      ( ntohl( peer_address.sin_addr.s_addr ) >> 24 ) == IN_LOOPBACKNET )
+  {
+    fprintf( stderr, "The packet ring can not send to local addresses; send "
+                     "to another host, or another network namespace.\n" );
+    return NULL;
+  }
+
+  snprintf( request.ifr_name, IFNAMSIZ, "%s", interface_name );
+
+  uint8_t source_mac[ ETH_ALEN ];
+  if( ioctl( a_udp_socket_fd, SIOCGIFHWADDR, &request ) != 0 )
+  {
+    perror( "The MAC address of the interface could not be read" );
+    return NULL;
+  }
+  memcpy( source_mac, request.ifr_hwaddr.sa_data, ETH_ALEN );
+
+  if( ioctl( a_udp_socket_fd, SIOCGIFMTU, &request ) != 0 )
+  {
+    perror( "The MTU of the interface could not be read" );
+    return NULL;
+  }
+  int mtu = request.ifr_mtu;
+
+  // An empty datagram has the kernel resolve the next hop, if not known yet
+  uint8_t destination_mac[ ETH_ALEN ];
+  struct in_addr next_hop = find_next_hop( interface_name,
+                                           peer_address.sin_addr );
+  bool found = find_neighbour( interface_name, next_hop, destination_mac );
+  if( !found && send( a_udp_socket_fd, "", 0, 0 ) < 0 )
+  {
+    perror( "The next hop could not be resolved" );
+    return NULL;
+  }
+
+  for( int i = 0; !found && i < NEIGHBOUR_WAIT_MS / NEIGHBOUR_POLL_MS; i++ )
+  {
+    struct timespec poll_time = { 0, NEIGHBOUR_POLL_MS * 1000000L };
+    nanosleep( &poll_time, NULL );
+    found = find_neighbour( interface_name, next_hop, destination_mac );
+  }
+
+  if( !found )
+  {
+    fprintf( stderr, "The MAC address of the next hop (%s) is not known.\n",
+             inet_ntoa( next_hop ) );
+    return NULL;
+  }
+
+  struct packet_ring* p_ring = calloc( 1, sizeof *p_ring );
+  if( p_ring == NULL )
+  {
+    return NULL;
+  }
+
+  // Protocol 0, here and when bound: no receive hook, so nothing is ever
+  // queued on it. The kernel takes the protocol of every frame from its
+  // Ethernet header.
+  p_ring->socket_fd = socket( AF_PACKET, SOCK_RAW, 0 );
+  if( p_ring->socket_fd < 0 )
+  {
+    perror( "It was not possible to create a packet socket" );
+    free( p_ring );
+    return NULL;
+  }
+
+  // Straight to the device, if the kernel lets it
+  int bypass = 1;
+  setsockopt( p_ring->socket_fd, SOL_PACKET, PACKET_QDISC_BYPASS,
+              &bypass, sizeof bypass );
+
+  struct sockaddr_ll link_address;
+  memset( &link_address, 0, sizeof link_address );
+  link_address.sll_family = AF_PACKET;
+  link_address.sll_ifindex = if_nametoindex( interface_name );
+  if( !map_ring( p_ring, mtu ) ||
+      bind( p_ring->socket_fd,
+            ( struct sockaddr* ) &link_address,
+            sizeof link_address ) != 0 )
+  {
+    perror( "It was not possible to set up the packet ring" );
+    packet_ring_destroy( p_ring );
+    return NULL;
+  }
+
+  // The headers all frames share
+  for( int i = 0; i < p_ring->num_frames; i++ )
+  {
+    uint8_t* p_frame = ( uint8_t* ) p_ring->p_ring + i * p_ring->frame_length +
+                       FRAME_DATA_OFFSET;
+    memcpy( p_frame, destination_mac, ETH_ALEN );
+    memcpy( p_frame + ETH_ALEN, source_mac, ETH_ALEN );
+    put_u16( p_frame + 2 * ETH_ALEN, ETH_P_IP );
+
+    uint8_t* p_ip = p_frame + ETHERNET_HEADER_LENGTH;
+    memset( p_ip, 0, IP_HEADER_LENGTH );
+    p_ip[ 0 ] = 0x45;                             // Version 4, 5 words
+    put_u16( p_ip + 6, 0x4000 );                  // Do not fragment
+    p_ip[ 8 ] = 64;                               // TTL
+    p_ip[ 9 ] = IPPROTO_UDP;
+    memcpy( p_ip + 12, &( local_address.sin_addr ), 4 );
+    memcpy( p_ip + 16, &( peer_address.sin_addr ), 4 );
+
+    // No UDP checksum, as IPv4 allows
+    uint8_t* p_udp = p_ip + IP_HEADER_LENGTH;
+    memset( p_udp, 0, UDP_HEADER_LENGTH );
+    memcpy( p_udp, &( local_address.sin_port ), 2 );
+    memcpy( p_udp + 2, &( peer_address.sin_port ), 2 );
+  }
+
+  return p_ring;
+}
+
+
+// Has the kernel transmit the frames requested so far, and waits for it
+static int flush_ring( struct packet_ring* ap_ring )
+{
+  while( send( ap_ring->socket_fd, NULL, 0, 0 ) < 0 )
+  {
+    if( errno != EINTR )
+    {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+
+int packet_ring_send_batch( struct packet_ring* ap_ring,
+                            const struct iovec* ap_datagrams,
+                            int a_num_datagrams )
+{
+  int num_calls = 0;
+  for( int i = 0; i < a_num_datagrams; i++ )
+  {
+    size_t length = ap_datagrams[ i ].iov_len;
+    if( length > ap_ring->max_payload_length )
+    {
+      errno = EMSGSIZE;
+      return -1;
+    }
+
+    char* p_slot = ap_ring->p_ring +
+                   ap_ring->next_frame * ap_ring->frame_length;
+    struct tpacket2_hdr* p_header = ( struct tpacket2_hdr* ) p_slot;
+    _Atomic uint32_t* p_status = ( _Atomic uint32_t* ) &( p_header->tp_status );
+
+    // A full ring is flushed first
+    uint32_t status = atomic_load_explicit( p_status, memory_order_acquire );
+    if( status & ( TP_STATUS_SEND_REQUEST | TP_STATUS_SENDING ) )
+    {
+      num_calls++;
+      if( flush_ring( ap_ring ) != 0 )
+      {
+        return -1;
+      }
+      status = atomic_load_explicit( p_status, memory_order_acquire );
+    }
+    if( status == TP_STATUS_WRONG_FORMAT )
+    {
+      errno = EINVAL;
+      return -1;
+    }
+    if( status != TP_STATUS_AVAILABLE )
+    {
+      errno = EAGAIN;
+      return -1;
+    }
+
+    uint8_t* p_ip = ( uint8_t* ) p_slot + FRAME_DATA_OFFSET +
+                    ETHERNET_HEADER_LENGTH;
+    put_u16( p_ip + 2, IP_HEADER_LENGTH + UDP_HEADER_LENGTH + length );
+    put_u16( p_ip + 4, ap_ring->ip_id++ );
+    put_u16( p_ip + 10, 0 );
+    put_u16( p_ip + 10, ip_checksum( p_ip ) );
+    put_u16( p_ip + IP_HEADER_LENGTH + 4, UDP_HEADER_LENGTH + length );
+    memcpy( p_ip + IP_HEADER_LENGTH + UDP_HEADER_LENGTH,
+            ap_datagrams[ i ].iov_base,
+            length );
+
+    p_header->tp_len = FRAME_HEADERS_LENGTH + length;
+    atomic_store_explicit( p_status,
+                           TP_STATUS_SEND_REQUEST,
+                           memory_order_release );
+    ap_ring->next_frame = ( ap_ring->next_frame + 1 ) % ap_ring->num_frames;
+  }
+
+  num_calls++;
+  if( flush_ring( ap_ring ) != 0 )
+  {
+    return -1;
+  }
+
+  return num_calls;
+}
+
+
+void packet_ring_destroy( struct packet_ring* ap_ring )
+{
+  if( ap_ring != NULL )
+  {
+    if( ap_ring->p_ring != NULL )
+    {
+      munmap( ap_ring->p_ring, ap_ring->ring_length );
+    }
+    close( ap_ring->socket_fd );
+    free( ap_ring );
+  }
+}
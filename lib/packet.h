@@ -0,0 +1,28 @@
+#ifndef CSENDER_PACKET_H
+#define CSENDER_PACKET_H
+
+#include <sys/uio.h>
+
+// Sends UDP datagrams as Ethernet frames written straight into a
+// PACKET_TX_RING shared with the kernel, past the socket layer and the qdisc.
+// The headers of every frame of the ring are built once, up front, so that
+// just the lengths, IP id and checksum, and payload change per datagram.
+// Needs CAP_NET_RAW, and IPv4.
+struct packet_ring;
+
+// Takes the addresses and ports of the given connected UDP socket, the
+// interface its route goes out through, and the MAC address of the next hop
+// from the neighbour table (asking for it with an empty datagram if missing).
+// Returns NULL, after telling why on stderr, if that was not possible.
+struct packet_ring* packet_ring_create( int a_udp_socket_fd );
+
+// Queues every buffer as a datagram, in order, and has the kernel transmit
+// them. Returns the no. of system calls it took, or -1 (with errno set) on
+// error.
+int packet_ring_send_batch( struct packet_ring* ap_ring,
+                            const struct iovec* ap_datagrams,
+                            int a_num_datagrams );
+
+void packet_ring_destroy( struct packet_ring* ap_ring );
+
+#endif
@@ -0,0 +1,173 @@
+#include "csender.h"
+
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+struct csender_perf
+{
+  int    fds[ CSENDER_NUM_PERF_COUNTERS ];     // -1: not available
+  bool   cycles_include_kernel;
+};
+
+// What every counter is, to the kernel
+struct perf_counter_definition
+{
+  uint32_t   type;
+  uint64_t   config;
+  bool       user_only;
+};
+
+static const struct perf_counter_definition
+    g_definitions[ CSENDER_NUM_PERF_COUNTERS ] =
+{
+  { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, false },
+  { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, false },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, false },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, true },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, false },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, false },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, false }
+};
+
+
+// Counts just the calling thread, on any CPU
+static int open_counter( uint32_t a_type, uint64_t a_config, bool a_user_only )
+{
+  struct perf_event_attr attributes;
+  memset( &attributes, 0, sizeof attributes );
+  attributes.size = sizeof attributes;
+  attributes.type = a_type;
+  attributes.config = a_config;
+  attributes.exclude_kernel = a_user_only;
+  attributes.exclude_hv = 1;
+
+  // Counters may have to share the hardware: these tell how much of the time
+  // each one was actually counting
+  attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                           PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  return ( int ) syscall( SYS_perf_event_open, &attributes, 0, -1, -1,
+                          PERF_FLAG_FD_CLOEXEC );
+}
+
+
+struct csender_perf* csender_perf_open( )
+{
+  struct csender_perf* p_perf = malloc( sizeof *p_perf );
+  if( p_perf == NULL )
+  {
+    return NULL;
+  }
+
+  // Virtual machines often lack the hardware ones, and unprivileged users
+  // may only count what happens out of the kernel
+  int num_open = 0;
+  int open_errno = 0;
+  for( int i = 0; i < CSENDER_NUM_PERF_COUNTERS; i++ )
+  {
+    const struct perf_counter_definition* p_definition = &( g_definitions[ i ] );
+    p_perf->fds[ i ] = open_counter( p_definition->type,
+                                     p_definition->config,
+                                     p_definition->user_only );
+    if( p_perf->fds[ i ] < 0 && errno == EACCES && !p_definition->user_only )
+    {
+      p_perf->fds[ i ] = open_counter( p_definition->type,
+                                       p_definition->config,
+                                       true );
+      if( i == CSENDER_PERF_CYCLES )
+      {
+        p_perf->cycles_include_kernel = false;
+      }
+    }
+    else if( i == CSENDER_PERF_CYCLES )
+    {
+      p_perf->cycles_include_kernel = true;
+    }
+
+    if( p_perf->fds[ i ] >= 0 )
+    {
+      num_open++;
+    }
+    else if( open_errno == 0 )
+    {
+      open_errno = errno;
+    }
+  }
+
+  if( num_open == 0 )
+  {
+    free( p_perf );
+    errno = open_errno;
+    return NULL;
+  }
+
+  return p_perf;
+}
+
+
+void csender_perf_read( const struct csender_perf* ap_perf,
+                        struct csender_perf_sample* ap_output_sample )
+{
+  memset( ap_output_sample, 0, sizeof *ap_output_sample );
+
+  for( int i = 0; i < CSENDER_NUM_PERF_COUNTERS; i++ )
+  {
+    // Value, time enabled, time running
+    uint64_t values[ 3 ];
+    if( ap_perf->fds[ i ] < 0 ||
+        read( ap_perf->fds[ i ], values, sizeof values ) != sizeof values )
+    {
+      continue;
+    }
+
+    // Scaled up to the whole time, if it had to share
+    if( values[ 2 ] > 0 && values[ 2 ] < values[ 1 ] )
+    {
+      values[ 0 ] = ( uint64_t ) ( ( double ) values[ 0 ] * values[ 1 ] /
+                                   values[ 2 ] );
+    }
+
+    ap_output_sample->values[ i ] = values[ 0 ];
+    ap_output_sample->available[ i ] = true;
+  }
+
+  // Without the kernel, the share of it can not be told
+  if( !ap_perf->cycles_include_kernel )
+  {
+    ap_output_sample->available[ CSENDER_PERF_USER_CYCLES ] = false;
+  }
+}
+
+
+void csender_perf_sample_accumulate(
+    struct csender_perf_sample* ap_total,
+    const struct csender_perf_sample* ap_sample )
+{
+  for( int i = 0; i < CSENDER_NUM_PERF_COUNTERS; i++ )
+  {
+    ap_total->values[ i ] += ap_sample->values[ i ];
+    ap_total->available[ i ] =
+        ap_total->available[ i ] || ap_sample->available[ i ];
+  }
+}
+
+
+void csender_perf_close( struct csender_perf* ap_perf )
+{
+  if( ap_perf != NULL )
+  {
+    for( int i = 0; i < CSENDER_NUM_PERF_COUNTERS; i++ )
+    {
+      if( ap_perf->fds[ i ] >= 0 )
+      {
+        close( ap_perf->fds[ i ] );
+      }
+    }
+
+    free( ap_perf );
+  }
+}
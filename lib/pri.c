@@ -0,0 +1,123 @@
+#include "pri.h"
+#include "format.h"
+#include "weights.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_FACILITY 1              // user
+#define DEFAULT_SEVERITY 5              // notice
+
+// RFC 5424 names, by code
+static const char* g_facility_names[ CSENDER_NUM_FACILITIES ] =
+{
+  "kern", "user", "mail", "daemon", "auth", "syslog", "lpr", "news",
+  "uucp", "cron", "authpriv", "ftp", "ntp", "security", "console",
+  "solaris-cron", "local0", "local1", "local2", "local3", "local4",
+  "local5", "local6", "local7"
+};
+
+static const char* g_severity_names[ CSENDER_NUM_SEVERITIES ] =
+{
+  "emerg", "alert", "crit", "err", "warning", "notice", "info", "debug"
+};
+
+
+const char* csender_facility_name( int a_facility )
+{
+  return ( a_facility >= 0 && a_facility < CSENDER_NUM_FACILITIES ) ?
+             g_facility_names[ a_facility ] :
+             NULL;
+}
+
+
+const char* csender_severity_name( int a_severity )
+{
+  return ( a_severity >= 0 && a_severity < CSENDER_NUM_SEVERITIES ) ?
+             g_severity_names[ a_severity ] :
+             NULL;
+}
+
+
+bool csender_parse_facility_weights( const char* a_specification,
+                                     unsigned int* ap_output_weights )
+{
+  return parse_weights( a_specification,
+                        g_facility_names,
+                        CSENDER_NUM_FACILITIES,
+                        ap_output_weights );
+}
+
+
+bool csender_parse_severity_weights( const char* a_specification,
+                                     unsigned int* ap_output_weights )
+{
+  return parse_weights( a_specification,
+                        g_severity_names,
+                        CSENDER_NUM_SEVERITIES,
+                        ap_output_weights );
+}
+
+
+void pri_table_init( struct pri_table* ap_table,
+                     const unsigned int* a_facility_weights,
+                     const unsigned int* a_severity_weights )
+{
+  unsigned int facility_weights[ CSENDER_NUM_FACILITIES ];
+  unsigned int severity_weights[ CSENDER_NUM_SEVERITIES ];
+  memcpy( facility_weights, a_facility_weights, sizeof facility_weights );
+  memcpy( severity_weights, a_severity_weights, sizeof severity_weights );
+
+  if( weights_all_zero( facility_weights, CSENDER_NUM_FACILITIES ) )
+  {
+    facility_weights[ DEFAULT_FACILITY ] = 1;
+  }
+  if( weights_all_zero( severity_weights, CSENDER_NUM_SEVERITIES ) )
+  {
+    severity_weights[ DEFAULT_SEVERITY ] = 1;
+  }
+
+  // Render the prefixes of every priority with some weight
+  double weights[ NUM_PRIORITIES ];
+  ap_table->num_entries = 0;
+  ap_table->max_prefix_length = 0;
+  for( int facility = 0; facility < CSENDER_NUM_FACILITIES; facility++ )
+  {
+    for( int severity = 0; severity < CSENDER_NUM_SEVERITIES; severity++ )
+    {
+      double weight = ( double ) facility_weights[ facility ] *
+                      severity_weights[ severity ];
+      if( weight == 0 )
+      {
+        continue;
+      }
+
+      int i = ap_table->num_entries++;
+      char* p_prefix = ap_table->prefixes[ i ];
+      memset( p_prefix, 0, PRI_PREFIX_BLOCK_LENGTH );
+      p_prefix[ 0 ] = '<';
+      size_t length = 1 + format_u64( p_prefix + 1,
+                                      facility * CSENDER_NUM_SEVERITIES +
+                                      severity );
+      p_prefix[ length++ ] = '>';
+
+      ap_table->prefix_lengths[ i ] = ( uint8_t ) length;
+      ap_table->severities[ i ] = ( uint8_t ) severity;
+      if( length > ap_table->max_prefix_length )
+      {
+        ap_table->max_prefix_length = length;
+      }
+
+      weights[ i ] = weight;
+    }
+  }
+
+  double scratch[ NUM_PRIORITIES ];
+  int scratch_indices[ NUM_PRIORITIES ];
+  alias_table_build( weights,
+                     ap_table->num_entries,
+                     scratch,
+                     scratch_indices,
+                     ap_table->thresholds,
+                     ap_table->aliases );
+}
@@ -0,0 +1,57 @@
+#ifndef CSENDER_PRI_H
+#define CSENDER_PRI_H
+
+#include "csender.h"
+#include "random.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define NUM_PRIORITIES ( CSENDER_NUM_FACILITIES * CSENDER_NUM_SEVERITIES )
+
+// "<191>" is the longest prefix. Every one is stored in a block of this size,
+// so that it is copied at once.
+#define PRI_PREFIX_MAXLENGTH 5
+#define PRI_PREFIX_BLOCK_LENGTH 8
+
+// The priorities with some weight, with their "<PRI>" prefixes rendered in
+// advance, and ready to be picked at random in constant time (Walker's alias
+// method: a uniformly chosen entry is kept with the probability of its
+// threshold, or else replaced by its alias).
+struct pri_table
+{
+  int        num_entries;
+  size_t     max_prefix_length;
+  char       prefixes[ NUM_PRIORITIES ][ PRI_PREFIX_BLOCK_LENGTH ];
+  uint8_t    prefix_lengths[ NUM_PRIORITIES ];
+  uint8_t    severities[ NUM_PRIORITIES ];
+  uint64_t   thresholds[ NUM_PRIORITIES ];      // Out of 2^32
+  uint32_t   aliases[ NUM_PRIORITIES ];
+};
+
+// Facilities, or severities, without any weight are taken as user, or notice,
+// alone.
+void pri_table_init( struct pri_table* ap_table,
+                     const unsigned int* a_facility_weights,
+                     const unsigned int* a_severity_weights );
+
+// Index of a random entry. A table of one entry does not use the random state,
+// so the events of the default priority do not depend on it.
+static inline int pri_table_pick( const struct pri_table* ap_table,
+                                  uint64_t* ap_io_random_state )
+{
+  if( ap_table->num_entries == 1 )
+  {
+    return 0;
+  }
+
+  uint64_t random = random_next( ap_io_random_state );
+  uint32_t index =
+      ( uint32_t ) ( ( ( random >> 32 ) * ap_table->num_entries ) >> 32 );
+
+  return ( ( random & 0xFFFFFFFFULL ) < ap_table->thresholds[ index ] ) ?
+             ( int ) index :
+             ( int ) ap_table->aliases[ index ];
+}
+
+#endif
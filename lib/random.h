@@ -0,0 +1,18 @@
+#ifndef CSENDER_RANDOM_H
+#define CSENDER_RANDOM_H
+
+#include <stdint.h>
+
+// xorshift64* step. The state must not be 0.
+static inline uint64_t random_next( uint64_t* ap_io_state )
+{
+  uint64_t x = *ap_io_state;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  *ap_io_state = x;
+
+  return x * 0x2545F4914F6CDD1DULL;
+}
+
+#endif
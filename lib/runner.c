@@ -0,0 +1,347 @@
+#include "csender.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct csender_worker
+{
+  pthread_t                    thread;
+  bool                         thread_started;
+  struct csender_generator*    p_generator;
+  struct csender_transport*    p_transport;
+  struct csender_stats*        p_stats;
+  struct csender_send_control  control;
+  struct csender_runner*       p_runner;
+
+  // Opened by the thread itself, as they count the calling thread
+  _Atomic( struct csender_perf* )   p_perf;
+};
+
+struct csender_runner
+{
+  struct csender_runner_options   options;
+  struct csender_worker*          p_workers;
+  atomic_long                     rate;
+  atomic_int                      num_workers_running;
+};
+
+
+static void* worker_main( void* ap_worker )
+{
+  struct csender_worker* p_worker = ap_worker;
+
+  // Counters of a restarted thread go on from those of the first start
+  if( p_worker->p_runner->options.perf_counters &&
+      atomic_load( &( p_worker->p_perf ) ) == NULL )
+  {
+    struct csender_perf* p_perf = csender_perf_open( );
+    if( p_perf != NULL )
+    {
+      atomic_store_explicit( &( p_worker->p_perf ),
+                             p_perf,
+                             memory_order_release );
+    }
+    else if( p_worker == p_worker->p_runner->p_workers )
+    {
+      perror( "Performance counters are not available" );
+    }
+  }
+
+  csender_send_events( p_worker->p_generator,
+                       p_worker->p_transport,
+                       p_worker->p_stats,
+                       &( p_worker->control ) );
+
+  atomic_fetch_sub( &( p_worker->p_runner->num_workers_running ), 1 );
+
+  return NULL;
+}
+
+
+struct csender_runner* csender_runner_create(
+    const struct csender_runner_options* ap_options )
+{
+  if( ap_options->num_threads <= 0 )
+  {
+    return NULL;
+  }
+
+  struct csender_runner* p_runner = calloc( 1, sizeof *p_runner );
+  if( p_runner == NULL )
+  {
+    return NULL;
+  }
+
+  p_runner->options = *ap_options;
+  atomic_init( &( p_runner->rate ), 0 );
+  atomic_init( &( p_runner->num_workers_running ), 0 );
+  p_runner->p_workers = calloc( ap_options->num_threads,
+                                sizeof *( p_runner->p_workers ) );
+  if( p_runner->p_workers == NULL )
+  {
+    free( p_runner );
+    return NULL;
+  }
+
+  // Every worker gets its own generator, connection and counters, so that
+  // they share nothing while sending.
+  for( int i = 0; i < ap_options->num_threads; i++ )
+  {
+    struct csender_worker* p_worker = &( p_runner->p_workers[ i ] );
+    p_worker->p_runner = p_runner;
+    p_worker->control.replay_speed = ap_options->replay_speed;
+    p_worker->control.batch_size = ap_options->batch_size;
+    atomic_init( &( p_worker->p_perf ), NULL );
+
+    struct csender_generator_options generator_options = ap_options->generator;
+    generator_options.stream_index += i;
+    p_worker->p_generator = csender_generator_create( &generator_options );
+    p_worker->p_stats = csender_stats_create( );
+    if( ap_options->shm_path != NULL )
+    {
+      p_worker->p_transport =
+          csender_transport_connect_shm( ap_options->shm_path );
+    }
+    else if( ap_options->udp )
+    {
+      p_worker->p_transport =
+          csender_transport_connect_udp( ap_options->target_name,
+                                         ap_options->service_name );
+    }
+    else if( ap_options->mptcp )
+    {
+      p_worker->p_transport =
+          csender_transport_connect_mptcp( ap_options->target_name,
+                                           ap_options->service_name );
+    }
+    else
+    {
+      p_worker->p_transport =
+          csender_transport_connect( ap_options->target_name,
+                                     ap_options->service_name );
+    }
+
+    if( p_worker->p_generator == NULL ||
+        p_worker->p_stats == NULL ||
+        p_worker->p_transport == NULL ||
+        csender_transport_set_engine( p_worker->p_transport,
+                                      ap_options->engine ) != 0 ||
+        ( ap_options->tx_timestamps > 0 &&
+          csender_transport_enable_tx_timestamps(
+              p_worker->p_transport,
+              ap_options->tx_timestamps ) != 0 ) )
+    {
+      csender_runner_destroy( p_runner );
+      return NULL;
+    }
+  }
+
+  csender_runner_set_rate( p_runner, ap_options->rate );
+
+  return p_runner;
+}
+
+
+int csender_runner_start( struct csender_runner* ap_runner )
+{
+  for( int i = 0; i < ap_runner->options.num_threads; i++ )
+  {
+    struct csender_worker* p_worker = &( ap_runner->p_workers[ i ] );
+    p_worker->control.stop_requested = false;
+
+    atomic_fetch_add( &( ap_runner->num_workers_running ), 1 );
+    if( pthread_create( &( p_worker->thread ),
+                        NULL,
+                        worker_main,
+                        p_worker ) != 0 )
+    {
+      atomic_fetch_sub( &( ap_runner->num_workers_running ), 1 );
+      fprintf( stderr, "It was not possible to create a sender thread.\n" );
+      csender_runner_stop( ap_runner );
+      return -1;
+    }
+
+    p_worker->thread_started = true;
+  }
+
+  return 0;
+}
+
+
+void csender_runner_stop( struct csender_runner* ap_runner )
+{
+  for( int i = 0; i < ap_runner->options.num_threads; i++ )
+  {
+    ap_runner->p_workers[ i ].control.stop_requested = true;
+  }
+
+  for( int i = 0; i < ap_runner->options.num_threads; i++ )
+  {
+    struct csender_worker* p_worker = &( ap_runner->p_workers[ i ] );
+    if( p_worker->thread_started )
+    {
+      pthread_join( p_worker->thread, NULL );
+      p_worker->thread_started = false;
+    }
+  }
+}
+
+
+bool csender_runner_is_running( const struct csender_runner* ap_runner )
+{
+  return atomic_load( &( ap_runner->num_workers_running ) ) > 0;
+}
+
+
+void csender_runner_set_rate( struct csender_runner* ap_runner, long a_rate )
+{
+  atomic_store( &( ap_runner->rate ), ( a_rate > 0 ) ? a_rate : 0 );
+
+  // Split the rate evenly among the threads. The first ones take the
+  // remainder, but never less than 1 event/sec.
+  int num_threads = ap_runner->options.num_threads;
+  for( int i = 0; i < num_threads; i++ )
+  {
+    long worker_rate = 0;
+    if( a_rate > 0 )
+    {
+      worker_rate = a_rate / num_threads + ( i < a_rate % num_threads );
+      if( worker_rate == 0 )
+      {
+        worker_rate = 1;
+      }
+    }
+
+    ap_runner->p_workers[ i ].control.rate = worker_rate;
+  }
+}
+
+
+long csender_runner_rate( const struct csender_runner* ap_runner )
+{
+  return atomic_load( &( ap_runner->rate ) );
+}
+
+
+void csender_runner_stats( const struct csender_runner* ap_runner,
+                           struct csender_stats_snapshot* ap_output_snapshot )
+{
+  memset( ap_output_snapshot, 0, sizeof *ap_output_snapshot );
+
+  for( int i = 0; i < ap_runner->options.num_threads; i++ )
+  {
+    struct csender_stats_snapshot worker_snapshot;
+    csender_stats_snapshot( ap_runner->p_workers[ i ].p_stats,
+                            &worker_snapshot );
+    csender_stats_snapshot_accumulate( ap_output_snapshot, &worker_snapshot );
+  }
+}
+
+
+void csender_runner_destroy( struct csender_runner* ap_runner )
+{
+  if( ap_runner == NULL )
+  {
+    return;
+  }
+
+  csender_runner_stop( ap_runner );
+
+  for( int i = 0; i < ap_runner->options.num_threads; i++ )
+  {
+    struct csender_worker* p_worker = &( ap_runner->p_workers[ i ] );
+    csender_transport_close( p_worker->p_transport );
+    csender_stats_destroy( p_worker->p_stats );
+    csender_generator_destroy( p_worker->p_generator );
+    csender_perf_close( atomic_load( &( p_worker->p_perf ) ) );
+  }
+
+  free( ap_runner->p_workers );
+  free( ap_runner );
+}
+
+
+void csender_runner_send_times( const struct csender_runner* ap_runner,
+                                struct csender_histogram* ap_output_histogram )
+{
+  csender_histogram_clear( ap_output_histogram );
+
+  for( int i = 0; i < ap_runner->options.num_threads; i++ )
+  {
+    csender_stats_send_times( ap_runner->p_workers[ i ].p_stats,
+                              ap_output_histogram );
+  }
+}
+
+
+void csender_runner_tx_latencies( const struct csender_runner* ap_runner,
+                                  struct csender_histogram* ap_output_qdisc_times,
+                                  struct csender_histogram* ap_output_ack_times )
+{
+  csender_histogram_clear( ap_output_qdisc_times );
+  csender_histogram_clear( ap_output_ack_times );
+  for( int i = 0; i < ap_runner->options.num_threads; i++ )
+  {
+    csender_stats_tx_latencies( ap_runner->p_workers[ i ].p_stats,
+                                ap_output_qdisc_times,
+                                ap_output_ack_times );
+  }
+}
+
+
+int csender_runner_subflows( const struct csender_runner* ap_runner,
+                             int a_thread_index,
+                             struct csender_subflow_info* ap_output_subflows,
+                             int a_max_subflows )
+{
+  if( a_thread_index < 0 || a_thread_index >= ap_runner->options.num_threads )
+  {
+    return -1;
+  }
+
+  return csender_transport_subflows(
+      ap_runner->p_workers[ a_thread_index ].p_transport,
+      ap_output_subflows,
+      a_max_subflows );
+}
+
+
+long csender_runner_send_queue_bytes( const struct csender_runner* ap_runner )
+{
+  long total = 0;
+  for( int i = 0; i < ap_runner->options.num_threads; i++ )
+  {
+    long num_bytes = csender_transport_send_queue_bytes(
+        ap_runner->p_workers[ i ].p_transport );
+    total += ( num_bytes > 0 ) ? num_bytes : 0;
+  }
+
+  return total;
+}
+
+
+bool csender_runner_perf_counters( const struct csender_runner* ap_runner,
+                                   struct csender_perf_sample* ap_output_sample )
+{
+  memset( ap_output_sample, 0, sizeof *ap_output_sample );
+
+  bool any_open = false;
+  for( int i = 0; i < ap_runner->options.num_threads; i++ )
+  {
+    const struct csender_perf* p_perf =
+        atomic_load_explicit( &( ap_runner->p_workers[ i ].p_perf ),
+                              memory_order_acquire );
+    if( p_perf != NULL )
+    {
+      struct csender_perf_sample worker_sample;
+      csender_perf_read( p_perf, &worker_sample );
+      csender_perf_sample_accumulate( ap_output_sample, &worker_sample );
+      any_open = true;
+    }
+  }
+
+  return any_open;
+}
@@ -0,0 +1,255 @@
+#include "csender.h"
+#include "allocation_check.h"
+#include "arena.h"
+#include "clock.h"
+#include "event.h"
+#include "pacing.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Room for the buffers of a send loop, cache line aligned: the events, and the
+// rest. Batches of events share a buffer, and are sent once it can not take
+// another one of the longest events.
+#define SEND_ARENA_LENGTH ( 4 * 1024 )
+#define SEND_BATCH_BUFFER_LENGTH ( 256 * 1024 )
+#define SEND_BUFFER_ALIGNMENT 64
+
+// TX latencies of sampled events taken from the transport at once
+#define TX_LATENCIES_PER_TAKE 8
+
+// Events generated but not yet sent
+struct send_batch
+{
+  char*           p_buffer;
+  size_t          buffer_length;
+  struct iovec*   p_events;
+  uint8_t*        p_severities;
+  int             num_events;
+  size_t          length;                     // Bytes of all the events
+};
+
+
+// Time spent sending tells how much the receiver is pushing back. Returns 0
+// on success.
+static int send_batch( struct send_batch* ap_batch,
+                       struct csender_transport* ap_transport,
+                       struct csender_stats* ap_stats )
+{
+  int64_t send_start_ns = monotonic_ns( );
+  int num_send_calls = csender_transport_send_batch( ap_transport,
+                                                     ap_batch->p_events,
+                                                     ap_batch->num_events );
+  if( num_send_calls < 0 )
+  {
+    allocation_check_end( );
+    csender_stats_add( ap_stats, 0, 0, 1 );
+    perror( "It was not possible to send an event" );
+    return -1;
+  }
+
+  csender_stats_record_send_time( ap_stats, monotonic_ns( ) - send_start_ns );
+  csender_stats_count_send_calls( ap_stats, num_send_calls );
+  csender_stats_add( ap_stats, ap_batch->num_events, ap_batch->length, 0 );
+  for( int i = 0; i < ap_batch->num_events; i++ )
+  {
+    csender_stats_count_severity( ap_stats, ap_batch->p_severities[ i ] );
+  }
+
+  struct csender_tx_latency latencies[ TX_LATENCIES_PER_TAKE ];
+  int num_latencies;
+  while( ( num_latencies = csender_transport_tx_latencies(
+               ap_transport,
+               latencies,
+               TX_LATENCIES_PER_TAKE ) ) > 0 )
+  {
+    for( int i = 0; i < num_latencies; i++ )
+    {
+      csender_stats_record_tx_latency( ap_stats, &( latencies[ i ] ) );
+    }
+  }
+
+  ap_batch->num_events = 0;
+  ap_batch->length = 0;
+
+  return 0;
+}
+
+
+int csender_send_events( struct csender_generator* ap_generator,
+                         struct csender_transport* ap_transport,
+                         struct csender_stats* ap_stats,
+                         const struct csender_send_control* ap_control )
+{
+  int batch_size = ap_control->batch_size;
+  if( batch_size < 1 )
+  {
+    batch_size = 1;
+  }
+  else if( batch_size > CSENDER_MAX_SEND_BATCH )
+  {
+    batch_size = CSENDER_MAX_SEND_BATCH;
+  }
+
+  struct send_batch batch;
+  memset( &batch, 0, sizeof batch );
+  batch.buffer_length = ( batch_size > 1 ) ? SEND_BATCH_BUFFER_LENGTH :
+                                             CSENDER_EVENT_BUFFER_LENGTH;
+
+  struct arena arena;
+  if( arena_init( &arena, SEND_ARENA_LENGTH + batch.buffer_length ) )
+  {
+    batch.p_buffer = arena_alloc( &arena,
+                                  batch.buffer_length,
+                                  SEND_BUFFER_ALIGNMENT );
+    batch.p_events = arena_alloc( &arena,
+                                  batch_size * sizeof( struct iovec ),
+                                  SEND_BUFFER_ALIGNMENT );
+    batch.p_severities = arena_alloc( &arena,
+                                      batch_size,
+                                      SEND_BUFFER_ALIGNMENT );
+  }
+  if( batch.p_buffer == NULL ||
+      batch.p_events == NULL ||
+      batch.p_severities == NULL )
+  {
+    fprintf( stderr, "It was not possible to set up the buffers of a sender "
+             "thread.\n" );
+    arena_destroy( &arena );
+    return -1;
+  }
+
+  int result = 0;
+  long num_events_sent = 0;
+  long current_rate = 0;
+  int64_t interval_ns = 0;
+  int64_t next_send_ns = 0;
+  int64_t replay_start_ns = -1;
+
+  while( !ap_control->stop_requested )
+  {
+    // Packs with times keep the spacing of their events, scaled
+    int64_t event_time_ns =
+        ( ap_control->replay_speed > 0 ) ?
+            csender_generator_next_event_time_ns( ap_generator ) :
+            -1;
+
+    // Pace the events, if a rate has been set. It may change at any moment.
+    long rate = ap_control->rate;
+    if( event_time_ns >= 0 )
+    {
+      int64_t now_ns = monotonic_ns( );
+      if( replay_start_ns < 0 )
+      {
+        replay_start_ns = now_ns;
+      }
+
+      int64_t send_ns = replay_start_ns +
+                        ( int64_t ) ( event_time_ns / ap_control->replay_speed );
+      if( now_ns < send_ns )
+      {
+        // Nothing waits for a batch to fill
+        if( batch.num_events > 0 &&
+            send_batch( &batch, ap_transport, ap_stats ) != 0 )
+        {
+          result = -1;
+          break;
+        }
+
+        if( send_ns - now_ns >= MIN_PACING_SLEEP_NS )
+        {
+          sleep_until_ns( send_ns );
+        }
+
+        continue;
+      }
+
+      if( now_ns - send_ns > MAX_PACING_BACKLOG_NS )
+      {
+        replay_start_ns += now_ns - send_ns - MAX_PACING_BACKLOG_NS;
+      }
+    }
+    else if( rate > 0 )
+    {
+      int64_t now_ns = monotonic_ns( );
+      if( rate != current_rate )
+      {
+        current_rate = rate;
+        interval_ns = NS_PER_SECOND / rate;
+        next_send_ns = now_ns;
+      }
+
+      if( now_ns < next_send_ns )
+      {
+        if( batch.num_events > 0 &&
+            send_batch( &batch, ap_transport, ap_stats ) != 0 )
+        {
+          result = -1;
+          break;
+        }
+
+        if( next_send_ns - now_ns >= MIN_PACING_SLEEP_NS )
+        {
+          sleep_until_ns( next_send_ns );
+        }
+
+        continue;
+      }
+
+      if( now_ns - next_send_ns > MAX_PACING_BACKLOG_NS )
+      {
+        next_send_ns = now_ns - MAX_PACING_BACKLOG_NS;
+      }
+
+      next_send_ns += interval_ns;
+    }
+    else
+    {
+      current_rate = 0;
+    }
+
+    char* p_event = batch.p_buffer + batch.length;
+    size_t event_length = 0;
+    if( csender_generator_next( ap_generator,
+                                p_event,
+                                &event_length,
+                                NULL ) != 0 )
+    {
+      allocation_check_end( );
+      fprintf( stderr, "It was not possible to generate a new event.\n" );
+      result = -1;
+      break;
+    }
+
+    int i = batch.num_events++;
+    batch.p_events[ i ].iov_base = p_event;
+    batch.p_events[ i ].iov_len = event_length;
+    batch.p_severities[ i ] =
+        ( uint8_t ) csender_generator_last_severity( ap_generator );
+    batch.length += event_length;
+
+    if( ( batch.num_events == batch_size ||
+          batch.buffer_length - batch.length < CSENDER_EVENT_BUFFER_LENGTH ) &&
+        send_batch( &batch, ap_transport, ap_stats ) != 0 )
+    {
+      result = -1;
+      break;
+    }
+
+    if( ++num_events_sent == ALLOCATION_CHECK_WARM_UP_EVENTS )
+    {
+      allocation_check_begin( );
+    }
+  }
+
+  // What is left of the last batch, if stopped on request
+  if( result == 0 && batch.num_events > 0 )
+  {
+    result = send_batch( &batch, ap_transport, ap_stats );
+  }
+
+  allocation_check_end( );
+  arena_destroy( &arena );
+
+  return result;
+}
@@ -0,0 +1,390 @@
+#define _GNU_SOURCE                     // accept4()
+
+#include "csender.h"
+#include "shm_ring.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// How long threads wait at a time, before checking whether to stop
+#define POLL_TIMEOUT_MS 100
+
+// A writer, and the thread draining its ring
+struct shm_lane
+{
+  pthread_t                    thread;
+  int                          socket_fd;
+  struct shm_ring*             p_ring;
+  struct csender_shm_reader*   p_reader;
+  atomic_bool                  connected;
+  bool                         started;            // Thread to join
+
+  // Octet counting framing: where the thread is within the current event
+  size_t                       frame_length;       // Digits so far
+  size_t                       num_bytes_to_skip;  // Of the message
+};
+
+struct csender_shm_reader
+{
+  int                    listen_fd;
+  struct sockaddr_un     address;
+  size_t                 ring_length;
+  enum csender_framing   framing;
+  pthread_t              accept_thread;
+  bool                   accept_thread_started;
+  atomic_bool            stop_requested;
+  struct shm_lane        lanes[ CSENDER_SHM_MAX_WRITERS ];
+  atomic_int             num_lanes;                // Slots ever taken
+
+  // Of every writer so far, so that they outlive the lanes
+  _Atomic uint64_t       num_events_read;
+  _Atomic uint64_t       num_bytes_read;
+};
+
+
+// Counts the events that end within the given bytes, as "LENGTH " and a
+// message of that length each, picking up from the previous bytes
+static uint64_t count_octet_counted_events( struct shm_lane* ap_lane,
+                                            const char* a_data,
+                                            size_t a_length )
+{
+  uint64_t num_events = 0;
+  while( a_length > 0 )
+  {
+    if( ap_lane->num_bytes_to_skip > 0 )
+    {
+      size_t length = ( a_length < ap_lane->num_bytes_to_skip ) ?
+                          a_length :
+                          ap_lane->num_bytes_to_skip;
+      a_data += length;
+      a_length -= length;
+      ap_lane->num_bytes_to_skip -= length;
+      if( ap_lane->num_bytes_to_skip == 0 )
+      {
+        num_events++;
+      }
+      continue;
+    }
+
+    char character = *a_data++;
+    a_length--;
+    if( character >= '0' && character <= '9' )
+    {
+      ap_lane->frame_length = ap_lane->frame_length * 10 + ( character - '0' );
+    }
+    else if( character == ' ' )
+    {
+      ap_lane->num_bytes_to_skip = ap_lane->frame_length;
+      ap_lane->frame_length = 0;
+      if( ap_lane->num_bytes_to_skip == 0 )
+      {
+        num_events++;
+      }
+    }
+  }
+
+  return num_events;
+}
+
+
+static uint64_t count_lf_events( const char* a_data, size_t a_length )
+{
+  uint64_t num_events = 0;
+  const char* p_end = a_data + a_length;
+  while( ( a_data = memchr( a_data, '\n', p_end - a_data ) ) != NULL )
+  {
+    num_events++;
+    a_data++;
+  }
+
+  return num_events;
+}
+
+
+static void* lane_main( void* ap_lane )
+{
+  struct shm_lane* p_lane = ap_lane;
+  struct csender_shm_reader* p_reader = p_lane->p_reader;
+
+  while( !atomic_load_explicit( &( p_reader->stop_requested ),
+                                memory_order_relaxed ) )
+  {
+    const char* p_data = NULL;
+    long length = shm_ring_read_begin( p_lane->p_ring,
+                                       &p_data,
+                                       p_lane->socket_fd,
+                                       POLL_TIMEOUT_MS );
+    if( length < 0 )
+    {
+      // The writer went away, and everything it wrote has been read
+      break;
+    }
+    if( length == 0 )
+    {
+      continue;
+    }
+
+    uint64_t num_events_read =
+        ( p_reader->framing == CSENDER_FRAMING_OCTET_COUNTING ) ?
+            count_octet_counted_events( p_lane, p_data, length ) :
+            count_lf_events( p_data, length );
+    shm_ring_read_end( p_lane->p_ring, length );
+
+    // Once per read, however many events it took
+    atomic_fetch_add_explicit( &( p_reader->num_events_read ),
+                               num_events_read,
+                               memory_order_relaxed );
+    atomic_fetch_add_explicit( &( p_reader->num_bytes_read ),
+                               ( uint64_t ) length,
+                               memory_order_relaxed );
+  }
+
+  atomic_store( &( p_lane->connected ), false );
+
+  return NULL;
+}
+
+
+// Joins the thread of a lane, and frees what it had
+static void stop_lane( struct shm_lane* ap_lane )
+{
+  pthread_join( ap_lane->thread, NULL );
+  close( ap_lane->socket_fd );
+  shm_ring_destroy( ap_lane->p_ring );
+  ap_lane->started = false;
+}
+
+
+// A lane no writer is using, that of one that went away if there is any.
+// Returns NULL if all of them are in use.
+static struct shm_lane* free_lane( struct csender_shm_reader* ap_reader )
+{
+  int num_lanes = atomic_load( &( ap_reader->num_lanes ) );
+  for( int i = 0; i < num_lanes; i++ )
+  {
+    struct shm_lane* p_lane = &( ap_reader->lanes[ i ] );
+    if( p_lane->started && !atomic_load( &( p_lane->connected ) ) )
+    {
+      stop_lane( p_lane );
+    }
+    if( !p_lane->started )
+    {
+      return p_lane;
+    }
+  }
+
+  if( num_lanes == CSENDER_SHM_MAX_WRITERS )
+  {
+    return NULL;
+  }
+
+  return &( ap_reader->lanes[ num_lanes ] );
+}
+
+
+// Hands the ring of a lane to the writer that connected through the given
+// socket, and starts draining it. Returns false (closing the socket) if that
+// was not possible.
+static bool start_lane( struct csender_shm_reader* ap_reader, int a_socket_fd )
+{
+  struct shm_lane* p_lane = free_lane( ap_reader );
+  if( p_lane == NULL )
+  {
+    fprintf( stderr,
+             "No more than %d writers can be taken at once.\n",
+             CSENDER_SHM_MAX_WRITERS );
+    close( a_socket_fd );
+    return false;
+  }
+
+  p_lane->socket_fd = a_socket_fd;
+  p_lane->p_reader = ap_reader;
+  p_lane->p_ring = shm_ring_create( ap_reader->ring_length );
+  atomic_store( &( p_lane->connected ), true );
+  p_lane->frame_length = 0;
+  p_lane->num_bytes_to_skip = 0;
+  if( p_lane->p_ring == NULL ||
+      shm_ring_send( p_lane->p_ring, a_socket_fd ) != 0 ||
+      pthread_create( &( p_lane->thread ), NULL, lane_main, p_lane ) != 0 )
+  {
+    perror( "It was not possible to hand a ring to a writer" );
+    atomic_store( &( p_lane->connected ), false );
+    shm_ring_destroy( p_lane->p_ring );
+    close( a_socket_fd );
+    return false;
+  }
+  p_lane->started = true;
+
+  // A new slot is only counted once ready, for the stats
+  int lane_index = p_lane - ap_reader->lanes;
+  if( lane_index == atomic_load( &( ap_reader->num_lanes ) ) )
+  {
+    atomic_store_explicit( &( ap_reader->num_lanes ),
+                           lane_index + 1,
+                           memory_order_release );
+  }
+
+  return true;
+}
+
+
+static void* accept_main( void* ap_reader )
+{
+  struct csender_shm_reader* p_reader = ap_reader;
+  while( !atomic_load( &( p_reader->stop_requested ) ) )
+  {
+    struct pollfd listen_poll = { p_reader->listen_fd, POLLIN, 0 };
+    if( poll( &listen_poll, 1, POLL_TIMEOUT_MS ) <= 0 )
+    {
+      continue;
+    }
+
+    int socket_fd = accept4( p_reader->listen_fd, NULL, NULL, SOCK_CLOEXEC );
+    if( socket_fd < 0 )
+    {
+      if( errno != EINTR && errno != ECONNABORTED )
+      {
+        perror( "It was not possible to take a writer" );
+      }
+      continue;
+    }
+
+    start_lane( p_reader, socket_fd );
+  }
+
+  return NULL;
+}
+
+
+struct csender_shm_reader* csender_shm_reader_create(
+    const char* a_socket_path,
+    size_t a_ring_length,
+    enum csender_framing a_framing )
+{
+  struct csender_shm_reader* p_reader = calloc( 1, sizeof *p_reader );
+  if( p_reader == NULL )
+  {
+    return NULL;
+  }
+
+  p_reader->address.sun_family = AF_UNIX;
+  if( strlen( a_socket_path ) >= sizeof p_reader->address.sun_path )
+  {
+    fprintf( stderr, "The socket path %s is too long.\n", a_socket_path );
+    free( p_reader );
+    return NULL;
+  }
+  strcpy( p_reader->address.sun_path, a_socket_path );
+  p_reader->ring_length = a_ring_length;
+  p_reader->framing = a_framing;
+  atomic_init( &( p_reader->stop_requested ), false );
+  atomic_init( &( p_reader->num_lanes ), 0 );
+  atomic_init( &( p_reader->num_events_read ), 0 );
+  atomic_init( &( p_reader->num_bytes_read ), 0 );
+
+  // A socket left behind by a previous reader, but never anything else
+  struct stat path_status;
+  if( lstat( a_socket_path, &path_status ) == 0 &&
+      S_ISSOCK( path_status.st_mode ) )
+  {
+    unlink( a_socket_path );
+  }
+
+  p_reader->listen_fd = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+  if( p_reader->listen_fd < 0 ||
+      bind( p_reader->listen_fd,
+            ( struct sockaddr* ) &( p_reader->address ),
+            sizeof p_reader->address ) != 0 ||
+      listen( p_reader->listen_fd, CSENDER_SHM_MAX_WRITERS ) != 0 )
+  {
+    perror( "It was not possible to listen for writers" );
+    if( p_reader->listen_fd >= 0 )
+    {
+      close( p_reader->listen_fd );
+    }
+    free( p_reader );
+    return NULL;
+  }
+
+  return p_reader;
+}
+
+
+int csender_shm_reader_start( struct csender_shm_reader* ap_reader )
+{
+  if( pthread_create( &( ap_reader->accept_thread ),
+                      NULL,
+                      accept_main,
+                      ap_reader ) != 0 )
+  {
+    return -1;
+  }
+
+  ap_reader->accept_thread_started = true;
+
+  return 0;
+}
+
+
+void csender_shm_reader_stats(
+    const struct csender_shm_reader* ap_reader,
+    struct csender_shm_reader_stats* ap_output_stats )
+{
+  memset( ap_output_stats, 0, sizeof *ap_output_stats );
+
+  int num_lanes = atomic_load_explicit( &( ap_reader->num_lanes ),
+                                        memory_order_acquire );
+  for( int i = 0; i < num_lanes; i++ )
+  {
+    if( atomic_load( &( ap_reader->lanes[ i ].connected ) ) )
+    {
+      ap_output_stats->num_writers++;
+    }
+  }
+
+  ap_output_stats->num_events_read =
+      atomic_load_explicit( &( ap_reader->num_events_read ),
+                            memory_order_relaxed );
+  ap_output_stats->num_bytes_read =
+      atomic_load_explicit( &( ap_reader->num_bytes_read ),
+                            memory_order_relaxed );
+}
+
+
+void csender_shm_reader_destroy( struct csender_shm_reader* ap_reader )
+{
+  if( ap_reader == NULL )
+  {
+    return;
+  }
+
+  // Lanes are only taken by the accept thread, so they are all known once it
+  // is gone
+  atomic_store( &( ap_reader->stop_requested ), true );
+  if( ap_reader->accept_thread_started )
+  {
+    pthread_join( ap_reader->accept_thread, NULL );
+  }
+
+  int num_lanes = atomic_load( &( ap_reader->num_lanes ) );
+  for( int i = 0; i < num_lanes; i++ )
+  {
+    if( ap_reader->lanes[ i ].started )
+    {
+      stop_lane( &( ap_reader->lanes[ i ] ) );
+    }
+  }
+
+  close( ap_reader->listen_fd );
+  unlink( ap_reader->address.sun_path );
+  free( ap_reader );
+}
@@ -0,0 +1,428 @@
+#define _GNU_SOURCE                     // memfd_create()
+
+#include "shm_ring.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SHM_RING_MAGIC 0x63736872     // "cshr"
+#define SHM_RING_VERSION 1
+
+// The bytes start past the header, on a page of their own
+#define SHM_RING_DATA_OFFSET 4096
+#define SHM_RING_MIN_LENGTH 4096
+#define CACHE_LINE_LENGTH 64
+
+// File descriptors that make up a ring, in the order they are passed
+enum shm_ring_fd
+{
+  SHM_RING_FD_MEMORY,
+  SHM_RING_FD_DATA,           // Written by the writer, to wake the reader up
+  SHM_RING_FD_SPACE,          // Written by the reader, to wake the writer up
+  SHM_RING_NUM_FDS
+};
+
+// At the start of the shared memory. Each side writes a cache line of its
+// own.
+struct shm_ring_header
+{
+  uint32_t   magic;
+  uint32_t   version;
+  uint64_t   length;
+
+  _Alignas( CACHE_LINE_LENGTH ) _Atomic uint64_t   head;  // Bytes written
+  _Atomic uint32_t                                 writer_waiting;
+
+  _Alignas( CACHE_LINE_LENGTH ) _Atomic uint64_t   tail;  // Bytes read
+  _Atomic uint32_t                                 reader_waiting;
+};
+
+struct shm_ring
+{
+  int                        fds[ SHM_RING_NUM_FDS ];
+  struct shm_ring_header*    p_header;
+  char*                      p_data;
+  size_t                     length;
+  size_t                     mapping_length;
+};
+
+
+static struct shm_ring* new_ring( )
+{
+  struct shm_ring* p_ring = calloc( 1, sizeof *p_ring );
+  if( p_ring != NULL )
+  {
+    for( int i = 0; i < SHM_RING_NUM_FDS; i++ )
+    {
+      p_ring->fds[ i ] = -1;
+    }
+  }
+
+  return p_ring;
+}
+
+
+static bool map_ring( struct shm_ring* ap_ring, size_t a_mapping_length )
+{
+  void* p_mapping = mmap( NULL,
+                          a_mapping_length,
+                          PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE,
+                          ap_ring->fds[ SHM_RING_FD_MEMORY ],
+                          0 );
+  if( p_mapping == MAP_FAILED )
+  {
+    return false;
+  }
+
+  ap_ring->p_header = p_mapping;
+  ap_ring->p_data = ( char* ) p_mapping + SHM_RING_DATA_OFFSET;
+  ap_ring->mapping_length = a_mapping_length;
+  ap_ring->length = a_mapping_length - SHM_RING_DATA_OFFSET;
+
+  return true;
+}
+
+
+struct shm_ring* shm_ring_create( size_t a_length )
+{
+  size_t length = SHM_RING_MIN_LENGTH;
+  while( length < a_length )
+  {
+    length *= 2;
+  }
+
+  struct shm_ring* p_ring = new_ring( );
+  if( p_ring == NULL )
+  {
+    return NULL;
+  }
+
+  p_ring->fds[ SHM_RING_FD_MEMORY ] = memfd_create( "csender-ring",
+                                                    MFD_CLOEXEC );
+  p_ring->fds[ SHM_RING_FD_DATA ] = eventfd( 0, EFD_CLOEXEC );
+  p_ring->fds[ SHM_RING_FD_SPACE ] = eventfd( 0, EFD_CLOEXEC );
+  if( p_ring->fds[ SHM_RING_FD_MEMORY ] < 0 ||
+      p_ring->fds[ SHM_RING_FD_DATA ] < 0 ||
+      p_ring->fds[ SHM_RING_FD_SPACE ] < 0 ||
+      ftruncate( p_ring->fds[ SHM_RING_FD_MEMORY ],
+                 SHM_RING_DATA_OFFSET + length ) != 0 ||
+      !map_ring( p_ring, SHM_RING_DATA_OFFSET + length ) )
+  {
+    int create_errno = errno;
+    shm_ring_destroy( p_ring );
+    errno = create_errno;
+    return NULL;
+  }
+
+  // A new memfd is all zeros
+  p_ring->p_header->magic = SHM_RING_MAGIC;
+  p_ring->p_header->version = SHM_RING_VERSION;
+  p_ring->p_header->length = length;
+
+  return p_ring;
+}
+
+
+int shm_ring_send( const struct shm_ring* ap_ring, int a_socket_fd )
+{
+  char byte = 0;
+  struct iovec buffer = { &byte, 1 };
+  char control[ CMSG_SPACE( sizeof ap_ring->fds ) ];
+  memset( control, 0, sizeof control );
+
+  struct msghdr message;
+  memset( &message, 0, sizeof message );
+  message.msg_iov = &buffer;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof control;
+
+  struct cmsghdr* p_control_message = CMSG_FIRSTHDR( &message );
+  p_control_message->cmsg_level = SOL_SOCKET;
+  p_control_message->cmsg_type = SCM_RIGHTS;
+  p_control_message->cmsg_len = CMSG_LEN( sizeof ap_ring->fds );
+  memcpy( CMSG_DATA( p_control_message ), ap_ring->fds, sizeof ap_ring->fds );
+
+  return ( sendmsg( a_socket_fd, &message, MSG_NOSIGNAL ) == 1 ) ? 0 : -1;
+}
+
+
+struct shm_ring* shm_ring_receive( int a_socket_fd )
+{
+  struct shm_ring* p_ring = new_ring( );
+  if( p_ring == NULL )
+  {
+    return NULL;
+  }
+
+  char byte;
+  struct iovec buffer = { &byte, 1 };
+  char control[ CMSG_SPACE( sizeof p_ring->fds ) ];
+  memset( control, 0, sizeof control );
+
+  struct msghdr message;
+  memset( &message, 0, sizeof message );
+  message.msg_iov = &buffer;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof control;
+
+  ssize_t num_bytes_received;
+  do
+  {
+    num_bytes_received = recvmsg( a_socket_fd, &message, MSG_CMSG_CLOEXEC );
+  }
+  while( num_bytes_received < 0 && errno == EINTR );
+
+  struct cmsghdr* p_control_message = CMSG_FIRSTHDR( &message );
+  if( num_bytes_received == 1 &&
+      p_control_message != NULL &&
+      p_control_message->cmsg_level == SOL_SOCKET &&
+      p_control_message->cmsg_type == SCM_RIGHTS &&
+      p_control_message->cmsg_len == CMSG_LEN( sizeof p_ring->fds ) )
+  {
+    memcpy( p_ring->fds, CMSG_DATA( p_control_message ), sizeof p_ring->fds );
+  }
+
+  // The length is that of the memfd, which the header has to agree with
+  struct stat memory_status;
+  if( p_ring->fds[ SHM_RING_FD_MEMORY ] < 0 ||
+      fstat( p_ring->fds[ SHM_RING_FD_MEMORY ], &memory_status ) != 0 ||
+      memory_status.st_size < SHM_RING_DATA_OFFSET + SHM_RING_MIN_LENGTH ||
+      !map_ring( p_ring, memory_status.st_size ) ||
+      p_ring->p_header->magic != SHM_RING_MAGIC ||
+      p_ring->p_header->version != SHM_RING_VERSION ||
+      p_ring->p_header->length != p_ring->length ||
+      ( p_ring->length & ( p_ring->length - 1 ) ) != 0 )
+  {
+    shm_ring_destroy( p_ring );
+    errno = EPROTO;
+    return NULL;
+  }
+
+  return p_ring;
+}
+
+
+// Waits for the given eventfd to be written, and resets it. Returns 1 if it
+// was, 0 if it was not in time, or -1 if the peer went away (its socket ends,
+// as nothing is ever sent through it once the ring is passed).
+static int wait_for_event( int a_event_fd, int a_peer_fd, int a_timeout_ms )
+{
+  struct pollfd fds[ 2 ] =
+  {
+    { a_event_fd, POLLIN, 0 },
+    { a_peer_fd, POLLIN, 0 }
+  };
+  if( poll( fds, 2, a_timeout_ms ) < 0 )
+  {
+    return ( errno == EINTR ) ? 0 : -1;
+  }
+
+  if( fds[ 0 ].revents & POLLIN )
+  {
+    uint64_t count;
+    if( read( a_event_fd, &count, sizeof count ) < 0 && errno != EAGAIN )
+    {
+      return -1;
+    }
+
+    return 1;
+  }
+
+  return ( fds[ 1 ].revents != 0 ) ? -1 : 0;
+}
+
+
+// Makes the bytes written so far visible, and wakes the reader up if it is
+// waiting for them. Returns the no. of system calls it took.
+static int publish( struct shm_ring* ap_ring, uint64_t a_head )
+{
+  // Sequentially consistent, as is the reader's flag, so that either the
+  // reader sees the bytes, or the writer sees it waiting
+  atomic_store( &( ap_ring->p_header->head ), a_head );
+  if( atomic_load( &( ap_ring->p_header->reader_waiting ) ) == 0 )
+  {
+    return 0;
+  }
+
+  // Only fails if the counter overflowed, when the reader is due anyway
+  uint64_t one = 1;
+  ssize_t num_bytes_written = write( ap_ring->fds[ SHM_RING_FD_DATA ],
+                                     &one,
+                                     sizeof one );
+  ( void ) num_bytes_written;
+
+  return 1;
+}
+
+
+int shm_ring_write( struct shm_ring* ap_ring,
+                    const struct iovec* ap_buffers,
+                    int a_num_buffers,
+                    int a_peer_fd )
+{
+  struct shm_ring_header* p_header = ap_ring->p_header;
+  size_t mask = ap_ring->length - 1;
+  uint64_t head = atomic_load_explicit( &( p_header->head ),
+                                        memory_order_relaxed );
+  uint64_t tail = atomic_load_explicit( &( p_header->tail ),
+                                        memory_order_acquire );
+
+  int num_calls = 0;
+  for( int i = 0; i < a_num_buffers; i++ )
+  {
+    const char* p_bytes = ap_buffers[ i ].iov_base;
+    size_t num_bytes_left = ap_buffers[ i ].iov_len;
+    while( num_bytes_left > 0 )
+    {
+      size_t room = ap_ring->length - ( size_t ) ( head - tail );
+      if( room == 0 )
+      {
+        // Full: hand over what is there, and wait for the reader to take it
+        num_calls += publish( ap_ring, head );
+        atomic_store( &( p_header->writer_waiting ), 1 );
+        tail = atomic_load( &( p_header->tail ) );
+        while( head - tail == ap_ring->length )
+        {
+          num_calls += 2;
+          if( wait_for_event( ap_ring->fds[ SHM_RING_FD_SPACE ],
+                              a_peer_fd,
+                              -1 ) < 0 )
+          {
+            atomic_store( &( p_header->writer_waiting ), 0 );
+            errno = EPIPE;
+            return -1;
+          }
+          tail = atomic_load( &( p_header->tail ) );
+        }
+        atomic_store( &( p_header->writer_waiting ), 0 );
+        continue;
+      }
+
+      // It may wrap around the end
+      size_t length = ( num_bytes_left < room ) ? num_bytes_left : room;
+      size_t offset = head & mask;
+      size_t first_length = ap_ring->length - offset;
+      if( first_length > length )
+      {
+        first_length = length;
+      }
+      memcpy( ap_ring->p_data + offset, p_bytes, first_length );
+      memcpy( ap_ring->p_data, p_bytes + first_length, length - first_length );
+
+      head += length;
+      p_bytes += length;
+      num_bytes_left -= length;
+    }
+  }
+
+  return num_calls + publish( ap_ring, head );
+}
+
+
+long shm_ring_read_begin( struct shm_ring* ap_ring,
+                          const char** ap_output_data,
+                          int a_peer_fd,
+                          int a_timeout_ms )
+{
+  struct shm_ring_header* p_header = ap_ring->p_header;
+  uint64_t tail = atomic_load_explicit( &( p_header->tail ),
+                                        memory_order_relaxed );
+  uint64_t head = atomic_load_explicit( &( p_header->head ),
+                                        memory_order_acquire );
+  if( head == tail )
+  {
+    // Empty: say so, and check again before waiting, as in publish()
+    atomic_store( &( p_header->reader_waiting ), 1 );
+    head = atomic_load( &( p_header->head ) );
+    int woken = 1;
+    if( head == tail )
+    {
+      woken = wait_for_event( ap_ring->fds[ SHM_RING_FD_DATA ],
+                              a_peer_fd,
+                              a_timeout_ms );
+      head = atomic_load( &( p_header->head ) );
+    }
+    atomic_store( &( p_header->reader_waiting ), 0 );
+
+    if( head == tail )
+    {
+      return ( woken < 0 ) ? -1 : 0;
+    }
+  }
+
+  size_t offset = tail & ( ap_ring->length - 1 );
+  size_t length = head - tail;
+  if( length > ap_ring->length - offset )
+  {
+    length = ap_ring->length - offset;
+  }
+  *ap_output_data = ap_ring->p_data + offset;
+
+  return ( long ) length;
+}
+
+
+void shm_ring_read_end( struct shm_ring* ap_ring, size_t a_length )
+{
+  struct shm_ring_header* p_header = ap_ring->p_header;
+  uint64_t tail = atomic_load_explicit( &( p_header->tail ),
+                                        memory_order_relaxed );
+
+  // Sequentially consistent, against the writer's flag
+  atomic_store( &( p_header->tail ), tail + a_length );
+  if( atomic_load( &( p_header->writer_waiting ) ) != 0 )
+  {
+    uint64_t one = 1;
+    ssize_t num_bytes_written = write( ap_ring->fds[ SHM_RING_FD_SPACE ],
+                                       &one,
+                                       sizeof one );
+    ( void ) num_bytes_written;
+  }
+}
+
+
+size_t shm_ring_pending_bytes( const struct shm_ring* ap_ring )
+{
+  uint64_t tail = atomic_load_explicit( &( ap_ring->p_header->tail ),
+                                        memory_order_acquire );
+  uint64_t head = atomic_load_explicit( &( ap_ring->p_header->head ),
+                                        memory_order_acquire );
+
+  return ( size_t ) ( head - tail );
+}
+
+
+void shm_ring_destroy( struct shm_ring* ap_ring )
+{
+  if( ap_ring == NULL )
+  {
+    return;
+  }
+
+  if( ap_ring->p_header != NULL )
+  {
+    munmap( ap_ring->p_header, ap_ring->mapping_length );
+  }
+  for( int i = 0; i < SHM_RING_NUM_FDS; i++ )
+  {
+    if( ap_ring->fds[ i ] >= 0 )
+    {
+      close( ap_ring->fds[ i ] );
+    }
+  }
+
+  free( ap_ring );
+}
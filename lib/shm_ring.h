@@ -0,0 +1,51 @@
+#ifndef CSENDER_SHM_RING_H
+#define CSENDER_SHM_RING_H
+
+#include <stddef.h>
+#include <sys/uio.h>
+
+// A single producer, single consumer ring of bytes in shared memory (a memfd),
+// for a writer and a reader on the same host. Each side only waits, on an
+// eventfd, when the ring is full (writer) or empty (reader), and is only woken
+// up by the other one if it said it was waiting. Both also watch a socket to
+// the other one, to notice it going away.
+struct shm_ring;
+
+// Reader side: a new, empty ring of the given no. of bytes (rounded up to a
+// power of two). Returns NULL, with errno set, on error.
+struct shm_ring* shm_ring_create( size_t a_length );
+
+// Reader side: passes the file descriptors of the ring to the writer, through
+// the given Unix socket. Returns 0 on success, or -1 with errno set.
+int shm_ring_send( const struct shm_ring* ap_ring, int a_socket_fd );
+
+// Writer side: maps the ring the reader passed through the given Unix
+// socket. Returns NULL, with errno set, if what came is not a ring.
+struct shm_ring* shm_ring_receive( int a_socket_fd );
+
+// Copies the buffers into the ring, waiting for room as needed. Returns the
+// no. of system calls it took (none, as long as there is room and the reader
+// is busy), or -1 with errno set to EPIPE if the reader went away.
+int shm_ring_write( struct shm_ring* ap_ring,
+                    const struct iovec* ap_buffers,
+                    int a_num_buffers,
+                    int a_peer_fd );
+
+// Waits up to the given time for bytes to read. Returns how many can be read
+// at once from *ap_output_data (the rest, past the end of the ring, come
+// next), 0 if none came in time, or -1 if the writer went away and none are
+// left.
+long shm_ring_read_begin( struct shm_ring* ap_ring,
+                          const char** ap_output_data,
+                          int a_peer_fd,
+                          int a_timeout_ms );
+
+// Gives the given no. of bytes read back to the writer
+void shm_ring_read_end( struct shm_ring* ap_ring, size_t a_length );
+
+// Bytes written but not read yet
+size_t shm_ring_pending_bytes( const struct shm_ring* ap_ring );
+
+void shm_ring_destroy( struct shm_ring* ap_ring );
+
+#endif
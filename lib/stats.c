@@ -0,0 +1,187 @@
+#include "csender.h"
+#include "histogram.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+struct csender_stats
+{
+  atomic_long   num_events_sent;
+  atomic_long   num_bytes_sent;
+  atomic_long   num_send_errors;
+  atomic_long   send_time_ns;
+  atomic_long   num_send_calls;
+  atomic_long   num_events_by_severity[ CSENDER_NUM_SEVERITIES ];
+  atomic_long   send_time_counts[ CSENDER_HISTOGRAM_NUM_BUCKETS ];
+  atomic_long   qdisc_time_counts[ CSENDER_HISTOGRAM_NUM_BUCKETS ];
+  atomic_long   ack_time_counts[ CSENDER_HISTOGRAM_NUM_BUCKETS ];
+};
+
+
+// Counters have a single writer, so a plain load and store (instead of a
+// locked read-modify-write) is enough to keep readers consistent.
+static inline void counter_add( atomic_long* ap_counter, long a_value )
+{
+  atomic_store_explicit(
+      ap_counter,
+      atomic_load_explicit( ap_counter, memory_order_relaxed ) + a_value,
+      memory_order_relaxed );
+}
+
+
+struct csender_stats* csender_stats_create( )
+{
+  struct csender_stats* p_stats = malloc( sizeof *p_stats );
+  if( p_stats != NULL )
+  {
+    atomic_init( &( p_stats->num_events_sent ), 0 );
+    atomic_init( &( p_stats->num_bytes_sent ), 0 );
+    atomic_init( &( p_stats->num_send_errors ), 0 );
+    atomic_init( &( p_stats->send_time_ns ), 0 );
+    atomic_init( &( p_stats->num_send_calls ), 0 );
+    for( int i = 0; i < CSENDER_NUM_SEVERITIES; i++ )
+    {
+      atomic_init( &( p_stats->num_events_by_severity[ i ] ), 0 );
+    }
+    for( int i = 0; i < CSENDER_HISTOGRAM_NUM_BUCKETS; i++ )
+    {
+      atomic_init( &( p_stats->send_time_counts[ i ] ), 0 );
+      atomic_init( &( p_stats->qdisc_time_counts[ i ] ), 0 );
+      atomic_init( &( p_stats->ack_time_counts[ i ] ), 0 );
+    }
+  }
+
+  return p_stats;
+}
+
+
+void csender_stats_destroy( struct csender_stats* ap_stats )
+{
+  free( ap_stats );
+}
+
+
+void csender_stats_add( struct csender_stats* ap_stats,
+                        long a_num_events,
+                        long a_num_bytes,
+                        long a_num_errors )
+{
+  counter_add( &( ap_stats->num_events_sent ), a_num_events );
+  counter_add( &( ap_stats->num_bytes_sent ), a_num_bytes );
+  if( a_num_errors != 0 )
+  {
+    counter_add( &( ap_stats->num_send_errors ), a_num_errors );
+  }
+}
+
+
+void csender_stats_count_severity( struct csender_stats* ap_stats,
+                                   int a_severity )
+{
+  counter_add( &( ap_stats->num_events_by_severity[ a_severity ] ), 1 );
+}
+
+
+void csender_stats_record_send_time( struct csender_stats* ap_stats,
+                                     uint64_t a_send_time_ns )
+{
+  counter_add( &( ap_stats->send_time_ns ), a_send_time_ns );
+  counter_add( &( ap_stats->send_time_counts[ histogram_bucket( a_send_time_ns ) ] ),
+               1 );
+}
+
+
+void csender_stats_count_send_calls( struct csender_stats* ap_stats,
+                                     long a_num_calls )
+{
+  counter_add( &( ap_stats->num_send_calls ), a_num_calls );
+}
+
+
+void csender_stats_record_tx_latency( struct csender_stats* ap_stats,
+                                      const struct csender_tx_latency* ap_latency )
+{
+  if( ap_latency->qdisc_ns >= 0 )
+  {
+    counter_add( &( ap_stats->qdisc_time_counts[
+                        histogram_bucket( ap_latency->qdisc_ns ) ] ),
+                 1 );
+  }
+  if( ap_latency->ack_ns >= 0 )
+  {
+    counter_add( &( ap_stats->ack_time_counts[
+                        histogram_bucket( ap_latency->ack_ns ) ] ),
+                 1 );
+  }
+}
+
+
+void csender_stats_snapshot( const struct csender_stats* ap_stats,
+                             struct csender_stats_snapshot* ap_output_snapshot )
+{
+  ap_output_snapshot->num_events_sent =
+      atomic_load_explicit( &( ap_stats->num_events_sent ),
+                            memory_order_relaxed );
+  ap_output_snapshot->num_bytes_sent =
+      atomic_load_explicit( &( ap_stats->num_bytes_sent ),
+                            memory_order_relaxed );
+  ap_output_snapshot->num_send_errors =
+      atomic_load_explicit( &( ap_stats->num_send_errors ),
+                            memory_order_relaxed );
+  ap_output_snapshot->send_time_ns =
+      atomic_load_explicit( &( ap_stats->send_time_ns ),
+                            memory_order_relaxed );
+  ap_output_snapshot->num_send_calls =
+      atomic_load_explicit( &( ap_stats->num_send_calls ),
+                            memory_order_relaxed );
+  for( int i = 0; i < CSENDER_NUM_SEVERITIES; i++ )
+  {
+    ap_output_snapshot->num_events_by_severity[ i ] =
+        atomic_load_explicit( &( ap_stats->num_events_by_severity[ i ] ),
+                              memory_order_relaxed );
+  }
+}
+
+
+static void add_counts( const atomic_long* ap_counts,
+                        struct csender_histogram* ap_io_histogram )
+{
+  for( int i = 0; i < CSENDER_HISTOGRAM_NUM_BUCKETS; i++ )
+  {
+    ap_io_histogram->counts[ i ] +=
+        atomic_load_explicit( &( ap_counts[ i ] ), memory_order_relaxed );
+  }
+}
+
+
+void csender_stats_send_times( const struct csender_stats* ap_stats,
+                               struct csender_histogram* ap_io_histogram )
+{
+  add_counts( ap_stats->send_time_counts, ap_io_histogram );
+}
+
+
+void csender_stats_tx_latencies( const struct csender_stats* ap_stats,
+                                 struct csender_histogram* ap_io_qdisc_times,
+                                 struct csender_histogram* ap_io_ack_times )
+{
+  add_counts( ap_stats->qdisc_time_counts, ap_io_qdisc_times );
+  add_counts( ap_stats->ack_time_counts, ap_io_ack_times );
+}
+
+
+void csender_stats_snapshot_accumulate(
+    struct csender_stats_snapshot* ap_total,
+    const struct csender_stats_snapshot* ap_snapshot )
+{
+  ap_total->num_events_sent += ap_snapshot->num_events_sent;
+  ap_total->num_bytes_sent += ap_snapshot->num_bytes_sent;
+  ap_total->num_send_errors += ap_snapshot->num_send_errors;
+  ap_total->send_time_ns += ap_snapshot->send_time_ns;
+  ap_total->num_send_calls += ap_snapshot->num_send_calls;
+  for( int i = 0; i < CSENDER_NUM_SEVERITIES; i++ )
+  {
+    ap_total->num_events_by_severity[ i ] +=
+        ap_snapshot->num_events_by_severity[ i ];
+  }
+}
@@ -0,0 +1,318 @@
+#include "structured.h"
+#include "format.h"
+#include "weights.h"
+
+#include <string.h>
+
+// Digits after the word of a key, when there are more keys than words
+#define KEY_SUFFIX_MAXLENGTH 6              // "_" + up to 5 digits
+
+// "123456.789"
+#define NUMBER_MAXLENGTH 10
+
+static const char* g_value_type_names[ CSENDER_NUM_VALUE_TYPES ] =
+{
+  "int", "float", "string", "bool"
+};
+
+
+bool csender_parse_value_types( const char* a_specification,
+                                unsigned int* ap_output_weights )
+{
+  return parse_weights( a_specification,
+                        g_value_type_names,
+                        CSENDER_NUM_VALUE_TYPES,
+                        ap_output_weights );
+}
+
+
+bool structured_schema_init( struct structured_schema* ap_schema,
+                             const struct csender_generator_options* ap_options )
+{
+  ap_schema->json = ( ap_options->body_kind == CSENDER_BODY_JSON );
+  ap_schema->num_fields = ap_options->num_fields;
+  ap_schema->num_keys = ( ap_options->num_keys > 0 ) ?
+                            ap_options->num_keys :
+                            ap_options->num_fields;
+  ap_schema->depth = ap_options->depth;
+  ap_schema->p_words = dictionary_builtin( );
+  if( ap_schema->p_words == NULL )
+  {
+    return false;
+  }
+
+  // Every field keeps the type of its value, as in real logs. Types are dealt
+  // to the fields in proportion to their weights, spread by a multiplicative
+  // hash of the field no., so that no type is left to the last fields.
+  unsigned int weights[ CSENDER_NUM_VALUE_TYPES ] = { 1, 1, 1, 1 };
+  if( !weights_all_zero( ap_options->value_type_weights,
+                         CSENDER_NUM_VALUE_TYPES ) )
+  {
+    memcpy( weights, ap_options->value_type_weights, sizeof weights );
+  }
+
+  uint64_t total_weight = 0;
+  for( int i = 0; i < CSENDER_NUM_VALUE_TYPES; i++ )
+  {
+    total_weight += weights[ i ];
+  }
+
+  for( unsigned int i = 0; i < CSENDER_MAX_BODY_FIELDS; i++ )
+  {
+    uint64_t position = ( i * 2654435761ULL ) % total_weight;
+    int type = 0;
+    while( position >= weights[ type ] )
+    {
+      position -= weights[ type ];
+      type++;
+    }
+    ap_schema->value_types[ i ] = ( uint8_t ) type;
+  }
+
+  size_t max_word_length = 0;
+  for( int i = 0; i < ap_schema->p_words->num_words; i++ )
+  {
+    if( ap_schema->p_words->p_lengths[ i ] > max_word_length )
+    {
+      max_word_length = ap_schema->p_words->p_lengths[ i ];
+    }
+  }
+
+  // Separator, key path (key-value bodies spell the keys of the enclosing
+  // objects), quotes and ':' or '=', and the longest value. Words are
+  // copied in blocks, which may go WORD_BLOCK_LENGTH beyond them.
+  size_t max_key_length = max_word_length + KEY_SUFFIX_MAXLENGTH;
+  size_t max_value_length = ( max_word_length + 2 > NUMBER_MAXLENGTH ) ?
+                                max_word_length + 2 :
+                                NUMBER_MAXLENGTH;
+  ap_schema->max_field_length = 1 +
+                                ( ap_schema->depth + 1 ) * max_key_length +
+                                3 + max_value_length + WORD_BLOCK_LENGTH;
+
+  return true;
+}
+
+
+// What a body is being written with
+struct structured_writer
+{
+  const struct structured_schema*   p_schema;
+  char*                             p_output;
+  const char*                       p_end;
+  uint64_t                          random_state;
+  unsigned int                      next_key;
+  bool                              first_pair;         // Key-value bodies
+  char                              key_path[ ( CSENDER_MAX_BODY_DEPTH ) *
+                                              ( DICTIONARY_WORD_MAXLENGTH +
+                                                KEY_SUFFIX_MAXLENGTH + 1 ) ];
+  size_t                            key_path_length;
+};
+
+
+static void write_word( struct structured_writer* ap_writer, int a_word )
+{
+  const struct csender_dictionary* p_words = ap_writer->p_schema->p_words;
+  size_t length = p_words->p_lengths[ a_word ];
+  const char* p_word = p_words->p_arena + p_words->p_offsets[ a_word ];
+
+  if( length <= WORD_BLOCK_LENGTH )
+  {
+    memcpy( ap_writer->p_output, p_word, WORD_BLOCK_LENGTH );
+  }
+  else
+  {
+    memcpy( ap_writer->p_output, p_word, length );
+  }
+
+  // Without its space
+  ap_writer->p_output += length - 1;
+}
+
+
+// Words of the dictionary in turn, then again with "_1", "_2"...
+static void write_key( struct structured_writer* ap_writer )
+{
+  unsigned int key = ap_writer->next_key++ % ap_writer->p_schema->num_keys;
+  int num_words = ap_writer->p_schema->p_words->num_words;
+
+  write_word( ap_writer, key % num_words );
+  if( key >= ( unsigned int ) num_words )
+  {
+    *ap_writer->p_output++ = '_';
+    ap_writer->p_output += format_u64( ap_writer->p_output, key / num_words );
+  }
+}
+
+
+static void write_value( struct structured_writer* ap_writer, int a_type )
+{
+  uint64_t random = random_next( &( ap_writer->random_state ) );
+  uint32_t number = ( uint32_t ) ( ( random >> 32 ) % 1000000 );
+
+  switch( a_type )
+  {
+    case CSENDER_VALUE_INT:
+    {
+      ap_writer->p_output += format_u64( ap_writer->p_output, number );
+      break;
+    }
+    case CSENDER_VALUE_FLOAT:
+    {
+      ap_writer->p_output += format_u64( ap_writer->p_output, number / 1000 );
+      *ap_writer->p_output++ = '.';
+      format_u64_fixed( ap_writer->p_output, number % 1000, 3 );
+      ap_writer->p_output += 3;
+      break;
+    }
+    case CSENDER_VALUE_STRING:
+    {
+      int word = dictionary_pick( ap_writer->p_schema->p_words,
+                                  ( uint32_t ) random );
+      if( ap_writer->p_schema->json )
+      {
+        *ap_writer->p_output++ = '"';
+        write_word( ap_writer, word );
+        *ap_writer->p_output++ = '"';
+      }
+      else
+      {
+        write_word( ap_writer, word );
+      }
+      break;
+    }
+    default:
+    {
+      if( random & 1 )
+      {
+        memcpy( ap_writer->p_output, "true", 4 );
+        ap_writer->p_output += 4;
+      }
+      else
+      {
+        memcpy( ap_writer->p_output, "false", 5 );
+        ap_writer->p_output += 5;
+      }
+      break;
+    }
+  }
+}
+
+
+// Fields of an object at the given level of nesting. The last one holds the
+// object of the next level, if any. Fields stop where the next one might not
+// fit, along with the braces left to close.
+static void write_fields( struct structured_writer* ap_writer,
+                          unsigned int a_level )
+{
+  const struct structured_schema* p_schema = ap_writer->p_schema;
+  size_t needed_length = p_schema->max_field_length +
+                         ( p_schema->json ? a_level + 1 : 0 );
+
+  for( unsigned int i = 0; i < p_schema->num_fields; i++ )
+  {
+    if( ( size_t ) ( ap_writer->p_end - ap_writer->p_output ) <
+        needed_length )
+    {
+      break;
+    }
+
+    bool nested = ( i == p_schema->num_fields - 1 &&
+                    a_level < p_schema->depth );
+
+    if( p_schema->json )
+    {
+      if( i > 0 )
+      {
+        *ap_writer->p_output++ = ',';
+      }
+      *ap_writer->p_output++ = '"';
+      write_key( ap_writer );
+      *ap_writer->p_output++ = '"';
+      *ap_writer->p_output++ = ':';
+
+      if( nested )
+      {
+        *ap_writer->p_output++ = '{';
+        write_fields( ap_writer, a_level + 1 );
+        *ap_writer->p_output++ = '}';
+      }
+      else
+      {
+        write_value( ap_writer, p_schema->value_types[ i ] );
+      }
+    }
+    else if( nested )
+    {
+      // Key-value bodies are flat: the fields of the nested object spell the
+      // path to it, as "outer.inner.key=value"
+      char* p_key_start = ap_writer->p_output;
+      write_key( ap_writer );
+      size_t key_length = ap_writer->p_output - p_key_start;
+      ap_writer->p_output = p_key_start;
+
+      size_t saved_length = ap_writer->key_path_length;
+      memcpy( ap_writer->key_path + saved_length, p_key_start, key_length );
+      ap_writer->key_path[ saved_length + key_length ] = '.';
+      ap_writer->key_path_length += key_length + 1;
+
+      write_fields( ap_writer, a_level + 1 );
+
+      ap_writer->key_path_length = saved_length;
+    }
+    else
+    {
+      if( !ap_writer->first_pair )
+      {
+        *ap_writer->p_output++ = ' ';
+      }
+      ap_writer->first_pair = false;
+
+      memcpy( ap_writer->p_output,
+              ap_writer->key_path,
+              ap_writer->key_path_length );
+      ap_writer->p_output += ap_writer->key_path_length;
+      write_key( ap_writer );
+      *ap_writer->p_output++ = '=';
+      write_value( ap_writer, p_schema->value_types[ i ] );
+    }
+  }
+}
+
+
+char* generate_structured_body( const struct structured_schema* ap_schema,
+                                char* a_output_body,
+                                const char* a_end,
+                                uint64_t* ap_io_random_state )
+{
+  struct structured_writer writer;
+  writer.p_schema = ap_schema;
+  writer.p_output = a_output_body;
+  writer.p_end = a_end;
+  writer.random_state = *ap_io_random_state;
+  writer.next_key = ( unsigned int ) ( random_next( &( writer.random_state ) ) %
+                                       ap_schema->num_keys );
+  writer.first_pair = true;
+  writer.key_path_length = 0;
+
+  if( ap_schema->json )
+  {
+    // Even "{}" needs room
+    if( a_end - a_output_body < 2 )
+    {
+      *ap_io_random_state = writer.random_state;
+      return a_output_body;
+    }
+
+    *writer.p_output++ = '{';
+    write_fields( &writer, 0 );
+    *writer.p_output++ = '}';
+  }
+  else
+  {
+    write_fields( &writer, 0 );
+  }
+
+  *ap_io_random_state = writer.random_state;
+
+  return writer.p_output;
+}
@@ -0,0 +1,37 @@
+#ifndef CSENDER_STRUCTURED_H
+#define CSENDER_STRUCTURED_H
+
+#include "csender.h"
+#include "dictionary.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The shape of key-value and JSON bodies, compiled once from the options: the
+// type of value of every field, and how long a field may take, so that
+// writing a body is a single pass over its fields with no other checks.
+struct structured_schema
+{
+  bool                              json;
+  unsigned int                      num_fields;
+  unsigned int                      num_keys;
+  unsigned int                      depth;
+  uint8_t                           value_types[ CSENDER_MAX_BODY_FIELDS ];
+  const struct csender_dictionary*  p_words;    // Of keys and string values
+  size_t                            max_field_length;
+};
+
+// Returns false if the built-in dictionary, which names the keys, could not be
+// built.
+bool structured_schema_init( struct structured_schema* ap_schema,
+                             const struct csender_generator_options* ap_options );
+
+// Writes a body of as many fields of the schema as fit before the given end,
+// and returns where it ends. Keys are drawn, in turn, from a random one.
+char* generate_structured_body( const struct structured_schema* ap_schema,
+                                char* a_output_body,
+                                const char* a_end,
+                                uint64_t* ap_io_random_state );
+
+#endif
@@ -0,0 +1,301 @@
+#include "timestamp.h"
+#include "clock.h"
+#include "format.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <cpuid.h>
+#include <x86intrin.h>
+#define CSENDER_HAS_TSC 1
+#else
+#define CSENDER_HAS_TSC 0
+#endif
+
+
+// Nanoseconds per TSC tick, shared by every context. 0 if the TSC cannot be
+// used as a clock.
+static double g_tsc_ns_per_tick = 0;
+static uint64_t g_tsc_ticks_per_second = 0;
+static pthread_once_t g_tsc_calibration_once = PTHREAD_ONCE_INIT;
+
+
+static void calibrate_tsc( )
+{
+#if CSENDER_HAS_TSC
+  // Only an invariant TSC ticks at a constant rate, whatever the power state
+  unsigned int eax, ebx, ecx, edx;
+  if( __get_cpuid( 0x80000007, &eax, &ebx, &ecx, &edx ) == 0 ||
+      ( edx & ( 1 << 8 ) ) == 0 )
+  {
+    return;
+  }
+
+  // Measure the TSC against the raw monotonic clock, for a few milliseconds
+  struct timespec start_time, end_time;
+  clock_gettime( CLOCK_MONOTONIC_RAW, &start_time );
+  uint64_t start_tsc = __rdtsc( );
+
+  struct timespec pause = { 0, 10000000 };
+  nanosleep( &pause, NULL );
+
+  clock_gettime( CLOCK_MONOTONIC_RAW, &end_time );
+  uint64_t end_tsc = __rdtsc( );
+
+  int64_t elapsed_ns =
+      ( end_time.tv_sec - start_time.tv_sec ) * NS_PER_SECOND +
+      ( end_time.tv_nsec - start_time.tv_nsec );
+
+  if( end_tsc > start_tsc && elapsed_ns > 0 )
+  {
+    g_tsc_ns_per_tick = ( double ) elapsed_ns / ( double ) ( end_tsc - start_tsc );
+    g_tsc_ticks_per_second = ( uint64_t ) ( NS_PER_SECOND / g_tsc_ns_per_tick );
+  }
+#endif
+}
+
+
+static int anchor_tsc( struct csender_timestamp_context* ap_context,
+                       struct timespec* ap_output_time )
+{
+  if( clock_gettime( CLOCK_REALTIME, ap_output_time ) != 0 )
+  {
+    return -1;
+  }
+
+#if CSENDER_HAS_TSC
+  ap_context->tsc_anchor = __rdtsc( );
+#endif
+  ap_context->tsc_anchor_ns =
+      ap_output_time->tv_sec * NS_PER_SECOND + ap_output_time->tv_nsec;
+
+  return 0;
+}
+
+
+static int read_clock( struct csender_timestamp_context* ap_context,
+                       struct timespec* ap_output_time )
+{
+  switch( ap_context->clock_source )
+  {
+    case CSENDER_CLOCK_REALTIME_COARSE:
+    {
+      return clock_gettime( CLOCK_REALTIME_COARSE, ap_output_time );
+    }
+    case CSENDER_CLOCK_SYNTHETIC:
+    {
+      *ap_output_time = ap_context->synthetic_time;
+
+      ap_context->synthetic_time.tv_nsec += 1000;
+      if( ap_context->synthetic_time.tv_nsec >= NS_PER_SECOND )
+      {
+        ap_context->synthetic_time.tv_sec++;
+        ap_context->synthetic_time.tv_nsec = 0;
+      }
+
+      return 0;
+    }
+    case CSENDER_CLOCK_TSC:
+    {
+#if CSENDER_HAS_TSC
+      // Extrapolate from the anchor. The wall clock is read again whenever the
+      // second changes, so the error never builds up beyond one second's drift.
+      uint64_t elapsed_ticks = __rdtsc( ) - ap_context->tsc_anchor;
+      if( ap_context->has_cached_second &&
+          elapsed_ticks < g_tsc_ticks_per_second )
+      {
+        int64_t now_ns = ap_context->tsc_anchor_ns +
+                         ( int64_t ) ( elapsed_ticks * g_tsc_ns_per_tick );
+        time_t now_second = now_ns / NS_PER_SECOND;
+
+        if( now_second == ap_context->cached_second )
+        {
+          ap_output_time->tv_sec = now_second;
+          ap_output_time->tv_nsec = now_ns % NS_PER_SECOND;
+          return 0;
+        }
+      }
+#endif
+      return anchor_tsc( ap_context, ap_output_time );
+    }
+    case CSENDER_CLOCK_REALTIME:
+    default:
+    {
+      return clock_gettime( CLOCK_REALTIME, ap_output_time );
+    }
+  }
+}
+
+
+// Writes "Z" in UTC, or the "+hh:mm" offset of the given local time
+static size_t format_timezone_suffix( enum csender_timezone a_timezone,
+                                      const struct tm* ap_time,
+                                      char* a_output_suffix )
+{
+  if( a_timezone == CSENDER_TIMEZONE_UTC )
+  {
+    a_output_suffix[ 0 ] = 'Z';
+    a_output_suffix[ 1 ] = '\0';
+    return 1;
+  }
+
+  long offset_minutes = ap_time->tm_gmtoff / 60;
+  a_output_suffix[ 0 ] = ( offset_minutes < 0 ) ? '-' : '+';
+  if( offset_minutes < 0 )
+  {
+    offset_minutes = -offset_minutes;
+  }
+
+  format_u64_fixed( &( a_output_suffix[ 1 ] ), offset_minutes / 60, 2 );
+  a_output_suffix[ 3 ] = ':';
+  format_u64_fixed( &( a_output_suffix[ 4 ] ), offset_minutes % 60, 2 );
+  a_output_suffix[ 6 ] = '\0';
+
+  return 6;
+}
+
+
+size_t timestamp_length( enum csender_timezone a_timezone )
+{
+  return TIMESTAMP_PREFIX_LENGTH + TIMESTAMP_MICROSECONDS_LENGTH +
+         ( ( a_timezone == CSENDER_TIMEZONE_UTC ) ? 1 : 6 );
+}
+
+
+void timestamp_context_init( struct csender_timestamp_context* ap_context,
+                             enum csender_clock_source a_clock_source,
+                             enum csender_timezone a_timezone )
+{
+  memset( ap_context, 0, sizeof *ap_context );
+
+  // localtime_r() is not required to load the time zone by itself
+  tzset( );
+
+  if( a_clock_source == CSENDER_CLOCK_TSC )
+  {
+    pthread_once( &g_tsc_calibration_once, calibrate_tsc );
+    if( g_tsc_ns_per_tick == 0 )
+    {
+      a_clock_source = CSENDER_CLOCK_REALTIME;
+    }
+  }
+
+  ap_context->clock_source = a_clock_source;
+  ap_context->timezone = a_timezone;
+  ap_context->synthetic_time.tv_sec = CSENDER_SYNTHETIC_CLOCK_START;
+  ap_context->synthetic_time.tv_nsec = 0;
+  ap_context->has_cached_second = false;
+}
+
+
+struct csender_timestamp_context* csender_timestamp_context_create(
+    enum csender_clock_source a_clock_source,
+    enum csender_timezone a_timezone )
+{
+  struct csender_timestamp_context* p_context = malloc( sizeof *p_context );
+  if( p_context != NULL )
+  {
+    timestamp_context_init( p_context, a_clock_source, a_timezone );
+  }
+
+  return p_context;
+}
+
+
+void csender_timestamp_context_destroy(
+    struct csender_timestamp_context* ap_context )
+{
+  free( ap_context );
+}
+
+
+enum csender_clock_source csender_timestamp_context_clock_source(
+    const struct csender_timestamp_context* ap_context )
+{
+  return ap_context->clock_source;
+}
+
+
+int csender_timestamp_rfc3339_at( struct csender_timestamp_context* ap_context,
+                                  const struct timespec* ap_time,
+                                  char* a_output_buffer,
+                                  bool* ap_output_second_changed )
+{
+  bool second_changed = false;
+
+  // Format the date and time, and find out the offset from UTC, only when the
+  // second changes. Any DST transition is picked up right at that moment.
+  if( !ap_context->has_cached_second ||
+      ap_context->cached_second != ap_time->tv_sec )
+  {
+    // Load a tm struct with those seconds
+    struct tm time;
+    struct tm* p_time =
+        ( ap_context->timezone == CSENDER_TIMEZONE_UTC ) ?
+            gmtime_r( &( ap_time->tv_sec ), &time ) :
+            localtime_r( &( ap_time->tv_sec ), &time );
+    if( p_time == NULL )
+    {
+      return -1;
+    }
+
+    // Years beyond 9999 would not fit
+    if( strftime( ap_context->cached_prefix,
+                  sizeof ap_context->cached_prefix,
+                  "%FT%T.",
+                  &time ) != TIMESTAMP_PREFIX_LENGTH )
+    {
+      return -1;
+    }
+
+    ap_context->cached_suffix_length =
+        format_timezone_suffix( ap_context->timezone,
+                                &time,
+                                ap_context->cached_suffix );
+
+    second_changed = ap_context->has_cached_second;
+    ap_context->has_cached_second = true;
+    ap_context->cached_second = ap_time->tv_sec;
+  }
+
+  memcpy( a_output_buffer, ap_context->cached_prefix, TIMESTAMP_PREFIX_LENGTH );
+
+  // Add the number of microseconds into the second, zero-padded
+  format_microseconds( &( a_output_buffer[ TIMESTAMP_PREFIX_LENGTH ] ),
+                       ap_time->tv_nsec / 1000 );
+
+  // Then the time zone. Copying the whole (fixed-size) array, terminator
+  // included, is cheaper than a variable-length copy.
+  char* p_suffix = &( a_output_buffer[ TIMESTAMP_PREFIX_LENGTH +
+                                       TIMESTAMP_MICROSECONDS_LENGTH ] );
+  memcpy( p_suffix,
+          ap_context->cached_suffix,
+          sizeof ap_context->cached_suffix );
+
+  if( ap_output_second_changed != NULL )
+  {
+    *ap_output_second_changed = second_changed;
+  }
+
+  return TIMESTAMP_PREFIX_LENGTH + TIMESTAMP_MICROSECONDS_LENGTH +
+         ap_context->cached_suffix_length;
+}
+
+
+int csender_timestamp_rfc3339( struct csender_timestamp_context* ap_context,
+                               char* a_output_buffer,
+                               bool* ap_output_second_changed )
+{
+  struct timespec now;
+  if( read_clock( ap_context, &now ) != 0 )
+  {
+    return -1;
+  }
+
+  return csender_timestamp_rfc3339_at( ap_context,
+                                       &now,
+                                       a_output_buffer,
+                                       ap_output_second_changed );
+}
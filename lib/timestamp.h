@@ -0,0 +1,45 @@
+#ifndef CSENDER_TIMESTAMP_H
+#define CSENDER_TIMESTAMP_H
+
+#include "csender.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+// Length of the "YYYY-MM-DDTHH:MM:SS." part that changes once per second
+#define TIMESTAMP_PREFIX_LENGTH 20
+#define TIMESTAMP_MICROSECONDS_LENGTH 6
+#define TIMESTAMP_MAX_SUFFIX_LENGTH 6
+
+struct csender_timestamp_context
+{
+  enum csender_clock_source   clock_source;
+  enum csender_timezone       timezone;
+
+  // Formatted prefix of the last second seen, and the "Z" or "+hh:mm" suffix
+  // that goes after the microseconds
+  bool                        has_cached_second;
+  time_t                      cached_second;
+  char                        cached_prefix[ TIMESTAMP_PREFIX_LENGTH + 1 ];
+  char                        cached_suffix[ TIMESTAMP_MAX_SUFFIX_LENGTH + 1 ];
+  size_t                      cached_suffix_length;
+
+  // Next time given by the synthetic clock
+  struct timespec             synthetic_time;
+
+  // TSC anchor: a TSC reading, and the wall clock time it matched
+  uint64_t                    tsc_anchor;
+  int64_t                     tsc_anchor_ns;
+};
+
+// Initializes a context embedded in another struct. Falls back to
+// CSENDER_CLOCK_REALTIME when the requested source is not usable.
+void timestamp_context_init( struct csender_timestamp_context* ap_context,
+                             enum csender_clock_source a_clock_source,
+                             enum csender_timezone a_timezone );
+
+// Length of every timestamp written in the given time zone mode
+size_t timestamp_length( enum csender_timezone a_timezone );
+
+#endif
@@ -0,0 +1,972 @@
+#define _GNU_SOURCE                     // sendmmsg()
+
+#include "csender.h"
+#include "packet.h"
+#include "shm_ring.h"
+#include "tx_timestamps.h"
+#include "uring.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <linux/mptcp.h>
+#include <linux/sockios.h>
+#include <linux/tcp.h>
+#include <linux/udp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Most datagrams the kernel splits a UDP_SEGMENT send into, and room for all
+// of them within the largest datagram
+#define UDP_GSO_MAX_SEGMENTS 64
+#define UDP_GSO_MAX_LENGTH 65000
+
+struct csender_transport
+{
+  int                        socket_fd;
+  int                        socket_type;   // SOCK_STREAM or SOCK_DGRAM
+  char                       peer_address[ INET6_ADDRSTRLEN ];
+  enum csender_send_engine   engine;
+  struct uring*              p_uring;       // Just for CSENDER_ENGINE_IO_URING
+  struct packet_ring*        p_packet_ring; // Just for CSENDER_ENGINE_PACKET_RING
+  struct tx_timestamps*      p_tx_timestamps; // If sampling them
+  struct shm_ring*           p_shm_ring;    // Instead of sending through the
+                                            // socket, which then just tells
+                                            // if the reader went away
+  uint64_t                   num_bytes_sent;  // Offset in the stream, which
+                                              // the kernel tells events apart by
+};
+
+static const char* g_engine_names[ CSENDER_NUM_SEND_ENGINES ] =
+{
+  "send", "writev", "sendmmsg", "io_uring", "udp_gso", "packet_ring"
+};
+
+
+static void* get_in_addr( struct sockaddr* ap_socket_address )
+{
+  void* p_socket_address = ( void* ) ap_socket_address;
+
+  // IPv4 or IPv6?
+  if ( ap_socket_address->sa_family == AF_INET)
+  {
+    return &( ( ( struct sockaddr_in* ) p_socket_address )->sin_addr );
+  }
+
+  return &( ( ( struct sockaddr_in6* ) p_socket_address )->sin6_addr );
+}
+
+
+// Sockets are created with the protocol of every item, unless another one
+// is given (such as IPPROTO_MPTCP), which falls back to the item's own if the
+// kernel does not offer it.
+static int create_socket_and_connect_from_info_list(
+    const struct addrinfo* ap_list,
+    int a_protocol,
+    char* a_output_peer_address )
+{
+  int socket_fd_to_return = -1;
+
+  // Traverse the given items, creating sockets based on them. Connect to the
+  // first one that can be created.
+  const struct addrinfo* p_current_addrinfo = NULL;
+  for( p_current_addrinfo = ap_list;
+       p_current_addrinfo != NULL;
+       p_current_addrinfo = p_current_addrinfo->ai_next )
+  {
+    socket_fd_to_return =
+        socket( p_current_addrinfo->ai_family,
+                p_current_addrinfo->ai_socktype,
+                ( a_protocol != 0 ) ? a_protocol :
+                                      p_current_addrinfo->ai_protocol );
+
+    // Not built in, or disabled (net.mptcp.enabled)
+    if( socket_fd_to_return == -1 &&
+        a_protocol != 0 &&
+        ( errno == EPROTONOSUPPORT || errno == ENOPROTOOPT ||
+          errno == EINVAL ) )
+    {
+      perror( "MPTCP is not available, falling back to TCP" );
+      a_protocol = 0;
+      socket_fd_to_return =
+          socket( p_current_addrinfo->ai_family,
+                  p_current_addrinfo->ai_socktype,
+                  p_current_addrinfo->ai_protocol );
+    }
+
+    if( socket_fd_to_return != -1 )
+    {
+      if( connect( socket_fd_to_return,
+                   p_current_addrinfo->ai_addr,
+                   p_current_addrinfo->ai_addrlen) != -1 )
+      {
+        // Keep the address the connection has been established with
+        inet_ntop( p_current_addrinfo->ai_family,
+                   get_in_addr( (struct sockaddr *)p_current_addrinfo->ai_addr),
+                   a_output_peer_address,
+                   INET6_ADDRSTRLEN );
+
+        // Just abandon the loop, once the socket has been created and
+        // connected.
+        break;
+      }
+      else
+      {
+        perror( "It was not possible to connect to the specified target" );
+        close( socket_fd_to_return );
+        socket_fd_to_return = -1;
+      }
+    }
+    else
+    {
+      perror( "Error while creating socket" );
+    }
+  }
+
+  return socket_fd_to_return;
+}
+
+
+static int create_socket_and_connect( const char* a_target_name,
+                                      const char* a_service_name,
+                                      int a_socket_type,
+                                      int a_protocol,
+                                      char* a_output_peer_address )
+{
+  int socket_fd_to_return = -1;
+
+  // Create a 'hints' struct, in order to specify which connection endtype is
+  // wanted.
+  struct addrinfo hints;
+  memset( &hints, 0, sizeof hints );
+  hints.ai_family = AF_UNSPEC;     // Both IPv4 and IPv6 addresses are wanted
+  hints.ai_socktype = a_socket_type; // TCP or UDP socket
+
+  // Fetch addrinfo items, from the hints above and the server and service names
+  struct addrinfo* p_addrinfo_list = NULL;
+  int error_code = getaddrinfo( a_target_name,
+                                a_service_name,
+                                &hints,
+                                &p_addrinfo_list );
+
+  if( error_code == 0 && p_addrinfo_list != NULL )
+  {
+    // Actually create a socket, and connect it to the target
+    socket_fd_to_return =
+        create_socket_and_connect_from_info_list( p_addrinfo_list,
+                                                  a_protocol,
+                                                  a_output_peer_address );
+
+    // Free mem storing the addrinfo items
+    freeaddrinfo( p_addrinfo_list );
+  }
+  else
+  {
+    fprintf( stderr,
+             "Error on getaddrinfo(): %s\n",
+             gai_strerror( error_code));
+  }
+
+  return socket_fd_to_return;
+}
+
+
+static struct csender_transport* new_transport( int a_socket_type )
+{
+  struct csender_transport* p_transport = malloc( sizeof *p_transport );
+  if( p_transport != NULL )
+  {
+    p_transport->socket_fd = -1;
+    p_transport->peer_address[ 0 ] = '\0';
+    p_transport->socket_type = a_socket_type;
+    p_transport->engine = CSENDER_ENGINE_SEND;
+    p_transport->p_uring = NULL;
+    p_transport->p_packet_ring = NULL;
+    p_transport->p_tx_timestamps = NULL;
+    p_transport->p_shm_ring = NULL;
+    p_transport->num_bytes_sent = 0;
+  }
+
+  return p_transport;
+}
+
+
+static struct csender_transport* connect_transport( const char* a_target_name,
+                                                    const char* a_service_name,
+                                                    int a_socket_type,
+                                                    int a_protocol )
+{
+  struct csender_transport* p_transport = new_transport( a_socket_type );
+  if( p_transport != NULL )
+  {
+    p_transport->socket_fd =
+        create_socket_and_connect( a_target_name,
+                                   a_service_name,
+                                   a_socket_type,
+                                   a_protocol,
+                                   p_transport->peer_address );
+
+    if( p_transport->socket_fd == -1 )
+    {
+      free( p_transport );
+      p_transport = NULL;
+    }
+  }
+
+  return p_transport;
+}
+
+
+struct csender_transport* csender_transport_connect( const char* a_target_name,
+                                                     const char* a_service_name )
+{
+  return connect_transport( a_target_name, a_service_name, SOCK_STREAM, 0 );
+}
+
+
+struct csender_transport* csender_transport_connect_udp(
+    const char* a_target_name,
+    const char* a_service_name )
+{
+  return connect_transport( a_target_name, a_service_name, SOCK_DGRAM, 0 );
+}
+
+
+struct csender_transport* csender_transport_connect_mptcp(
+    const char* a_target_name,
+    const char* a_service_name )
+{
+  return connect_transport( a_target_name,
+                            a_service_name,
+                            SOCK_STREAM,
+                            IPPROTO_MPTCP );
+}
+
+
+struct csender_transport* csender_transport_connect_shm(
+    const char* a_socket_path )
+{
+  struct sockaddr_un address;
+  memset( &address, 0, sizeof address );
+  address.sun_family = AF_UNIX;
+  if( strlen( a_socket_path ) >= sizeof address.sun_path )
+  {
+    fprintf( stderr, "The socket path %s is too long.\n", a_socket_path );
+    return NULL;
+  }
+  strcpy( address.sun_path, a_socket_path );
+
+  struct csender_transport* p_transport = new_transport( SOCK_STREAM );
+  if( p_transport == NULL )
+  {
+    return NULL;
+  }
+
+  p_transport->socket_fd = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+  if( p_transport->socket_fd == -1 ||
+      connect( p_transport->socket_fd,
+               ( struct sockaddr* ) &address,
+               sizeof address ) != 0 )
+  {
+    perror( "It was not possible to connect to the shared memory reader" );
+    csender_transport_close( p_transport );
+    return NULL;
+  }
+
+  p_transport->p_shm_ring = shm_ring_receive( p_transport->socket_fd );
+  if( p_transport->p_shm_ring == NULL )
+  {
+    perror( "It was not possible to map the ring of the reader" );
+    csender_transport_close( p_transport );
+    return NULL;
+  }
+
+  // As much of the path as fits, for messages
+  snprintf( p_transport->peer_address,
+            sizeof p_transport->peer_address,
+            "%s",
+            a_socket_path );
+
+  return p_transport;
+}
+
+
+// send() may take just a part of the buffer; keep on until all of it is gone
+static int send_all( int a_socket_fd, const char* a_data, size_t a_length )
+{
+  int num_calls = 0;
+  while( a_length > 0 )
+  {
+    ssize_t num_bytes_sent = send( a_socket_fd,
+                                   a_data,
+                                   a_length,
+                                   MSG_NOSIGNAL );
+    num_calls++;
+    if( num_bytes_sent < 0 )
+    {
+      if( errno == EINTR )
+      {
+        continue;
+      }
+
+      return -1;
+    }
+
+    a_data += num_bytes_sent;
+    a_length -= num_bytes_sent;
+  }
+
+  return num_calls;
+}
+
+
+int csender_transport_send( struct csender_transport* ap_transport,
+                            const char* a_data,
+                            size_t a_length )
+{
+  int num_calls;
+  if( ap_transport->p_shm_ring != NULL )
+  {
+    struct iovec buffer = { ( void* ) a_data, a_length };
+    num_calls = shm_ring_write( ap_transport->p_shm_ring,
+                                &buffer,
+                                1,
+                                ap_transport->socket_fd );
+  }
+  else
+  {
+    num_calls = send_all( ap_transport->socket_fd, a_data, a_length );
+  }
+
+  if( num_calls >= 0 )
+  {
+    ap_transport->num_bytes_sent += a_length;
+  }
+
+  return num_calls;
+}
+
+
+const char* csender_send_engine_name( enum csender_send_engine a_engine )
+{
+  return ( a_engine >= 0 && a_engine < CSENDER_NUM_SEND_ENGINES ) ?
+             g_engine_names[ a_engine ] :
+             NULL;
+}
+
+
+bool csender_parse_send_engine( const char* a_name,
+                                enum csender_send_engine* ap_output_engine )
+{
+  for( int i = 0; i < CSENDER_NUM_SEND_ENGINES; i++ )
+  {
+    if( strcmp( a_name, g_engine_names[ i ] ) == 0 )
+    {
+      *ap_output_engine = ( enum csender_send_engine ) i;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+int csender_transport_set_engine( struct csender_transport* ap_transport,
+                                  enum csender_send_engine a_engine )
+{
+  if( ap_transport->p_shm_ring != NULL )
+  {
+    if( a_engine != CSENDER_ENGINE_SEND )
+    {
+      fprintf( stderr,
+               "The shared memory ring takes whole batches, without an "
+               "engine.\n" );
+      return -1;
+    }
+
+    return 0;
+  }
+
+  bool udp = ( ap_transport->socket_type == SOCK_DGRAM );
+  if( a_engine == CSENDER_ENGINE_WRITEV && udp )
+  {
+    fprintf( stderr, "writev would send a batch of events as one datagram.\n" );
+    return -1;
+  }
+
+  if( a_engine == CSENDER_ENGINE_UDP_GSO )
+  {
+    if( !udp )
+    {
+      fprintf( stderr, "UDP GSO needs a UDP transport.\n" );
+      return -1;
+    }
+
+    // Kernels older than 4.18 do not know of it
+    int segment_length = 0;
+    socklen_t option_length = sizeof segment_length;
+    if( getsockopt( ap_transport->socket_fd,
+                    IPPROTO_UDP,
+                    UDP_SEGMENT,
+                    &segment_length,
+                    &option_length ) != 0 )
+    {
+      perror( "UDP GSO is not available, falling back to sendmmsg" );
+      a_engine = CSENDER_ENGINE_SENDMMSG;
+    }
+  }
+
+  if( a_engine == CSENDER_ENGINE_IO_URING && ap_transport->p_uring == NULL )
+  {
+    ap_transport->p_uring = uring_create( CSENDER_MAX_SEND_BATCH );
+    if( ap_transport->p_uring == NULL )
+    {
+      perror( "io_uring is not available" );
+      return -1;
+    }
+  }
+
+  if( a_engine == CSENDER_ENGINE_PACKET_RING &&
+      ap_transport->p_packet_ring == NULL )
+  {
+    if( !udp )
+    {
+      fprintf( stderr, "The packet ring needs a UDP transport.\n" );
+      return -1;
+    }
+
+    ap_transport->p_packet_ring = packet_ring_create( ap_transport->socket_fd );
+    if( ap_transport->p_packet_ring == NULL )
+    {
+      return -1;
+    }
+  }
+
+  ap_transport->engine = a_engine;
+
+  return 0;
+}
+
+
+// Skips the given no. of bytes of the events, from the first one left, and
+// moves it past those emptied
+static void skip_sent_bytes( struct iovec* ap_events,
+                             int a_num_events,
+                             size_t a_num_bytes,
+                             int* ap_io_first )
+{
+  int i = *ap_io_first;
+  while( i < a_num_events && a_num_bytes >= ap_events[ i ].iov_len )
+  {
+    a_num_bytes -= ap_events[ i ].iov_len;
+    i++;
+  }
+  if( i < a_num_events )
+  {
+    ap_events[ i ].iov_base = ( char* ) ap_events[ i ].iov_base + a_num_bytes;
+    ap_events[ i ].iov_len -= a_num_bytes;
+  }
+
+  *ap_io_first = i;
+}
+
+
+static int send_batch_writev( int a_socket_fd,
+                              struct iovec* ap_events,
+                              int a_num_events )
+{
+  // writev() may take just a part of the events; keep on with the rest
+  int num_calls = 0;
+  int first = 0;
+  while( first < a_num_events )
+  {
+    ssize_t num_bytes_sent = writev( a_socket_fd,
+                                     ap_events + first,
+                                     a_num_events - first );
+    num_calls++;
+    if( num_bytes_sent < 0 )
+    {
+      if( errno == EINTR )
+      {
+        continue;
+      }
+
+      return -1;
+    }
+
+    skip_sent_bytes( ap_events, a_num_events, num_bytes_sent, &first );
+  }
+
+  return num_calls;
+}
+
+
+static int send_batch_sendmmsg( int a_socket_fd,
+                                struct iovec* ap_events,
+                                int a_num_events )
+{
+  struct mmsghdr messages[ CSENDER_MAX_SEND_BATCH ];
+  memset( messages, 0, a_num_events * sizeof messages[ 0 ] );
+  for( int i = 0; i < a_num_events; i++ )
+  {
+    messages[ i ].msg_hdr.msg_iov = &( ap_events[ i ] );
+    messages[ i ].msg_hdr.msg_iovlen = 1;
+  }
+
+  // On a stream socket, the last message taken may only be taken in part
+  int num_calls = 0;
+  int first = 0;
+  while( first < a_num_events )
+  {
+    int num_messages_sent = sendmmsg( a_socket_fd,
+                                      messages + first,
+                                      a_num_events - first,
+                                      MSG_NOSIGNAL );
+    num_calls++;
+    if( num_messages_sent < 0 )
+    {
+      if( errno == EINTR )
+      {
+        continue;
+      }
+
+      return -1;
+    }
+
+    first += num_messages_sent - 1;
+    skip_sent_bytes( ap_events,
+                     a_num_events,
+                     messages[ first ].msg_len,
+                     &first );
+  }
+
+  return num_calls;
+}
+
+
+static int send_datagrams( int a_socket_fd,
+                           struct iovec* ap_events,
+                           int a_num_events,
+                           uint16_t a_segment_length )
+{
+  struct msghdr message;
+  memset( &message, 0, sizeof message );
+  message.msg_iov = ap_events;
+  message.msg_iovlen = a_num_events;
+
+  // The kernel cuts the payload into datagrams of the segment length
+  char control[ CMSG_SPACE( sizeof( uint16_t ) ) ];
+  if( a_num_events > 1 )
+  {
+    memset( control, 0, sizeof control );
+    message.msg_control = control;
+    message.msg_controllen = sizeof control;
+
+    struct cmsghdr* p_control_message = CMSG_FIRSTHDR( &message );
+    p_control_message->cmsg_level = IPPROTO_UDP;
+    p_control_message->cmsg_type = UDP_SEGMENT;
+    p_control_message->cmsg_len = CMSG_LEN( sizeof( uint16_t ) );
+    memcpy( CMSG_DATA( p_control_message ),
+            &a_segment_length,
+            sizeof a_segment_length );
+  }
+
+  ssize_t num_bytes_sent;
+  do
+  {
+    num_bytes_sent = sendmsg( a_socket_fd, &message, 0 );
+  }
+  while( num_bytes_sent < 0 && errno == EINTR );
+
+  return ( num_bytes_sent < 0 ) ? -1 : 0;
+}
+
+
+// Runs of events of the same length are sent with one system call, as
+// datagrams of their length. The last one of a run may be shorter.
+static int send_batch_udp_gso( struct csender_transport* ap_transport,
+                               struct iovec* ap_events,
+                               int a_num_events )
+{
+  int num_calls = 0;
+  int first = 0;
+  while( first < a_num_events )
+  {
+    size_t segment_length = ap_events[ first ].iov_len;
+    size_t run_length = segment_length;
+    int end = first + 1;
+    while( end < a_num_events &&
+           end - first < UDP_GSO_MAX_SEGMENTS &&
+           ap_events[ end ].iov_len <= segment_length &&
+           run_length + ap_events[ end ].iov_len <= UDP_GSO_MAX_LENGTH )
+    {
+      run_length += ap_events[ end ].iov_len;
+      end++;
+      if( ap_events[ end - 1 ].iov_len < segment_length )
+      {
+        break;
+      }
+    }
+
+    num_calls++;
+    if( send_datagrams( ap_transport->socket_fd,
+                        ap_events + first,
+                        end - first,
+                        ( uint16_t ) segment_length ) != 0 )
+    {
+      // Devices without checksum offload, or datagrams beyond the MTU, may
+      // not take it: go on without it
+      if( errno != EIO && errno != EINVAL )
+      {
+        return -1;
+      }
+
+      perror( "UDP GSO failed, falling back to sendmmsg" );
+      ap_transport->engine = CSENDER_ENGINE_SENDMMSG;
+      int num_fallback_calls = send_batch_sendmmsg( ap_transport->socket_fd,
+                                                    ap_events + first,
+                                                    a_num_events - first );
+
+      return ( num_fallback_calls < 0 ) ? -1 : num_calls + num_fallback_calls;
+    }
+
+    first = end;
+  }
+
+  return num_calls;
+}
+
+
+static int send_batch_with_engine( struct csender_transport* ap_transport,
+                                   struct iovec* ap_events,
+                                   int a_num_events )
+{
+  switch( ap_transport->engine )
+  {
+    case CSENDER_ENGINE_WRITEV:
+    {
+      return send_batch_writev( ap_transport->socket_fd,
+                                ap_events,
+                                a_num_events );
+    }
+    case CSENDER_ENGINE_SENDMMSG:
+    {
+      return send_batch_sendmmsg( ap_transport->socket_fd,
+                                  ap_events,
+                                  a_num_events );
+    }
+    case CSENDER_ENGINE_UDP_GSO:
+    {
+      return send_batch_udp_gso( ap_transport, ap_events, a_num_events );
+    }
+    case CSENDER_ENGINE_PACKET_RING:
+    {
+      return packet_ring_send_batch( ap_transport->p_packet_ring,
+                                     ap_events,
+                                     a_num_events );
+    }
+    case CSENDER_ENGINE_IO_URING:
+    {
+      return uring_send_batch( ap_transport->p_uring,
+                               ap_transport->socket_fd,
+                               ap_events,
+                               a_num_events );
+    }
+    default:
+    {
+      int num_calls = 0;
+      for( int i = 0; i < a_num_events; i++ )
+      {
+        int num_event_calls = send_all( ap_transport->socket_fd,
+                                        ap_events[ i ].iov_base,
+                                        ap_events[ i ].iov_len );
+        if( num_event_calls < 0 )
+        {
+          return -1;
+        }
+        num_calls += num_event_calls;
+      }
+
+      return num_calls;
+    }
+  }
+}
+
+
+int csender_transport_send_batch( struct csender_transport* ap_transport,
+                                  const struct iovec* ap_events,
+                                  int a_num_events )
+{
+  if( a_num_events <= 0 || a_num_events > CSENDER_MAX_SEND_BATCH )
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if( ap_transport->p_shm_ring != NULL )
+  {
+    return shm_ring_write( ap_transport->p_shm_ring,
+                           ap_events,
+                           a_num_events,
+                           ap_transport->socket_fd );
+  }
+
+  // Partial sends move the bases and lengths, on a copy
+  struct iovec events[ CSENDER_MAX_SEND_BATCH ];
+  memcpy( events, ap_events, a_num_events * sizeof events[ 0 ] );
+
+  size_t length = 0;
+  for( int i = 0; i < a_num_events; i++ )
+  {
+    length += events[ i ].iov_len;
+  }
+
+  // A sampled batch asks for the timestamps of its last byte, in the first
+  // call. The engine sends whatever that one leaves.
+  int num_calls = 0;
+  int first = 0;
+  if( ap_transport->p_tx_timestamps != NULL &&
+      tx_timestamps_due( ap_transport->p_tx_timestamps, a_num_events ) )
+  {
+    long num_bytes_sent = tx_timestamps_send( ap_transport->p_tx_timestamps,
+                                              events,
+                                              a_num_events,
+                                              ap_transport->num_bytes_sent,
+                                              &num_calls );
+    if( num_bytes_sent < 0 )
+    {
+      return -1;
+    }
+
+    skip_sent_bytes( events, a_num_events, num_bytes_sent, &first );
+  }
+
+  if( first < a_num_events )
+  {
+    int num_engine_calls = send_batch_with_engine( ap_transport,
+                                                   events + first,
+                                                   a_num_events - first );
+    if( num_engine_calls < 0 )
+    {
+      return -1;
+    }
+    num_calls += num_engine_calls;
+  }
+
+  ap_transport->num_bytes_sent += length;
+
+  return num_calls;
+}
+
+
+int csender_transport_enable_tx_timestamps(
+    struct csender_transport* ap_transport,
+    int a_sample_period )
+{
+  if( ap_transport->socket_type != SOCK_STREAM ||
+      ap_transport->p_shm_ring != NULL )
+  {
+    fprintf( stderr, "Kernel TX timestamps need a TCP transport.\n" );
+    return -1;
+  }
+
+  if( ap_transport->p_tx_timestamps == NULL )
+  {
+    ap_transport->p_tx_timestamps =
+        tx_timestamps_create( ap_transport->socket_fd, a_sample_period );
+    if( ap_transport->p_tx_timestamps == NULL )
+    {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+
+int csender_transport_tx_latencies( struct csender_transport* ap_transport,
+                                    struct csender_tx_latency* ap_output_latencies,
+                                    int a_max_latencies )
+{
+  if( ap_transport->p_tx_timestamps == NULL )
+  {
+    return 0;
+  }
+
+  return tx_timestamps_take( ap_transport->p_tx_timestamps,
+                             ap_output_latencies,
+                             a_max_latencies );
+}
+
+
+// "address:port", or "[address]:port" for IPv6
+static void format_endpoint( const struct sockaddr* ap_address,
+                             char* a_output_endpoint )
+{
+  char address[ INET6_ADDRSTRLEN ] = "?";
+  int port = 0;
+  if( ap_address->sa_family == AF_INET )
+  {
+    const struct sockaddr_in* p_address =
+        ( const struct sockaddr_in* ) ap_address;
+    inet_ntop( AF_INET, &( p_address->sin_addr ), address, sizeof address );
+    port = ntohs( p_address->sin_port );
+  }
+  else if( ap_address->sa_family == AF_INET6 )
+  {
+    const struct sockaddr_in6* p_address =
+        ( const struct sockaddr_in6* ) ap_address;
+    inet_ntop( AF_INET6, &( p_address->sin6_addr ), address, sizeof address );
+    port = ntohs( p_address->sin6_port );
+  }
+
+  snprintf( a_output_endpoint,
+            CSENDER_ENDPOINT_LENGTH,
+            ( ap_address->sa_family == AF_INET6 ) ? "[%s]:%d" : "%s:%d",
+            address,
+            port );
+}
+
+
+int csender_transport_subflows( const struct csender_transport* ap_transport,
+                                struct csender_subflow_info* ap_output_subflows,
+                                int a_max_subflows )
+{
+  // Plain TCP sockets do not know of the option; fallen back ones tell
+  struct mptcp_info info;
+  memset( &info, 0, sizeof info );
+  socklen_t length = sizeof info;
+  if( getsockopt( ap_transport->socket_fd,
+                  SOL_MPTCP,
+                  MPTCP_INFO,
+                  &info,
+                  &length ) != 0 ||
+      ( info.mptcpi_flags & MPTCP_INFO_FLAG_FALLBACK ) != 0 )
+  {
+    return -1;
+  }
+
+  // Both come as a header, followed by an item per subflow
+  struct
+  {
+    struct mptcp_subflow_data   header;
+    struct tcp_info             items[ CSENDER_MAX_SUBFLOWS ];
+  } tcp_infos;
+  struct
+  {
+    struct mptcp_subflow_data    header;
+    struct mptcp_subflow_addrs   items[ CSENDER_MAX_SUBFLOWS ];
+  } addresses;
+
+  memset( &tcp_infos, 0, sizeof tcp_infos );
+  tcp_infos.header.size_subflow_data = sizeof tcp_infos.header;
+  tcp_infos.header.size_user = sizeof tcp_infos.items[ 0 ];
+  length = sizeof tcp_infos;
+  if( getsockopt( ap_transport->socket_fd,
+                  SOL_MPTCP,
+                  MPTCP_TCPINFO,
+                  &tcp_infos,
+                  &length ) != 0 )
+  {
+    return -1;
+  }
+
+  memset( &addresses, 0, sizeof addresses );
+  addresses.header.size_subflow_data = sizeof addresses.header;
+  addresses.header.size_user = sizeof addresses.items[ 0 ];
+  length = sizeof addresses;
+  if( getsockopt( ap_transport->socket_fd,
+                  SOL_MPTCP,
+                  MPTCP_SUBFLOW_ADDRS,
+                  &addresses,
+                  &length ) != 0 )
+  {
+    return -1;
+  }
+
+  // Subflows may come and go between both calls
+  int num_subflows = tcp_infos.header.num_subflows;
+  if( num_subflows > ( int ) addresses.header.num_subflows )
+  {
+    num_subflows = addresses.header.num_subflows;
+  }
+  if( num_subflows > CSENDER_MAX_SUBFLOWS )
+  {
+    num_subflows = CSENDER_MAX_SUBFLOWS;
+  }
+  if( num_subflows > a_max_subflows )
+  {
+    num_subflows = a_max_subflows;
+  }
+
+  for( int i = 0; i < num_subflows; i++ )
+  {
+    struct csender_subflow_info* p_subflow = &( ap_output_subflows[ i ] );
+    const struct tcp_info* p_tcp_info = &( tcp_infos.items[ i ] );
+    format_endpoint( &( addresses.items[ i ].sa_local ),
+                     p_subflow->local_endpoint );
+    format_endpoint( &( addresses.items[ i ].sa_remote ),
+                     p_subflow->remote_endpoint );
+    p_subflow->num_bytes_acked = p_tcp_info->tcpi_bytes_acked;
+    p_subflow->rtt_us = p_tcp_info->tcpi_rtt;
+    p_subflow->congestion_window = p_tcp_info->tcpi_snd_cwnd;
+    p_subflow->num_retransmits = p_tcp_info->tcpi_total_retrans;
+  }
+
+  return num_subflows;
+}
+
+
+int csender_transport_fd( const struct csender_transport* ap_transport )
+{
+  return ap_transport->socket_fd;
+}
+
+
+long csender_transport_send_queue_bytes(
+    const struct csender_transport* ap_transport )
+{
+  if( ap_transport->p_shm_ring != NULL )
+  {
+    return ( long ) shm_ring_pending_bytes( ap_transport->p_shm_ring );
+  }
+
+  int num_bytes = 0;
+  if( ioctl( ap_transport->socket_fd, SIOCOUTQ, &num_bytes ) != 0 )
+  {
+    return -1;
+  }
+
+  return num_bytes;
+}
+
+
+const char* csender_transport_peer_address(
+    const struct csender_transport* ap_transport )
+{
+  return ap_transport->peer_address;
+}
+
+
+void csender_transport_close( struct csender_transport* ap_transport )
+{
+  if( ap_transport != NULL )
+  {
+    if( ap_transport->socket_fd != -1 )
+    {
+      close( ap_transport->socket_fd );
+    }
+    shm_ring_destroy( ap_transport->p_shm_ring );
+    uring_destroy( ap_transport->p_uring );
+    packet_ring_destroy( ap_transport->p_packet_ring );
+    tx_timestamps_destroy( ap_transport->p_tx_timestamps );
+    free( ap_transport );
+  }
+}
@@ -0,0 +1,312 @@
+#include "tx_timestamps.h"
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+
+// Sampled events the kernel has not acknowledged the last report of yet; the
+// oldest one is dropped to make room, if the peer never acknowledges it
+#define MAX_PENDING_SAMPLES 16
+
+// Latencies reported in full, but not taken yet
+#define MAX_DONE_SAMPLES 64
+
+// Room for the timestamps, and the extended error telling which they are
+#define REPORT_CONTROL_LENGTH 512
+
+struct pending_sample
+{
+  uint32_t   key;                   // Offset of its last byte in the stream
+  int64_t    send_ns;               // All of them, CLOCK_REALTIME, as the
+  int64_t    scheduled_ns;          // kernel's software timestamps. 0 until
+  int64_t    transmitted_ns;        // reported.
+};
+
+struct tx_timestamps
+{
+  int                         socket_fd;
+  int                         sample_period;
+  int                         num_events_to_sample;
+  struct pending_sample       pending[ MAX_PENDING_SAMPLES ];  // Oldest first
+  int                         num_pending;
+  struct csender_tx_latency   done[ MAX_DONE_SAMPLES ];
+  int                         num_done;
+};
+
+
+static int64_t realtime_ns( )
+{
+  struct timespec now;
+  clock_gettime( CLOCK_REALTIME, &now );
+
+  return ( int64_t ) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+
+struct tx_timestamps* tx_timestamps_create( int a_socket_fd,
+                                            int a_sample_period )
+{
+  // Reported by software, with an ID (the offset of the byte) and without a
+  // copy of the data. What to timestamp is asked for per sampled send.
+  unsigned int flags = SOF_TIMESTAMPING_SOFTWARE |
+                       SOF_TIMESTAMPING_OPT_ID |
+                       SOF_TIMESTAMPING_OPT_TSONLY;
+  if( setsockopt( a_socket_fd,
+                  SOL_SOCKET,
+                  SO_TIMESTAMPING,
+                  &flags,
+                  sizeof flags ) != 0 )
+  {
+    perror( "Kernel TX timestamps are not available" );
+    return NULL;
+  }
+
+  struct tx_timestamps* p_timestamps = calloc( 1, sizeof *p_timestamps );
+  if( p_timestamps != NULL )
+  {
+    p_timestamps->socket_fd = a_socket_fd;
+    p_timestamps->sample_period = ( a_sample_period > 0 ) ? a_sample_period : 1;
+    p_timestamps->num_events_to_sample = p_timestamps->sample_period;
+  }
+
+  return p_timestamps;
+}
+
+
+bool tx_timestamps_due( struct tx_timestamps* ap_timestamps,
+                        int a_num_events )
+{
+  ap_timestamps->num_events_to_sample -= a_num_events;
+  if( ap_timestamps->num_events_to_sample > 0 )
+  {
+    return false;
+  }
+
+  ap_timestamps->num_events_to_sample = ap_timestamps->sample_period;
+
+  return true;
+}
+
+
+static void complete_sample( struct tx_timestamps* ap_timestamps,
+                             int a_index,
+                             int64_t a_acknowledged_ns )
+{
+  const struct pending_sample* p_sample = &( ap_timestamps->pending[ a_index ] );
+  if( ap_timestamps->num_done < MAX_DONE_SAMPLES )
+  {
+    struct csender_tx_latency* p_latency =
+        &( ap_timestamps->done[ ap_timestamps->num_done++ ] );
+    p_latency->qdisc_ns =
+        ( p_sample->scheduled_ns > 0 && p_sample->transmitted_ns > 0 ) ?
+            p_sample->transmitted_ns - p_sample->scheduled_ns :
+            -1;
+    p_latency->ack_ns = a_acknowledged_ns - p_sample->send_ns;
+  }
+
+  ap_timestamps->num_pending--;
+  memmove( &( ap_timestamps->pending[ a_index ] ),
+           &( ap_timestamps->pending[ a_index + 1 ] ),
+           ( ap_timestamps->num_pending - a_index ) *
+               sizeof ap_timestamps->pending[ 0 ] );
+}
+
+
+static void record_report( struct tx_timestamps* ap_timestamps,
+                           uint32_t a_key,
+                           uint32_t a_type,
+                           int64_t a_time_ns )
+{
+  for( int i = 0; i < ap_timestamps->num_pending; i++ )
+  {
+    struct pending_sample* p_sample = &( ap_timestamps->pending[ i ] );
+    if( p_sample->key != a_key )
+    {
+      continue;
+    }
+
+    switch( a_type )
+    {
+      case SCM_TSTAMP_SCHED:
+      {
+        p_sample->scheduled_ns = a_time_ns;
+        break;
+      }
+      case SCM_TSTAMP_SND:
+      {
+        p_sample->transmitted_ns = a_time_ns;
+        break;
+      }
+      case SCM_TSTAMP_ACK:
+      {
+        complete_sample( ap_timestamps, i, a_time_ns );
+        break;
+      }
+    }
+
+    return;
+  }
+}
+
+
+// Drains the error queue of the socket. Returns the no. of system calls it
+// took.
+static int read_reports( struct tx_timestamps* ap_timestamps )
+{
+  int num_calls = 0;
+  for( ;; )
+  {
+    char control[ REPORT_CONTROL_LENGTH ];
+    struct msghdr message;
+    memset( &message, 0, sizeof message );
+    message.msg_control = control;
+    message.msg_controllen = sizeof control;
+
+    num_calls++;
+    if( recvmsg( ap_timestamps->socket_fd,
+                 &message,
+                 MSG_ERRQUEUE | MSG_DONTWAIT ) < 0 )
+    {
+      if( errno == EINTR )
+      {
+        continue;
+      }
+
+      // Nothing left
+      break;
+    }
+
+    const struct scm_timestamping* p_times = NULL;
+    const struct sock_extended_err* p_error = NULL;
+    for( struct cmsghdr* p_control_message = CMSG_FIRSTHDR( &message );
+         p_control_message != NULL;
+         p_control_message = CMSG_NXTHDR( &message, p_control_message ) )
+    {
+      int level = p_control_message->cmsg_level;
+      int type = p_control_message->cmsg_type;
+      if( level == SOL_SOCKET && type == SCM_TIMESTAMPING )
+      {
+        p_times = ( const struct scm_timestamping* )
+                      CMSG_DATA( p_control_message );
+      }
+      else if( ( level == IPPROTO_IP && type == IP_RECVERR ) ||
+               ( level == IPPROTO_IPV6 && type == IPV6_RECVERR ) )
+      {
+        p_error = ( const struct sock_extended_err* )
+                      CMSG_DATA( p_control_message );
+      }
+    }
+
+    if( p_times != NULL &&
+        p_error != NULL &&
+        p_error->ee_errno == ENOMSG &&
+        p_error->ee_origin == SO_EE_ORIGIN_TIMESTAMPING )
+    {
+      record_report( ap_timestamps,
+                     p_error->ee_data,
+                     p_error->ee_info,
+                     ( int64_t ) p_times->ts[ 0 ].tv_sec * 1000000000 +
+                         p_times->ts[ 0 ].tv_nsec );
+    }
+  }
+
+  return num_calls;
+}
+
+
+long tx_timestamps_send( struct tx_timestamps* ap_timestamps,
+                         const struct iovec* ap_events,
+                         int a_num_events,
+                         uint64_t a_stream_offset,
+                         int* ap_io_num_calls )
+{
+  *ap_io_num_calls += read_reports( ap_timestamps );
+
+  struct msghdr message;
+  memset( &message, 0, sizeof message );
+  message.msg_iov = ( struct iovec* ) ap_events;
+  message.msg_iovlen = a_num_events;
+
+  // What to timestamp, for this send alone
+  char control[ CMSG_SPACE( sizeof( uint32_t ) ) ];
+  memset( control, 0, sizeof control );
+  message.msg_control = control;
+  message.msg_controllen = sizeof control;
+
+  uint32_t flags = SOF_TIMESTAMPING_TX_SCHED |
+                   SOF_TIMESTAMPING_TX_SOFTWARE |
+                   SOF_TIMESTAMPING_TX_ACK;
+  struct cmsghdr* p_control_message = CMSG_FIRSTHDR( &message );
+  p_control_message->cmsg_level = SOL_SOCKET;
+  p_control_message->cmsg_type = SO_TIMESTAMPING;
+  p_control_message->cmsg_len = CMSG_LEN( sizeof flags );
+  memcpy( CMSG_DATA( p_control_message ), &flags, sizeof flags );
+
+  int64_t send_ns = realtime_ns( );
+  ssize_t num_bytes_sent;
+  do
+  {
+    ( *ap_io_num_calls )++;
+    num_bytes_sent = sendmsg( ap_timestamps->socket_fd,
+                              &message,
+                              MSG_NOSIGNAL );
+  }
+  while( num_bytes_sent < 0 && errno == EINTR );
+
+  if( num_bytes_sent <= 0 )
+  {
+    return num_bytes_sent;
+  }
+
+  if( ap_timestamps->num_pending == MAX_PENDING_SAMPLES )
+  {
+    ap_timestamps->num_pending--;
+    memmove( &( ap_timestamps->pending[ 0 ] ),
+             &( ap_timestamps->pending[ 1 ] ),
+             ap_timestamps->num_pending * sizeof ap_timestamps->pending[ 0 ] );
+  }
+
+  // The kernel timestamps the last byte the call took
+  struct pending_sample* p_sample =
+      &( ap_timestamps->pending[ ap_timestamps->num_pending++ ] );
+  p_sample->key = ( uint32_t ) ( a_stream_offset + num_bytes_sent - 1 );
+  p_sample->send_ns = send_ns;
+  p_sample->scheduled_ns = 0;
+  p_sample->transmitted_ns = 0;
+
+  return num_bytes_sent;
+}
+
+
+int tx_timestamps_take( struct tx_timestamps* ap_timestamps,
+                        struct csender_tx_latency* ap_output_latencies,
+                        int a_max_latencies )
+{
+  int num_latencies = ap_timestamps->num_done;
+  if( num_latencies > a_max_latencies )
+  {
+    num_latencies = a_max_latencies;
+  }
+
+  memcpy( ap_output_latencies,
+          ap_timestamps->done,
+          num_latencies * sizeof ap_timestamps->done[ 0 ] );
+  ap_timestamps->num_done -= num_latencies;
+  memmove( &( ap_timestamps->done[ 0 ] ),
+           &( ap_timestamps->done[ num_latencies ] ),
+           ap_timestamps->num_done * sizeof ap_timestamps->done[ 0 ] );
+
+  return num_latencies;
+}
+
+
+void tx_timestamps_destroy( struct tx_timestamps* ap_timestamps )
+{
+  free( ap_timestamps );
+}
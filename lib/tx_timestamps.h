@@ -0,0 +1,46 @@
+#ifndef CSENDER_TX_TIMESTAMPS_H
+#define CSENDER_TX_TIMESTAMPS_H
+
+#include "csender.h"
+
+#include <stdint.h>
+#include <sys/uio.h>
+
+// Kernel TX timestamps (SO_TIMESTAMPING) of one in every so many events sent
+// through a TCP socket: when its last byte enters the queueing discipline,
+// when it is handed to the device, and when the peer acknowledges it. The
+// kernel reports them on the error queue of the socket, which is read as
+// further events are sampled.
+struct tx_timestamps;
+
+// Must be set up before anything is sent through the socket, as the kernel
+// tells events apart by their offset in the stream since then. Returns NULL,
+// after telling why on stderr, if the kernel does not offer it.
+struct tx_timestamps* tx_timestamps_create( int a_socket_fd,
+                                            int a_sample_period );
+
+// Counts the given no. of events about to be sent. Tells whether the last of
+// them is to be sampled.
+bool tx_timestamps_due( struct tx_timestamps* ap_timestamps,
+                        int a_num_events );
+
+// Reads the reports queued so far, and sends the events with one sendmsg()
+// that asks for the timestamps of its last byte, the given no. of bytes into
+// the stream. Returns the no. of bytes sent (maybe not all of them), or -1
+// (with errno set) on error. Adds the system calls it took to the given
+// counter.
+long tx_timestamps_send( struct tx_timestamps* ap_timestamps,
+                         const struct iovec* ap_events,
+                         int a_num_events,
+                         uint64_t a_stream_offset,
+                         int* ap_io_num_calls );
+
+// Takes the latencies of the sampled events reported in full, up to the given
+// no. of them. Returns how many.
+int tx_timestamps_take( struct tx_timestamps* ap_timestamps,
+                        struct csender_tx_latency* ap_output_latencies,
+                        int a_max_latencies );
+
+void tx_timestamps_destroy( struct tx_timestamps* ap_timestamps );
+
+#endif
@@ -0,0 +1,286 @@
+#include "uring.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+struct uring
+{
+  int                    ring_fd;
+  unsigned int           num_entries;
+
+  // Submission queue
+  void*                  p_sq_ring;
+  size_t                 sq_ring_length;
+  unsigned int*          p_sq_tail;
+  unsigned int           sq_mask;
+  unsigned int*          p_sq_array;
+  struct io_uring_sqe*   p_sqes;
+  size_t                 sqes_length;
+
+  // Completion queue; it may share the mapping of the submission one
+  void*                  p_cq_ring;
+  size_t                 cq_ring_length;
+  unsigned int*          p_cq_head;
+  unsigned int*          p_cq_tail;
+  unsigned int           cq_mask;
+  struct io_uring_cqe*   p_cqes;
+
+  int*                   p_results;       // Of every send of the batch
+};
+
+
+static void* map_ring( int a_ring_fd, size_t a_length, off_t a_offset )
+{
+  void* p_ring = mmap( NULL,
+                       a_length,
+                       PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE,
+                       a_ring_fd,
+                       a_offset );
+
+  return ( p_ring != MAP_FAILED ) ? p_ring : NULL;
+}
+
+
+struct uring* uring_create( unsigned int a_num_entries )
+{
+  struct uring* p_uring = calloc( 1, sizeof *p_uring );
+  if( p_uring == NULL )
+  {
+    return NULL;
+  }
+
+  struct io_uring_params params;
+  memset( &params, 0, sizeof params );
+  p_uring->ring_fd = ( int ) syscall( __NR_io_uring_setup,
+                                      a_num_entries,
+                                      &params );
+  p_uring->p_results = malloc( params.sq_entries * sizeof( int ) );
+  if( p_uring->ring_fd < 0 || p_uring->p_results == NULL )
+  {
+    int setup_errno = errno;
+    uring_destroy( p_uring );
+    errno = setup_errno;
+    return NULL;
+  }
+
+  p_uring->num_entries = params.sq_entries;
+  p_uring->sq_ring_length = params.sq_off.array +
+                            params.sq_entries * sizeof( unsigned int );
+  p_uring->cq_ring_length = params.cq_off.cqes +
+                            params.cq_entries * sizeof( struct io_uring_cqe );
+  p_uring->sqes_length = params.sq_entries * sizeof( struct io_uring_sqe );
+
+  // Newer kernels map both queues at once
+  bool single_mapping = ( params.features & IORING_FEAT_SINGLE_MMAP ) != 0;
+  if( single_mapping && p_uring->cq_ring_length > p_uring->sq_ring_length )
+  {
+    p_uring->sq_ring_length = p_uring->cq_ring_length;
+  }
+
+  p_uring->p_sq_ring = map_ring( p_uring->ring_fd,
+                                 p_uring->sq_ring_length,
+                                 IORING_OFF_SQ_RING );
+  p_uring->p_cq_ring = single_mapping ?
+                           p_uring->p_sq_ring :
+                           map_ring( p_uring->ring_fd,
+                                     p_uring->cq_ring_length,
+                                     IORING_OFF_CQ_RING );
+  p_uring->p_sqes = map_ring( p_uring->ring_fd,
+                              p_uring->sqes_length,
+                              IORING_OFF_SQES );
+  if( p_uring->p_sq_ring == NULL ||
+      p_uring->p_cq_ring == NULL ||
+      p_uring->p_sqes == NULL )
+  {
+    int map_errno = errno;
+    uring_destroy( p_uring );
+    errno = map_errno;
+    return NULL;
+  }
+
+  char* p_sq_ring = p_uring->p_sq_ring;
+  p_uring->p_sq_tail = ( unsigned int* ) ( p_sq_ring + params.sq_off.tail );
+  p_uring->sq_mask = *( unsigned int* ) ( p_sq_ring + params.sq_off.ring_mask );
+  p_uring->p_sq_array = ( unsigned int* ) ( p_sq_ring + params.sq_off.array );
+
+  char* p_cq_ring = p_uring->p_cq_ring;
+  p_uring->p_cq_head = ( unsigned int* ) ( p_cq_ring + params.cq_off.head );
+  p_uring->p_cq_tail = ( unsigned int* ) ( p_cq_ring + params.cq_off.tail );
+  p_uring->cq_mask = *( unsigned int* ) ( p_cq_ring + params.cq_off.ring_mask );
+  p_uring->p_cqes = ( struct io_uring_cqe* ) ( p_cq_ring + params.cq_off.cqes );
+
+  return p_uring;
+}
+
+
+// Sends what is left of a buffer the ring did not send whole
+static int send_rest( int a_socket_fd, const char* a_data, size_t a_length )
+{
+  int num_calls = 0;
+  while( a_length > 0 )
+  {
+    ssize_t num_bytes_sent = send( a_socket_fd, a_data, a_length, MSG_NOSIGNAL );
+    num_calls++;
+    if( num_bytes_sent < 0 )
+    {
+      if( errno == EINTR )
+      {
+        continue;
+      }
+
+      return -1;
+    }
+
+    a_data += num_bytes_sent;
+    a_length -= num_bytes_sent;
+  }
+
+  return num_calls;
+}
+
+
+int uring_send_batch( struct uring* ap_uring,
+                      int a_socket_fd,
+                      const struct iovec* ap_buffers,
+                      int a_num_buffers )
+{
+  if( a_num_buffers <= 0 ||
+      ( unsigned int ) a_num_buffers > ap_uring->num_entries )
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Linked, so that they go out in order. A send that fails, or falls short,
+  // cancels the ones after it.
+  unsigned int tail = *( ap_uring->p_sq_tail );
+  for( int i = 0; i < a_num_buffers; i++ )
+  {
+    unsigned int index = tail & ap_uring->sq_mask;
+    struct io_uring_sqe* p_sqe = &( ap_uring->p_sqes[ index ] );
+    memset( p_sqe, 0, sizeof *p_sqe );
+    p_sqe->opcode = IORING_OP_SEND;
+    p_sqe->fd = a_socket_fd;
+    p_sqe->addr = ( uint64_t ) ( uintptr_t ) ap_buffers[ i ].iov_base;
+    p_sqe->len = ( uint32_t ) ap_buffers[ i ].iov_len;
+    p_sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+    p_sqe->flags = ( i + 1 < a_num_buffers ) ? IOSQE_IO_LINK : 0;
+    p_sqe->user_data = ( uint64_t ) i;
+    ap_uring->p_sq_array[ index ] = index;
+    tail++;
+  }
+  atomic_store_explicit( ( _Atomic unsigned int* ) ap_uring->p_sq_tail,
+                         tail,
+                         memory_order_release );
+
+  // Submit them all, and wait for all of them
+  int num_calls = 0;
+  int num_to_submit = a_num_buffers;
+  int num_completed = 0;
+  while( num_completed < a_num_buffers )
+  {
+    num_calls++;
+    int num_submitted = ( int ) syscall( __NR_io_uring_enter,
+                                         ap_uring->ring_fd,
+                                         num_to_submit,
+                                         a_num_buffers - num_completed,
+                                         IORING_ENTER_GETEVENTS,
+                                         NULL,
+                                         0 );
+    if( num_submitted < 0 )
+    {
+      if( errno == EINTR )
+      {
+        continue;
+      }
+
+      return -1;
+    }
+    num_to_submit -= num_submitted;
+
+    unsigned int head = *( ap_uring->p_cq_head );
+    unsigned int cq_tail =
+        atomic_load_explicit( ( _Atomic unsigned int* ) ap_uring->p_cq_tail,
+                              memory_order_acquire );
+    while( head != cq_tail )
+    {
+      const struct io_uring_cqe* p_cqe =
+          &( ap_uring->p_cqes[ head & ap_uring->cq_mask ] );
+      ap_uring->p_results[ p_cqe->user_data ] = p_cqe->res;
+      num_completed++;
+      head++;
+    }
+    atomic_store_explicit( ( _Atomic unsigned int* ) ap_uring->p_cq_head,
+                           head,
+                           memory_order_release );
+  }
+
+  // Finish, in order, whatever the ring left undone
+  for( int i = 0; i < a_num_buffers; i++ )
+  {
+    int result = ap_uring->p_results[ i ];
+    size_t length = ap_buffers[ i ].iov_len;
+    if( result >= 0 && ( size_t ) result == length )
+    {
+      continue;
+    }
+
+    if( result < 0 && result != -ECANCELED && result != -EINTR )
+    {
+      errno = -result;
+      return -1;
+    }
+
+    size_t offset = ( result > 0 ) ? ( size_t ) result : 0;
+    int num_rest_calls = send_rest( a_socket_fd,
+                                    ( const char* ) ap_buffers[ i ].iov_base +
+                                        offset,
+                                    length - offset );
+    if( num_rest_calls < 0 )
+    {
+      return -1;
+    }
+    num_calls += num_rest_calls;
+  }
+
+  return num_calls;
+}
+
+
+void uring_destroy( struct uring* ap_uring )
+{
+  if( ap_uring == NULL )
+  {
+    return;
+  }
+
+  if( ap_uring->p_sqes != NULL )
+  {
+    munmap( ap_uring->p_sqes, ap_uring->sqes_length );
+  }
+  if( ap_uring->p_cq_ring != NULL && ap_uring->p_cq_ring != ap_uring->p_sq_ring )
+  {
+    munmap( ap_uring->p_cq_ring, ap_uring->cq_ring_length );
+  }
+  if( ap_uring->p_sq_ring != NULL )
+  {
+    munmap( ap_uring->p_sq_ring, ap_uring->sq_ring_length );
+  }
+  if( ap_uring->ring_fd >= 0 )
+  {
+    close( ap_uring->ring_fd );
+  }
+
+  free( ap_uring->p_results );
+  free( ap_uring );
+}
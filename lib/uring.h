@@ -0,0 +1,24 @@
+#ifndef CSENDER_URING_H
+#define CSENDER_URING_H
+
+#include <sys/uio.h>
+
+// A minimal io_uring, set up with the raw system calls, to hand a whole batch
+// of sends to the kernel with one io_uring_enter()
+struct uring;
+
+// Room for the given no. of sends per batch. Returns NULL, with errno set, if
+// the kernel does not offer io_uring.
+struct uring* uring_create( unsigned int a_num_entries );
+
+// Sends every buffer, in order, through the given socket, as a chain of linked
+// sends. Returns the no. of system calls it took, or -1 (with errno set) on
+// error.
+int uring_send_batch( struct uring* ap_uring,
+                      int a_socket_fd,
+                      const struct iovec* ap_buffers,
+                      int a_num_buffers );
+
+void uring_destroy( struct uring* ap_uring );
+
+#endif
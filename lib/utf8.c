@@ -0,0 +1,209 @@
+#include "utf8.h"
+#include "random.h"
+#include "weights.h"
+
+#include <pthread.h>
+#include <string.h>
+
+// Characters of every class, encoded once
+#define CHARACTERS_PER_CLASS 256
+
+struct utf8_character
+{
+  char      bytes[ 4 ];
+  uint8_t   length;
+};
+
+static struct utf8_character
+    g_characters[ CSENDER_NUM_UTF8_CLASSES ][ CHARACTERS_PER_CLASS ];
+static pthread_once_t g_characters_once = PTHREAD_ONCE_INIT;
+
+static const char* g_class_names[ CSENDER_NUM_UTF8_CLASSES ] =
+{
+  "ascii", "cyrillic", "cjk", "emoji", "invalid"
+};
+
+// Default mix, in percent
+static const unsigned int g_default_weights[ CSENDER_NUM_UTF8_CLASSES ] =
+{
+  70, 10, 10, 10, 0
+};
+
+static const char g_ascii_characters[] =
+    "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ 0123456789";
+
+// Sequences no valid UTF-8 decoder accepts: stray continuation bytes, bytes
+// that never appear, an overlong encoding, a sequence cut short, a surrogate
+// and a code point beyond U+10FFFF
+static const struct utf8_character g_invalid_sequences[] =
+{
+  { { ( char ) 0x80 }, 1 },
+  { { ( char ) 0xBF }, 1 },
+  { { ( char ) 0xFE }, 1 },
+  { { ( char ) 0xFF }, 1 },
+  { { ( char ) 0xC0, ( char ) 0x80 }, 2 },
+  { { ( char ) 0xE4, ( char ) 0xB8 }, 2 },
+  { { ( char ) 0xED, ( char ) 0xA0, ( char ) 0x80 }, 3 },
+  { { ( char ) 0xF4, ( char ) 0x90, ( char ) 0x80, ( char ) 0x80 }, 4 }
+};
+
+static const char g_byte_order_mark[] = "\xEF\xBB\xBF";
+
+
+static uint8_t utf8_encode( uint32_t a_code_point, char* a_output )
+{
+  if( a_code_point < 0x80 )
+  {
+    a_output[ 0 ] = ( char ) a_code_point;
+    return 1;
+  }
+
+  if( a_code_point < 0x800 )
+  {
+    a_output[ 0 ] = ( char ) ( 0xC0 | ( a_code_point >> 6 ) );
+    a_output[ 1 ] = ( char ) ( 0x80 | ( a_code_point & 0x3F ) );
+    return 2;
+  }
+
+  if( a_code_point < 0x10000 )
+  {
+    a_output[ 0 ] = ( char ) ( 0xE0 | ( a_code_point >> 12 ) );
+    a_output[ 1 ] = ( char ) ( 0x80 | ( ( a_code_point >> 6 ) & 0x3F ) );
+    a_output[ 2 ] = ( char ) ( 0x80 | ( a_code_point & 0x3F ) );
+    return 3;
+  }
+
+  a_output[ 0 ] = ( char ) ( 0xF0 | ( a_code_point >> 18 ) );
+  a_output[ 1 ] = ( char ) ( 0x80 | ( ( a_code_point >> 12 ) & 0x3F ) );
+  a_output[ 2 ] = ( char ) ( 0x80 | ( ( a_code_point >> 6 ) & 0x3F ) );
+  a_output[ 3 ] = ( char ) ( 0x80 | ( a_code_point & 0x3F ) );
+  return 4;
+}
+
+
+static void init_characters( )
+{
+  for( uint32_t i = 0; i < CHARACTERS_PER_CLASS; i++ )
+  {
+    struct utf8_character* p_character;
+
+    p_character = &( g_characters[ CSENDER_UTF8_ASCII ][ i ] );
+    p_character->length = utf8_encode(
+        g_ascii_characters[ i % ( sizeof g_ascii_characters - 1 ) ],
+        p_character->bytes );
+
+    // А-я
+    p_character = &( g_characters[ CSENDER_UTF8_CYRILLIC ][ i ] );
+    p_character->length = utf8_encode( 0x410 + i % 64, p_character->bytes );
+
+    // Spread over the CJK Unified Ideographs block
+    p_character = &( g_characters[ CSENDER_UTF8_CJK ][ i ] );
+    p_character->length = utf8_encode( 0x4E00 + i * 79, p_character->bytes );
+
+    // Miscellaneous Symbols and Pictographs
+    p_character = &( g_characters[ CSENDER_UTF8_EMOJI ][ i ] );
+    p_character->length = utf8_encode( 0x1F300 + i, p_character->bytes );
+
+    g_characters[ CSENDER_UTF8_INVALID ][ i ] =
+        g_invalid_sequences[ i % ( sizeof g_invalid_sequences /
+                                   sizeof g_invalid_sequences[ 0 ] ) ];
+  }
+}
+
+
+bool csender_parse_utf8_weights( const char* a_specification,
+                                 unsigned int* ap_output_weights )
+{
+  return parse_weights( a_specification,
+                        g_class_names,
+                        CSENDER_NUM_UTF8_CLASSES,
+                        ap_output_weights );
+}
+
+
+void utf8_mix_init( struct utf8_mix* ap_mix,
+                    const unsigned int* a_weights,
+                    bool a_byte_order_mark )
+{
+  pthread_once( &g_characters_once, init_characters );
+
+  const unsigned int* p_weights =
+      weights_all_zero( a_weights, CSENDER_NUM_UTF8_CLASSES ) ?
+          g_default_weights :
+          a_weights;
+
+  double total_weight = 0;
+  for( int i = 0; i < CSENDER_NUM_UTF8_CLASSES; i++ )
+  {
+    total_weight += p_weights[ i ];
+  }
+
+  // Every class with some weight gets at least a slot, and the last one
+  // with any takes what rounding leaves
+  int num_slots = 0;
+  int last_class = 0;
+  for( int i = 0; i < CSENDER_NUM_UTF8_CLASSES; i++ )
+  {
+    if( p_weights[ i ] == 0 )
+    {
+      continue;
+    }
+
+    int class_slots = ( int ) ( p_weights[ i ] * UTF8_MIX_SLOTS / total_weight );
+    if( class_slots == 0 )
+    {
+      class_slots = 1;
+    }
+    if( class_slots > UTF8_MIX_SLOTS - num_slots )
+    {
+      class_slots = UTF8_MIX_SLOTS - num_slots;
+    }
+
+    memset( ap_mix->classes + num_slots, i, class_slots );
+    num_slots += class_slots;
+    last_class = i;
+  }
+
+  memset( ap_mix->classes + num_slots,
+          last_class,
+          UTF8_MIX_SLOTS - num_slots );
+
+  ap_mix->byte_order_mark = a_byte_order_mark;
+}
+
+
+void generate_utf8_body( const struct utf8_mix* ap_mix,
+                         size_t a_body_length,
+                         uint64_t* ap_io_random_state,
+                         char* a_output_body )
+{
+  char* p_output = a_output_body;
+  char* p_end = a_output_body + a_body_length;
+
+  if( ap_mix->byte_order_mark && a_body_length >= sizeof g_byte_order_mark - 1 )
+  {
+    memcpy( p_output, g_byte_order_mark, sizeof g_byte_order_mark - 1 );
+    p_output += sizeof g_byte_order_mark - 1;
+  }
+
+  // Every random no. picks 3 characters: 12 bits for the class, and 8 for
+  // the character. The ones that would not fit at the end become ASCII.
+  while( p_output < p_end )
+  {
+    uint64_t random = random_next( ap_io_random_state );
+    for( int i = 0; i < 3 && p_output < p_end; i++, random >>= 20 )
+    {
+      unsigned int index = ( random >> 12 ) & ( CHARACTERS_PER_CLASS - 1 );
+      const struct utf8_character* p_character =
+          &( g_characters[ ap_mix->classes[ random & ( UTF8_MIX_SLOTS - 1 ) ] ]
+                         [ index ] );
+      if( p_character->length > p_end - p_output )
+      {
+        p_character = &( g_characters[ CSENDER_UTF8_ASCII ][ index ] );
+      }
+
+      memcpy( p_output, p_character->bytes, sizeof p_character->bytes );
+      p_output += p_character->length;
+    }
+  }
+}
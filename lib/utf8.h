@@ -0,0 +1,34 @@
+#ifndef CSENDER_UTF8_H
+#define CSENDER_UTF8_H
+
+#include "csender.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The class of every character is looked up with 12 random bits, so shares
+// are kept to 1/4096
+#define UTF8_MIX_SLOTS 4096
+
+// Which class of characters every slot picks, in proportion to their weights
+struct utf8_mix
+{
+  uint8_t   classes[ UTF8_MIX_SLOTS ];
+  bool      byte_order_mark;
+};
+
+// Classes without any weight are taken as the default mix
+void utf8_mix_init( struct utf8_mix* ap_mix,
+                    const unsigned int* a_weights,
+                    bool a_byte_order_mark );
+
+// Fills exactly the given no. of bytes with characters of the mix, which are
+// copied from tables encoded in advance. Up to 3 bytes past them may be
+// overwritten.
+void generate_utf8_body( const struct utf8_mix* ap_mix,
+                         size_t a_body_length,
+                         uint64_t* ap_io_random_state,
+                         char* a_output_body );
+
+#endif
@@ -0,0 +1,159 @@
+#include "weights.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Code of a name, or of a number, within the given list. -1 if none.
+static int find_code( const char* a_name,
+                      size_t a_name_length,
+                      const char** a_names,
+                      int a_num_names )
+{
+  for( int i = 0; i < a_num_names; i++ )
+  {
+    if( strlen( a_names[ i ] ) == a_name_length &&
+        strncmp( a_names[ i ], a_name, a_name_length ) == 0 )
+    {
+      return i;
+    }
+  }
+
+  char number[ 8 ];
+  if( a_name_length == 0 || a_name_length >= sizeof number )
+  {
+    return -1;
+  }
+  memcpy( number, a_name, a_name_length );
+  number[ a_name_length ] = '\0';
+
+  char* p_end = NULL;
+  long code = strtol( number, &p_end, 10 );
+  if( *p_end != '\0' || code < 0 || code >= a_num_names )
+  {
+    return -1;
+  }
+
+  return ( int ) code;
+}
+
+
+// "name[:weight],...", where a missing weight is 1
+bool parse_weights( const char* a_specification,
+                    const char** a_names,
+                    int a_num_names,
+                    unsigned int* ap_output_weights )
+{
+  memset( ap_output_weights, 0, a_num_names * sizeof *ap_output_weights );
+
+  const char* p_item = a_specification;
+  while( *p_item != '\0' )
+  {
+    const char* p_item_end = strchr( p_item, ',' );
+    if( p_item_end == NULL )
+    {
+      p_item_end = p_item + strlen( p_item );
+    }
+
+    const char* p_colon = memchr( p_item, ':', p_item_end - p_item );
+    const char* p_name_end = ( p_colon != NULL ) ? p_colon : p_item_end;
+    int code = find_code( p_item, p_name_end - p_item, a_names, a_num_names );
+    if( code < 0 )
+    {
+      return false;
+    }
+
+    unsigned long weight = 1;
+    if( p_colon != NULL )
+    {
+      char* p_end = NULL;
+      weight = strtoul( p_colon + 1, &p_end, 10 );
+      if( p_end != p_item_end || p_end == p_colon + 1 || weight > 1000000 )
+      {
+        return false;
+      }
+    }
+
+    ap_output_weights[ code ] += ( unsigned int ) weight;
+    p_item = ( *p_item_end == ',' ) ? p_item_end + 1 : p_item_end;
+  }
+
+  return true;
+}
+
+
+bool weights_all_zero( const unsigned int* a_weights, int a_num_weights )
+{
+  for( int i = 0; i < a_num_weights; i++ )
+  {
+    if( a_weights[ i ] != 0 )
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+void alias_table_build( const double* a_weights,
+                        int a_num_entries,
+                        double* ap_scratch,
+                        int* ap_scratch_indices,
+                        uint64_t* ap_output_thresholds,
+                        uint32_t* ap_output_aliases )
+{
+  double total_weight = 0;
+  for( int i = 0; i < a_num_entries; i++ )
+  {
+    total_weight += a_weights[ i ];
+  }
+
+  // Entries below the average probability are topped up with the excess of
+  // the ones above it. Both kinds share the list of indices: the small ones
+  // grow from its start, and the large ones from its end.
+  double* scaled = ap_scratch;
+  int* small = ap_scratch_indices;
+  int* large = ap_scratch_indices + a_num_entries;
+  int num_small = 0, num_large = 0;
+  for( int i = 0; i < a_num_entries; i++ )
+  {
+    scaled[ i ] = a_weights[ i ] * a_num_entries / total_weight;
+    ap_output_aliases[ i ] = ( uint32_t ) i;
+    if( scaled[ i ] < 1 )
+    {
+      small[ num_small++ ] = i;
+    }
+    else
+    {
+      *--large = i;
+      num_large++;
+    }
+  }
+
+  while( num_small > 0 && num_large > 0 )
+  {
+    int low = small[ --num_small ];
+    int high = large[ 0 ];
+
+    ap_output_thresholds[ low ] = ( uint64_t ) ( scaled[ low ] * 4294967296.0 );
+    ap_output_aliases[ low ] = ( uint32_t ) high;
+
+    scaled[ high ] -= 1 - scaled[ low ];
+    if( scaled[ high ] < 1 )
+    {
+      large++;
+      num_large--;
+      small[ num_small++ ] = high;
+    }
+  }
+
+  // What is left is 1, but for rounding
+  while( num_large > 0 )
+  {
+    ap_output_thresholds[ large[ --num_large ] ] = 4294967296ULL;
+  }
+  while( num_small > 0 )
+  {
+    ap_output_thresholds[ small[ --num_small ] ] = 4294967296ULL;
+  }
+}
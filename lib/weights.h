@@ -0,0 +1,28 @@
+#ifndef CSENDER_WEIGHTS_H
+#define CSENDER_WEIGHTS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Parses "name[:weight],...", where names may also be given by their index
+// in the list, and a missing weight is 1. Weights not given are 0.
+bool parse_weights( const char* a_specification,
+                    const char** a_names,
+                    int a_num_names,
+                    unsigned int* ap_output_weights );
+
+bool weights_all_zero( const unsigned int* a_weights, int a_num_weights );
+
+// Builds an alias table (Walker's method, as set up by Vose) of the given
+// weights, so that an entry is picked in constant time: a uniformly chosen
+// one is kept if 32 random bits are below its threshold (out of 2^32), or else
+// replaced by its alias. The scratch space takes a double, and an int, per
+// entry.
+void alias_table_build( const double* a_weights,
+                        int a_num_entries,
+                        double* ap_scratch,
+                        int* ap_scratch_indices,
+                        uint64_t* ap_output_thresholds,
+                        uint32_t* ap_output_aliases );
+
+#endif
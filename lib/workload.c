@@ -0,0 +1,774 @@
+#include "csender.h"
+#include "clock.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_LINE_LENGTH 1024
+
+
+static char* trim( char* a_text )
+{
+  while( isspace( ( unsigned char ) *a_text ) )
+  {
+    a_text++;
+  }
+
+  char* p_end = a_text + strlen( a_text );
+  while( p_end > a_text && isspace( ( unsigned char ) p_end[ -1 ] ) )
+  {
+    p_end--;
+  }
+  *p_end = '\0';
+
+  return a_text;
+}
+
+
+// Cuts the comment off a line, if any: a '#' or ';' at its start or after
+// whitespace, so that values may hold them
+static void strip_comment( char* a_line )
+{
+  for( char* p_character = a_line; *p_character != '\0'; p_character++ )
+  {
+    if( ( *p_character == '#' || *p_character == ';' ) &&
+        ( p_character == a_line ||
+          isspace( ( unsigned char ) p_character[ -1 ] ) ) )
+    {
+      *p_character = '\0';
+      return;
+    }
+  }
+}
+
+
+static bool copy_value( char* a_output, size_t a_max_length, const char* a_value )
+{
+  size_t length = strlen( a_value );
+  if( length > a_max_length )
+  {
+    return false;
+  }
+
+  memcpy( a_output, a_value, length + 1 );
+
+  return true;
+}
+
+
+static bool parse_long( const char* a_value, long* ap_output )
+{
+  char* p_end = NULL;
+  errno = 0;
+  long value = strtol( a_value, &p_end, 10 );
+  if( p_end == a_value || *p_end != '\0' || errno != 0 )
+  {
+    return false;
+  }
+
+  *ap_output = value;
+
+  return true;
+}
+
+
+static bool parse_bool( const char* a_value, bool* ap_output )
+{
+  if( strcmp( a_value, "yes" ) == 0 || strcmp( a_value, "true" ) == 0 ||
+      strcmp( a_value, "1" ) == 0 )
+  {
+    *ap_output = true;
+    return true;
+  }
+
+  if( strcmp( a_value, "no" ) == 0 || strcmp( a_value, "false" ) == 0 ||
+      strcmp( a_value, "0" ) == 0 )
+  {
+    *ap_output = false;
+    return true;
+  }
+
+  return false;
+}
+
+
+// "N", or "N-M", within [1, a_limit]
+static bool parse_range( char* a_value,
+                         long a_limit,
+                         long* ap_output_min,
+                         long* ap_output_max )
+{
+  long min_value = 0;
+  long max_value = 0;
+
+  char* p_dash = strchr( a_value, '-' );
+  if( p_dash != NULL )
+  {
+    *p_dash = '\0';
+    if( !parse_long( trim( a_value ), &min_value ) ||
+        !parse_long( trim( p_dash + 1 ), &max_value ) ||
+        max_value < min_value )
+    {
+      return false;
+    }
+  }
+  else if( parse_long( a_value, &min_value ) )
+  {
+    max_value = min_value;
+  }
+  else
+  {
+    return false;
+  }
+
+  if( min_value <= 0 || max_value > a_limit )
+  {
+    return false;
+  }
+
+  *ap_output_min = min_value;
+  *ap_output_max = max_value;
+
+  return true;
+}
+
+
+// Loads a corpus, which the workload keeps until it is destroyed
+static const char* load_corpus( struct csender_workload* ap_workload,
+                                struct csender_stream_options* ap_stream,
+                                const char* a_file_name )
+{
+  struct csender_corpus** pp_corpora =
+      realloc( ap_workload->pp_corpora,
+               ( ap_workload->num_corpora + 1 ) * sizeof *pp_corpora );
+  if( pp_corpora == NULL )
+  {
+    return "out of memory";
+  }
+  ap_workload->pp_corpora = pp_corpora;
+
+  struct csender_corpus* p_corpus = csender_corpus_load( a_file_name );
+  if( p_corpus == NULL )
+  {
+    return "invalid corpus";
+  }
+
+  pp_corpora[ ap_workload->num_corpora++ ] = p_corpus;
+  ap_stream->generator.p_corpus = p_corpus;
+  ap_stream->generator.body_kind = CSENDER_BODY_CORPUS;
+
+  return NULL;
+}
+
+
+// Loads a dictionary, which the workload keeps until it is destroyed
+static const char* load_dictionary( struct csender_workload* ap_workload,
+                                    struct csender_stream_options* ap_stream,
+                                    const char* a_file_name )
+{
+  struct csender_dictionary** pp_dictionaries =
+      realloc( ap_workload->pp_dictionaries,
+               ( ap_workload->num_dictionaries + 1 ) *
+                   sizeof *pp_dictionaries );
+  if( pp_dictionaries == NULL )
+  {
+    return "out of memory";
+  }
+  ap_workload->pp_dictionaries = pp_dictionaries;
+
+  struct csender_dictionary* p_dictionary =
+      csender_dictionary_load( a_file_name );
+  if( p_dictionary == NULL )
+  {
+    return "invalid dictionary";
+  }
+
+  pp_dictionaries[ ap_workload->num_dictionaries++ ] = p_dictionary;
+  ap_stream->generator.p_dictionary = p_dictionary;
+  ap_stream->generator.body_kind = CSENDER_BODY_WORDS;
+
+  return NULL;
+}
+
+
+// Opens a pack, which the workload keeps until it is destroyed
+static const char* open_pack( struct csender_workload* ap_workload,
+                              struct csender_stream_options* ap_stream,
+                              const char* a_file_name )
+{
+  struct csender_pack** pp_packs =
+      realloc( ap_workload->pp_packs,
+               ( ap_workload->num_packs + 1 ) * sizeof *pp_packs );
+  if( pp_packs == NULL )
+  {
+    return "out of memory";
+  }
+  ap_workload->pp_packs = pp_packs;
+
+  struct csender_pack* p_pack = csender_pack_open( a_file_name );
+  if( p_pack == NULL )
+  {
+    return "invalid pack";
+  }
+
+  pp_packs[ ap_workload->num_packs++ ] = p_pack;
+  ap_stream->generator.p_pack = p_pack;
+
+  return NULL;
+}
+
+
+// Applies a key of the file to a stream (or to the defaults of all of them).
+// Returns NULL on success, or what is wrong.
+static const char* apply_key( struct csender_workload* ap_workload,
+                              struct csender_stream_options* ap_stream,
+                              const char* a_key,
+                              char* a_value )
+{
+  struct csender_generator_options* p_generator = &( ap_stream->generator );
+  long number = 0;
+  long max_number = 0;
+
+  if( strcmp( a_key, "host" ) == 0 )
+  {
+    return copy_value( ap_stream->target_name,
+                       CSENDER_TARGET_NAME_MAXLENGTH,
+                       a_value ) ? NULL : "host too long";
+  }
+  else if( strcmp( a_key, "port" ) == 0 )
+  {
+    return copy_value( ap_stream->service_name,
+                       CSENDER_SERVICE_NAME_MAXLENGTH,
+                       a_value ) ? NULL : "port too long";
+  }
+  else if( strcmp( a_key, "hostname" ) == 0 )
+  {
+    return copy_value( ap_stream->hostname,
+                       CSENDER_HOSTNAME_MAXLENGTH,
+                       a_value ) ? NULL : "hostname too long";
+  }
+  else if( strcmp( a_key, "app" ) == 0 )
+  {
+    return copy_value( ap_stream->app_name,
+                       CSENDER_APP_NAME_MAXLENGTH,
+                       a_value ) ? NULL : "app too long";
+  }
+  else if( strcmp( a_key, "rate" ) == 0 )
+  {
+    if( !parse_long( a_value, &number ) || number <= 0 )
+    {
+      return "invalid rate";
+    }
+    ap_stream->rate = number;
+  }
+  else if( strcmp( a_key, "peak_rate" ) == 0 )
+  {
+    if( !parse_long( a_value, &number ) || number <= 0 )
+    {
+      return "invalid peak rate";
+    }
+    ap_stream->peak_rate = number;
+  }
+  else if( strcmp( a_key, "period" ) == 0 )
+  {
+    if( !parse_long( a_value, &number ) || number <= 0 || number > 1000000 )
+    {
+      return "invalid period";
+    }
+    ap_stream->period_seconds = ( int ) number;
+  }
+  else if( strcmp( a_key, "profile" ) == 0 )
+  {
+    if( strcmp( a_value, "constant" ) == 0 )
+    {
+      ap_stream->rate_profile = CSENDER_RATE_CONSTANT;
+    }
+    else if( strcmp( a_value, "ramp" ) == 0 )
+    {
+      ap_stream->rate_profile = CSENDER_RATE_RAMP;
+    }
+    else if( strcmp( a_value, "sine" ) == 0 )
+    {
+      ap_stream->rate_profile = CSENDER_RATE_SINE;
+    }
+    else
+    {
+      return "invalid rate profile";
+    }
+  }
+  else if( strcmp( a_key, "connections" ) == 0 )
+  {
+    if( !parse_long( a_value, &number ) || number <= 0 || number > 1024 )
+    {
+      return "invalid no. of connections";
+    }
+    ap_stream->num_connections = ( int ) number;
+  }
+  else if( strcmp( a_key, "length" ) == 0 )
+  {
+    if( !parse_range( a_value, csender_max_event_length( ),
+                      &number, &max_number ) )
+    {
+      return "invalid length";
+    }
+    p_generator->event_length = number;
+    p_generator->max_event_length = max_number;
+  }
+  else if( strcmp( a_key, "body" ) == 0 )
+  {
+    if( strcmp( a_value, "random" ) == 0 )
+    {
+      p_generator->body_kind = CSENDER_BODY_RANDOM;
+    }
+    else if( strcmp( a_value, "multiline" ) == 0 )
+    {
+      p_generator->body_kind = CSENDER_BODY_MULTILINE;
+    }
+    else if( strcmp( a_value, "corpus" ) == 0 )
+    {
+      p_generator->body_kind = CSENDER_BODY_CORPUS;
+    }
+    else if( strcmp( a_value, "utf8" ) == 0 )
+    {
+      p_generator->body_kind = CSENDER_BODY_UTF8;
+    }
+    else if( strcmp( a_value, "words" ) == 0 )
+    {
+      p_generator->body_kind = CSENDER_BODY_WORDS;
+    }
+    else if( strcmp( a_value, "kv" ) == 0 )
+    {
+      p_generator->body_kind = CSENDER_BODY_KEY_VALUE;
+    }
+    else if( strcmp( a_value, "json" ) == 0 )
+    {
+      p_generator->body_kind = CSENDER_BODY_JSON;
+    }
+    else
+    {
+      return "invalid body";
+    }
+  }
+  else if( strcmp( a_key, "lines" ) == 0 )
+  {
+    if( !parse_range( a_value, CSENDER_MAX_BODY_LINES, &number, &max_number ) )
+    {
+      return "invalid no. of lines";
+    }
+    p_generator->min_lines = number;
+    p_generator->max_lines = max_number;
+  }
+  else if( strcmp( a_key, "line_length" ) == 0 )
+  {
+    if( !parse_range( a_value, csender_max_event_length( ),
+                      &number, &max_number ) )
+    {
+      return "invalid line length";
+    }
+    p_generator->min_line_length = number;
+    p_generator->max_line_length = max_number;
+  }
+  else if( strcmp( a_key, "corpus" ) == 0 )
+  {
+    return load_corpus( ap_workload, ap_stream, a_value );
+  }
+  else if( strcmp( a_key, "dictionary" ) == 0 )
+  {
+    return load_dictionary( ap_workload, ap_stream, a_value );
+  }
+  else if( strcmp( a_key, "replay" ) == 0 )
+  {
+    return open_pack( ap_workload, ap_stream, a_value );
+  }
+  else if( strcmp( a_key, "fields" ) == 0 )
+  {
+    if( !parse_long( a_value, &number ) || number <= 0 ||
+        number > CSENDER_MAX_BODY_FIELDS )
+    {
+      return "invalid no. of fields";
+    }
+    p_generator->num_fields = number;
+  }
+  else if( strcmp( a_key, "keys" ) == 0 )
+  {
+    if( !parse_long( a_value, &number ) || number <= 0 ||
+        number > CSENDER_MAX_BODY_KEYS )
+    {
+      return "invalid no. of keys";
+    }
+    p_generator->num_keys = number;
+  }
+  else if( strcmp( a_key, "depth" ) == 0 )
+  {
+    if( !parse_long( a_value, &number ) || number < 0 ||
+        number > CSENDER_MAX_BODY_DEPTH )
+    {
+      return "invalid depth";
+    }
+    p_generator->depth = number;
+  }
+  else if( strcmp( a_key, "value_types" ) == 0 )
+  {
+    if( !csender_parse_value_types( a_value,
+                                    p_generator->value_type_weights ) )
+    {
+      return "invalid value types";
+    }
+  }
+  else if( strcmp( a_key, "utf8" ) == 0 )
+  {
+    if( !csender_parse_utf8_weights( a_value, p_generator->utf8_weights ) )
+    {
+      return "invalid UTF-8 classes";
+    }
+    p_generator->body_kind = CSENDER_BODY_UTF8;
+  }
+  else if( strcmp( a_key, "bom" ) == 0 )
+  {
+    if( !parse_bool( a_value, &( p_generator->utf8_byte_order_mark ) ) )
+    {
+      return "invalid byte order mark flag";
+    }
+  }
+  else if( strcmp( a_key, "clock" ) == 0 )
+  {
+    if( strcmp( a_value, "realtime" ) == 0 )
+    {
+      p_generator->clock_source = CSENDER_CLOCK_REALTIME;
+    }
+    else if( strcmp( a_value, "coarse" ) == 0 )
+    {
+      p_generator->clock_source = CSENDER_CLOCK_REALTIME_COARSE;
+    }
+    else if( strcmp( a_value, "tsc" ) == 0 )
+    {
+      p_generator->clock_source = CSENDER_CLOCK_TSC;
+    }
+    else if( strcmp( a_value, "synthetic" ) == 0 )
+    {
+      p_generator->clock_source = CSENDER_CLOCK_SYNTHETIC;
+    }
+    else
+    {
+      return "invalid clock";
+    }
+  }
+  else if( strcmp( a_key, "timezone" ) == 0 )
+  {
+    if( strcmp( a_value, "utc" ) == 0 )
+    {
+      p_generator->timezone = CSENDER_TIMEZONE_UTC;
+    }
+    else if( strcmp( a_value, "local" ) == 0 )
+    {
+      p_generator->timezone = CSENDER_TIMEZONE_LOCAL;
+    }
+    else
+    {
+      return "invalid time zone";
+    }
+  }
+  else if( strcmp( a_key, "framing" ) == 0 )
+  {
+    if( strcmp( a_value, "lf" ) == 0 )
+    {
+      p_generator->framing = CSENDER_FRAMING_LF;
+    }
+    else if( strcmp( a_value, "octet" ) == 0 )
+    {
+      p_generator->framing = CSENDER_FRAMING_OCTET_COUNTING;
+    }
+    else
+    {
+      return "invalid framing";
+    }
+  }
+  else if( strcmp( a_key, "sequence" ) == 0 )
+  {
+    if( !parse_bool( a_value, &( p_generator->sequence_numbers ) ) )
+    {
+      return "invalid sequence flag";
+    }
+  }
+  else if( strcmp( a_key, "facility" ) == 0 )
+  {
+    if( !csender_parse_facility_weights( a_value,
+                                         p_generator->facility_weights ) )
+    {
+      return "invalid facilities";
+    }
+  }
+  else if( strcmp( a_key, "severity" ) == 0 )
+  {
+    if( !csender_parse_severity_weights( a_value,
+                                         p_generator->severity_weights ) )
+    {
+      return "invalid severities";
+    }
+  }
+  else if( strcmp( a_key, "seed" ) == 0 )
+  {
+    char* p_end = NULL;
+    p_generator->seed = strtoull( a_value, &p_end, 0 );
+    if( p_end == a_value || *p_end != '\0' )
+    {
+      return "invalid seed";
+    }
+  }
+  else
+  {
+    return "unknown key";
+  }
+
+  return NULL;
+}
+
+
+// Checks what can only be checked once the whole stream is known
+static const char* validate_stream( struct csender_stream_options* ap_stream )
+{
+  if( ap_stream->rate <= 0 )
+  {
+    return "no rate";
+  }
+
+  if( ap_stream->rate_profile != CSENDER_RATE_CONSTANT )
+  {
+    if( ap_stream->peak_rate <= 0 )
+    {
+      ap_stream->peak_rate = ap_stream->rate;
+    }
+    if( ap_stream->period_seconds <= 0 )
+    {
+      return "no period for its rate profile";
+    }
+  }
+
+  struct csender_generator_options generator = ap_stream->generator;
+  generator.hostname = ( ap_stream->hostname[ 0 ] != '\0' ) ?
+                           ap_stream->hostname :
+                           NULL;
+  generator.app_name = ( ap_stream->app_name[ 0 ] != '\0' ) ?
+                           ap_stream->app_name :
+                           NULL;
+  if( generator.event_length < csender_min_event_length_for( &generator ) )
+  {
+    return "length too short for its header";
+  }
+
+  if( generator.body_kind == CSENDER_BODY_CORPUS && generator.p_corpus == NULL )
+  {
+    return "no corpus for its body";
+  }
+
+  if( generator.num_keys > 0 && generator.num_keys < generator.num_fields )
+  {
+    return "fewer keys than fields";
+  }
+
+  return NULL;
+}
+
+
+struct csender_workload* csender_workload_load(
+    const char* a_file_name,
+    const struct csender_stream_options* ap_defaults,
+    int a_default_num_threads )
+{
+  FILE* p_file = fopen( a_file_name, "r" );
+  if( p_file == NULL )
+  {
+    fprintf( stderr, "%s: %s\n", a_file_name, strerror( errno ) );
+    return NULL;
+  }
+
+  struct csender_workload* p_workload = calloc( 1, sizeof *p_workload );
+  if( p_workload == NULL )
+  {
+    fclose( p_file );
+    return NULL;
+  }
+  p_workload->num_threads = a_default_num_threads;
+
+  // Keys before the first section change the defaults of every stream
+  struct csender_stream_options defaults = *ap_defaults;
+  struct csender_stream_options* p_current = &defaults;
+
+  char line[ MAX_LINE_LENGTH ];
+  int line_number = 0;
+  const char* p_error = NULL;
+  while( p_error == NULL && fgets( line, sizeof line, p_file ) != NULL )
+  {
+    line_number++;
+
+    // A line that fills the buffer must end right after it
+    if( strchr( line, '\n' ) == NULL )
+    {
+      int next_character = fgetc( p_file );
+      if( next_character != EOF && next_character != '\n' )
+      {
+        p_error = "line too long";
+        break;
+      }
+    }
+
+    strip_comment( line );
+
+    char* p_line = trim( line );
+    if( *p_line == '\0' )
+    {
+      continue;
+    }
+
+    if( *p_line == '[' )
+    {
+      char* p_close = strchr( p_line, ']' );
+      if( p_close == NULL || p_close[ 1 ] != '\0' )
+      {
+        p_error = "invalid section";
+        break;
+      }
+      *p_close = '\0';
+
+      struct csender_stream_options* p_streams =
+          realloc( p_workload->p_streams,
+                   ( p_workload->num_streams + 1 ) * sizeof *p_streams );
+      if( p_streams == NULL )
+      {
+        p_error = "out of memory";
+        break;
+      }
+
+      p_workload->p_streams = p_streams;
+      p_current = &( p_streams[ p_workload->num_streams++ ] );
+      *p_current = defaults;
+      if( !copy_value( p_current->name,
+                       CSENDER_STREAM_NAME_MAXLENGTH,
+                       trim( p_line + 1 ) ) ||
+          p_current->name[ 0 ] == '\0' )
+      {
+        p_error = "invalid stream name";
+      }
+
+      continue;
+    }
+
+    char* p_equals = strchr( p_line, '=' );
+    if( p_equals == NULL )
+    {
+      p_error = "expected key = value";
+      break;
+    }
+    *p_equals = '\0';
+    char* p_key = trim( p_line );
+    char* p_value = trim( p_equals + 1 );
+
+    if( strcmp( p_key, "threads" ) == 0 )
+    {
+      long num_threads = 0;
+      if( p_current != &defaults )
+      {
+        p_error = "threads must be set before any stream";
+      }
+      else if( !parse_long( p_value, &num_threads ) || num_threads <= 0 ||
+               num_threads > 1024 )
+      {
+        p_error = "invalid no. of threads";
+      }
+      else
+      {
+        p_workload->num_threads = ( int ) num_threads;
+      }
+
+      continue;
+    }
+
+    p_error = apply_key( p_workload, p_current, p_key, p_value );
+  }
+
+  fclose( p_file );
+
+  if( p_error == NULL && p_workload->num_streams == 0 )
+  {
+    line_number = 0;
+    p_error = "no streams";
+  }
+
+  for( int i = 0; p_error == NULL && i < p_workload->num_streams; i++ )
+  {
+    p_error = validate_stream( &( p_workload->p_streams[ i ] ) );
+    if( p_error != NULL )
+    {
+      fprintf( stderr, "%s: stream %s: %s\n",
+               a_file_name, p_workload->p_streams[ i ].name, p_error );
+      csender_workload_destroy( p_workload );
+      return NULL;
+    }
+  }
+
+  if( p_error != NULL )
+  {
+    fprintf( stderr, "%s:%d: %s\n", a_file_name, line_number, p_error );
+    csender_workload_destroy( p_workload );
+    return NULL;
+  }
+
+  return p_workload;
+}
+
+
+void csender_workload_destroy( struct csender_workload* ap_workload )
+{
+  if( ap_workload != NULL )
+  {
+    for( int i = 0; i < ap_workload->num_corpora; i++ )
+    {
+      csender_corpus_destroy( ap_workload->pp_corpora[ i ] );
+    }
+    free( ap_workload->pp_corpora );
+    for( int i = 0; i < ap_workload->num_dictionaries; i++ )
+    {
+      csender_dictionary_destroy( ap_workload->pp_dictionaries[ i ] );
+    }
+    free( ap_workload->pp_dictionaries );
+    for( int i = 0; i < ap_workload->num_packs; i++ )
+    {
+      csender_pack_close( ap_workload->pp_packs[ i ] );
+    }
+    free( ap_workload->pp_packs );
+    free( ap_workload->p_streams );
+    free( ap_workload );
+  }
+}
+
+
+long csender_stream_rate_at( const struct csender_stream_options* ap_stream,
+                             int64_t a_elapsed_ns )
+{
+  double period_ns = ( double ) ap_stream->period_seconds * NS_PER_SECOND;
+  double phase = ( period_ns > 0 ) ? a_elapsed_ns / period_ns : 0;
+  double delta = ap_stream->peak_rate - ap_stream->rate;
+
+  switch( ap_stream->rate_profile )
+  {
+    case CSENDER_RATE_RAMP:
+    {
+      return ( phase >= 1 ) ? ap_stream->peak_rate :
+                              ap_stream->rate + ( long ) ( delta * phase );
+    }
+    case CSENDER_RATE_SINE:
+    {
+      // Starts at rate, peaks at half the period
+      return ap_stream->rate +
+             ( long ) ( delta * ( 1 - cos( 2 * M_PI * phase ) ) / 2 );
+    }
+    default:
+    {
+      return ap_stream->rate;
+    }
+  }
+}
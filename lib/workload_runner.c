@@ -0,0 +1,416 @@
+#include "csender.h"
+#include "allocation_check.h"
+#include "arena.h"
+#include "clock.h"
+#include "pacing.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// How often the rate of every connection follows the profile of its stream
+#define RATE_UPDATE_INTERVAL_NS 10000000LL
+
+// Room for the buffers of the send loop of a thread, cache line aligned
+#define WORKER_ARENA_LENGTH ( 64 * 1024 )
+#define WORKER_BUFFER_ALIGNMENT 64
+
+// One connection of a stream, paced on its own
+struct workload_lane
+{
+  const struct csender_stream_options*   p_stream;
+  int                                    stream_index;
+  int                                    connection_index;  // In the stream
+  struct csender_generator*              p_generator;
+  struct csender_transport*              p_transport;
+  struct csender_stats*                  p_stats;
+  int64_t                                interval_ns;       // 0 when idle
+  int64_t                                next_send_ns;
+  int64_t                                next_rate_update_ns;
+  bool                                   failed;
+};
+
+struct workload_worker
+{
+  pthread_t                         thread;
+  bool                              thread_started;
+  struct workload_lane**            pp_lanes;
+  int                               num_lanes;
+  struct csender_workload_runner*   p_runner;
+};
+
+struct csender_workload_runner
+{
+  const struct csender_workload*   p_workload;
+  struct workload_lane*            p_lanes;
+  int                              num_lanes;
+  struct workload_worker*          p_workers;
+  int                              num_workers;
+  volatile bool                    stop_requested;
+  int64_t                          start_ns;
+  atomic_int                       num_workers_running;
+};
+
+
+// The connections of a stream split its rate evenly, the first ones taking
+// the remainder. A lane left with no rate sends nothing until the next update.
+static void update_lane_rate( struct workload_lane* ap_lane, int64_t a_now_ns,
+                              int64_t a_start_ns )
+{
+  long stream_rate = csender_stream_rate_at( ap_lane->p_stream,
+                                             a_now_ns - a_start_ns );
+  int num_connections = ap_lane->p_stream->num_connections;
+  long rate = 0;
+  if( stream_rate > 0 )
+  {
+    rate = stream_rate / num_connections +
+           ( ap_lane->connection_index < stream_rate % num_connections );
+  }
+
+  ap_lane->interval_ns = ( rate > 0 ) ? NS_PER_SECOND / rate : 0;
+  ap_lane->next_rate_update_ns = a_now_ns + RATE_UPDATE_INTERVAL_NS;
+}
+
+
+// Returns false if the event could not be sent, with the allocation check
+// suspended for the report
+static bool send_lane_event( struct workload_lane* ap_lane, char* a_buffer )
+{
+  size_t event_length = 0;
+  if( csender_generator_next( ap_lane->p_generator,
+                              a_buffer,
+                              &event_length,
+                              NULL ) != 0 )
+  {
+    allocation_check_end( );
+    fprintf( stderr,
+             "It was not possible to generate a new event of stream %s.\n",
+             ap_lane->p_stream->name );
+    return false;
+  }
+
+  int64_t send_start_ns = monotonic_ns( );
+  int num_send_calls = csender_transport_send( ap_lane->p_transport,
+                                               a_buffer,
+                                               event_length );
+  if( num_send_calls < 0 )
+  {
+    allocation_check_end( );
+    csender_stats_add( ap_lane->p_stats, 0, 0, 1 );
+    fprintf( stderr,
+             "It was not possible to send an event of stream %s: %s\n",
+             ap_lane->p_stream->name,
+             strerror( errno ) );
+    return false;
+  }
+
+  csender_stats_record_send_time( ap_lane->p_stats,
+                                  monotonic_ns( ) - send_start_ns );
+  csender_stats_count_send_calls( ap_lane->p_stats, num_send_calls );
+  csender_stats_add( ap_lane->p_stats, 1, event_length, 0 );
+  csender_stats_count_severity(
+      ap_lane->p_stats,
+      csender_generator_last_severity( ap_lane->p_generator ) );
+
+  return true;
+}
+
+
+static void* worker_main( void* ap_worker )
+{
+  struct workload_worker* p_worker = ap_worker;
+  struct csender_workload_runner* p_runner = p_worker->p_runner;
+
+  struct arena arena;
+  char* syslog_event = NULL;
+  if( arena_init( &arena, WORKER_ARENA_LENGTH ) )
+  {
+    syslog_event = arena_alloc( &arena,
+                                CSENDER_EVENT_BUFFER_LENGTH,
+                                WORKER_BUFFER_ALIGNMENT );
+  }
+  if( syslog_event == NULL )
+  {
+    fprintf( stderr, "It was not possible to set up the buffers of a sender "
+             "thread.\n" );
+  }
+
+  long num_events_sent = 0;
+  while( syslog_event != NULL && !p_runner->stop_requested )
+  {
+    // Next lane due. A thread has just a few of them, so a scan is enough.
+    struct workload_lane* p_lane = NULL;
+    for( int i = 0; i < p_worker->num_lanes; i++ )
+    {
+      struct workload_lane* p_candidate = p_worker->pp_lanes[ i ];
+      if( !p_candidate->failed &&
+          ( p_lane == NULL ||
+            p_candidate->next_send_ns < p_lane->next_send_ns ) )
+      {
+        p_lane = p_candidate;
+      }
+    }
+
+    if( p_lane == NULL )
+    {
+      break;
+    }
+
+    int64_t now_ns = monotonic_ns( );
+    if( now_ns < p_lane->next_send_ns )
+    {
+      if( p_lane->next_send_ns - now_ns >= MIN_PACING_SLEEP_NS )
+      {
+        sleep_until_ns( p_lane->next_send_ns );
+      }
+
+      continue;
+    }
+
+    if( now_ns >= p_lane->next_rate_update_ns )
+    {
+      update_lane_rate( p_lane, now_ns, p_runner->start_ns );
+    }
+
+    if( p_lane->interval_ns == 0 )
+    {
+      p_lane->next_send_ns = p_lane->next_rate_update_ns;
+      continue;
+    }
+
+    if( now_ns - p_lane->next_send_ns > MAX_PACING_BACKLOG_NS )
+    {
+      p_lane->next_send_ns = now_ns - MAX_PACING_BACKLOG_NS;
+    }
+    p_lane->next_send_ns += p_lane->interval_ns;
+
+    // A broken connection stops just its own lane, and the other lanes are
+    // still checked
+    if( !send_lane_event( p_lane, syslog_event ) )
+    {
+      p_lane->failed = true;
+      if( num_events_sent >= ALLOCATION_CHECK_WARM_UP_EVENTS )
+      {
+        allocation_check_begin( );
+      }
+    }
+    else if( ++num_events_sent == ALLOCATION_CHECK_WARM_UP_EVENTS )
+    {
+      allocation_check_begin( );
+    }
+  }
+
+  allocation_check_end( );
+  arena_destroy( &arena );
+  atomic_fetch_sub( &( p_runner->num_workers_running ), 1 );
+
+  return NULL;
+}
+
+
+struct csender_workload_runner* csender_workload_runner_create(
+    const struct csender_workload* ap_workload )
+{
+  if( ap_workload->num_threads <= 0 || ap_workload->num_streams <= 0 )
+  {
+    return NULL;
+  }
+
+  struct csender_workload_runner* p_runner = calloc( 1, sizeof *p_runner );
+  if( p_runner == NULL )
+  {
+    return NULL;
+  }
+
+  p_runner->p_workload = ap_workload;
+  atomic_init( &( p_runner->num_workers_running ), 0 );
+
+  for( int i = 0; i < ap_workload->num_streams; i++ )
+  {
+    p_runner->num_lanes += ap_workload->p_streams[ i ].num_connections;
+  }
+
+  p_runner->num_workers = ( ap_workload->num_threads < p_runner->num_lanes ) ?
+                              ap_workload->num_threads :
+                              p_runner->num_lanes;
+  p_runner->p_lanes = calloc( p_runner->num_lanes,
+                              sizeof *( p_runner->p_lanes ) );
+  p_runner->p_workers = calloc( p_runner->num_workers,
+                                sizeof *( p_runner->p_workers ) );
+  if( p_runner->p_lanes == NULL || p_runner->p_workers == NULL )
+  {
+    csender_workload_runner_destroy( p_runner );
+    return NULL;
+  }
+
+  // Lanes are dealt to the threads in turn, so that the connections of a
+  // stream end up on different threads
+  for( int i = 0; i < p_runner->num_workers; i++ )
+  {
+    struct workload_worker* p_worker = &( p_runner->p_workers[ i ] );
+    p_worker->p_runner = p_runner;
+    p_worker->pp_lanes =
+        calloc( p_runner->num_lanes / p_runner->num_workers + 1,
+                sizeof *( p_worker->pp_lanes ) );
+    if( p_worker->pp_lanes == NULL )
+    {
+      csender_workload_runner_destroy( p_runner );
+      return NULL;
+    }
+  }
+
+  int lane_index = 0;
+  for( int i = 0; i < ap_workload->num_streams; i++ )
+  {
+    const struct csender_stream_options* p_stream =
+        &( ap_workload->p_streams[ i ] );
+
+    for( int j = 0; j < p_stream->num_connections; j++, lane_index++ )
+    {
+      struct workload_lane* p_lane = &( p_runner->p_lanes[ lane_index ] );
+      p_lane->p_stream = p_stream;
+      p_lane->stream_index = i;
+      p_lane->connection_index = j;
+
+      struct csender_generator_options generator_options = p_stream->generator;
+      generator_options.hostname = ( p_stream->hostname[ 0 ] != '\0' ) ?
+                                       p_stream->hostname :
+                                       NULL;
+      generator_options.app_name = ( p_stream->app_name[ 0 ] != '\0' ) ?
+                                       p_stream->app_name :
+                                       NULL;
+      generator_options.stream_index += lane_index;
+
+      p_lane->p_generator = csender_generator_create( &generator_options );
+      p_lane->p_stats = csender_stats_create( );
+      p_lane->p_transport = csender_transport_connect( p_stream->target_name,
+                                                       p_stream->service_name );
+      if( p_lane->p_generator == NULL ||
+          p_lane->p_stats == NULL ||
+          p_lane->p_transport == NULL )
+      {
+        csender_workload_runner_destroy( p_runner );
+        return NULL;
+      }
+
+      struct workload_worker* p_worker =
+          &( p_runner->p_workers[ lane_index % p_runner->num_workers ] );
+      p_worker->pp_lanes[ p_worker->num_lanes++ ] = p_lane;
+    }
+  }
+
+  return p_runner;
+}
+
+
+int csender_workload_runner_start( struct csender_workload_runner* ap_runner )
+{
+  ap_runner->stop_requested = false;
+  ap_runner->start_ns = monotonic_ns( );
+  for( int i = 0; i < ap_runner->num_lanes; i++ )
+  {
+    ap_runner->p_lanes[ i ].next_send_ns = ap_runner->start_ns;
+    ap_runner->p_lanes[ i ].next_rate_update_ns = ap_runner->start_ns;
+  }
+
+  for( int i = 0; i < ap_runner->num_workers; i++ )
+  {
+    struct workload_worker* p_worker = &( ap_runner->p_workers[ i ] );
+
+    atomic_fetch_add( &( ap_runner->num_workers_running ), 1 );
+    if( pthread_create( &( p_worker->thread ),
+                        NULL,
+                        worker_main,
+                        p_worker ) != 0 )
+    {
+      atomic_fetch_sub( &( ap_runner->num_workers_running ), 1 );
+      fprintf( stderr, "It was not possible to create a sender thread.\n" );
+      csender_workload_runner_stop( ap_runner );
+      return -1;
+    }
+
+    p_worker->thread_started = true;
+  }
+
+  return 0;
+}
+
+
+void csender_workload_runner_stop( struct csender_workload_runner* ap_runner )
+{
+  ap_runner->stop_requested = true;
+
+  for( int i = 0; i < ap_runner->num_workers; i++ )
+  {
+    struct workload_worker* p_worker = &( ap_runner->p_workers[ i ] );
+    if( p_worker->thread_started )
+    {
+      pthread_join( p_worker->thread, NULL );
+      p_worker->thread_started = false;
+    }
+  }
+}
+
+
+bool csender_workload_runner_is_running(
+    const struct csender_workload_runner* ap_runner )
+{
+  return atomic_load( &( ap_runner->num_workers_running ) ) > 0;
+}
+
+
+void csender_workload_runner_stream_stats(
+    const struct csender_workload_runner* ap_runner,
+    int a_stream_index,
+    struct csender_stats_snapshot* ap_output_snapshot )
+{
+  memset( ap_output_snapshot, 0, sizeof *ap_output_snapshot );
+
+  for( int i = 0; i < ap_runner->num_lanes; i++ )
+  {
+    if( ap_runner->p_lanes[ i ].stream_index == a_stream_index )
+    {
+      struct csender_stats_snapshot lane_snapshot;
+      csender_stats_snapshot( ap_runner->p_lanes[ i ].p_stats, &lane_snapshot );
+      csender_stats_snapshot_accumulate( ap_output_snapshot, &lane_snapshot );
+    }
+  }
+}
+
+
+void csender_workload_runner_destroy(
+    struct csender_workload_runner* ap_runner )
+{
+  if( ap_runner == NULL )
+  {
+    return;
+  }
+
+  csender_workload_runner_stop( ap_runner );
+
+  if( ap_runner->p_lanes != NULL )
+  {
+    for( int i = 0; i < ap_runner->num_lanes; i++ )
+    {
+      struct workload_lane* p_lane = &( ap_runner->p_lanes[ i ] );
+      csender_transport_close( p_lane->p_transport );
+      csender_stats_destroy( p_lane->p_stats );
+      csender_generator_destroy( p_lane->p_generator );
+    }
+  }
+
+  if( ap_runner->p_workers != NULL )
+  {
+    for( int i = 0; i < ap_runner->num_workers; i++ )
+    {
+      free( ap_runner->p_workers[ i ].pp_lanes );
+    }
+  }
+
+  free( ap_runner->p_workers );
+  free( ap_runner->p_lanes );
+  free( ap_runner );
+}
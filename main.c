@@ -1,262 +1,566 @@
+#include "csender.h"
+
 #include <arpa/inet.h>
 #include <getopt.h>
 #include <netdb.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/socket.h>
 #include <sys/types.h>
 #include <time.h>
-#include <unistd.h>
 
-#define DATETIME_LENGTH 28
-#define SYSLOG_MSG_MAXLENGTH 1024
-#define SYSLOG_HEADER_LENGTH 62
 #define STATISTICS_INTERVAL 1
 
 struct csender_arguments
 {
   char*    hostname;
   char*    servicename;
-  size_t   event_length;
+  int      num_threads;
+  long     rate;
+  long     num_checksum_events;
+  bool     find_max;
+  struct csender_find_max_options find_max_options;
+  bool     adaptive;
+  struct csender_adaptive_options adaptive_options;
+  char*    workload_file_name;
+  char*    corpus_file_name;
+  char*    dictionary_file_name;
+  char*    replay_file_name;
+  char*    import_file_name;
+  bool     port_given;
+  double   replay_speed;
+  bool     perf_counters;
+  enum csender_send_engine engine;
+  int      batch_size;
+  bool     udp;
+  bool     mptcp;
+  int      tx_timestamps;
+  char*    shm_path;
+  long     num_pack_events;
+  struct csender_generator_options generator;
 };
 
-int timestamp_rfc3339( char* ap_output_buffer,
-                       bool* ap_output_second_changed_since_last_call )
-{
-  int to_return = -1;
-  *ap_output_second_changed_since_last_call = false;
 
-  static int last_call_second = -1;
+// Generates the stream of every thread twice, with the synthetic clock, and
+// checks both passes match. Returns true if they do.
+bool check_determinism( const struct csender_arguments* ap_arguments )
+{
+  struct csender_generator_options options = ap_arguments->generator;
+  options.clock_source = CSENDER_CLOCK_SYNTHETIC;
 
-  // Fetch no. of seconds passed since epoch, and no. of nanoseconds into the
-  // next second.
-  struct timespec time_spec;
-  if( clock_gettime( CLOCK_REALTIME, &time_spec ) == 0 )
+  bool deterministic = true;
+  uint64_t combined_checksum = 0;
+  for( int i = 0; i < ap_arguments->num_threads; i++ )
   {
-    // Load a tm struct with those seconds
-    struct tm time;
-    if( localtime_r( &time_spec.tv_sec, &time ) != NULL )
+    uint64_t checksums[ 2 ];
+    uint64_t num_bytes[ 2 ];
+    for( int pass = 0; pass < 2; pass++ )
     {
-      // Format the output string from the tm struct
-      size_t num_chars_copied = strftime( ap_output_buffer,
-                                          DATETIME_LENGTH,
-                                          "%FT%T.",
-                                          &time);
-
-      // Add the number of microseconds into the next second
-      snprintf( &( ap_output_buffer[ num_chars_copied ] ),
-                DATETIME_LENGTH - num_chars_copied,
-                "%6ldZ",
-                ( time_spec.tv_nsec / 1000 ) );
-
-      // Has the second field changed since the last call?
-      *ap_output_second_changed_since_last_call =
-          ( ( last_call_second != time.tm_sec ) &&
-            ( last_call_second >= 0 ) );
-
-      last_call_second = time.tm_sec;
-      to_return = 0;
+      options.stream_index = ap_arguments->generator.stream_index + i;
+      struct csender_generator* p_generator = csender_generator_create( &options );
+      if( p_generator == NULL )
+      {
+        printf( "It was not possible to create a generator.\n" );
+        return false;
+      }
+
+      checksums[ pass ] =
+          csender_generator_checksum( p_generator,
+                                      ap_arguments->num_checksum_events,
+                                      &( num_bytes[ pass ] ) );
+      csender_generator_destroy( p_generator );
     }
+
+    printf( "stream %4d: %10ld events, %12lu bytes, checksum %016lx\n",
+            i,
+            ap_arguments->num_checksum_events,
+            ( unsigned long ) num_bytes[ 0 ],
+            ( unsigned long ) checksums[ 0 ] );
+
+    deterministic = deterministic && ( checksums[ 0 ] == checksums[ 1 ] ) &&
+                    ( num_bytes[ 0 ] == num_bytes[ 1 ] );
+    combined_checksum = combined_checksum * 31 + checksums[ 0 ];
   }
 
-  return to_return;
+  printf( "seed %lu, combined checksum %016lx: %s\n",
+          ( unsigned long ) ap_arguments->generator.seed,
+          ( unsigned long ) combined_checksum,
+          deterministic ? "deterministic" : "NOT deterministic" );
+
+  return deterministic;
+}
+
+
+void print_find_max_step( const struct csender_find_max_step* ap_step,
+                          void* ap_user_data )
+{
+  ( void ) ap_user_data;
+
+  printf( "%9ld events/sec offered, %9.0f achieved, send p99: %9.1f us, "
+          "%2d sec. -> %s\n",
+          ap_step->offered_rate,
+          ap_step->achieved_rate,
+          ap_step->p99_send_time_ns / 1000.0,
+          ap_step->num_seconds,
+          ap_step->sustained ? "sustained" : "NOT sustained" );
+  fflush( stdout );
 }
 
 
-void generate_event_body( size_t a_event_length,
-                          char* a_output_body )
+// Returns true if the search could be completed
+bool find_max_rate( struct csender_runner* ap_runner,
+                    const struct csender_arguments* ap_arguments )
 {
-  size_t body_length = a_event_length - ( SYSLOG_HEADER_LENGTH + 1 );
+  struct csender_find_max_result result;
+  if( csender_find_max( ap_runner,
+                        &( ap_arguments->find_max_options ),
+                        print_find_max_step,
+                        NULL,
+                        &result ) != 0 )
+  {
+    printf( "The search was interrupted, as sending stopped.\n" );
+    return false;
+  }
 
-  // Fill the event body with a random character, between 65 ('A') and 90 ('Z')
-  memset( a_output_body, 65 + ( rand( ) % 25 ), body_length );
+  if( result.max_sustained_rate > 0 )
+  {
+    printf( "\nMax. sustained rate: %ld events/sec (send p99: %.1f us), "
+            "after %d steps.\n",
+            result.max_sustained_rate,
+            result.p99_send_time_ns / 1000.0,
+            result.num_steps );
+  }
+  else
+  {
+    printf( "\nNo rate could be sustained, after %d steps.\n",
+            result.num_steps );
+  }
 
-  // Null-terminate the event
-  sprintf( a_output_body + body_length, "\n%s", "\0" );
+  return true;
 }
 
 
-void generate_event( char* a_output_event,
-                     const char* a_timestamp,
-                     const struct csender_arguments* ap_arguments )
+// Appends the events sent of every severity there was any of
+void print_severities( const struct csender_stats_snapshot* ap_snapshot )
 {
-  // First add the event header
-  sprintf( a_output_event,
-           "<13>%s localhost.localdomain my.app: %s",
-           a_timestamp,
-           "\0" );
-  char* a_output_event_end = a_output_event + strlen( a_output_event );
-
-  // Then append the event body
-  generate_event_body( ap_arguments->event_length, a_output_event_end );
+  const char* p_separator = " (";
+  for( int i = 0; i < CSENDER_NUM_SEVERITIES; i++ )
+  {
+    if( ap_snapshot->num_events_by_severity[ i ] > 0 )
+    {
+      printf( "%s%s %ld",
+              p_separator,
+              csender_severity_name( i ),
+              ap_snapshot->num_events_by_severity[ i ] );
+      p_separator = ", ";
+    }
+  }
+
+  if( p_separator[ 0 ] == ',' )
+  {
+    printf( ")" );
+  }
 }
 
 
-void send_events( int a_socket, const struct csender_arguments* ap_arguments )
-{    
-  // Set seed for random numbers generation
-  srand( ( unsigned int ) time( NULL ) );
+// System calls the events of the last interval were sent with, and the time
+// spent in them (as many threads as were busy in them all along)
+void print_send_calls( const struct csender_stats_snapshot* ap_snapshot,
+                       const struct csender_stats_snapshot* ap_previous_snapshot,
+                       long a_interval_ns )
+{
+  long num_calls = ap_snapshot->num_send_calls -
+                   ap_previous_snapshot->num_send_calls;
+  long num_events = ap_snapshot->num_events_sent -
+                    ap_previous_snapshot->num_events_sent;
+  long num_bytes = ap_snapshot->num_bytes_sent -
+                   ap_previous_snapshot->num_bytes_sent;
+  double send_time_ns = ( double ) ( ap_snapshot->send_time_ns -
+                                     ap_previous_snapshot->send_time_ns );
 
-  char timestamp[ DATETIME_LENGTH ];
-  char syslog_event[ SYSLOG_MSG_MAXLENGTH + 1 ];
+  printf( "     send calls: %.0f/sec",
+          num_calls * 1e9 / a_interval_ns );
+  if( num_calls > 0 )
+  {
+    printf( ", %.2f events and %.0f bytes per call, %.2f us per call "
+            "(%.2f threads busy in them)",
+            ( double ) num_events / num_calls,
+            ( double ) num_bytes / num_calls,
+            send_time_ns / num_calls / 1000.0,
+            send_time_ns / a_interval_ns );
+  }
+  printf( "\n" );
+}
 
-  bool second_changed_since_last_timestamp = false;
-  long num_second_changes = -1;
-  long num_events_sent = 0;
 
-  while( 1 )
+// Percentiles of the latencies of the events sampled during the last interval
+void print_latencies( const char* a_label,
+                      const struct csender_histogram* ap_histogram )
+{
+  uint64_t num_samples = csender_histogram_count( ap_histogram );
+  printf( "     %s: %lu sampled", a_label, ( unsigned long ) num_samples );
+  if( num_samples > 0 )
   {
-    // Generate a timestamp. Has a full second passed since the last second
-    // change?
-    if( timestamp_rfc3339( timestamp,
-                           &second_changed_since_last_timestamp ) == 0 )
-    {
-      if( second_changed_since_last_timestamp )
-      {
-        num_second_changes++;
-      }     
+    printf( ", p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us",
+            csender_histogram_percentile( ap_histogram, 50 ) / 1000.0,
+            csender_histogram_percentile( ap_histogram, 90 ) / 1000.0,
+            csender_histogram_percentile( ap_histogram, 99 ) / 1000.0,
+            csender_histogram_percentile( ap_histogram, 100 ) / 1000.0 );
+  }
+  printf( "\n" );
+}
 
-      if( num_second_changes >= 0 )
-      {
-        // Send a new event, from the just generated timestamp
-        generate_event( syslog_event, timestamp, ap_arguments );
-        send( a_socket, syslog_event, strlen( syslog_event ), 0 );
-        num_events_sent++;
-      }
 
-      // Inform user, every few seconds...
-      if( second_changed_since_last_timestamp &&
-          num_second_changes >= 1 &&
-          num_second_changes % STATISTICS_INTERVAL == 0 )
-      {        
-        printf( "%4ld sec. %10ld events sent, avg: %ld events/sec\n",
-                num_second_changes,
-                num_events_sent,
-                num_events_sent / num_second_changes );
-      }
+// Every subflow of the connection of every sender thread, with its share of
+// the bytes acknowledged
+void print_subflows( const struct csender_runner* ap_runner, int a_num_threads )
+{
+  for( int i = 0; i < a_num_threads; i++ )
+  {
+    struct csender_subflow_info subflows[ CSENDER_MAX_SUBFLOWS ];
+    int num_subflows = csender_runner_subflows( ap_runner,
+                                                i,
+                                                subflows,
+                                                CSENDER_MAX_SUBFLOWS );
+    if( num_subflows < 0 )
+    {
+      printf( "     connection %d: plain TCP\n", i );
+      continue;
     }
-    else
+
+    uint64_t num_bytes_acked = 0;
+    for( int j = 0; j < num_subflows; j++ )
     {
-      printf( "It was not possible to generate a new timestamp.\n" );
-      break;
+      num_bytes_acked += subflows[ j ].num_bytes_acked;
+    }
+
+    for( int j = 0; j < num_subflows; j++ )
+    {
+      const struct csender_subflow_info* p_subflow = &( subflows[ j ] );
+      printf( "     connection %d, subflow %d: %s -> %s, %.1f MB acked "
+              "(%.0f%%), rtt %.2f ms, cwnd %u, %u retransmits\n",
+              i,
+              j,
+              p_subflow->local_endpoint,
+              p_subflow->remote_endpoint,
+              p_subflow->num_bytes_acked / 1e6,
+              ( num_bytes_acked > 0 ) ?
+                  100.0 * p_subflow->num_bytes_acked / num_bytes_acked :
+                  0.0,
+              p_subflow->rtt_us / 1000.0,
+              p_subflow->congestion_window,
+              p_subflow->num_retransmits );
     }
   }
 }
 
 
-void* get_in_addr( struct sockaddr* ap_socket_address )
+// What the events of the last interval cost the CPU, each. The share of the
+// cycles spent in the kernel tells runs bound by system calls from those bound
+// by generating events.
+void print_perf_counters( const struct csender_perf_sample* ap_sample,
+                          const struct csender_perf_sample* ap_previous_sample,
+                          long a_num_events,
+                          long a_interval_ns )
 {
-  void* p_socket_address = ( void* ) ap_socket_address;
+  double deltas[ CSENDER_NUM_PERF_COUNTERS ];
+  for( int i = 0; i < CSENDER_NUM_PERF_COUNTERS; i++ )
+  {
+    deltas[ i ] = ( double ) ( ap_sample->values[ i ] -
+                               ap_previous_sample->values[ i ] );
+  }
+
+  const bool* p_available = ap_sample->available;
+  printf( "     cpu:" );
+  const char* p_separator = " ";
+  if( p_available[ CSENDER_PERF_TASK_CLOCK ] )
+  {
+    printf( " %.2f cores", deltas[ CSENDER_PERF_TASK_CLOCK ] / a_interval_ns );
+    p_separator = ", ";
+  }
+  if( p_available[ CSENDER_PERF_CONTEXT_SWITCHES ] )
+  {
+    printf( "%s%.0f context switches/sec",
+            p_separator,
+            deltas[ CSENDER_PERF_CONTEXT_SWITCHES ] * 1e9 / a_interval_ns );
+  }
 
-  // IPv4 or IPv6?
-  if ( ap_socket_address->sa_family == AF_INET)
+  if( a_num_events > 0 )
   {
-    return &( ( ( struct sockaddr_in* ) p_socket_address )->sin_addr );
+    printf( ", per event:" );
+    if( p_available[ CSENDER_PERF_TASK_CLOCK ] )
+    {
+      printf( " %.0f ns on a CPU",
+              deltas[ CSENDER_PERF_TASK_CLOCK ] / a_num_events );
+    }
+    if( p_available[ CSENDER_PERF_CYCLES ] )
+    {
+      printf( " %.0f cycles", deltas[ CSENDER_PERF_CYCLES ] / a_num_events );
+      if( p_available[ CSENDER_PERF_USER_CYCLES ] &&
+          deltas[ CSENDER_PERF_CYCLES ] > 0 )
+      {
+        printf( " (%.0f%% kernel)",
+                100.0 * ( 1.0 - deltas[ CSENDER_PERF_USER_CYCLES ] /
+                                deltas[ CSENDER_PERF_CYCLES ] ) );
+      }
+    }
+    if( p_available[ CSENDER_PERF_INSTRUCTIONS ] )
+    {
+      printf( " %.0f instructions",
+              deltas[ CSENDER_PERF_INSTRUCTIONS ] / a_num_events );
+      if( p_available[ CSENDER_PERF_CYCLES ] &&
+          deltas[ CSENDER_PERF_CYCLES ] > 0 )
+      {
+        printf( " (IPC %.2f)",
+                deltas[ CSENDER_PERF_INSTRUCTIONS ] /
+                deltas[ CSENDER_PERF_CYCLES ] );
+      }
+    }
+    if( p_available[ CSENDER_PERF_CACHE_MISSES ] )
+    {
+      printf( " %.3f cache misses",
+              deltas[ CSENDER_PERF_CACHE_MISSES ] / a_num_events );
+    }
+    if( p_available[ CSENDER_PERF_BRANCH_MISSES ] )
+    {
+      printf( " %.3f branch misses",
+              deltas[ CSENDER_PERF_BRANCH_MISSES ] / a_num_events );
+    }
   }
 
-  return &( ( ( struct sockaddr_in6* ) p_socket_address )->sin6_addr );
+  printf( "\n" );
 }
 
 
-int create_socket_and_connect_from_info_list( const struct addrinfo* ap_list,
-                                              const char* a_target_name,
-                                              const char* a_service_name )
+// In adaptive mode, the rate is also adjusted at every report, and every
+// decision is printed along with the stats, tracing the rate over time.
+void report_statistics( struct csender_runner* ap_runner,
+                        struct csender_adaptive* ap_adaptive,
+                        const struct csender_arguments* ap_arguments )
 {
-  int socket_fd_to_return = -1;
+  struct timespec start_time;
+  clock_gettime( CLOCK_MONOTONIC, &start_time );
 
-  // Traverse the given items, creating sockets based on them. Connect to the
-  // first one that can be created.
-  const struct addrinfo* p_current_addrinfo = NULL;
-  for( p_current_addrinfo = ap_list;
-       p_current_addrinfo != NULL;
-       p_current_addrinfo = p_current_addrinfo->ai_next )
+  // Of the previous report, for the counters of the interval
+  struct csender_stats_snapshot previous_snapshot;
+  memset( &previous_snapshot, 0, sizeof previous_snapshot );
+  struct csender_perf_sample previous_perf_sample;
+  memset( &previous_perf_sample, 0, sizeof previous_perf_sample );
+  struct csender_histogram previous_qdisc_times, previous_ack_times;
+  csender_histogram_clear( &previous_qdisc_times );
+  csender_histogram_clear( &previous_ack_times );
+
+  long num_seconds = 0;
+  while( csender_runner_is_running( ap_runner ) )
   {
-    socket_fd_to_return =
-        socket( p_current_addrinfo->ai_family,
-                p_current_addrinfo->ai_socktype,
-                p_current_addrinfo->ai_protocol );
+    // Wait until the next whole second since the start
+    num_seconds++;
+    struct timespec wake_up_time = start_time;
+    wake_up_time.tv_sec += num_seconds;
+    clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &wake_up_time, NULL );
 
-    if( socket_fd_to_return != -1 )
+    // Inform user, every few seconds...
+    if( num_seconds % STATISTICS_INTERVAL == 0 )
     {
-      if( connect( socket_fd_to_return,
-                   p_current_addrinfo->ai_addr,
-                   p_current_addrinfo->ai_addrlen) != -1 )
+      struct csender_stats_snapshot snapshot;
+      csender_runner_stats( ap_runner, &snapshot );
+
+      printf( "%4ld sec. %10ld events sent, avg: %ld events/sec",
+              num_seconds,
+              snapshot.num_events_sent,
+              snapshot.num_events_sent / num_seconds );
+      print_severities( &snapshot );
+
+      struct csender_adaptive_step step;
+      if( ap_adaptive != NULL &&
+          csender_adaptive_update( ap_adaptive, &step ) == 0 )
       {
-        // Tell the user a connection has been established
-        char ip_address[ INET6_ADDRSTRLEN ];
+        printf( ", rate: %ld -> %ld (achieved %.0f, send p99: %.1f us, "
+                "send queue: %ld bytes)%s",
+                step.rate,
+                step.next_rate,
+                step.achieved_rate,
+                step.p99_send_time_ns / 1000.0,
+                step.send_queue_bytes,
+                step.congested ? " congested" : "" );
+      }
 
-        inet_ntop( p_current_addrinfo->ai_family,
-                   get_in_addr( (struct sockaddr *)p_current_addrinfo->ai_addr),
-                   ip_address,
-                   sizeof ip_address );
+      printf( "\n" );
 
-        printf( "\nA connection with the target (%s:%s) has been established. "
-                "Sending events...\n\n",
-                ( strcmp( ip_address, a_target_name ) == 0 ) ? ip_address :
-                                                               a_target_name,
-                a_service_name );
+      print_send_calls( &snapshot,
+                        &previous_snapshot,
+                        STATISTICS_INTERVAL * 1000000000L );
 
-        // Just abandon the loop, once the socket has been created and
-        // connected.
-        break;
+      struct csender_perf_sample perf_sample;
+      if( ap_arguments->perf_counters &&
+          csender_runner_perf_counters( ap_runner, &perf_sample ) )
+      {
+        print_perf_counters( &perf_sample,
+                             &previous_perf_sample,
+                             snapshot.num_events_sent -
+                                 previous_snapshot.num_events_sent,
+                             STATISTICS_INTERVAL * 1000000000L );
+        previous_perf_sample = perf_sample;
+      }
+
+      if( ap_arguments->tx_timestamps > 0 )
+      {
+        struct csender_histogram qdisc_times, ack_times;
+        csender_runner_tx_latencies( ap_runner, &qdisc_times, &ack_times );
+
+        struct csender_histogram interval_times = qdisc_times;
+        csender_histogram_subtract( &interval_times, &previous_qdisc_times );
+        print_latencies( "in qdisc", &interval_times );
+        interval_times = ack_times;
+        csender_histogram_subtract( &interval_times, &previous_ack_times );
+        print_latencies( "until ACK", &interval_times );
+
+        previous_qdisc_times = qdisc_times;
+        previous_ack_times = ack_times;
       }
-      else
+
+      if( ap_arguments->mptcp )
       {
-        socket_fd_to_return = -1;
-        close( socket_fd_to_return );
-        perror( "It was not possible to connect to the specified target" );
+        print_subflows( ap_runner, ap_arguments->num_threads );
       }
+      previous_snapshot = snapshot;
+
+      fflush( stdout );
     }
-    else
+  }
+}
+
+
+// Totals, and the rate of every stream during the last interval
+void report_workload_statistics( struct csender_workload_runner* ap_runner,
+                                 const struct csender_workload* ap_workload )
+{
+  long* p_previous_events = calloc( ap_workload->num_streams, sizeof( long ) );
+  if( p_previous_events == NULL )
+  {
+    return;
+  }
+
+  struct csender_stats_snapshot previous_total;
+  memset( &previous_total, 0, sizeof previous_total );
+
+  struct timespec start_time;
+  clock_gettime( CLOCK_MONOTONIC, &start_time );
+
+  long num_seconds = 0;
+  while( csender_workload_runner_is_running( ap_runner ) )
+  {
+    num_seconds++;
+    struct timespec wake_up_time = start_time;
+    wake_up_time.tv_sec += num_seconds;
+    clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &wake_up_time, NULL );
+
+    if( num_seconds % STATISTICS_INTERVAL == 0 )
     {
-      perror( "Error while creating socket" );
+      struct csender_stats_snapshot total;
+      memset( &total, 0, sizeof total );
+
+      struct csender_stats_snapshot* p_snapshots =
+          calloc( ap_workload->num_streams, sizeof *p_snapshots );
+      if( p_snapshots == NULL )
+      {
+        break;
+      }
+
+      for( int i = 0; i < ap_workload->num_streams; i++ )
+      {
+        csender_workload_runner_stream_stats( ap_runner, i,
+                                              &( p_snapshots[ i ] ) );
+        csender_stats_snapshot_accumulate( &total, &( p_snapshots[ i ] ) );
+      }
+
+      printf( "%4ld sec. %10ld events sent, avg: %ld events/sec\n",
+              num_seconds,
+              total.num_events_sent,
+              total.num_events_sent / num_seconds );
+      print_send_calls( &total,
+                        &previous_total,
+                        STATISTICS_INTERVAL * 1000000000L );
+      previous_total = total;
+
+      for( int i = 0; i < ap_workload->num_streams; i++ )
+      {
+        const struct csender_stream_options* p_stream =
+            &( ap_workload->p_streams[ i ] );
+        printf( "     %-20s %10ld events sent, %8ld events/sec (target %ld), "
+                "%ld errors",
+                p_stream->name,
+                p_snapshots[ i ].num_events_sent,
+                ( p_snapshots[ i ].num_events_sent - p_previous_events[ i ] ) /
+                    STATISTICS_INTERVAL,
+                csender_stream_rate_at( p_stream,
+                                        num_seconds * 1000000000LL ),
+                p_snapshots[ i ].num_send_errors );
+        print_severities( &( p_snapshots[ i ] ) );
+        printf( "\n" );
+        p_previous_events[ i ] = p_snapshots[ i ].num_events_sent;
+      }
+
+      free( p_snapshots );
+      fflush( stdout );
     }
   }
 
-  return socket_fd_to_return;
+  free( p_previous_events );
 }
 
 
-int create_socket_and_connect( const char* a_target_name,
-                               const char* a_service_name )
+// Sends the streams of the workload file, until all of them stop. Returns
+// the exit code.
+int send_workload( const struct csender_arguments* ap_arguments )
 {
-  int socket_fd_to_return = -1;
-
-  // Create a 'hints' struct, in order to specify which connection endtype is
-  // wanted.
-  struct addrinfo hints;
-  memset( &hints, 0, sizeof hints );
-  hints.ai_family = AF_UNSPEC;     // Both IPv4 and IPv6 addresses are wanted
-  hints.ai_socktype = SOCK_STREAM; // TCP socket
-
-  // Fetch addrinfo items, from the hints above and the server and service names
-  struct addrinfo* p_addrinfo_list = NULL;
-  int error_code = getaddrinfo( a_target_name,
-                                a_service_name,
-                                &hints,
-                                &p_addrinfo_list );
+  // The options given on the command line are the defaults of every stream
+  struct csender_stream_options defaults;
+  memset( &defaults, 0, sizeof defaults );
+  snprintf( defaults.target_name, sizeof defaults.target_name, "%s",
+            ap_arguments->hostname );
+  snprintf( defaults.service_name, sizeof defaults.service_name, "%s",
+            ap_arguments->servicename );
+  defaults.generator = ap_arguments->generator;
+  defaults.rate = ap_arguments->rate;
+  defaults.rate_profile = CSENDER_RATE_CONSTANT;
+  defaults.num_connections = 1;
 
-  if( error_code == 0 && p_addrinfo_list != NULL )
+  struct csender_workload* p_workload =
+      csender_workload_load( ap_arguments->workload_file_name,
+                             &defaults,
+                             ap_arguments->num_threads );
+  if( p_workload == NULL )
   {
-    // Actually create a socket, and connect it to the target
-    socket_fd_to_return =
-        create_socket_and_connect_from_info_list( p_addrinfo_list,
-                                                  a_target_name,
-                                                  a_service_name );
+    return 1;
+  }
 
-    // Free mem storing the addrinfo items
-    freeaddrinfo( p_addrinfo_list );
+  struct csender_workload_runner* p_runner =
+      csender_workload_runner_create( p_workload );
+  if( p_runner == NULL )
+  {
+    csender_workload_destroy( p_workload );
+    return 1;
   }
-  else
+
+  printf( "\nConnections for the %d streams of %s have been established. "
+          "Sending events (seed %lu)...\n\n",
+          p_workload->num_streams,
+          ap_arguments->workload_file_name,
+          ( unsigned long ) ap_arguments->generator.seed );
+
+  if( csender_workload_runner_start( p_runner ) == 0 )
   {
-    fprintf( stderr,
-             "Error on getaddrinfo(): %s\n",
-             gai_strerror( error_code));
+    report_workload_statistics( p_runner, p_workload );
   }
 
-  return socket_fd_to_return;
+  csender_workload_runner_destroy( p_runner );
+  csender_workload_destroy( p_workload );
+
+  // Sender threads only stop on errors
+  return 1;
 }
 
 
@@ -279,19 +583,6 @@ char* trim_initial_slashes( char* a_program_name )
 }
 
 
-size_t min_event_length( )
-{
-  // Minimum: The syslog information + trailing \n + 1 character
-  return SYSLOG_HEADER_LENGTH + 1 + 1;
-}
-
-
-size_t max_event_length( )
-{
-  return SYSLOG_MSG_MAXLENGTH;
-}
-
-
 void print_usage( char* a_program_name )
 {
   printf( "%s. A program that sends syslog events to a receiver. Written "
@@ -299,11 +590,86 @@ void print_usage( char* a_program_name )
           trim_initial_slashes( a_program_name ) );
   printf( "usage:\n"
           "    csender [option]...\n"
+          "    csender pack FILE [option]...   Render the events of the options, or --import those of a capture,\n"
+          "                                    into FILE, to --replay them.\n"
+          "    csender shm SOCKET [option]...  Read the events of writers started with --shm SOCKET, framed as\n"
+          "                                    --framing, and report how fast they come.\n"
           "options:\n"
           "    -h, --help      Print this help.\n"
           "    -H, --host      Address or name of the host to send events to. Default: 127.0.0.1.\n"
           "    -p, --port      Port or service name to send events to. Default: 8000.\n"
-          "    -l, --length    Length (in chars) of the events to send [%ld-%ld]. Default: 300\n", min_event_length(), max_event_length() );
+          "    -l, --length    Length (in chars) of the events to send [%ld-%ld]. Default: 300\n"
+          "    -t, --threads   No. of sender threads, each one with its own connection. Default: 1.\n"
+          "    -c, --clock     Clock to timestamp events with [realtime, coarse, tsc, synthetic]. Default: realtime.\n"
+          "    -z, --timezone  Time zone of timestamps [utc, local]. Default: utc.\n"
+          "    -F, --framing   How events are delimited [lf, octet]. Default: lf.\n"
+          "    -S, --sequence  Start the body of every event with a sequence number.\n"
+          "    -f, --facility  Facilities to pick from, with their weights, e.g. local0:3,auth:1. Default: user.\n"
+          "    -v, --severity  Severities to pick from, with their weights, e.g. info:90,warning:9,err:1.\n"
+          "                    Default: notice.\n"
+          "    -b, --body      What fills the body of the events [random, multiline, corpus, utf8, words,\n"
+          "                    kv, json]. Multi-line, corpus, kv and json bodies set the length of their\n"
+          "                    events. Multi-line and corpus ones need octet framing to stay whole.\n"
+          "                    Default: random.\n"
+          "    -L, --lines     No. of lines of multi-line bodies, as MIN-MAX. Default: 5-30.\n"
+          "    -W, --line-length  Length of the lines of multi-line bodies, as MIN-MAX. Default: 40-120.\n"
+          "    -K, --corpus    File of bodies to replay, e.g. stack traces, separated by blank lines.\n"
+          "                    Implies --body corpus.\n"
+          "    -U, --utf8      Classes of characters of UTF-8 bodies, with their weights, among ascii, cyrillic,\n"
+          "                    cjk, emoji and invalid, e.g. ascii:80,cjk:15,invalid:5. Implies --body utf8.\n"
+          "                    Default: ascii:70,cyrillic:10,cjk:10,emoji:10.\n"
+          "    -B, --bom       Start UTF-8 bodies with a byte order mark.\n"
+          "    -D, --dictionary  File of words for word bodies, one per line, most frequent first, optionally\n"
+          "                    followed by their weights. Implies --body words. Default: a built-in one.\n"
+          "    -N, --fields    Fields of every object of kv and json bodies [1-%d]. Default: 8.\n"
+          "    -k, --keys      Distinct keys the fields are named from, at least as many as the fields\n"
+          "                    [1-%d]. Default: as many as the fields.\n"
+          "    -d, --depth     Levels of objects nested in the last field of kv and json bodies [0-%d].\n"
+          "                    Key-value ones spell them as outer.inner.key=value. Default: 0.\n"
+          "    -T, --value-types  Types of the values of kv and json bodies, with their weights, among int,\n"
+          "                    float, string and bool, e.g. int:3,string:1. Default: all the same.\n"
+          "    -n, --events    No. of events to pack. Default: 100000.\n"
+          "    -R, --replay    Send the events of a pack file, in turn, with new timestamps and sequence numbers.\n"
+          "                    Options of their contents do not apply.\n"
+          "    -I, --import    Pack the syslog events of a pcap or pcapng capture instead, UDP or TCP, framed as\n"
+          "                    --framing, and with the times they were captured at. With --port, just the\n"
+          "                    traffic to that port.\n"
+          "    -X, --speed     Send the events of a pack imported from a capture as they were captured, with their\n"
+          "                    own timestamps, at the given multiple of their original pace, e.g. 1 or 10.\n"
+          "    -u, --udp       Send every event as a UDP datagram, instead of through a TCP connection.\n"
+          "    -M, --mptcp     Connect with Multipath TCP, where the system offers it (falling back to TCP\n"
+          "                    otherwise), and report the subflows of every connection.\n"
+          "    -Z, --shm       Write events into a shared memory ring handed over by a csender shm reader\n"
+          "                    listening on the given Unix socket, instead of sending them.\n"
+          "    -e, --engine    How events are handed to the kernel [send, writev, sendmmsg, io_uring, udp_gso,\n"
+          "                    packet_ring]. writev is just for TCP, and udp_gso (UDP generic segmentation\n"
+          "                    offload, falling back to sendmmsg where not available) just for UDP. So is\n"
+          "                    packet_ring (Ethernet frames written to a PACKET_TX_RING, past the socket\n"
+          "                    layer), for IPv4 targets on other hosts or network namespaces, with\n"
+          "                    CAP_NET_RAW. Default: send.\n"
+          "    -y, --batch     Most events per batch handed to the engine [1-%d]. Batches are sent early\n"
+          "                    rather than held back by --rate. Default: 1.\n"
+          "    -x, --tx-timestamps  Have the kernel timestamp one in every given no. of events sent (TCP),\n"
+          "                    and report how long they waited in the queueing discipline, and for the\n"
+          "                    peer to acknowledge them, with no help from the receiver.\n"
+          "    -E, --perf      Also report what the events cost the CPU: cycles (and their share in the kernel),\n"
+          "                    instructions, cache and branch misses per event, and context switches, from\n"
+          "                    the performance counters of the sender threads that the system offers.\n"
+          "    -s, --seed      Seed of the random streams of the sender threads. Default: based on the current time.\n"
+          "    -C, --checksum  Do not send: generate the given no. of events per thread, with the synthetic\n"
+          "                    clock, twice, and print their checksums to confirm they are deterministic.\n"
+          "    -r, --rate      Events/sec to send, among all threads. Default: as many as possible.\n"
+          "    -m, --find-max  Search for the highest rate the target sustains, starting at --rate (or 10000).\n"
+          "    -a, --adaptive  Adapt the rate to the target, starting at --rate (or 10000): increase it while\n"
+          "                    the target keeps up, and cut it down when it pushes back.\n"
+          "    -A, --increase  Events/sec the adaptive rate grows by every second. Default: 1000.\n"
+          "    -Q, --max-queue Unsent bytes in the kernel, among all connections, that the adaptive rate\n"
+          "                    considers a push back. Default: 1048576.\n"
+          "    -w, --workload  Send the streams described in the given file, all at once. The options above\n"
+          "                    are the defaults of every stream.\n"
+          "    -P, --max-p99   Send time p99 (in us) a rate may cause to be considered sustained. Default: 1000.\n", csender_min_event_length(), csender_max_event_length(),
+          CSENDER_MAX_BODY_FIELDS, CSENDER_MAX_BODY_KEYS, CSENDER_MAX_BODY_DEPTH,
+          CSENDER_MAX_SEND_BATCH );
 }
 
 
@@ -313,7 +679,43 @@ bool process_argument_list( int argc,
 {
   ap_arguments->hostname = "127.0.0.1";
   ap_arguments->servicename = "8000";
-  ap_arguments->event_length = 300;
+  ap_arguments->num_threads = 1;
+  ap_arguments->rate = 0;
+  ap_arguments->num_checksum_events = 0;
+  ap_arguments->find_max = false;
+  csender_find_max_options_init( &( ap_arguments->find_max_options ) );
+  ap_arguments->adaptive = false;
+  csender_adaptive_options_init( &( ap_arguments->adaptive_options ) );
+  ap_arguments->workload_file_name = NULL;
+  ap_arguments->corpus_file_name = NULL;
+  ap_arguments->dictionary_file_name = NULL;
+  ap_arguments->replay_file_name = NULL;
+  ap_arguments->import_file_name = NULL;
+  ap_arguments->port_given = false;
+  ap_arguments->replay_speed = 0;
+  ap_arguments->perf_counters = false;
+  ap_arguments->engine = CSENDER_ENGINE_SEND;
+  ap_arguments->batch_size = 1;
+  ap_arguments->udp = false;
+  ap_arguments->mptcp = false;
+  ap_arguments->tx_timestamps = 0;
+  ap_arguments->shm_path = NULL;
+  ap_arguments->num_pack_events = 100000;
+  memset( &( ap_arguments->generator ), 0, sizeof ap_arguments->generator );
+  ap_arguments->generator.event_length = 300;
+  ap_arguments->generator.clock_source = CSENDER_CLOCK_REALTIME;
+  ap_arguments->generator.timezone = CSENDER_TIMEZONE_UTC;
+  ap_arguments->generator.framing = CSENDER_FRAMING_LF;
+  ap_arguments->generator.sequence_numbers = false;
+  ap_arguments->generator.seed = ( uint64_t ) time( NULL );
+  ap_arguments->generator.body_kind = CSENDER_BODY_RANDOM;
+  ap_arguments->generator.min_lines = 5;
+  ap_arguments->generator.max_lines = 30;
+  ap_arguments->generator.min_line_length = 40;
+  ap_arguments->generator.max_line_length = 120;
+  ap_arguments->generator.num_fields = 8;
+  ap_arguments->generator.num_keys = 0;
+  ap_arguments->generator.depth = 0;
 
   // Process options
   struct option long_options[] =
@@ -322,12 +724,50 @@ bool process_argument_list( int argc,
   { "host", required_argument, 0, 'H' },
   { "port", required_argument, 0, 'p' },
   { "length", required_argument, 0, 'l' },
+  { "threads", required_argument, 0, 't' },
+  { "clock", required_argument, 0, 'c' },
+  { "timezone", required_argument, 0, 'z' },
+  { "framing", required_argument, 0, 'F' },
+  { "sequence", no_argument, 0, 'S' },
+  { "facility", required_argument, 0, 'f' },
+  { "severity", required_argument, 0, 'v' },
+  { "body", required_argument, 0, 'b' },
+  { "lines", required_argument, 0, 'L' },
+  { "line-length", required_argument, 0, 'W' },
+  { "corpus", required_argument, 0, 'K' },
+  { "utf8", required_argument, 0, 'U' },
+  { "bom", no_argument, 0, 'B' },
+  { "dictionary", required_argument, 0, 'D' },
+  { "fields", required_argument, 0, 'N' },
+  { "keys", required_argument, 0, 'k' },
+  { "depth", required_argument, 0, 'd' },
+  { "value-types", required_argument, 0, 'T' },
+  { "events", required_argument, 0, 'n' },
+  { "replay", required_argument, 0, 'R' },
+  { "import", required_argument, 0, 'I' },
+  { "speed", required_argument, 0, 'X' },
+  { "perf", no_argument, 0, 'E' },
+  { "udp", no_argument, 0, 'u' },
+  { "mptcp", no_argument, 0, 'M' },
+  { "engine", required_argument, 0, 'e' },
+  { "batch", required_argument, 0, 'y' },
+  { "tx-timestamps", required_argument, 0, 'x' },
+  { "shm", required_argument, 0, 'Z' },
+  { "seed", required_argument, 0, 's' },
+  { "checksum", required_argument, 0, 'C' },
+  { "rate", required_argument, 0, 'r' },
+  { "find-max", no_argument, 0, 'm' },
+  { "max-p99", required_argument, 0, 'P' },
+  { "adaptive", no_argument, 0, 'a' },
+  { "increase", required_argument, 0, 'A' },
+  { "max-queue", required_argument, 0, 'Q' },
+  { "workload", required_argument, 0, 'w' },
   { 0, 0, 0, 0 }
   };
 
   int index, opt = 0;
   while( ( opt =
-           getopt_long( argc, argv, "hH:p:l:", long_options, &index ) ) != -1 )
+           getopt_long( argc, argv, "hH:p:l:t:c:z:F:Sf:v:b:L:W:K:U:BD:N:k:d:T:n:R:I:X:EuMZ:e:y:x:s:C:r:mP:aA:Q:w:", long_options, &index ) ) != -1 )
   {
     switch( opt )
     {
@@ -344,52 +784,892 @@ bool process_argument_list( int argc,
       case 'p':
       {
         ap_arguments->servicename = optarg;
+        ap_arguments->port_given = true;
         break;
       }
       case 'l':
       {
-        ap_arguments->event_length = atoi( optarg );
+        long event_length = atol( optarg );
 
-        if( ap_arguments->event_length < ( ssize_t )min_event_length( ) ||
-            ap_arguments->event_length > ( ssize_t )max_event_length( ) )
+        if( event_length <= 0 ||
+            event_length < ( long ) csender_min_event_length( ) ||
+            event_length > ( long ) csender_max_event_length( ) )
         {
           printf( "Invalid event length.\n" );
-          ap_arguments->event_length = -1;
           print_usage( argv[ 0 ] );
           return false;
         }
 
+        ap_arguments->generator.event_length = event_length;
+
         break;
       }
-      default:
+      case 't':
       {
-        printf( "Unknown option, or option without value.\n");
-        print_usage( argv[ 0 ] );
-        return false;
+        ap_arguments->num_threads = atoi( optarg );
+
+        if( ap_arguments->num_threads <= 0 )
+        {
+          printf( "Invalid no. of threads.\n" );
+          print_usage( argv[ 0 ] );
+          return false;
+        }
+
+        break;
       }
-    }
-  }
+      case 'c':
+      {
+        if( strcmp( optarg, "realtime" ) == 0 )
+        {
+          ap_arguments->generator.clock_source = CSENDER_CLOCK_REALTIME;
+        }
+        else if( strcmp( optarg, "coarse" ) == 0 )
+        {
+          ap_arguments->generator.clock_source = CSENDER_CLOCK_REALTIME_COARSE;
+        }
+        else if( strcmp( optarg, "tsc" ) == 0 )
+        {
+          ap_arguments->generator.clock_source = CSENDER_CLOCK_TSC;
+        }
+        else if( strcmp( optarg, "synthetic" ) == 0 )
+        {
+          ap_arguments->generator.clock_source = CSENDER_CLOCK_SYNTHETIC;
+        }
+        else
+        {
+          printf( "Invalid clock.\n" );
+          print_usage( argv[ 0 ] );
+          return false;
+        }
 
-  return true;
-}
+        break;
+      }
+      case 'z':
+      {
+        if( strcmp( optarg, "utc" ) == 0 )
+        {
+          ap_arguments->generator.timezone = CSENDER_TIMEZONE_UTC;
+        }
+        else if( strcmp( optarg, "local" ) == 0 )
+        {
+          ap_arguments->generator.timezone = CSENDER_TIMEZONE_LOCAL;
+        }
+        else
+        {
+          printf( "Invalid time zone.\n" );
+          print_usage( argv[ 0 ] );
+          return false;
+        }
 
+        break;
+      }
+      case 'F':
+      {
+        if( strcmp( optarg, "lf" ) == 0 )
+        {
+          ap_arguments->generator.framing = CSENDER_FRAMING_LF;
+        }
+        else if( strcmp( optarg, "octet" ) == 0 )
+        {
+          ap_arguments->generator.framing = CSENDER_FRAMING_OCTET_COUNTING;
+        }
+        else
+        {
+          printf( "Invalid framing.\n" );
+          print_usage( argv[ 0 ] );
+          return false;
+        }
 
-int main( int argc, char* argv[] )
-{    
-  struct csender_arguments arguments;
-  if( process_argument_list( argc, argv, &arguments ) )
-  {
-    // Connect to the given target
-    int socket_to_target_fd =
-        create_socket_and_connect( arguments.hostname,
-                                   arguments.servicename );
-    if( socket_to_target_fd != -1 )
-    {
-      // Send events to it
-      send_events( socket_to_target_fd, &arguments );
-    }
+        break;
+      }
+      case 'S':
+      {
+        ap_arguments->generator.sequence_numbers = true;
+        break;
+      }
+      case 'f':
+      {
+        if( !csender_parse_facility_weights(
+                optarg, ap_arguments->generator.facility_weights ) )
+        {
+          printf( "Invalid facilities.\n" );
+          print_usage( argv[ 0 ] );
+          return false;
+        }
+
+        break;
+      }
+      case 'v':
+      {
+        if( !csender_parse_severity_weights(
+                optarg, ap_arguments->generator.severity_weights ) )
+        {
+          printf( "Invalid severities.\n" );
+          print_usage( argv[ 0 ] );
+          return false;
+        }
+
+        break;
+      }
+      case 'b':
+      {
+        if( strcmp( optarg, "random" ) == 0 )
+        {
+          ap_arguments->generator.body_kind = CSENDER_BODY_RANDOM;
+        }
+        else if( strcmp( optarg, "multiline" ) == 0 )
+        {
+          ap_arguments->generator.body_kind = CSENDER_BODY_MULTILINE;
+        }
+        else if( strcmp( optarg, "corpus" ) == 0 )
+        {
+          ap_arguments->generator.body_kind = CSENDER_BODY_CORPUS;
+        }
+        else if( strcmp( optarg, "utf8" ) == 0 )
+        {
+          ap_arguments->generator.body_kind = CSENDER_BODY_UTF8;
+        }
+        else if( strcmp( optarg, "words" ) == 0 )
+        {
+          ap_arguments->generator.body_kind = CSENDER_BODY_WORDS;
+        }
+        else if( strcmp( optarg, "kv" ) == 0 )
+        {
+          ap_arguments->generator.body_kind = CSENDER_BODY_KEY_VALUE;
+        }
+        else if( strcmp( optarg, "json" ) == 0 )
+        {
+          ap_arguments->generator.body_kind = CSENDER_BODY_JSON;
+        }
+        else
+        {
+          printf( "Invalid body.\n" );
+          print_usage( argv[ 0 ] );
+          return false;
+        }
+
+        break;
+      }
+      case 'L':
+      case 'W':
+      {
+        unsigned int min_value = 0, max_value = 0;
+        char extra;
+        int num_values = sscanf( optarg, "%u-%u%c",
+                                 &min_value, &max_value, &extra );
+        if( num_values == 1 )
+        {
+          max_value = min_value;
+        }
+
+        if( ( num_values != 1 && num_values != 2 ) || min_value == 0 ||
+            max_value < min_value ||
+            ( opt == 'L' && max_value > CSENDER_MAX_BODY_LINES ) ||
+            ( opt == 'W' && max_value > csender_max_event_length( ) ) )
+        {
+          printf( "Invalid %s.\n",
+                  ( opt == 'L' ) ? "no. of lines" : "line length" );
+          print_usage( argv[ 0 ] );
+          return false;
+        }
+
+        if( opt == 'L' )
+        {
+          ap_arguments->generator.min_lines = min_value;
+          ap_arguments->generator.max_lines = max_value;
+        }
+        else
+        {
+          ap_arguments->generator.min_line_length = min_value;
+          ap_arguments->generator.max_line_length = max_value;
+        }
+
+        break;
+      }
+      case 'K':
+      {
+        ap_arguments->corpus_file_name = optarg;
+        ap_arguments->generator.body_kind = CSENDER_BODY_CORPUS;
+        break;
+      }
+      case 'U':
+      {
+        if( !csender_parse_utf8_weights(
+                optarg, ap_arguments->generator.utf8_weights ) )
+        {
+          printf( "Invalid UTF-8 classes.\n" );
+          print_usage( argv[ 0 ] );
+          return false;
+        }
+
+        ap_arguments->generator.body_kind = CSENDER_BODY_UTF8;
+        break;
+      }
+      case 'B':
+      {
+        ap_arguments->generator.utf8_byte_order_mark = true;
+        break;
+      }
+      case 'D':
+      {
+        ap_arguments->dictionary_file_name = optarg;
+        ap_arguments->generator.body_kind = CSENDER_BODY_WORDS;
+        break;
+      }
+      case 'N':
+      case 'k':
+      case 'd':
+      {
+        char* p_end = NULL;
+        long value = strtol( optarg, &p_end, 10 );
+        long min_value = ( opt == 'd' ) ? 0 : 1;
+        long max_value = ( opt == 'N' ) ? CSENDER_MAX_BODY_FIELDS :
+                         ( opt == 'k' ) ? CSENDER_MAX_BODY_KEYS :
+                                          CSENDER_MAX_BODY_DEPTH;
+        if( p_end == optarg || *p_end != '\0' ||
+            value < min_value || value > max_value )
+        {
+          printf( "Invalid %s.\n",
+                  ( opt == 'N' ) ? "no. of fields" :
+                  ( opt == 'k' ) ? "no. of keys" :
+                                   "depth" );
+          print_usage( argv[ 0 ] );
+          return false;
+        }
+
+        if( opt == 'N' )
+        {
+          ap_arguments->generator.num_fields = ( unsigned int ) value;
+        }
+        else if( opt == 'k' )
+        {
+          ap_arguments->generator.num_keys = ( unsigned int ) value;
+        }
+        else
+        {
+          ap_arguments->generator.depth = ( unsigned int ) value;
+        }
+
+        break;
+      }
+      case 'T':
+      {
+        if( !csender_parse_value_types(
+                optarg, ap_arguments->generator.value_type_weights ) )
+        {
+          printf( "Invalid value types.\n" );
+          print_usage( argv[ 0 ] );
+          return false;
+        }
+
+        break;
+      }
+      case 's':
+      {
+        char* p_end = NULL;
+        ap_arguments->generator.seed = strtoull( optarg, &p_end, 0 );
+
+        if( p_end == optarg || *p_end != '\0' )
+        {
+          printf( "Invalid seed.\n" );
+          print_usage( argv[ 0 ] );
+          return false;
+        }
+
+        break;
+      }
+      case 'n':
+      {
+        ap_arguments->num_pack_events = atol( optarg );
+
+        if( ap_arguments->num_pack_events <= 0 ||
+            ap_arguments->num_pack_events > INT32_MAX )
+        {
+          printf( "Invalid no. of events to pack.\n" );
+          print_usage( argv[ 0 ] );
+          return false;
+        }
+
+        break;
+      }
+      case 'R':
+      {
+        ap_arguments->replay_file_name = optarg;
+        break;
+      }
+      case 'I':
+      {
+        ap_arguments->import_file_name = optarg;
+        break;
+      }
+      case 'X':
+      {
+        ap_arguments->replay_speed = atof( optarg );
+
+        if( ap_arguments->replay_speed <= 0 )
+        {
+          printf( "Invalid replay speed.\n" );
+          print_usage( argv[ 0 ] );
+          return false;
+        }
+
+        break;
+      }
+      case 'E':
+      {
+        ap_arguments->perf_counters = true;
+        break;
+      }
+      case 'u':
+      {
+        ap_arguments->udp = true;
+        break;
+      }
+      case 'M':
+      {
+        ap_arguments->mptcp = true;
+        break;
+      }
+      case 'Z':
+      {
+        ap_arguments->shm_path = optarg;
+        break;
+      }
+      case 'e':
+      {
+        if( !csender_parse_send_engine( optarg, &( ap_arguments->engine ) ) )
+        {
+          printf( "Invalid engine.\n" );
+          print_usage( argv[ 0 ] );
+          return false;
+        }
+
+        break;
+      }
+      case 'y':
+      {
+        ap_arguments->batch_size = atoi( optarg );
+
+        if( ap_arguments->batch_size < 1 ||
+            ap_arguments->batch_size > CSENDER_MAX_SEND_BATCH )
+        {
+          printf( "Invalid batch size.\n" );
+          print_usage( argv[ 0 ] );
+          return false;
+        }
+
+        break;
+      }
+      case 'x':
+      {
+        ap_arguments->tx_timestamps = atoi( optarg );
+
+        if( ap_arguments->tx_timestamps < 1 )
+        {
+          printf( "Invalid no. of events per timestamped one.\n" );
+          print_usage( argv[ 0 ] );
+          return false;
+        }
+
+        break;
+      }
+      case 'C':
+      {
+        ap_arguments->num_checksum_events = atol( optarg );
+
+        if( ap_arguments->num_checksum_events <= 0 )
+        {
+          printf( "Invalid no. of events to checksum.\n" );
+          print_usage( argv[ 0 ] );
+          return false;
+        }
+
+        break;
+      }
+      case 'r':
+      {
+        ap_arguments->rate = atol( optarg );
+
+        if( ap_arguments->rate <= 0 )
+        {
+          printf( "Invalid rate.\n" );
+          print_usage( argv[ 0 ] );
+          return false;
+        }
+
+        ap_arguments->find_max_options.initial_rate = ap_arguments->rate;
+        ap_arguments->adaptive_options.initial_rate = ap_arguments->rate;
+        break;
+      }
+      case 'm':
+      {
+        ap_arguments->find_max = true;
+        break;
+      }
+      case 'P':
+      {
+        double max_p99_us = atof( optarg );
+
+        if( max_p99_us <= 0 )
+        {
+          printf( "Invalid send time p99.\n" );
+          print_usage( argv[ 0 ] );
+          return false;
+        }
+
+        ap_arguments->find_max_options.max_p99_send_time_ns =
+            ( uint64_t ) ( max_p99_us * 1000 );
+        ap_arguments->adaptive_options.max_p99_send_time_ns =
+            ap_arguments->find_max_options.max_p99_send_time_ns;
+        break;
+      }
+      case 'a':
+      {
+        ap_arguments->adaptive = true;
+        break;
+      }
+      case 'A':
+      {
+        ap_arguments->adaptive_options.additive_increase = atol( optarg );
+
+        if( ap_arguments->adaptive_options.additive_increase <= 0 )
+        {
+          printf( "Invalid rate increase.\n" );
+          print_usage( argv[ 0 ] );
+          return false;
+        }
+
+        break;
+      }
+      case 'Q':
+      {
+        ap_arguments->adaptive_options.max_send_queue_bytes = atol( optarg );
+
+        if( ap_arguments->adaptive_options.max_send_queue_bytes <= 0 )
+        {
+          printf( "Invalid send queue length.\n" );
+          print_usage( argv[ 0 ] );
+          return false;
+        }
+
+        break;
+      }
+      case 'w':
+      {
+        ap_arguments->workload_file_name = optarg;
+        break;
+      }
+      default:
+      {
+        printf( "Unknown option, or option without value.\n");
+        print_usage( argv[ 0 ] );
+        return false;
+      }
+    }
+  }
+
+  if( ap_arguments->find_max && ap_arguments->adaptive )
+  {
+    printf( "--find-max and --adaptive can not be used together.\n" );
+    return false;
+  }
+
+  if( ap_arguments->workload_file_name != NULL &&
+      ( ap_arguments->find_max || ap_arguments->adaptive ) )
+  {
+    printf( "--workload can not be used with --find-max or --adaptive.\n" );
+    return false;
+  }
+
+  if( ap_arguments->generator.body_kind == CSENDER_BODY_CORPUS )
+  {
+    if( ap_arguments->corpus_file_name == NULL )
+    {
+      printf( "Corpus bodies need a --corpus file.\n" );
+      return false;
+    }
+
+    // Kept for the whole run, and shared by every sender thread
+    ap_arguments->generator.p_corpus =
+        csender_corpus_load( ap_arguments->corpus_file_name );
+    if( ap_arguments->generator.p_corpus == NULL )
+    {
+      return false;
+    }
+  }
+
+  if( ap_arguments->generator.num_keys > 0 &&
+      ap_arguments->generator.num_keys < ap_arguments->generator.num_fields )
+  {
+    printf( "There must be at least as many keys as fields.\n" );
+    return false;
+  }
+
+  if( ap_arguments->replay_file_name != NULL )
+  {
+    ap_arguments->generator.p_pack =
+        csender_pack_open( ap_arguments->replay_file_name );
+    if( ap_arguments->generator.p_pack == NULL )
+    {
+      return false;
+    }
+  }
+
+  if( ap_arguments->replay_speed > 0 &&
+      ( ap_arguments->generator.p_pack == NULL ||
+        !csender_pack_has_times( ap_arguments->generator.p_pack ) ) )
+  {
+    printf( "--speed needs a --replay pack imported from a capture.\n" );
+    return false;
+  }
+
+  if( ap_arguments->replay_speed > 0 &&
+      ( ap_arguments->find_max || ap_arguments->adaptive ||
+        ap_arguments->workload_file_name != NULL ) )
+  {
+    printf( "--speed can not be used with --find-max, --adaptive or "
+            "--workload.\n" );
+    return false;
+  }
+
+  if( ( ap_arguments->engine != CSENDER_ENGINE_SEND ||
+        ap_arguments->batch_size > 1 || ap_arguments->udp ||
+        ap_arguments->mptcp ) &&
+      ap_arguments->workload_file_name != NULL )
+  {
+    printf( "--engine, --batch, --udp and --mptcp can not be used with "
+            "--workload.\n" );
+    return false;
+  }
+
+  if( ap_arguments->mptcp && ap_arguments->udp )
+  {
+    printf( "--mptcp can not be used with --udp.\n" );
+    return false;
+  }
+
+  if( ap_arguments->shm_path != NULL &&
+      ( ap_arguments->udp || ap_arguments->mptcp ||
+        ap_arguments->engine != CSENDER_ENGINE_SEND ||
+        ap_arguments->tx_timestamps > 0 ||
+        ap_arguments->workload_file_name != NULL ) )
+  {
+    printf( "--shm can not be used with --udp, --mptcp, --engine, "
+            "--tx-timestamps or --workload.\n" );
+    return false;
+  }
+
+  if( ap_arguments->perf_counters &&
+      ( ap_arguments->find_max || ap_arguments->workload_file_name != NULL ) )
+  {
+    printf( "--perf can not be used with --find-max or --workload.\n" );
+    return false;
+  }
+
+  // The kernel tells the events of an MPTCP connection apart per subflow
+  if( ap_arguments->tx_timestamps > 0 &&
+      ( ap_arguments->udp || ap_arguments->mptcp || ap_arguments->find_max ||
+        ap_arguments->workload_file_name != NULL ) )
+  {
+    printf( "--tx-timestamps can not be used with --udp, --mptcp, --find-max "
+            "or --workload.\n" );
+    return false;
+  }
+
+  if( ap_arguments->dictionary_file_name != NULL )
+  {
+    ap_arguments->generator.p_dictionary =
+        csender_dictionary_load( ap_arguments->dictionary_file_name );
+    if( ap_arguments->generator.p_dictionary == NULL )
+    {
+      return false;
+    }
+  }
+
+  // Some options make room for more than the bare header
+  if( ap_arguments->generator.event_length <
+      csender_min_event_length_for( &( ap_arguments->generator ) ) )
+  {
+    printf( "Invalid event length: at least %ld chars are needed with the "
+            "given options.\n",
+            csender_min_event_length_for( &( ap_arguments->generator ) ) );
+    return false;
+  }
+
+  return true;
+}
+
+
+// Port of a service name, or -1 if there is no such service
+int service_port( const char* a_service_name )
+{
+  char* p_end = NULL;
+  long port = strtol( a_service_name, &p_end, 10 );
+  if( p_end != a_service_name && *p_end == '\0' )
+  {
+    return ( port > 0 && port <= 65535 ) ? ( int ) port : -1;
+  }
+
+  struct servent* p_service = getservbyname( a_service_name, NULL );
+
+  return ( p_service != NULL ) ? ntohs( p_service->s_port ) : -1;
+}
+
+
+// "csender pack FILE --import CAPTURE [option]...": packs the events of a
+// capture
+int import_capture( const char* a_file_name,
+                    const struct csender_arguments* ap_arguments )
+{
+  int port = 0;
+  if( ap_arguments->port_given )
+  {
+    port = service_port( ap_arguments->servicename );
+    if( port < 0 )
+    {
+      printf( "Unknown port %s.\n", ap_arguments->servicename );
+      return 1;
+    }
+  }
+
+  long num_events = csender_pack_import( a_file_name,
+                                         ap_arguments->import_file_name,
+                                         port,
+                                         ap_arguments->generator.framing );
+  if( num_events < 0 )
+  {
+    return 1;
+  }
+
+  printf( "%ld events of %s packed into %s.\n",
+          num_events,
+          ap_arguments->import_file_name,
+          a_file_name );
+
+  return 0;
+}
+
+
+// Options of a subcommand, which follow its name and a file name, e.g.
+// "csender pack FILE [option]..."
+bool process_subcommand_argument_list( int argc,
+                                       char* argv[],
+                                       struct csender_arguments* ap_arguments )
+{
+  char* arguments_after_file[ argc - 1 ];
+  arguments_after_file[ 0 ] = argv[ 0 ];
+  for( int i = 3; i < argc; i++ )
+  {
+    arguments_after_file[ i - 2 ] = argv[ i ];
+  }
+  arguments_after_file[ argc - 2 ] = NULL;
+
+  return process_argument_list( argc - 2, arguments_after_file, ap_arguments );
+}
+
+
+// "csender pack FILE [option]...": renders the events of the options into a
+// pack file
+int pack_events( int argc, char* argv[] )
+{
+  struct csender_arguments arguments;
+  if( !process_subcommand_argument_list( argc, argv, &arguments ) )
+  {
+    return 1;
+  }
+
+  if( arguments.generator.p_pack != NULL )
+  {
+    printf( "A pack can not be made of the events of another one.\n" );
+    return 1;
+  }
+
+  if( arguments.import_file_name != NULL )
+  {
+    return import_capture( argv[ 2 ], &arguments );
+  }
+
+  if( csender_pack_write( argv[ 2 ],
+                          &( arguments.generator ),
+                          arguments.num_pack_events ) != 0 )
+  {
+    return 1;
+  }
+
+  printf( "%ld events packed into %s (seed %lu).\n",
+          arguments.num_pack_events,
+          argv[ 2 ],
+          ( unsigned long ) arguments.generator.seed );
+
+  return 0;
+}
+
+
+// "csender shm SOCKET [option]...": reads the events of the writers that
+// connect to the socket, and reports how fast they come, until stopped
+int read_shm_events( int argc, char* argv[] )
+{
+  struct csender_arguments arguments;
+  if( !process_subcommand_argument_list( argc, argv, &arguments ) )
+  {
+    return 1;
+  }
+
+  struct csender_shm_reader* p_reader =
+      csender_shm_reader_create( argv[ 2 ],
+                                 CSENDER_SHM_DEFAULT_RING_LENGTH,
+                                 arguments.generator.framing );
+  if( p_reader == NULL )
+  {
+    return 1;
+  }
+
+  if( csender_shm_reader_start( p_reader ) != 0 )
+  {
+    csender_shm_reader_destroy( p_reader );
+    return 1;
+  }
+
+  printf( "\nWaiting for writers on %s...\n\n", argv[ 2 ] );
+  fflush( stdout );
+
+  struct timespec start_time;
+  clock_gettime( CLOCK_MONOTONIC, &start_time );
+
+  struct csender_shm_reader_stats previous_stats;
+  memset( &previous_stats, 0, sizeof previous_stats );
+
+  long num_seconds = 0;
+  for( ;; )
+  {
+    num_seconds++;
+    struct timespec wake_up_time = start_time;
+    wake_up_time.tv_sec += num_seconds;
+    clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &wake_up_time, NULL );
+
+    if( num_seconds % STATISTICS_INTERVAL == 0 )
+    {
+      struct csender_shm_reader_stats stats;
+      csender_shm_reader_stats( p_reader, &stats );
+
+      printf( "%4ld sec. %12llu events read, %10llu events/sec, "
+              "%8.1f MB/sec, %d writers\n",
+              num_seconds,
+              ( unsigned long long ) stats.num_events_read,
+              ( unsigned long long ) ( stats.num_events_read -
+                                       previous_stats.num_events_read ) /
+                  STATISTICS_INTERVAL,
+              ( stats.num_bytes_read - previous_stats.num_bytes_read ) /
+                  ( STATISTICS_INTERVAL * 1e6 ),
+              stats.num_writers );
+      previous_stats = stats;
+
+      fflush( stdout );
+    }
+  }
+}
+
+
+int main( int argc, char* argv[] )
+{    
+  if( argc >= 3 && strcmp( argv[ 1 ], "pack" ) == 0 )
+  {
+    return pack_events( argc, argv );
+  }
+
+  if( argc >= 3 && strcmp( argv[ 1 ], "shm" ) == 0 )
+  {
+    return read_shm_events( argc, argv );
+  }
+
+  struct csender_arguments arguments;
+  if( process_argument_list( argc, argv, &arguments ) )
+  {
+    if( arguments.num_checksum_events > 0 )
+    {
+      return check_determinism( &arguments ) ? 0 : 1;
+    }
+
+    if( arguments.workload_file_name != NULL )
+    {
+      return send_workload( &arguments );
+    }
+
+    struct csender_runner_options runner_options;
+    memset( &runner_options, 0, sizeof runner_options );
+    runner_options.target_name = arguments.hostname;
+    runner_options.service_name = arguments.servicename;
+    runner_options.generator = arguments.generator;
+    runner_options.num_threads = arguments.num_threads;
+    runner_options.rate = arguments.find_max ? 0 : arguments.rate;
+    runner_options.replay_speed = arguments.replay_speed;
+    runner_options.perf_counters = arguments.perf_counters;
+    runner_options.engine = arguments.engine;
+    runner_options.batch_size = arguments.batch_size;
+    runner_options.udp = arguments.udp;
+    runner_options.mptcp = arguments.mptcp;
+    runner_options.tx_timestamps = arguments.tx_timestamps;
+    runner_options.shm_path = arguments.shm_path;
+
+    // Connect to the given target
+    struct csender_runner* p_runner = csender_runner_create( &runner_options );
+    if( p_runner == NULL )
+    {
+      exit( 1 );
+    }
+
+    if( arguments.shm_path != NULL )
+    {
+      printf( "\nA shared memory ring with the reader (%s) has been "
+              "established. Sending events (seed %lu)...\n\n",
+              arguments.shm_path,
+              ( unsigned long ) arguments.generator.seed );
+    }
+    else
+    {
+      printf( "\nA connection with the target (%s:%s) has been established. "
+              "Sending events (seed %lu)...\n\n",
+              arguments.hostname,
+              arguments.servicename,
+              ( unsigned long ) arguments.generator.seed );
+    }
+
+    if( arguments.find_max )
+    {
+      // Search for the highest rate, and stop
+      csender_runner_set_rate( p_runner,
+                               arguments.find_max_options.initial_rate );
+
+      bool found = ( csender_runner_start( p_runner ) == 0 ) &&
+                   find_max_rate( p_runner, &arguments );
+      csender_runner_destroy( p_runner );
+
+      return found ? 0 : 1;
+    }
+
+    struct csender_adaptive* p_adaptive = NULL;
+    if( arguments.adaptive )
+    {
+      p_adaptive = csender_adaptive_create( p_runner,
+                                            &( arguments.adaptive_options ) );
+      if( p_adaptive == NULL )
+      {
+        csender_runner_destroy( p_runner );
+        exit( 1 );
+      }
+    }
+
+    // Send events to it, until every sender thread stops
+    if( csender_runner_start( p_runner ) == 0 )
+    {
+      report_statistics( p_runner, p_adaptive, &arguments );
+    }
+
+    csender_adaptive_destroy( p_adaptive );
+    csender_runner_destroy( p_runner );
 
-    return ( socket_to_target_fd != -1 );
+    // Sender threads only stop on errors
+    return 1;
   }
   else
   {
@@ -0,0 +1,492 @@
+#include "csender.h"
+#include "pack.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Imports captures built here, byte by byte, with csender_pack_import(), and
+// checks the events of the packs, and their times: UDP datagrams behind VLAN
+// tags, TCP streams behind Linux cooked headers, with their segments out of
+// order and retransmitted, both framings, and captures cut short. Exits with
+// 1 on any mismatch.
+
+#define BUFFER_LENGTH 4096
+
+// Link types, as numbered by pcap
+#define LINKTYPE_ETHERNET 1
+#define LINKTYPE_LINUX_SLL 113
+
+#define IP_PROTOCOL_TCP 6
+#define IP_PROTOCOL_UDP 17
+
+#define TCP_FLAG_FIN 0x01
+#define TCP_FLAG_SYN 0x02
+#define TCP_FLAG_ACK 0x10
+
+#define SYSLOG_PORT 514
+
+static int g_num_failures = 0;
+
+struct buffer
+{
+  uint8_t   data[ BUFFER_LENGTH ];
+  size_t    length;
+};
+
+// A packet to build, from the link layer to the payload
+struct test_packet
+{
+  int           link_type;
+  int           num_vlan_tags;      // Ethernet
+  uint8_t       protocol;
+  uint16_t      destination_port;
+  uint32_t      sequence_number;    // TCP
+  uint8_t       tcp_flags;
+  const char*   p_payload;
+  size_t        payload_length;     // 0: strlen() of the payload
+};
+
+
+static void put_bytes( struct buffer* ap_buffer,
+                       const void* a_bytes,
+                       size_t a_length )
+{
+  memcpy( ap_buffer->data + ap_buffer->length, a_bytes, a_length );
+  ap_buffer->length += a_length;
+}
+
+
+static void put_u8( struct buffer* ap_buffer, uint8_t a_value )
+{
+  put_bytes( ap_buffer, &a_value, 1 );
+}
+
+
+// Little-endian, as the captures are written by the hosts csender runs on;
+// network order within the packets
+static void put_u16( struct buffer* ap_buffer,
+                     uint16_t a_value,
+                     bool a_big_endian )
+{
+  uint8_t bytes[ 2 ] = { a_value & 0xFF, a_value >> 8 };
+  if( a_big_endian )
+  {
+    bytes[ 0 ] = a_value >> 8;
+    bytes[ 1 ] = a_value & 0xFF;
+  }
+  put_bytes( ap_buffer, bytes, sizeof bytes );
+}
+
+
+static void put_u32( struct buffer* ap_buffer,
+                     uint32_t a_value,
+                     bool a_big_endian )
+{
+  put_u16( ap_buffer, a_big_endian ? a_value >> 16 : a_value & 0xFFFF,
+           a_big_endian );
+  put_u16( ap_buffer, a_big_endian ? a_value & 0xFFFF : a_value >> 16,
+           a_big_endian );
+}
+
+
+static void build_packet( const struct test_packet* ap_packet,
+                          struct buffer* ap_output_packet )
+{
+  ap_output_packet->length = 0;
+
+  static const uint8_t addresses[ 12 ] = { 2, 0, 0, 0, 0, 2, 2, 0, 0, 0, 0, 1 };
+  if( ap_packet->link_type == LINKTYPE_ETHERNET )
+  {
+    put_bytes( ap_output_packet, addresses, sizeof addresses );
+    for( int i = 0; i < ap_packet->num_vlan_tags; i++ )
+    {
+      // The outer tag of two is a service one (802.1ad)
+      bool outer = ( i == 0 && ap_packet->num_vlan_tags > 1 );
+      put_u16( ap_output_packet, outer ? 0x88A8 : 0x8100, true );
+      put_u16( ap_output_packet, 100 + i, true );
+    }
+    put_u16( ap_output_packet, 0x0800, true );
+  }
+  else
+  {
+    put_u16( ap_output_packet, 0, true );           // To this host
+    put_u16( ap_output_packet, 1, true );           // ARPHRD_ETHER
+    put_u16( ap_output_packet, 6, true );
+    put_bytes( ap_output_packet, addresses, 8 );
+    put_u16( ap_output_packet, 0x0800, true );
+  }
+
+  size_t payload_length = ( ap_packet->payload_length > 0 ) ?
+                              ap_packet->payload_length :
+                              strlen( ap_packet->p_payload );
+  size_t transport_length = ( ap_packet->protocol == IP_PROTOCOL_TCP ) ? 20 : 8;
+
+  static const uint8_t ip_addresses[ 8 ] = { 10, 0, 0, 1, 10, 0, 0, 2 };
+  put_u8( ap_output_packet, 0x45 );
+  put_u8( ap_output_packet, 0 );
+  put_u16( ap_output_packet, 20 + transport_length + payload_length, true );
+  put_u32( ap_output_packet, 0x00004000, true );    // Don't fragment
+  put_u8( ap_output_packet, 64 );
+  put_u8( ap_output_packet, ap_packet->protocol );
+  put_u16( ap_output_packet, 0, true );
+  put_bytes( ap_output_packet, ip_addresses, sizeof ip_addresses );
+
+  put_u16( ap_output_packet, 40000, true );
+  put_u16( ap_output_packet, ap_packet->destination_port, true );
+  if( ap_packet->protocol == IP_PROTOCOL_TCP )
+  {
+    put_u32( ap_output_packet, ap_packet->sequence_number, true );
+    put_u32( ap_output_packet, 0, true );
+    put_u8( ap_output_packet, 5 << 4 );
+    put_u8( ap_output_packet, ap_packet->tcp_flags );
+    put_u16( ap_output_packet, 65535, true );
+    put_u32( ap_output_packet, 0, true );
+  }
+  else
+  {
+    put_u16( ap_output_packet, 8 + payload_length, true );
+    put_u16( ap_output_packet, 0, true );
+  }
+
+  put_bytes( ap_output_packet, ap_packet->p_payload, payload_length );
+}
+
+
+static void start_pcap( struct buffer* ap_capture, int a_link_type )
+{
+  ap_capture->length = 0;
+  put_u32( ap_capture, 0xA1B2C3D4, false );         // Microseconds
+  put_u16( ap_capture, 2, false );
+  put_u16( ap_capture, 4, false );
+  put_u32( ap_capture, 0, false );
+  put_u32( ap_capture, 0, false );
+  put_u32( ap_capture, 65535, false );
+  put_u32( ap_capture, a_link_type, false );
+}
+
+
+static void add_pcap_packet( struct buffer* ap_capture,
+                             uint64_t a_time_us,
+                             const struct test_packet* ap_packet )
+{
+  struct buffer packet;
+  build_packet( ap_packet, &packet );
+
+  put_u32( ap_capture, a_time_us / 1000000, false );
+  put_u32( ap_capture, a_time_us % 1000000, false );
+  put_u32( ap_capture, packet.length, false );
+  put_u32( ap_capture, packet.length, false );
+  put_bytes( ap_capture, packet.data, packet.length );
+}
+
+
+// A section, and an interface with timestamps in ns
+static void start_pcapng( struct buffer* ap_capture, int a_link_type )
+{
+  ap_capture->length = 0;
+  put_u32( ap_capture, 0x0A0D0D0A, false );
+  put_u32( ap_capture, 28, false );
+  put_u32( ap_capture, 0x1A2B3C4D, false );
+  put_u16( ap_capture, 1, false );
+  put_u16( ap_capture, 0, false );
+  put_u32( ap_capture, 0xFFFFFFFF, false );         // Section length unknown
+  put_u32( ap_capture, 0xFFFFFFFF, false );
+  put_u32( ap_capture, 28, false );
+
+  put_u32( ap_capture, 1, false );
+  put_u32( ap_capture, 32, false );
+  put_u16( ap_capture, a_link_type, false );
+  put_u16( ap_capture, 0, false );
+  put_u32( ap_capture, 65535, false );
+  put_u16( ap_capture, 9, false );                  // if_tsresol: 10^-9
+  put_u16( ap_capture, 1, false );
+  put_u32( ap_capture, 9, false );
+  put_u32( ap_capture, 0, false );                  // opt_endofopt
+  put_u32( ap_capture, 32, false );
+}
+
+
+static void add_pcapng_packet( struct buffer* ap_capture,
+                               uint64_t a_time_ns,
+                               const struct test_packet* ap_packet )
+{
+  struct buffer packet;
+  build_packet( ap_packet, &packet );
+
+  uint32_t padded_length = ( packet.length + 3 ) & ~3u;
+  put_u32( ap_capture, 6, false );
+  put_u32( ap_capture, 32 + padded_length, false );
+  put_u32( ap_capture, 0, false );
+  put_u32( ap_capture, a_time_ns >> 32, false );
+  put_u32( ap_capture, a_time_ns & 0xFFFFFFFF, false );
+  put_u32( ap_capture, packet.length, false );
+  put_u32( ap_capture, packet.length, false );
+  put_bytes( ap_capture, packet.data, packet.length );
+  while( packet.length++ < padded_length )
+  {
+    put_u8( ap_capture, 0 );
+  }
+  put_u32( ap_capture, 32 + padded_length, false );
+}
+
+
+// Imports the capture, and checks the events of the pack, and their times
+// (in ns since the first one), in order. A number of events of -1 expects the
+// import to fail.
+static void check_import( const char* a_name,
+                          const struct buffer* ap_capture,
+                          int a_port,
+                          enum csender_framing a_framing,
+                          const char* const* a_expected_events,
+                          const uint64_t* a_expected_times_ns,
+                          int a_num_events )
+{
+  char capture_file_name[] = "/tmp/csender_capture_test_XXXXXX";
+  char pack_file_name[] = "/tmp/csender_capture_test_XXXXXX";
+  int capture_fd = mkstemp( capture_file_name );
+  int pack_fd = mkstemp( pack_file_name );
+  if( capture_fd < 0 || pack_fd < 0 ||
+      write( capture_fd, ap_capture->data, ap_capture->length ) !=
+          ( ssize_t ) ap_capture->length )
+  {
+    perror( "FAIL: no temporary files" );
+    g_num_failures++;
+    return;
+  }
+  close( capture_fd );
+  close( pack_fd );
+
+  long num_events = csender_pack_import( pack_file_name,
+                                         capture_file_name,
+                                         a_port,
+                                         a_framing );
+  if( num_events != a_num_events )
+  {
+    printf( "FAIL: %s: %ld events imported, instead of %d\n",
+            a_name,
+            num_events,
+            a_num_events );
+    g_num_failures++;
+  }
+
+  struct csender_pack* p_pack =
+      ( num_events > 0 ) ? csender_pack_open( pack_file_name ) : NULL;
+  for( int i = 0; p_pack != NULL && i < p_pack->num_events &&
+                  i < a_num_events; i++ )
+  {
+    char event[ CSENDER_EVENT_BUFFER_LENGTH ];
+    pack_replay_event( p_pack, i, NULL, 0, event );
+    if( strcmp( event, a_expected_events[ i ] ) != 0 )
+    {
+      printf( "FAIL: %s: event %d is \"%s\", instead of \"%s\"\n",
+              a_name,
+              i,
+              event,
+              a_expected_events[ i ] );
+      g_num_failures++;
+    }
+    else if( p_pack->p_times == NULL ||
+             p_pack->p_times[ i ] != a_expected_times_ns[ i ] )
+    {
+      printf( "FAIL: %s: event %d captured at %llu ns, instead of %llu\n",
+              a_name,
+              i,
+              ( p_pack->p_times != NULL ) ?
+                  ( unsigned long long ) p_pack->p_times[ i ] :
+                  0ULL,
+              ( unsigned long long ) a_expected_times_ns[ i ] );
+      g_num_failures++;
+    }
+  }
+
+  csender_pack_close( p_pack );
+  unlink( capture_file_name );
+  unlink( pack_file_name );
+}
+
+
+// Datagrams behind one VLAN tag, and two, with the trailing '\n's and nulls
+// of some senders, and some to another port
+static void check_udp_over_vlans( void )
+{
+  struct test_packet datagrams[] =
+  {
+    { LINKTYPE_ETHERNET, 1, IP_PROTOCOL_UDP, SYSLOG_PORT, 0, 0,
+      "<13>one\n", 0 },
+    { LINKTYPE_ETHERNET, 0, IP_PROTOCOL_UDP, SYSLOG_PORT + 1, 0, 0,
+      "<13>elsewhere", 0 },
+    { LINKTYPE_ETHERNET, 2, IP_PROTOCOL_UDP, SYSLOG_PORT, 0, 0,
+      "<14>two\n\0", 9 },
+    { LINKTYPE_ETHERNET, 0, IP_PROTOCOL_UDP, SYSLOG_PORT, 0, 0,
+      "<15>three", 0 }
+  };
+  uint64_t times_us[] = { 1000000100, 1000000200, 1000250100, 1001000099 };
+
+  struct buffer capture;
+  start_pcap( &capture, LINKTYPE_ETHERNET );
+  for( int i = 0; i < 4; i++ )
+  {
+    add_pcap_packet( &capture, times_us[ i ], &( datagrams[ i ] ) );
+  }
+
+  const char* const events[] = { "<13>one\n", "<14>two\n", "<15>three\n" };
+  const uint64_t times_ns[] = { 0, 250000000, 999999000 };
+  check_import( "UDP over VLANs", &capture, SYSLOG_PORT, CSENDER_FRAMING_LF,
+                events, times_ns, 3 );
+
+  const char* const all_events[] =
+  {
+    "<13>one\n", "<13>elsewhere\n", "<14>two\n", "<15>three\n"
+  };
+  const uint64_t all_times_ns[] = { 0, 100000, 250000000, 999999000 };
+  check_import( "UDP over VLANs, any port", &capture, 0, CSENDER_FRAMING_LF,
+                all_events, all_times_ns, 4 );
+}
+
+
+// A stream of LF framed messages, split anywhere, with its segments out of
+// order and one retransmitted, behind Linux cooked headers
+static void check_tcp_out_of_order( void )
+{
+  // "<13>one\n<14>two\n<15>three\n", from sequence number 1001
+  struct test_packet segments[] =
+  {
+    { LINKTYPE_LINUX_SLL, 0, IP_PROTOCOL_TCP, SYSLOG_PORT, 1000, TCP_FLAG_SYN,
+      "", 0 },
+    { LINKTYPE_LINUX_SLL, 0, IP_PROTOCOL_TCP, SYSLOG_PORT, 1001, TCP_FLAG_ACK,
+      "<13>one\n<1", 0 },
+    { LINKTYPE_LINUX_SLL, 0, IP_PROTOCOL_TCP, SYSLOG_PORT, 1019, TCP_FLAG_ACK,
+      "5>three\n", 0 },
+    { LINKTYPE_LINUX_SLL, 0, IP_PROTOCOL_TCP, SYSLOG_PORT, 1011, TCP_FLAG_ACK,
+      "4>two\n<1", 0 },
+    { LINKTYPE_LINUX_SLL, 0, IP_PROTOCOL_TCP, SYSLOG_PORT, 1006, TCP_FLAG_ACK,
+      "ne\n<14>tw", 0 },
+    { LINKTYPE_LINUX_SLL, 0, IP_PROTOCOL_TCP, SYSLOG_PORT, 1027,
+      TCP_FLAG_FIN | TCP_FLAG_ACK, "", 0 }
+  };
+
+  struct buffer capture;
+  start_pcap( &capture, LINKTYPE_LINUX_SLL );
+  for( int i = 0; i < 6; i++ )
+  {
+    add_pcap_packet( &capture, 2000000000 + i * 1000, &( segments[ i ] ) );
+  }
+
+  // The last two are only complete once the hole is filled
+  const char* const events[] = { "<13>one\n", "<14>two\n", "<15>three\n" };
+  const uint64_t times_ns[] = { 0, 2000000, 2000000 };
+  check_import( "TCP out of order", &capture, SYSLOG_PORT, CSENDER_FRAMING_LF,
+                events, times_ns, 3 );
+
+  // Reframed as asked
+  const char* const octet_counted_events[] =
+  {
+    "7 <13>one", "7 <14>two", "9 <15>three"
+  };
+  check_import( "TCP out of order, reframed", &capture, SYSLOG_PORT,
+                CSENDER_FRAMING_OCTET_COUNTING, octet_counted_events, times_ns,
+                3 );
+}
+
+
+// An octet counted stream, in reverse, in a pcapng capture with timestamps in
+// ns, and a datagram after it
+static void check_octet_counting_pcapng( void )
+{
+  // "9 <13>alpha14 <14>beta gamma", from sequence number 5001
+  struct test_packet packets[] =
+  {
+    { LINKTYPE_ETHERNET, 1, IP_PROTOCOL_TCP, SYSLOG_PORT, 5000, TCP_FLAG_SYN,
+      "", 0 },
+    { LINKTYPE_ETHERNET, 1, IP_PROTOCOL_TCP, SYSLOG_PORT, 5019, TCP_FLAG_ACK,
+      "beta gamma", 0 },
+    { LINKTYPE_ETHERNET, 1, IP_PROTOCOL_TCP, SYSLOG_PORT, 5009, TCP_FLAG_ACK,
+      "pha14 <14>", 0 },
+    { LINKTYPE_ETHERNET, 1, IP_PROTOCOL_TCP, SYSLOG_PORT, 5001, TCP_FLAG_ACK,
+      "9 <13>al", 0 },
+    { LINKTYPE_ETHERNET, 1, IP_PROTOCOL_UDP, SYSLOG_PORT, 0, 0,
+      "<11>delta", 0 }
+  };
+  uint64_t times_ns[] =
+  {
+    5000000000, 5000000100, 5000000200, 5000000323, 5000001200
+  };
+
+  struct buffer capture;
+  start_pcapng( &capture, LINKTYPE_ETHERNET );
+  for( int i = 0; i < 5; i++ )
+  {
+    add_pcapng_packet( &capture, times_ns[ i ], &( packets[ i ] ) );
+  }
+
+  const char* const events[] =
+  {
+    "9 <13>alpha", "14 <14>beta gamma", "9 <11>delta"
+  };
+  const uint64_t event_times_ns[] = { 0, 0, 877 };
+  check_import( "octet counting pcapng", &capture, SYSLOG_PORT,
+                CSENDER_FRAMING_OCTET_COUNTING, events, event_times_ns, 3 );
+}
+
+
+// Captures cut in the middle of a record keep the events before it, but not
+// those cut in their header
+static void check_truncated_captures( void )
+{
+  struct test_packet datagram =
+  {
+    LINKTYPE_ETHERNET, 0, IP_PROTOCOL_UDP, SYSLOG_PORT, 0, 0, "<13>kept", 0
+  };
+  const char* const events[] = { "<13>kept\n", "<13>kept\n" };
+  const uint64_t times_ns[] = { 0, 1000 };
+
+  struct buffer capture;
+  start_pcap( &capture, LINKTYPE_ETHERNET );
+  for( int i = 0; i < 3; i++ )
+  {
+    add_pcap_packet( &capture, 3000000000 + i, &datagram );
+  }
+  capture.length -= 5;
+  check_import( "pcap cut in a record", &capture, SYSLOG_PORT,
+                CSENDER_FRAMING_LF, events, times_ns, 2 );
+
+  // In the header of the last record, and then in that of the capture
+  capture.length = 24 + 2 * ( 16 + 50 ) + 10;
+  check_import( "pcap cut in a record header", &capture, SYSLOG_PORT,
+                CSENDER_FRAMING_LF, events, times_ns, 2 );
+  capture.length = 20;
+  check_import( "pcap cut in its header", &capture, SYSLOG_PORT,
+                CSENDER_FRAMING_LF, events, times_ns, -1 );
+
+  start_pcapng( &capture, LINKTYPE_ETHERNET );
+  for( int i = 0; i < 3; i++ )
+  {
+    add_pcapng_packet( &capture, 3000000000 + i * 1000, &datagram );
+  }
+  capture.length -= 30;
+  check_import( "pcapng cut in a block", &capture, SYSLOG_PORT,
+                CSENDER_FRAMING_LF, events, times_ns, 2 );
+}
+
+
+int main( )
+{
+  check_udp_over_vlans( );
+  check_tcp_out_of_order( );
+  check_octet_counting_pcapng( );
+  check_truncated_captures( );
+
+  if( g_num_failures > 0 )
+  {
+    printf( "%d checks failed\n", g_num_failures );
+    return 1;
+  }
+
+  printf( "All events match\n" );
+
+  return 0;
+}
@@ -0,0 +1,201 @@
+#define _GNU_SOURCE                     // timegm()
+
+#include "csender.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Checks the cached timestamps of csender_timestamp_rfc3339_at() against
+// those libc formats from scratch, across second rollovers, and across both
+// DST transitions of a zone that has them. Exits with 1 on any mismatch, or
+// with TEST_SKIPPED if the zone is not installed.
+
+#define TEST_TIMEZONE "Europe/Madrid"
+
+// Offset of the zone in summer, which it only has if loaded: libc falls back
+// to UTC otherwise
+#define TEST_TIMEZONE_SUMMER_OFFSET 7200
+
+// Tells ctest the test did not run (SKIP_RETURN_CODE)
+#define TEST_SKIPPED 77
+
+// Room for whatever libc formats, even if longer than a valid timestamp
+#define EXPECTED_TIMESTAMP_LENGTH 64
+
+static int g_num_failures = 0;
+
+
+// What the timestamp of the given instant should be, from localtime_r() or
+// gmtime_r(), and strftime()
+static void expected_timestamp( const struct timespec* ap_time,
+                                enum csender_timezone a_timezone,
+                                char* a_output_buffer )
+{
+  struct tm broken_down;
+  if( a_timezone == CSENDER_TIMEZONE_LOCAL )
+  {
+    localtime_r( &( ap_time->tv_sec ), &broken_down );
+  }
+  else
+  {
+    gmtime_r( &( ap_time->tv_sec ), &broken_down );
+  }
+
+  char date_time[ 32 ];
+  strftime( date_time, sizeof date_time, "%Y-%m-%dT%H:%M:%S", &broken_down );
+
+  // strftime() spells the offset as +hhmm; RFC 3339 as +hh:mm
+  char offset[ 8 ] = "Z";
+  if( a_timezone == CSENDER_TIMEZONE_LOCAL )
+  {
+    char numeric_offset[ 8 ];
+    strftime( numeric_offset, sizeof numeric_offset, "%z", &broken_down );
+    snprintf( offset,
+              sizeof offset,
+              "%.3s:%.2s",
+              numeric_offset,
+              numeric_offset + 3 );
+  }
+
+  snprintf( a_output_buffer,
+            EXPECTED_TIMESTAMP_LENGTH,
+            "%s.%06ld%s",
+            date_time,
+            ap_time->tv_nsec / 1000,
+            offset );
+}
+
+
+// Formats the instants around the end of the given UTC second, with a fresh
+// context, and checks every timestamp, and that the second is only told to
+// have changed at the rollover
+static void check_rollover( enum csender_timezone a_timezone,
+                            int a_year,
+                            int a_month,
+                            int a_day,
+                            int a_hour,
+                            int a_minute,
+                            int a_second )
+{
+  struct tm utc_time;
+  memset( &utc_time, 0, sizeof utc_time );
+  utc_time.tm_year = a_year - 1900;
+  utc_time.tm_mon = a_month - 1;
+  utc_time.tm_mday = a_day;
+  utc_time.tm_hour = a_hour;
+  utc_time.tm_min = a_minute;
+  utc_time.tm_sec = a_second;
+  time_t second = timegm( &utc_time );
+
+  // The first one just primes the context
+  struct
+  {
+    time_t   seconds;
+    long     microseconds;
+    bool     second_changed;
+  } instants[] =
+  {
+    { second, 999990, false },
+    { second, 999998, false },
+    { second, 999999, false },
+    { second + 1, 0, true },
+    { second + 1, 1, false },
+    { second + 1, 999999, false },
+    { second + 2, 0, true }
+  };
+
+  struct csender_timestamp_context* p_context =
+      csender_timestamp_context_create( CSENDER_CLOCK_REALTIME,
+                                        a_timezone );
+  if( p_context == NULL )
+  {
+    printf( "FAIL: no timestamp context\n" );
+    g_num_failures++;
+    return;
+  }
+
+  int num_instants = sizeof instants / sizeof instants[ 0 ];
+  for( int i = 0; i < num_instants; i++ )
+  {
+    struct timespec time;
+    time.tv_sec = instants[ i ].seconds;
+    time.tv_nsec = instants[ i ].microseconds * 1000;
+
+    char timestamp[ CSENDER_DATETIME_LENGTH ];
+    bool second_changed = false;
+    int length = csender_timestamp_rfc3339_at( p_context,
+                                               &time,
+                                               timestamp,
+                                               &second_changed );
+
+    char expected[ EXPECTED_TIMESTAMP_LENGTH ];
+    expected_timestamp( &time, a_timezone, expected );
+    if( length != ( int ) strlen( expected ) ||
+        strcmp( timestamp, expected ) != 0 )
+    {
+      printf( "FAIL: %ld.%06ld formatted as %s, instead of %s\n",
+              ( long ) time.tv_sec,
+              ( long ) instants[ i ].microseconds,
+              ( length < 0 ) ? "(error)" : timestamp,
+              expected );
+      g_num_failures++;
+    }
+    else if( i > 0 && second_changed != instants[ i ].second_changed )
+    {
+      printf( "FAIL: %s told the second %s\n",
+              timestamp,
+              second_changed ? "changed" : "did not change" );
+      g_num_failures++;
+    }
+  }
+
+  csender_timestamp_context_destroy( p_context );
+}
+
+
+int main( )
+{
+  setenv( "TZ", TEST_TIMEZONE, 1 );
+  tzset( );
+
+  // Without the zone, local time is just UTC, and DST is not tested at all
+  time_t summer = 1719835200;               // 2024-07-01T12:00:00Z
+  struct tm summer_time;
+  if( localtime_r( &summer, &summer_time ) == NULL ||
+      summer_time.tm_gmtoff != TEST_TIMEZONE_SUMMER_OFFSET )
+  {
+    printf( "SKIP: the %s time zone is not installed\n", TEST_TIMEZONE );
+    return TEST_SKIPPED;
+  }
+
+  enum csender_timezone timezones[] =
+  {
+    CSENDER_TIMEZONE_LOCAL, CSENDER_TIMEZONE_UTC
+  };
+  for( int i = 0; i < 2; i++ )
+  {
+    // Plain seconds, minutes, hours, days and years
+    check_rollover( timezones[ i ], 2024, 6, 15, 12, 30, 0 );
+    check_rollover( timezones[ i ], 2024, 6, 15, 12, 59, 59 );
+    check_rollover( timezones[ i ], 2024, 2, 28, 22, 59, 59 );
+    check_rollover( timezones[ i ], 2024, 12, 31, 22, 59, 59 );
+    check_rollover( timezones[ i ], 2024, 12, 31, 23, 59, 59 );
+
+    // 02:00 CET becomes 03:00 CEST, and 03:00 CEST becomes 02:00 CET
+    check_rollover( timezones[ i ], 2024, 3, 31, 0, 59, 59 );
+    check_rollover( timezones[ i ], 2024, 10, 27, 0, 59, 59 );
+  }
+
+  if( g_num_failures > 0 )
+  {
+    printf( "%d checks failed\n", g_num_failures );
+    return 1;
+  }
+
+  printf( "All timestamps match\n" );
+
+  return 0;
+}